@@ -0,0 +1,566 @@
+/*
+ * Copyright (C) 2012 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "codecbench"
+#include <utils/Log.h>
+
+#include <binder/ProcessState.h>
+#include <media/stagefright/foundation/ABuffer.h>
+#include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/foundation/ALooper.h>
+#include <media/stagefright/foundation/AMessage.h>
+#include <media/stagefright/foundation/AString.h>
+#include <media/stagefright/DataSource.h>
+#include <media/stagefright/MediaCodec.h>
+#include <media/stagefright/MediaErrors.h>
+#include <media/stagefright/NuMediaExtractor.h>
+#include <utils/KeyedVector.h>
+#include <utils/Vector.h>
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+#include <time.h>
+
+// Drives a number of decoder instances concurrently, each on its own
+// thread and as fast as the codec accepts input, and reports throughput,
+// latency from queueing an input buffer to receiving the corresponding
+// output, CPU time and memory high-water mark.
+//
+// CPU time is measured for the whole process, the codecs' threads can't be
+// told apart from each other, so it is only reported for all instances
+// together. Software codecs live in this process, so the CPU time reported covers
+// the codecs themselves. For hardware codecs it only covers the client.
+
+static void usage(const char *me) {
+    fprintf(stderr, "usage: %s [-a] decode audio instead of video\n"
+                    "\t\t[-n instances] number of concurrent decoders (default: 1)\n"
+                    "\t\t[-r repeat] number of passes over each file (default: 1)\n"
+                    "\t\t[-j] print the results as JSON\n"
+                    "\t\tfile [file ...]\n"
+                    "Instance i decodes file (i modulo number of files).\n",
+                    me);
+
+    exit(1);
+}
+
+namespace android {
+
+struct BenchInstance {
+    size_t mIndex;
+    const char *mPath;
+    bool mUseAudio;
+    int32_t mNumPasses;
+
+    pthread_t mThread;
+
+    AString mMime;
+    status_t mResult;
+
+    int64_t mNumBuffersDecoded;
+    int64_t mNumBytesDecoded;
+    int64_t mElapsedTimeUs;
+
+    // Time from queueing an input buffer to dequeueing the output buffer
+    // carrying the same timestamp, one entry per matched output buffer.
+    Vector<int64_t> mLatenciesUs;
+};
+
+static int64_t getCpuTimeUs() {
+    struct rusage usage;
+    CHECK_EQ(getrusage(RUSAGE_SELF, &usage), 0);
+
+    return (int64_t)(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000ll
+        + usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+}
+
+static int64_t getMaxResidentKb() {
+    struct rusage usage;
+    CHECK_EQ(getrusage(RUSAGE_SELF, &usage), 0);
+
+    return usage.ru_maxrss;
+}
+
+// Runs that fail right away can take less than a microsecond.
+static double perSecond(int64_t count, int64_t elapsedTimeUs) {
+    return (elapsedTimeUs > 0) ? count * 1E6 / elapsedTimeUs : 0.0;
+}
+
+static int compareInt64(const void *a, const void *b) {
+    int64_t x = *(const int64_t *)a;
+    int64_t y = *(const int64_t *)b;
+
+    return (x < y) ? -1 : ((x > y) ? 1 : 0);
+}
+
+// "latencies" must be sorted.
+static int64_t percentile(const Vector<int64_t> &latencies, int32_t p) {
+    if (latencies.isEmpty()) {
+        return -1;
+    }
+
+    size_t index = (latencies.size() - 1) * p / 100;
+
+    return latencies.itemAt(index);
+}
+
+static void sortLatencies(Vector<int64_t> *latencies) {
+    if (!latencies->isEmpty()) {
+        qsort(latencies->editArray(), latencies->size(), sizeof(int64_t),
+              compareInt64);
+    }
+}
+
+static status_t runInstance(BenchInstance *instance) {
+    static const int64_t kTimeoutUs = 5000ll;
+
+    sp<NuMediaExtractor> extractor = new NuMediaExtractor;
+    if (extractor->setDataSource(instance->mPath) != OK) {
+        ALOGE("unable to instantiate extractor for '%s'", instance->mPath);
+        return UNKNOWN_ERROR;
+    }
+
+    sp<AMessage> format;
+    bool found = false;
+    for (size_t i = 0; i < extractor->countTracks(); ++i) {
+        CHECK_EQ(extractor->getTrackFormat(i, &format), (status_t)OK);
+
+        AString mime;
+        CHECK(format->findString("mime", &mime));
+
+        if (!strncasecmp(mime.c_str(), instance->mUseAudio ? "audio/" : "video/", 6)) {
+            CHECK_EQ(extractor->selectTrack(i), (status_t)OK);
+            instance->mMime = mime;
+            found = true;
+            break;
+        }
+    }
+
+    if (!found) {
+        ALOGE("no %s track in '%s'",
+              instance->mUseAudio ? "audio" : "video", instance->mPath);
+        return ERROR_UNSUPPORTED;
+    }
+
+    int64_t durationUs;
+    if (!format->findInt64("durationUs", &durationUs)) {
+        durationUs = 0;
+    }
+
+    sp<ALooper> looper = new ALooper;
+    looper->setName("codecbench");
+    looper->start();
+
+    sp<MediaCodec> codec = MediaCodec::CreateByType(
+            looper, instance->mMime.c_str(), false /* encoder */);
+
+    if (codec == NULL) {
+        ALOGE("unable to instantiate a decoder for '%s'",
+              instance->mMime.c_str());
+        looper->stop();
+        return ERROR_UNSUPPORTED;
+    }
+
+    CHECK_EQ(codec->configure(
+                format, NULL /* nativeWindow */, NULL /* crypto */,
+                0 /* flags */),
+             (status_t)OK);
+
+    CHECK_EQ(codec->start(), (status_t)OK);
+
+    Vector<sp<ABuffer> > inBuffers;
+    CHECK_EQ(codec->getInputBuffers(&inBuffers), (status_t)OK);
+
+    // Timestamps are shifted by a multiple of this on every pass, so that
+    // they stay unique across passes.
+    int64_t passOffsetUs = durationUs + 1000000ll;
+
+    KeyedVector<int64_t, int64_t> queueTimeUsByTimestamp;
+
+    int32_t pass = 0;
+    bool signalledInputEOS = false;
+    bool sawOutputEOS = false;
+
+    int64_t startTimeUs = ALooper::GetNowUs();
+
+    while (!sawOutputEOS) {
+        bool progressed = false;
+
+        // Keep every input buffer the codec hands out busy.
+        while (!signalledInputEOS) {
+            size_t index;
+            status_t err = codec->dequeueInputBuffer(&index);
+
+            if (err == -EAGAIN) {
+                break;
+            }
+            CHECK_EQ(err, (status_t)OK);
+
+            progressed = true;
+
+            const sp<ABuffer> &buffer = inBuffers.itemAt(index);
+
+            int64_t timeUs;
+            err = extractor->getSampleTime(&timeUs);
+
+            if (err != OK && ++pass < instance->mNumPasses) {
+                CHECK_EQ(extractor->seekTo(0), (status_t)OK);
+                err = extractor->getSampleTime(&timeUs);
+            }
+
+            if (err != OK) {
+                CHECK_EQ(codec->queueInputBuffer(
+                            index, 0 /* offset */, 0 /* size */,
+                            0ll /* timeUs */, MediaCodec::BUFFER_FLAG_EOS),
+                         (status_t)OK);
+
+                signalledInputEOS = true;
+                break;
+            }
+
+            CHECK_EQ(extractor->readSampleData(buffer), (status_t)OK);
+
+            timeUs += pass * passOffsetUs;
+            queueTimeUsByTimestamp.add(timeUs, ALooper::GetNowUs());
+
+            CHECK_EQ(codec->queueInputBuffer(
+                        index, 0 /* offset */, buffer->size(), timeUs,
+                        0 /* flags */),
+                     (status_t)OK);
+
+            extractor->advance();
+        }
+
+        // Drain whatever output is ready, and wait briefly for more only
+        // if nothing at all could be done in this round.
+        for (;;) {
+            size_t index;
+            size_t offset;
+            size_t size;
+            int64_t timeUs;
+            uint32_t flags;
+            status_t err = codec->dequeueOutputBuffer(
+                    &index, &offset, &size, &timeUs, &flags,
+                    progressed ? 0ll : kTimeoutUs);
+
+            if (err == -EAGAIN) {
+                break;
+            }
+
+            progressed = true;
+
+            if (err == INFO_OUTPUT_BUFFERS_CHANGED
+                    || err == INFO_FORMAT_CHANGED) {
+                continue;
+            }
+            CHECK_EQ(err, (status_t)OK);
+
+            if (size > 0) {
+                ++instance->mNumBuffersDecoded;
+                instance->mNumBytesDecoded += size;
+
+                ssize_t i = queueTimeUsByTimestamp.indexOfKey(timeUs);
+                if (i >= 0) {
+                    instance->mLatenciesUs.push(
+                            ALooper::GetNowUs()
+                                - queueTimeUsByTimestamp.valueAt(i));
+
+                    queueTimeUsByTimestamp.removeItemsAt(i);
+                }
+
+                // Output comes in presentation order, anything queued with
+                // an earlier timestamp was dropped by the codec.
+                size_t numDropped = 0;
+                while (numDropped < queueTimeUsByTimestamp.size()
+                        && queueTimeUsByTimestamp.keyAt(numDropped) < timeUs) {
+                    ++numDropped;
+                }
+                queueTimeUsByTimestamp.removeItemsAt(0, numDropped);
+            }
+
+            CHECK_EQ(codec->releaseOutputBuffer(index), (status_t)OK);
+
+            if (flags & MediaCodec::BUFFER_FLAG_EOS) {
+                sawOutputEOS = true;
+                break;
+            }
+        }
+    }
+
+    instance->mElapsedTimeUs = ALooper::GetNowUs() - startTimeUs;
+
+    CHECK_EQ(codec->release(), (status_t)OK);
+    looper->stop();
+
+    sortLatencies(&instance->mLatenciesUs);
+
+    return OK;
+}
+
+static void *threadWrapper(void *me) {
+    BenchInstance *instance = static_cast<BenchInstance *>(me);
+
+    instance->mResult = runInstance(instance);
+
+    return NULL;
+}
+
+static void printText(
+        const Vector<BenchInstance *> &instances,
+        const Vector<int64_t> &allLatenciesUs,
+        int64_t elapsedTimeUs, int64_t cpuTimeUs, int64_t maxResidentKb) {
+    int64_t totalBuffers = 0;
+
+    for (size_t i = 0; i < instances.size(); ++i) {
+        const BenchInstance *instance = instances.itemAt(i);
+
+        if (instance->mResult != OK) {
+            printf("instance %zu (%s): failed (%d)\n",
+                   instance->mIndex, instance->mPath, instance->mResult);
+            continue;
+        }
+
+        totalBuffers += instance->mNumBuffersDecoded;
+
+        printf("instance %zu (%s, %s): %lld buffers in %lld us, "
+               "%.2f buffers/sec, latency p50 %lld us, p90 %lld us, "
+               "p99 %lld us\n",
+               instance->mIndex,
+               instance->mPath,
+               instance->mMime.c_str(),
+               instance->mNumBuffersDecoded,
+               instance->mElapsedTimeUs,
+               perSecond(instance->mNumBuffersDecoded, instance->mElapsedTimeUs),
+               percentile(instance->mLatenciesUs, 50),
+               percentile(instance->mLatenciesUs, 90),
+               percentile(instance->mLatenciesUs, 99));
+    }
+
+    printf("total: %lld buffers in %lld us, %.2f buffers/sec, "
+           "latency p50 %lld us, p90 %lld us, p99 %lld us\n",
+           totalBuffers,
+           elapsedTimeUs,
+           perSecond(totalBuffers, elapsedTimeUs),
+           percentile(allLatenciesUs, 50),
+           percentile(allLatenciesUs, 90),
+           percentile(allLatenciesUs, 99));
+
+    printf("cpu (whole process): %lld us (%.1f%% of one core)\n",
+           cpuTimeUs,
+           perSecond(cpuTimeUs, elapsedTimeUs) / 1E4);
+
+    printf("memory high-water: %lld KB\n", maxResidentKb);
+}
+
+static void printJSONString(const char *s) {
+    putchar('"');
+    for (; *s != '\0'; ++s) {
+        if (*s == '"' || *s == '\\') {
+            putchar('\\');
+            putchar(*s);
+        } else if ((unsigned char)*s < 0x20) {
+            printf("\\u%04x", *s);
+        } else {
+            putchar(*s);
+        }
+    }
+    putchar('"');
+}
+
+static void printJSONLatencies(const Vector<int64_t> &latenciesUs) {
+    printf("\"latency_us\": { \"p50\": %lld, \"p90\": %lld, \"p99\": %lld, "
+           "\"max\": %lld }",
+           percentile(latenciesUs, 50),
+           percentile(latenciesUs, 90),
+           percentile(latenciesUs, 99),
+           percentile(latenciesUs, 100));
+}
+
+static void printJSON(
+        const Vector<BenchInstance *> &instances,
+        const Vector<int64_t> &allLatenciesUs,
+        int64_t elapsedTimeUs, int64_t cpuTimeUs, int64_t maxResidentKb) {
+    int64_t totalBuffers = 0;
+
+    printf("{\n  \"instances\": [\n");
+
+    for (size_t i = 0; i < instances.size(); ++i) {
+        const BenchInstance *instance = instances.itemAt(i);
+
+        printf("    { \"index\": %zu, \"file\": ", instance->mIndex);
+        printJSONString(instance->mPath);
+        printf(", \"mime\": ");
+        printJSONString(instance->mMime.c_str());
+        printf(", \"status\": %d", instance->mResult);
+
+        if (instance->mResult == OK) {
+            totalBuffers += instance->mNumBuffersDecoded;
+
+            printf(", \"buffers\": %lld, \"bytes\": %lld, "
+                   "\"elapsed_us\": %lld, \"buffers_per_sec\": %.2f, ",
+                   instance->mNumBuffersDecoded,
+                   instance->mNumBytesDecoded,
+                   instance->mElapsedTimeUs,
+                   perSecond(instance->mNumBuffersDecoded,
+                             instance->mElapsedTimeUs));
+
+            printJSONLatencies(instance->mLatenciesUs);
+        }
+
+        printf(" }%s\n", (i + 1 < instances.size()) ? "," : "");
+    }
+
+    printf("  ],\n");
+    printf("  \"total\": { \"buffers\": %lld, \"elapsed_us\": %lld, "
+           "\"buffers_per_sec\": %.2f, ",
+           totalBuffers,
+           elapsedTimeUs,
+           perSecond(totalBuffers, elapsedTimeUs));
+    printJSONLatencies(allLatenciesUs);
+    printf(" },\n");
+
+    printf("  \"process_cpu_us\": %lld,\n", cpuTimeUs);
+    printf("  \"max_resident_kb\": %lld\n", maxResidentKb);
+    printf("}\n");
+}
+
+}  // namespace android
+
+int main(int argc, char **argv) {
+    using namespace android;
+
+    const char *me = argv[0];
+
+    bool useAudio = false;
+    bool printAsJSON = false;
+    int32_t numInstances = 1;
+    int32_t numPasses = 1;
+
+    int res;
+    while ((res = getopt(argc, argv, "han:r:j")) >= 0) {
+        switch (res) {
+            case 'a':
+            {
+                useAudio = true;
+                break;
+            }
+
+            case 'n':
+            {
+                numInstances = atoi(optarg);
+                if (numInstances < 1) {
+                    usage(me);
+                }
+                break;
+            }
+
+            case 'r':
+            {
+                numPasses = atoi(optarg);
+                if (numPasses < 1) {
+                    usage(me);
+                }
+                break;
+            }
+
+            case 'j':
+            {
+                printAsJSON = true;
+                break;
+            }
+
+            case '?':
+            case 'h':
+            default:
+            {
+                usage(me);
+            }
+        }
+    }
+
+    argc -= optind;
+    argv += optind;
+
+    if (argc < 1) {
+        usage(me);
+    }
+
+    ProcessState::self()->startThreadPool();
+
+    DataSource::RegisterDefaultSniffers();
+
+    Vector<BenchInstance *> instances;
+    for (int32_t i = 0; i < numInstances; ++i) {
+        BenchInstance *instance = new BenchInstance;
+        instance->mIndex = i;
+        instance->mPath = argv[i % argc];
+        instance->mUseAudio = useAudio;
+        instance->mNumPasses = numPasses;
+        instance->mResult = UNKNOWN_ERROR;
+        instance->mNumBuffersDecoded = 0;
+        instance->mNumBytesDecoded = 0;
+        instance->mElapsedTimeUs = 0;
+
+        instances.push(instance);
+    }
+
+    int64_t startCpuTimeUs = getCpuTimeUs();
+    int64_t startTimeUs = ALooper::GetNowUs();
+
+    for (size_t i = 0; i < instances.size(); ++i) {
+        BenchInstance *instance = instances.editItemAt(i);
+
+        CHECK_EQ(pthread_create(
+                    &instance->mThread, NULL, threadWrapper, instance), 0);
+    }
+
+    for (size_t i = 0; i < instances.size(); ++i) {
+        pthread_join(instances.itemAt(i)->mThread, NULL);
+    }
+
+    int64_t elapsedTimeUs = ALooper::GetNowUs() - startTimeUs;
+    int64_t cpuTimeUs = getCpuTimeUs() - startCpuTimeUs;
+    int64_t maxResidentKb = getMaxResidentKb();
+
+    Vector<int64_t> allLatenciesUs;
+    bool failed = false;
+    for (size_t i = 0; i < instances.size(); ++i) {
+        const BenchInstance *instance = instances.itemAt(i);
+
+        if (instance->mResult != OK) {
+            failed = true;
+            continue;
+        }
+
+        allLatenciesUs.appendVector(instance->mLatenciesUs);
+    }
+    sortLatencies(&allLatenciesUs);
+
+    if (printAsJSON) {
+        printJSON(instances, allLatenciesUs,
+                  elapsedTimeUs, cpuTimeUs, maxResidentKb);
+    } else {
+        printText(instances, allLatenciesUs,
+                  elapsedTimeUs, cpuTimeUs, maxResidentKb);
+    }
+
+    for (size_t i = 0; i < instances.size(); ++i) {
+        delete instances.editItemAt(i);
+    }
+
+    return failed ? 1 : 0;
+}
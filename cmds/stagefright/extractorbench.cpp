@@ -0,0 +1,436 @@
+/*
+ * Copyright (C) 2012 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "extractorbench"
+#include <utils/Log.h>
+
+#include <binder/ProcessState.h>
+#include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/foundation/ALooper.h>
+#include <media/stagefright/DataSource.h>
+#include <media/stagefright/MediaBuffer.h>
+#include <media/stagefright/MediaDefs.h>
+#include <media/stagefright/MediaErrors.h>
+#include <media/stagefright/MediaExtractor.h>
+#include <media/stagefright/MediaSource.h>
+#include <media/stagefright/MetaData.h>
+#include <utils/Vector.h>
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+// Reads all tracks of a local file to the end without decoding them and
+// reports the throughput, once with a single thread taking turns between
+// the tracks and once with a thread per track, the way a player pulls
+// audio and video concurrently.
+//
+// With -m it instead retrieves only the metadata of each file given, the
+// way the media scanner does, with and without lazy parsing. The two modes
+// take turns going first on every pass, and an untimed scan warms the page
+// cache beforehand, so that neither mode benefits from the reads of the
+// other.
+//
+// For cold cache numbers, run as root with -c, which drops the page cache
+// before every timed pass.
+
+static void usage(const char *me) {
+    fprintf(stderr, "usage: %s [-s] sequential reading only\n"
+                    "\t\t[-p] parallel reading only\n"
+                    "\t\t[-r repeat] number of passes per mode (default: 1)\n"
+                    "\t\t[-m] metadata scan of all files given\n"
+                    "\t\t[-c] drop the page cache before each pass (root)\n"
+                    "\t\tfile [file ...]\n",
+                    me);
+
+    exit(1);
+}
+
+namespace android {
+
+struct TrackReader {
+    sp<MediaSource> mSource;
+    const char *mMime;
+
+    pthread_t mThread;
+
+    status_t mResult;
+    int64_t mNumBuffers;
+    int64_t mNumBytes;
+};
+
+static void dropCaches() {
+    sync();
+
+    FILE *f = fopen("/proc/sys/vm/drop_caches", "w");
+    if (f == NULL) {
+        fprintf(stderr, "unable to drop the page cache, not running as root?\n");
+        exit(1);
+    }
+    fputs("3\n", f);
+    fclose(f);
+}
+
+static int64_t getCpuTimeUs() {
+    struct rusage usage;
+    CHECK_EQ(getrusage(RUSAGE_SELF, &usage), 0);
+
+    return (int64_t)(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000ll
+        + usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+}
+
+// Returns false once the track has been read to the end (or failed).
+static bool readOneBuffer(TrackReader *reader) {
+    MediaBuffer *buffer;
+    status_t err = reader->mSource->read(&buffer);
+
+    if (err != OK) {
+        reader->mResult = (err == ERROR_END_OF_STREAM) ? OK : err;
+        return false;
+    }
+
+    ++reader->mNumBuffers;
+    reader->mNumBytes += buffer->range_length();
+
+    buffer->release();
+    buffer = NULL;
+
+    return true;
+}
+
+static void *threadWrapper(void *me) {
+    TrackReader *reader = static_cast<TrackReader *>(me);
+
+    while (readOneBuffer(reader)) {
+    }
+
+    return NULL;
+}
+
+static status_t runPass(
+        const char *path, bool parallel,
+        int64_t *numBuffers, int64_t *numBytes) {
+    sp<DataSource> dataSource = DataSource::CreateFromURI(path);
+
+    if (dataSource == NULL) {
+        ALOGE("unable to create data source for '%s'", path);
+        return UNKNOWN_ERROR;
+    }
+
+    sp<MediaExtractor> extractor = MediaExtractor::Create(dataSource);
+
+    if (extractor == NULL) {
+        ALOGE("unable to instantiate extractor for '%s'", path);
+        return UNKNOWN_ERROR;
+    }
+
+    Vector<TrackReader> readers;
+    for (size_t i = 0; i < extractor->countTracks(); ++i) {
+        TrackReader reader;
+        reader.mSource = extractor->getTrack(i);
+
+        if (reader.mSource == NULL) {
+            continue;
+        }
+
+        CHECK(reader.mSource->getFormat()->findCString(
+                    kKeyMIMEType, &reader.mMime));
+
+        reader.mResult = UNKNOWN_ERROR;
+        reader.mNumBuffers = 0;
+        reader.mNumBytes = 0;
+
+        CHECK_EQ(reader.mSource->start(), (status_t)OK);
+
+        readers.push(reader);
+    }
+
+    if (parallel) {
+        pthread_attr_t attr;
+        pthread_attr_init(&attr);
+        pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_JOINABLE);
+
+        for (size_t i = 0; i < readers.size(); ++i) {
+            TrackReader *reader = &readers.editItemAt(i);
+            CHECK_EQ(pthread_create(
+                        &reader->mThread, &attr, threadWrapper, reader), 0);
+        }
+
+        pthread_attr_destroy(&attr);
+
+        for (size_t i = 0; i < readers.size(); ++i) {
+            void *dummy;
+            pthread_join(readers.itemAt(i).mThread, &dummy);
+        }
+    } else {
+        Vector<TrackReader *> active;
+        for (size_t i = 0; i < readers.size(); ++i) {
+            active.push(&readers.editItemAt(i));
+        }
+
+        while (!active.isEmpty()) {
+            for (size_t i = active.size(); i-- > 0;) {
+                if (!readOneBuffer(active.itemAt(i))) {
+                    active.removeAt(i);
+                }
+            }
+        }
+    }
+
+    status_t result = OK;
+    for (size_t i = 0; i < readers.size(); ++i) {
+        TrackReader *reader = &readers.editItemAt(i);
+
+        if (reader->mResult != OK) {
+            ALOGE("reading the %s track failed (%d)",
+                  reader->mMime, reader->mResult);
+            result = reader->mResult;
+        }
+
+        *numBuffers += reader->mNumBuffers;
+        *numBytes += reader->mNumBytes;
+
+        reader->mSource->stop();
+    }
+
+    return result;
+}
+
+static status_t runMode(
+        const char *path, bool parallel, int32_t numPasses, bool cold) {
+    int64_t numBuffers = 0;
+    int64_t numBytes = 0;
+    int64_t elapsedTimeUs = 0;
+    int64_t cpuTimeUs = 0;
+
+    for (int32_t pass = 0; pass < numPasses; ++pass) {
+        if (cold) {
+            dropCaches();
+        }
+
+        int64_t startCpuTimeUs = getCpuTimeUs();
+        int64_t startTimeUs = ALooper::GetNowUs();
+
+        status_t err = runPass(path, parallel, &numBuffers, &numBytes);
+
+        elapsedTimeUs += ALooper::GetNowUs() - startTimeUs;
+        cpuTimeUs += getCpuTimeUs() - startCpuTimeUs;
+
+        if (err != OK) {
+            return err;
+        }
+    }
+
+    printf("%s: %lld buffers, %lld bytes in %lld us, %.2f MB/sec, "
+           "%.2f buffers/sec, cpu %lld us\n",
+           parallel ? "parallel" : "sequential",
+           numBuffers,
+           numBytes,
+           elapsedTimeUs,
+           numBytes / (elapsedTimeUs / 1E6) / (1024.0 * 1024.0),
+           numBuffers * 1E6 / elapsedTimeUs,
+           cpuTimeUs);
+
+    return OK;
+}
+
+static status_t scanMetaData(const char *path, bool lazy) {
+    sp<DataSource> dataSource = DataSource::CreateFromURI(path);
+
+    if (dataSource == NULL) {
+        return UNKNOWN_ERROR;
+    }
+
+    sp<MediaExtractor> extractor = MediaExtractor::Create(dataSource);
+
+    if (extractor == NULL) {
+        return UNKNOWN_ERROR;
+    }
+
+    extractor->setLazyParsing(lazy);
+
+    // What StagefrightMetadataRetriever::parseMetaData() looks at.
+    extractor->getMetaData();
+
+    for (size_t i = 0; i < extractor->countTracks(); ++i) {
+        if (extractor->getTrackMetaData(i) == NULL) {
+            return UNKNOWN_ERROR;
+        }
+    }
+
+    return OK;
+}
+
+struct ScanStats {
+    int64_t mNumFiles;
+    int64_t mNumFailures;
+    int64_t mElapsedTimeUs;
+    int64_t mCpuTimeUs;
+};
+
+static void scanAll(
+        const char * const *paths, int numPaths, bool lazy, bool cold,
+        ScanStats *stats) {
+    if (cold) {
+        dropCaches();
+    }
+
+    int64_t startCpuTimeUs = getCpuTimeUs();
+    int64_t startTimeUs = ALooper::GetNowUs();
+
+    for (int i = 0; i < numPaths; ++i) {
+        if (scanMetaData(paths[i], lazy) != OK) {
+            ++stats->mNumFailures;
+        }
+
+        ++stats->mNumFiles;
+    }
+
+    stats->mElapsedTimeUs += ALooper::GetNowUs() - startTimeUs;
+    stats->mCpuTimeUs += getCpuTimeUs() - startCpuTimeUs;
+}
+
+static void printScanStats(bool lazy, const ScanStats &stats) {
+    printf("%s parsing: %lld files (%lld failed) in %lld us, "
+           "%.2f files/sec, cpu %lld us\n",
+           lazy ? "lazy" : "full",
+           stats.mNumFiles,
+           stats.mNumFailures,
+           stats.mElapsedTimeUs,
+           stats.mNumFiles * 1E6 / stats.mElapsedTimeUs,
+           stats.mCpuTimeUs);
+}
+
+static void runMetaDataScan(
+        const char * const *paths, int numPaths, int32_t numPasses,
+        bool cold) {
+    ScanStats full, lazy;
+    memset(&full, 0, sizeof(full));
+    memset(&lazy, 0, sizeof(lazy));
+
+    if (!cold) {
+        // Whichever mode went first would otherwise pay for the disk reads.
+        ScanStats warmup;
+        memset(&warmup, 0, sizeof(warmup));
+        scanAll(paths, numPaths, false /* lazy */, false /* cold */, &warmup);
+    }
+
+    for (int32_t pass = 0; pass < numPasses; ++pass) {
+        bool lazyFirst = (pass & 1) != 0;
+
+        scanAll(paths, numPaths, lazyFirst, cold,
+                lazyFirst ? &lazy : &full);
+        scanAll(paths, numPaths, !lazyFirst, cold,
+                lazyFirst ? &full : &lazy);
+    }
+
+    printScanStats(false /* lazy */, full);
+    printScanStats(true /* lazy */, lazy);
+}
+
+}  // namespace android
+
+int main(int argc, char **argv) {
+    using namespace android;
+
+    const char *me = argv[0];
+
+    bool runSequential = true;
+    bool runParallel = true;
+    bool scanOnly = false;
+    bool cold = false;
+    int32_t numPasses = 1;
+
+    int res;
+    while ((res = getopt(argc, argv, "hspr:mc")) >= 0) {
+        switch (res) {
+            case 's':
+            {
+                runParallel = false;
+                break;
+            }
+
+            case 'p':
+            {
+                runSequential = false;
+                break;
+            }
+
+            case 'r':
+            {
+                numPasses = atoi(optarg);
+                if (numPasses < 1) {
+                    usage(me);
+                }
+                break;
+            }
+
+            case 'm':
+            {
+                scanOnly = true;
+                break;
+            }
+
+            case 'c':
+            {
+                cold = true;
+                break;
+            }
+
+            case '?':
+            case 'h':
+            default:
+            {
+                usage(me);
+            }
+        }
+    }
+
+    argc -= optind;
+    argv += optind;
+
+    if (argc < 1 || (!scanOnly && argc != 1)
+            || (!runSequential && !runParallel)) {
+        usage(me);
+    }
+
+    ProcessState::self()->startThreadPool();
+
+    DataSource::RegisterDefaultSniffers();
+
+    if (scanOnly) {
+        runMetaDataScan(argv, argc, numPasses, cold);
+
+        return 0;
+    }
+
+    if (runSequential
+            && runMode(argv[0], false /* parallel */, numPasses, cold)
+                != OK) {
+        return 1;
+    }
+
+    if (runParallel
+            && runMode(argv[0], true /* parallel */, numPasses, cold)
+                != OK) {
+        return 1;
+    }
+
+    return 0;
+}
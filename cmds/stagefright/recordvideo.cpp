@@ -26,6 +26,7 @@
 #include <media/stagefright/OMXClient.h>
 #include <media/stagefright/OMXCodec.h>
 #include <media/MediaPlayerInterface.h>
+#include <cutils/properties.h>
 
 using namespace android;
 
@@ -44,6 +45,8 @@ static void usage(const char *me) {
     fprintf(stderr, "       -p encoder profile. see omx il header (default: encoder specific)\n");
     fprintf(stderr, "       -v video codec: [0] AVC [1] M4V [2] H263 (default: 0)\n");
     fprintf(stderr, "       -s(oftware) prefer software codec\n");
+    fprintf(stderr, "       -m(oving) generate moving content instead of a blank picture\n");
+    fprintf(stderr, "       -j number of software AVC encoder threads (default: number of cores)\n");
     fprintf(stderr, "The output file is /sdcard/output.mp4\n");
     exit(1);
 }
@@ -51,12 +54,14 @@ static void usage(const char *me) {
 class DummySource : public MediaSource {
 
 public:
-    DummySource(int width, int height, int nFrames, int fps, int colorFormat)
+    DummySource(int width, int height, int nFrames, int fps, int colorFormat,
+                bool moving)
         : mWidth(width),
           mHeight(height),
           mMaxNumFrames(nFrames),
           mFrameRate(fps),
           mColorFormat(colorFormat),
+          mMoving(moving),
           mSize((width * height * 3) / 2) {
 
         mGroup.add_buffer(new MediaBuffer(mSize));
@@ -101,6 +106,11 @@ public:
         // read() much faster.
         //char x = (char)((double)rand() / RAND_MAX * 255);
         //memset((*buffer)->data(), x, mSize);
+        if (mMoving) {
+            // A textured picture panning diagonally, so that motion
+            // estimation has actual work to do.
+            generateFrame((uint8_t *)(*buffer)->data());
+        }
         (*buffer)->set_range(0, mSize);
         (*buffer)->meta_data()->clear();
         (*buffer)->meta_data()->setInt64(
@@ -119,9 +129,24 @@ private:
     int mMaxNumFrames;
     int mFrameRate;
     int mColorFormat;
+    bool mMoving;
     size_t mSize;
     int64_t mNumFramesOutput;;
 
+    void generateFrame(uint8_t *data) {
+        int dx = mNumFramesOutput * 3;
+        int dy = mNumFramesOutput * 2;
+        for (int y = 0; y < mHeight; ++y) {
+            uint8_t *row = data + y * mWidth;
+            for (int x = 0; x < mWidth; ++x) {
+                int u = x + dx;
+                int v = y + dy;
+                row[x] = (uint8_t)(((u ^ v) & 0x3f) + ((u * v) >> 6));
+            }
+        }
+        memset(data + mWidth * mHeight, 0x80, mSize - mWidth * mHeight);
+    }
+
     DummySource(const DummySource &);
     DummySource &operator=(const DummySource &);
 };
@@ -164,10 +189,12 @@ int main(int argc, char **argv) {
     int codec = 0;
     const char *fileName = "/sdcard/output.mp4";
     bool preferSoftwareCodec = false;
+    bool movingContent = false;
+    int numEncoderThreads = -1;  // Encoder default
 
     android::ProcessState::self()->startThreadPool();
     int res;
-    while ((res = getopt(argc, argv, "b:c:f:i:n:w:t:l:p:v:hs")) >= 0) {
+    while ((res = getopt(argc, argv, "b:c:f:i:n:w:t:l:p:v:j:hsm")) >= 0) {
         switch (res) {
             case 'b':
             {
@@ -241,6 +268,21 @@ int main(int argc, char **argv) {
                 break;
             }
 
+            case 'm':
+            {
+                movingContent = true;
+                break;
+            }
+
+            case 'j':
+            {
+                numEncoderThreads = atoi(optarg);
+                if (numEncoderThreads < 1) {
+                    usage(argv[0]);
+                }
+                break;
+            }
+
             case 'h':
             default:
             {
@@ -250,12 +292,30 @@ int main(int argc, char **argv) {
         }
     }
 
+    // The property is global, it's put back the way it was once encoding
+    // is done so that later encoders are not affected.
+    char savedEncoderThreads[PROPERTY_VALUE_MAX];
+    bool restoreEncoderThreads = false;
+    if (numEncoderThreads > 0) {
+        // Picked up by the software AVC encoder when it is started.
+        property_get("media.stagefright.avcenc-threads", savedEncoderThreads, "");
+
+        char value[PROPERTY_VALUE_MAX];
+        snprintf(value, sizeof(value), "%d", numEncoderThreads);
+        if (property_set("media.stagefright.avcenc-threads", value) != 0) {
+            fprintf(stderr, "failed to set the number of encoder threads\n");
+        } else {
+            restoreEncoderThreads = true;
+        }
+    }
+
     OMXClient client;
     CHECK_EQ(client.connect(), (status_t)OK);
 
     status_t err = OK;
     sp<MediaSource> source =
-        new DummySource(width, height, nFrames, frameRateFps, colorFormat);
+        new DummySource(width, height, nFrames, frameRateFps, colorFormat,
+                        movingContent);
 
     sp<MetaData> enc_meta = new MetaData;
     switch (codec) {
@@ -299,6 +359,10 @@ int main(int argc, char **argv) {
     err = writer->stop();
     int64_t end = systemTime();
 
+    if (restoreEncoderThreads) {
+        property_set("media.stagefright.avcenc-threads", savedEncoderThreads);
+    }
+
     fprintf(stderr, "$\n");
     client.disconnect();
 
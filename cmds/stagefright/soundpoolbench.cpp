@@ -0,0 +1,256 @@
+/*
+ * Copyright (C) 2012 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "soundpoolbench"
+#include <utils/Log.h>
+
+#include <binder/ProcessState.h>
+#include <media/SoundPool.h>
+#include <utils/threads.h>
+#include <utils/Timers.h>
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Loads one sound into a SoundPool and plays it over and over the way a
+// game fires effects, reporting how long play() takes to return and how
+// long it takes from play() until the first sample of the sound has been
+// written to its AudioTrack.
+
+static void usage(const char *me) {
+    fprintf(stderr, "usage: %s [-n plays] number of sounds to play (default: 100)\n"
+                    "\t\t[-i interval] ms between plays (default: 50)\n"
+                    "\t\t[-c channels] SoundPool channels (default: 4)\n"
+                    "\t\t[-q srcQuality] (default: 0)\n"
+                    "\t\tfile\n",
+                    me);
+
+    exit(1);
+}
+
+namespace android {
+
+struct LoadState {
+    Mutex mLock;
+    Condition mCondition;
+    bool mDone;
+    int mStatus;
+};
+
+static void soundPoolCallback(
+        SoundPoolEvent event, SoundPool * /* soundPool */, void *user) {
+    LoadState *state = static_cast<LoadState *>(user);
+
+    if (event.mMsg == SoundPoolEvent::SAMPLE_LOADED) {
+        Mutex::Autolock autoLock(state->mLock);
+        state->mDone = true;
+        state->mStatus = event.mArg2;
+        state->mCondition.signal();
+    }
+}
+
+struct Stats {
+    Stats() : mCount(0), mTotal(0), mMin(0), mMax(0) {}
+
+    void add(nsecs_t value) {
+        if (mCount == 0 || value < mMin) {
+            mMin = value;
+        }
+        if (mCount == 0 || value > mMax) {
+            mMax = value;
+        }
+        mTotal += value;
+        ++mCount;
+    }
+
+    void print(const char *name) const {
+        if (mCount == 0) {
+            printf("%s: no samples\n", name);
+            return;
+        }
+
+        printf("%s: min %lld us, avg %lld us, max %lld us (%d samples)\n",
+               name,
+               ns2us(mMin),
+               ns2us(mTotal / mCount),
+               ns2us(mMax),
+               mCount);
+    }
+
+    int mCount;
+    nsecs_t mTotal;
+    nsecs_t mMin;
+    nsecs_t mMax;
+};
+
+static int run(const char *path, int numPlays, int intervalMs,
+        int numChannels, int srcQuality) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "unable to open '%s'\n", path);
+        return 1;
+    }
+
+    struct stat sb;
+    if (fstat(fd, &sb) != 0) {
+        close(fd);
+        return 1;
+    }
+
+    LoadState state;
+    state.mDone = false;
+    state.mStatus = -1;
+
+    SoundPool *soundPool =
+        new SoundPool(numChannels, AUDIO_STREAM_MUSIC, srcQuality);
+    soundPool->setCallback(soundPoolCallback, &state);
+
+    int64_t startTimeUs = ns2us(systemTime());
+    int sampleID = soundPool->load(fd, 0, sb.st_size, 1);
+    close(fd);
+
+    {
+        Mutex::Autolock autoLock(state.mLock);
+        while (!state.mDone) {
+            state.mCondition.wait(state.mLock);
+        }
+    }
+
+    if (state.mStatus != 0) {
+        fprintf(stderr, "unable to load '%s'\n", path);
+        delete soundPool;
+        return 1;
+    }
+
+    printf("loaded in %lld us\n", ns2us(systemTime()) - startTimeUs);
+
+    Stats playStats;
+    Stats startStats;
+    int numFailed = 0;
+
+    for (int i = 0; i < numPlays; ++i) {
+        nsecs_t playTime = systemTime();
+        int channelID = soundPool->play(sampleID, 1.0f, 1.0f, 1, 0, 1.0f);
+        playStats.add(systemTime() - playTime);
+
+        if (channelID == 0) {
+            ++numFailed;
+        } else {
+            // The latency is stamped by the track's callback, polling
+            // only decides how long we're willing to wait for it.
+            nsecs_t latency = -1;
+            nsecs_t deadline = playTime + milliseconds(500);
+            while ((latency = soundPool->startLatency(channelID)) < 0
+                    && systemTime() < deadline) {
+                usleep(1000);
+            }
+
+            if (latency < 0) {
+                ++numFailed;
+            } else {
+                startStats.add(latency);
+            }
+        }
+
+        nsecs_t next = playTime + milliseconds(intervalMs);
+        nsecs_t now = systemTime();
+        if (next > now) {
+            usleep(ns2us(next - now));
+        }
+    }
+
+    playStats.print("play()");
+    startStats.print("play() to first sample");
+    if (numFailed > 0) {
+        printf("%d of %d plays didn't start\n", numFailed, numPlays);
+    }
+
+    delete soundPool;
+
+    return 0;
+}
+
+}  // namespace android
+
+int main(int argc, char **argv) {
+    using namespace android;
+
+    const char *me = argv[0];
+
+    int numPlays = 100;
+    int intervalMs = 50;
+    int numChannels = 4;
+    int srcQuality = 0;
+
+    int res;
+    while ((res = getopt(argc, argv, "hn:i:c:q:")) >= 0) {
+        switch (res) {
+            case 'n':
+            {
+                numPlays = atoi(optarg);
+                if (numPlays < 1) {
+                    usage(me);
+                }
+                break;
+            }
+
+            case 'i':
+            {
+                intervalMs = atoi(optarg);
+                if (intervalMs < 0) {
+                    usage(me);
+                }
+                break;
+            }
+
+            case 'c':
+            {
+                numChannels = atoi(optarg);
+                if (numChannels < 1) {
+                    usage(me);
+                }
+                break;
+            }
+
+            case 'q':
+            {
+                srcQuality = atoi(optarg);
+                break;
+            }
+
+            case '?':
+            case 'h':
+            default:
+            {
+                usage(me);
+            }
+        }
+    }
+
+    argc -= optind;
+    argv += optind;
+
+    if (argc != 1) {
+        usage(me);
+    }
+
+    ProcessState::self()->startThreadPool();
+
+    return run(argv[0], numPlays, intervalMs, numChannels, srcQuality);
+}
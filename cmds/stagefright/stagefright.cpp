@@ -20,6 +20,7 @@
 
 #include <sys/time.h>
 
+#include <malloc.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
@@ -538,8 +539,14 @@ static void performSeekTest(const sp<MediaSource> &source) {
     int64_t durationUs;
     CHECK(source->getFormat()->findInt64(kKeyDuration, &durationUs));
 
+    int64_t totalSeekUs = 0;
+    int64_t maxSeekUs = 0;
+    int32_t numSeeks = 0;
+
     for (int64_t seekTimeUs = 0; seekTimeUs <= durationUs;
             seekTimeUs += 60000ll) {
+        int64_t startUs = getNowUs();
+
         MediaSource::ReadOptions options;
         options.setSeekTo(
                 seekTimeUs, MediaSource::ReadOptions::SEEK_PREVIOUS_SYNC);
@@ -571,11 +578,20 @@ static void performSeekTest(const sp<MediaSource> &source) {
             buffer = NULL;
         }
 
+        int64_t seekUs = getNowUs() - startUs;
+
         if (err == OK) {
             int64_t timeUs;
             CHECK(buffer->meta_data()->findInt64(kKeyTime, &timeUs));
 
-            printf("%lld\t%lld\t%lld\n", seekTimeUs, timeUs, seekTimeUs - timeUs);
+            printf("%lld\t%lld\t%lld\t%lld\n",
+                   seekTimeUs, timeUs, seekTimeUs - timeUs, seekUs);
+
+            totalSeekUs += seekUs;
+            if (seekUs > maxSeekUs) {
+                maxSeekUs = seekUs;
+            }
+            ++numSeeks;
 
             buffer->release();
             buffer = NULL;
@@ -585,6 +601,11 @@ static void performSeekTest(const sp<MediaSource> &source) {
         }
     }
 
+    if (numSeeks > 0) {
+        printf("%d seeks, avg %lld us, max %lld us\n",
+               numSeeks, totalSeekUs / numSeeks, maxSeekUs);
+    }
+
     CHECK_EQ((status_t)OK, source->stop());
 }
 
@@ -1017,6 +1038,9 @@ int main(int argc, char **argv) {
 
                 syncInfoPresent = false;
             } else {
+                int64_t startUs = getNowUs();
+                int heapBytes = mallinfo().uordblks;
+
                 extractor = MediaExtractor::Create(dataSource);
 
                 if (extractor == NULL) {
@@ -1024,6 +1048,13 @@ int main(int argc, char **argv) {
                     return -1;
                 }
 
+                if (seekTest) {
+                    printf("extractor created in %lld us, "
+                           "heap grew by %d bytes\n",
+                           getNowUs() - startUs,
+                           mallinfo().uordblks - heapBytes);
+                }
+
                 sp<MetaData> meta = extractor->getMetaData();
 
                 if (meta != NULL) {
@@ -37,6 +37,7 @@
 #include <gui/SurfaceComposerClient.h>
 
 #include <fcntl.h>
+#include <pthread.h>
 #include <ui/DisplayInfo.h>
 
 using namespace android;
@@ -294,13 +295,68 @@ private:
     DISALLOW_EVIL_CONSTRUCTORS(MyClient);
 };
 
+static volatile bool gStopLoad;
+
+// Keeps a core busy for as long as the stream plays, to see how playback
+// copes with a CPU starved decoder.
+static void *loadThread(void *) {
+    volatile uint32_t x = 0;
+    while (!gStopLoad) {
+        ++x;
+    }
+
+    return NULL;
+}
+
+static void usage(const char *me) {
+    fprintf(stderr, "usage: %s [-l threads] [-s] filename\n"
+                    "       -l keep this many threads spinning during playback\n"
+                    "       -s print the player's frame statistics at the end\n",
+                    me);
+}
+
 int main(int argc, char **argv) {
     android::ProcessState::self()->startThreadPool();
 
     DataSource::RegisterDefaultSniffers();
 
-    if (argc != 2) {
-        fprintf(stderr, "Usage: %s filename\n", argv[0]);
+    const char *me = argv[0];
+
+    int numLoadThreads = 0;
+    bool printStats = false;
+
+    int res;
+    while ((res = getopt(argc, argv, "hl:s")) >= 0) {
+        switch (res) {
+            case 'l':
+            {
+                char *end;
+                numLoadThreads = strtol(optarg, &end, 10);
+
+                if (*end != '\0' || numLoadThreads < 0) {
+                    usage(me);
+                    return 1;
+                }
+                break;
+            }
+
+            case 's':
+                printStats = true;
+                break;
+
+            case '?':
+            case 'h':
+            default:
+                usage(me);
+                return 1;
+        }
+    }
+
+    argc -= optind;
+    argv += optind;
+
+    if (argc != 1) {
+        usage(me);
         return 1;
     }
 
@@ -349,16 +405,16 @@ int main(int argc, char **argv) {
     bool usemp4 = property_get("media.stagefright.use-mp4source", prop, NULL) &&
             (!strcmp(prop, "1") || !strcasecmp(prop, "true"));
 
-    size_t len = strlen(argv[1]);
-    if ((!usemp4 && len >= 3 && !strcasecmp(".ts", &argv[1][len - 3])) ||
+    size_t len = strlen(argv[0]);
+    if ((!usemp4 && len >= 3 && !strcasecmp(".ts", &argv[0][len - 3])) ||
         (usemp4 && len >= 4 &&
-         (!strcasecmp(".mp4", &argv[1][len - 4])
-            || !strcasecmp(".3gp", &argv[1][len- 4])
-            || !strcasecmp(".3g2", &argv[1][len- 4])))) {
-        int fd = open(argv[1], O_RDONLY);
+         (!strcasecmp(".mp4", &argv[0][len - 4])
+            || !strcasecmp(".3gp", &argv[0][len- 4])
+            || !strcasecmp(".3g2", &argv[0][len- 4])))) {
+        int fd = open(argv[0], O_RDONLY);
 
         if (fd < 0) {
-            fprintf(stderr, "Failed to open file '%s'.", argv[1]);
+            fprintf(stderr, "Failed to open file '%s'.", argv[0]);
             return 1;
         }
 
@@ -366,7 +422,7 @@ int main(int argc, char **argv) {
     } else {
         printf("Converting file to transport stream for streaming...\n");
 
-        source = new MyConvertingStreamSource(argv[1]);
+        source = new MyConvertingStreamSource(argv[0]);
     }
 
     sp<IMediaPlayer> player =
@@ -374,10 +430,28 @@ int main(int argc, char **argv) {
 
     if (player != NULL && player->setDataSource(source) == NO_ERROR) {
         player->setVideoSurfaceTexture(surface->getSurfaceTexture());
+
+        Vector<pthread_t> loadThreads;
+        for (int i = 0; i < numLoadThreads; ++i) {
+            pthread_t thread;
+            CHECK_EQ(pthread_create(&thread, NULL, loadThread, NULL), 0);
+            loadThreads.push(thread);
+        }
+
         player->start();
 
         client->waitForEOS();
 
+        gStopLoad = true;
+        for (size_t i = 0; i < loadThreads.size(); ++i) {
+            pthread_join(loadThreads[i], NULL);
+        }
+
+        if (printStats) {
+            Vector<String16> args;
+            player->asBinder()->dump(STDOUT_FILENO, args);
+        }
+
         player->stop();
     } else {
         fprintf(stderr, "failed to instantiate player.\n");
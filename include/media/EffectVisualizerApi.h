@@ -0,0 +1,81 @@
+/*
+ * Copyright (C) 2012 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_EFFECTVISUALIZERAPI_H_
+#define ANDROID_EFFECTVISUALIZERAPI_H_
+
+#include <stdint.h>
+#include <audio_effects/effect_visualizer.h>
+
+#if __cplusplus
+extern "C" {
+#endif
+
+/////////////////////////////////////////////////
+//      Visualizer effect extensions
+/////////////////////////////////////////////////
+
+// Parameters and commands the framework visualizer (libvisualizer) supports
+// on top of those in audio_effects/effect_visualizer.h.
+
+enum visualizer_ext_params {
+    // uint32_t: combination of VISUALIZER_MEASUREMENT_MODE_* flags, what the
+    // effect measures on the audio in addition to capturing it
+    VISUALIZER_PARAM_MEASUREMENT_MODE = 0x100,
+};
+
+#define VISUALIZER_MEASUREMENT_MODE_NONE        0x0
+// peak and RMS level over the last half second or so
+#define VISUALIZER_MEASUREMENT_MODE_PEAK_RMS    0x1
+// magnitude spectrum of the current capture, in VISUALIZER_MEASUREMENT_BANDS
+// linearly spaced bands
+#define VISUALIZER_MEASUREMENT_MODE_FFT         0x2
+
+#define VISUALIZER_MEASUREMENT_BANDS            32
+
+// level reported for silence, in millibels
+#define VISUALIZER_MEASUREMENT_SILENCE_MB       (-9600)
+
+// reply to VISUALIZER_CMD_MEASURE, fields for modes not enabled are zero
+typedef struct visualizer_measurement_s {
+    int32_t     peakMb;     // peak level relative to full scale, in millibels
+    int32_t     rmsMb;      // RMS level relative to full scale, in millibels
+    uint16_t    bands[VISUALIZER_MEASUREMENT_BANDS]; // peak magnitude per band, low to high
+} visualizer_measurement_t;
+
+// header of the reply to VISUALIZER_CMD_READ, followed by "frames" 8 bit
+// unsigned mono samples
+typedef struct visualizer_read_header_s {
+    uint32_t    position;   // stream position after the samples returned
+    uint32_t    frames;     // number of samples returned
+    uint32_t    lost;       // samples overwritten before they could be read
+} visualizer_read_header_t;
+
+enum visualizer_ext_cmds {
+    // returns a visualizer_measurement_t for the enabled measurement modes
+    VISUALIZER_CMD_MEASURE = VISUALIZER_CMD_CAPTURE + 1,
+    // streaming capture: the command data is the uint32_t stream position
+    // returned by the previous read, the reply holds the samples captured
+    // since then, up to the reply size. Without command data, the read
+    // starts from the current position and returns no samples.
+    VISUALIZER_CMD_READ,
+};
+
+#if __cplusplus
+}  // extern "C"
+#endif
+
+#endif /*ANDROID_EFFECTVISUALIZERAPI_H_*/
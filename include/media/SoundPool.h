@@ -18,6 +18,7 @@
 #define SOUNDPOOL_H_
 
 #include <utils/threads.h>
+#include <utils/Timers.h>
 #include <utils/List.h>
 #include <utils/Vector.h>
 #include <utils/KeyedVector.h>
@@ -60,7 +61,7 @@ public:
     size_t size() { return mSize; }
     int state() { return mState; }
     uint8_t* data() { return static_cast<uint8_t*>(mData->pointer()); }
-    status_t doLoad();
+    status_t doLoad(uint32_t resampleRate);
     void startLoad() { mState = LOADING; }
     sp<IMemory> getIMemory() { return mData; }
 
@@ -90,9 +91,9 @@ class SoundEvent
 {
 public:
     SoundEvent() : mChannelID(0), mLeftVolume(0), mRightVolume(0),
-            mPriority(IDLE_PRIORITY), mLoop(0), mRate(0) {}
+            mPriority(IDLE_PRIORITY), mLoop(0), mRate(0), mPlayTime(0) {}
     void set(const sp<Sample>& sample, int channelID, float leftVolume,
-            float rightVolume, int priority, int loop, float rate);
+            float rightVolume, int priority, int loop, float rate, nsecs_t playTime);
     sp<Sample>      sample() { return mSample; }
     int             channelID() { return mChannelID; }
     float           leftVolume() { return mLeftVolume; }
@@ -100,6 +101,7 @@ public:
     int             priority() { return mPriority; }
     int             loop() { return mLoop; }
     float           rate() { return mRate; }
+    nsecs_t         playTime() { return mPlayTime; }
     void            clear() { mChannelID = 0; mSample.clear(); }
 
 protected:
@@ -110,6 +112,7 @@ protected:
     int             mPriority;
     int             mLoop;
     float           mRate;
+    nsecs_t         mPlayTime;
 };
 
 // for channels aka AudioTracks
@@ -117,11 +120,13 @@ class SoundChannel : public SoundEvent {
 public:
     enum state { IDLE, RESUMING, STOPPING, PAUSED, PLAYING };
     SoundChannel() : mAudioTrack(NULL), mState(IDLE), mNumChannels(1),
-            mPos(0), mToggle(0), mAutoPaused(false) {}
+            mPos(0), mToggle(0), mAutoPaused(false), mTrackSampleRate(0),
+            mTrackFrameCount(0), mTrackFormat(AUDIO_FORMAT_DEFAULT), mStopTime(0),
+            mCallbacksInFlight(0), mStartLatency(-1) {}
     ~SoundChannel();
     void init(SoundPool* soundPool);
     void play(const sp<Sample>& sample, int channelID, float leftVolume, float rightVolume,
-            int priority, int loop, float rate);
+            int priority, int loop, float rate, nsecs_t playTime);
     void setVolume_l(float leftVolume, float rightVolume);
     void setVolume(float leftVolume, float rightVolume);
     void stop_l();
@@ -138,6 +143,7 @@ public:
     void clearNextEvent() { mNextEvent.clear(); }
     void nextEvent();
     int nextChannelID() { return mNextEvent.channelID(); }
+    nsecs_t startLatency();
     void dump();
 
 private:
@@ -155,6 +161,23 @@ private:
     int                 mAudioBufferSize;
     unsigned long       mToggle;
     bool                mAutoPaused;
+
+    // what mAudioTrack was created for, a stopped track that matches the
+    // next sample is reused instead of creating a new one
+    uint32_t            mTrackSampleRate;
+    uint32_t            mTrackFrameCount;
+    audio_format_t      mTrackFormat;
+
+    // The callback user data can't change when a track is reused, so the
+    // toggle doesn't protect a restarted track from callbacks left over from
+    // its previous sound. A track is only reused once its callback thread is
+    // known to be done with it: nothing in (or waiting to enter) process(),
+    // and stopped for long enough that AudioTrack has paused the thread.
+    nsecs_t             mStopTime;
+    volatile int32_t    mCallbacksInFlight;
+
+    // from play() to the first sample written, -1 until then
+    nsecs_t             mStartLatency;
 };
 
 // application object for managing a pool of sounds
@@ -178,9 +201,17 @@ public:
     void setPriority(int channelID, int priority);
     void setLoop(int channelID, int loop);
     void setRate(int channelID, float rate);
+
+    // time from play() to the first sample of channelID being written to
+    // its track, or -1 if that hasn't happened (yet)
+    nsecs_t startLatency(int channelID);
+
     audio_stream_type_t streamType() const { return mStreamType; }
     int srcQuality() const { return mSrcQuality; }
 
+    // rate samples are converted to when loaded, 0 to keep their own
+    uint32_t resampleRate() const { return mResampleRate; }
+
     // called from SoundPoolThread
     void sampleLoaded(int sampleID);
 
@@ -199,7 +230,9 @@ private:
     SoundChannel* findChannel (int channelID);
     SoundChannel* findNextChannel (int channelID);
     SoundChannel* allocateChannel_l(int priority);
-    void moveToFront_l(SoundChannel* channel);
+    void updateChannel_l(SoundChannel* channel, int priority, uint32_t order);
+    void siftChannel_l(size_t index);
+    void swapChannels_l(size_t a, size_t b);
     void notify(SoundPoolEvent event);
     void dump();
 
@@ -215,13 +248,30 @@ private:
     Condition               mCondition;
     SoundPoolThread*        mDecodeThread;
     SoundChannel*           mChannelPool;
-    List<SoundChannel*>     mChannels;
+    // Channels in a binary min-heap on (priority, order of allocation or,
+    // for idle channels, of stopping), so the one to steal is always at
+    // the top. mHeapIndex maps a channel's
+    // position in mChannelPool to its entry.
+    struct ChannelEntry {
+        int             priority;
+        uint32_t        order;
+        SoundChannel*   channel;
+
+        bool operator<(const ChannelEntry& other) const {
+            return priority < other.priority
+                    || (priority == other.priority && order < other.order);
+        }
+    };
+    Vector<ChannelEntry>    mChannelHeap;
+    Vector<size_t>          mHeapIndex;
+    uint32_t                mNextOrder;
     List<SoundChannel*>     mRestart;
     List<SoundChannel*>     mStop;
     DefaultKeyedVector< int, sp<Sample> >   mSamples;
     int                     mMaxChannels;
     audio_stream_type_t     mStreamType;
     int                     mSrcQuality;
+    uint32_t                mResampleRate;
     int                     mAllocated;
     int                     mNextSampleID;
     int                     mNextChannelID;
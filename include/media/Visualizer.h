@@ -19,6 +19,7 @@
 
 #include <media/AudioEffect.h>
 #include <audio_effects/effect_visualizer.h>
+#include <media/EffectVisualizerApi.h>
 #include <string.h>
 
 /**
@@ -43,6 +44,11 @@
  * In addition to the polling capture mode, a callback mode is also available by installing a
  * callback function by use of the setCaptureCallBack() method. The rate at which the callback
  * is called as well as the type of data returned is specified.
+ * Clients that only need levels or a coarse spectrum can instead enable a measurement mode with
+ * setMeasurementMode() and call getMeasurement(): peak, RMS and band magnitudes are then computed
+ * by the effect and returned in a few bytes.
+ * Clients that want every sample rather than periodic snapshots can call readStream() at a low
+ * rate: each call returns all samples captured since the previous one.
  * Before capturing data, the Visualizer must be enabled by calling the setEnabled() method.
  * When data capture is not needed any more, the Visualizer should be disabled.
  */
@@ -123,6 +129,21 @@ public:
     // are returned
     status_t getFft(uint8_t *fft);
 
+    // set what the effect measures on the audio, a combination of
+    // VISUALIZER_MEASUREMENT_MODE_PEAK_RMS and VISUALIZER_MEASUREMENT_MODE_FFT
+    status_t setMeasurementMode(uint32_t mode);
+    uint32_t getMeasurementMode() { return mMeasurementMode; }
+
+    // return the measurements enabled by setMeasurementMode(). Levels are in millibels relative
+    // to full scale, VISUALIZER_MEASUREMENT_SILENCE_MB when nothing is playing.
+    status_t getMeasurement(visualizer_measurement_t *measurement);
+
+    // return up to size 8 bit unsigned mono samples captured since the previous call, in order
+    // and without overlap. The first call after the Visualizer is enabled starts the stream and
+    // returns no samples. *lost is set to the number of samples that were overwritten before
+    // they could be read.
+    status_t readStream(uint8_t *buffer, uint32_t size, uint32_t *frames, uint32_t *lost = NULL);
+
 protected:
     // from IEffectClient
     virtual void controlStatusChanged(bool controlGranted);
@@ -160,6 +181,9 @@ private:
     void *mCaptureCbkUser;
     sp<CaptureThread> mCaptureThread;
     uint32_t mCaptureFlags;
+    uint32_t mMeasurementMode;
+    bool mStreamStarted;
+    uint32_t mStreamPosition;
 };
 
 
@@ -30,6 +30,7 @@
 namespace android {
 
 struct ABuffer;
+struct CodecObserver;
 struct MemoryDealer;
 
 struct ACodec : public AHierarchicalStateMachine {
@@ -59,6 +60,10 @@ struct ACodec : public AHierarchicalStateMachine {
     void initiateStart();
 
     void signalRequestIDRFrame();
+    void signalSetParameters(const sp<AMessage> &params);
+
+    // Describes the idle decoder components kept around for reuse.
+    static void DumpComponentPool(AString *out);
 
     struct PortDescription : public RefBase {
         size_t countBuffers();
@@ -105,6 +110,7 @@ private:
         kWhatConfigureComponent      = 'conf',
         kWhatStart                   = 'star',
         kWhatRequestIDRFrame         = 'ridr',
+        kWhatSetParameters           = 'setP',
     };
 
     enum {
@@ -159,6 +165,7 @@ private:
     uint32_t mQuirks;
     sp<IOMX> mOMX;
     IOMX::node_id mNode;
+    sp<CodecObserver> mObserver;
     sp<MemoryDealer> mDealer[2];
 
     sp<ANativeWindow> mNativeWindow;
@@ -172,6 +179,10 @@ private:
     bool mSentFormat;
     bool mIsEncoder;
 
+    // Set once an error was signalled, the component is not handed to
+    // the next codec after that.
+    bool mComponentFailed;
+
     bool mShutdownInProgress;
 
     // If "mKeepComponentAllocated" we only transition back to Loaded state
@@ -252,6 +263,8 @@ private:
 
     status_t pushBlankBuffersToNativeWindow();
 
+    bool isComponentPoolable() const;
+
     // Returns true iff all buffers on the given port have status OWNED_BY_US.
     bool allYourBuffersAreBelongToUs(OMX_U32 portIndex);
 
@@ -269,6 +282,7 @@ private:
             status_t internalError = UNKNOWN_ERROR);
 
     status_t requestIDRFrame();
+    status_t setParameters(const sp<AMessage> &params);
 
     DISALLOW_EVIL_CONSTRUCTORS(ACodec);
 };
@@ -20,12 +20,13 @@
 
 #include <media/MediaPlayerInterface.h>
 #include <media/stagefright/MediaBuffer.h>
+#include <media/stagefright/MediaSource.h>
 #include <media/stagefright/TimeSource.h>
+#include <pthread.h>
 #include <utils/threads.h>
 
 namespace android {
 
-class MediaSource;
 class AudioTrack;
 class AwesomePlayer;
 
@@ -50,6 +51,11 @@ public:
 
     status_t start(bool sourceAlreadyStarted = false);
 
+    // Starts decoding ahead without opening the audio sink, a later
+    // start() then has PCM ready for the very first callback. Used to
+    // line up the next player for a gapless transition.
+    status_t preroll(bool sourceAlreadyStarted = false);
+
     void pause(bool playPendingSamples = false);
     void resume();
 
@@ -69,15 +75,62 @@ public:
 
 private:
     friend class VideoEditorAudioPlayer;
+
+    // Marks the position in the PCM ring where a new input buffer starts,
+    // or where the source ran dry.
+    struct Marker {
+        uint32_t mPos;
+        int32_t mGeneration;
+        int64_t mMediaTimeUs;
+        bool mEOS;
+        status_t mFinalStatus;
+    };
+
+    enum {
+        kMaxMarkers = 128,
+    };
+
     sp<MediaSource> mSource;
     AudioTrack *mAudioTrack;
 
+    // Owned by the decoder thread once it runs.
     MediaBuffer *mInputBuffer;
 
     int mSampleRate;
+    int32_t mNumChannels;
+    int32_t mChannelMask;
     int64_t mLatencyUs;
     size_t mFrameSize;
 
+    // Decoded PCM, written by the decoder thread and read by the audio
+    // callback without taking a lock. Positions are free running byte
+    // counts, the size is a power of two.
+    uint8_t *mRingData;
+    size_t mRingSize;
+    volatile int32_t mRingReadPos;
+    volatile int32_t mRingWritePos;
+
+    Marker mMarkers[kMaxMarkers];
+    volatile int32_t mMarkerReadIndex;
+    volatile int32_t mMarkerWriteIndex;
+
+    pthread_t mDecoderThread;
+    bool mDecoderThreadStarted;
+    Condition mDecoderCondition;
+    bool mDecoderExit;
+    bool mDecoderEOS;
+    bool mDecoderSeekPending;
+    int32_t mGeneration;
+
+    // Set by the decoder thread once it reads from the seek position,
+    // whatever the ring holds before mFlushPos is stale by then.
+    bool mFlushPending;
+    uint32_t mFlushPos;
+    int32_t mFlushGeneration;
+
+    bool mPrerolled;
+    bool mStartedSource;
+
     Mutex mLock;
     int64_t mNumFramesPlayed;
     int64_t mNumFramesPlayedSysTimeUs;
@@ -92,10 +145,6 @@ private:
 
     bool mStarted;
 
-    bool mIsFirstBuffer;
-    status_t mFirstBufferResult;
-    MediaBuffer *mFirstBuffer;
-
     sp<MediaPlayerBase::AudioSink> mAudioSink;
     bool mAllowDeepBuffering;       // allow audio deep audio buffers. Helps with low power audio
                                     // playback but implies high latency
@@ -111,6 +160,20 @@ private:
 
     size_t fillBuffer(void *data, size_t size);
 
+    status_t startDecoding(bool sourceAlreadyStarted);
+    void stopDecoding();
+
+    static void *DecoderThreadWrapper(void *me);
+    void decoderThread();
+
+    void decodeOneBuffer(MediaSource::ReadOptions *options);
+    bool queueReadResult(status_t err);
+    void writeInputBuffer();
+    bool canWrite() const;
+
+    void pushMarker(const Marker &marker);
+    size_t writeToRing(const uint8_t *data, size_t size);
+
     int64_t getRealTimeUsLocked() const;
 
     void reset();
@@ -108,6 +108,10 @@ struct MediaCodec : public AHandler {
 
     status_t requestIDRFrame();
 
+    // Applies parameter changes to a running codec, e.g. "videoBitrate"
+    // to retune an encoder's target bitrate without reconfiguring it.
+    status_t setParameters(const sp<AMessage> &params);
+
     // Notification will be posted once there "is something to do", i.e.
     // an input/output buffer has become available, a format change is
     // pending, an error is pending.
@@ -154,6 +158,7 @@ private:
         kWhatCodecNotify                    = 'codc',
         kWhatRequestIDRFrame                = 'ridr',
         kWhatRequestActivityNotification    = 'racN',
+        kWhatSetParameters                  = 'setP',
     };
 
     enum {
@@ -55,6 +55,13 @@ public:
     // CAN_SEEK_BACKWARD | CAN_SEEK_FORWARD | CAN_SEEK | CAN_PAUSE
     virtual uint32_t flags() const;
 
+    // Clients mostly after the metadata, like the media scanner, call this
+    // before anything else. Extractors may then postpone parsing what is
+    // only needed to read samples until getTrack() or getTrackMetaData()
+    // with kIncludeExtensiveMetaData asks for it, until then the track
+    // metadata may lack keys only needed for decoding (kKeyMaxInputSize).
+    virtual void setLazyParsing(bool lazy) {}
+
     // for DRM
     void setDrmFlag(bool flag) {
         mIsDrm = flag;
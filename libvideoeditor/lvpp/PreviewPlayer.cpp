@@ -151,16 +151,16 @@ PreviewPlayer::~PreviewPlayer() {
 }
 
 void PreviewPlayer::cancelPlayerEvents_l(bool updateProgressCb) {
-    mQueue.cancelEvent(mVideoEvent->eventID());
+    mQueue.cancelEvent(mVideoEvent);
     mVideoEventPending = false;
-    mQueue.cancelEvent(mStreamDoneEvent->eventID());
+    mQueue.cancelEvent(mStreamDoneEvent);
     mStreamDoneEventPending = false;
-    mQueue.cancelEvent(mCheckAudioStatusEvent->eventID());
+    mQueue.cancelEvent(mCheckAudioStatusEvent);
     mAudioStatusEventPending = false;
-    mQueue.cancelEvent(mVideoLagEvent->eventID());
+    mQueue.cancelEvent(mVideoLagEvent);
     mVideoLagEventPending = false;
     if (updateProgressCb) {
-        mQueue.cancelEvent(mProgressCbEvent->eventID());
+        mQueue.cancelEvent(mProgressCbEvent);
         mProgressCbEventPending = false;
     }
 }
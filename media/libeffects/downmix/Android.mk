@@ -26,3 +26,52 @@ LOCAL_C_INCLUDES := \
 LOCAL_PRELINK_MODULE := false
 
 include $(BUILD_SHARED_LIBRARY)
+
+# Downmix benchmark, compares the effect output with the per format folds and the SIMD fold
+# matrix kernels with the scalar one. The host build has no SIMD kernels, use the device build
+# below to check the NEON ones.
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= \
+	EffectDownmix.c \
+	tests/downmixbench.c
+
+LOCAL_STATIC_LIBRARIES := \
+	libcutils \
+	liblog
+
+LOCAL_MODULE:= downmixbench
+
+LOCAL_MODULE_TAGS := optional
+
+ifeq ($(HOST_OS),linux)
+LOCAL_LDLIBS += -lrt
+endif
+
+LOCAL_C_INCLUDES := \
+	$(LOCAL_PATH) \
+	$(call include-path-for, audio-effects) \
+	$(call include-path-for, audio-utils)
+
+include $(BUILD_HOST_EXECUTABLE)
+
+# Same benchmark for the device
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= \
+	EffectDownmix.c \
+	tests/downmixbench.c
+
+LOCAL_SHARED_LIBRARIES := \
+	libcutils
+
+LOCAL_MODULE:= downmixbench
+
+LOCAL_MODULE_TAGS := optional
+
+LOCAL_C_INCLUDES := \
+	$(LOCAL_PATH) \
+	$(call include-path-for, audio-effects) \
+	$(call include-path-for, audio-utils)
+
+include $(BUILD_EXECUTABLE)
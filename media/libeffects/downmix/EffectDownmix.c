@@ -22,12 +22,17 @@
 #include <stdbool.h>
 #include "EffectDownmix.h"
 
+#ifdef __ARM_NEON__
+#include <arm_neon.h>
+#endif
+
 // Do not submit with DOWNMIX_TEST_CHANNEL_INDEX defined, strictly for testing
 //#define DOWNMIX_TEST_CHANNEL_INDEX 0
 // Do not submit with DOWNMIX_ALWAYS_USE_GENERIC_DOWNMIXER defined, strictly for testing
 //#define DOWNMIX_ALWAYS_USE_GENERIC_DOWNMIXER 0
 
 #define MINUS_3_DB_IN_Q19_12 2896 // -3dB = 0.707 * 2^12 = 2896
+#define UNITY_GAIN_IN_Q19_12 4096
 
 typedef enum {
     CHANNEL_MASK_SURROUND = AUDIO_CHANNEL_OUT_SURROUND,
@@ -352,6 +357,19 @@ static int Downmix_Process(effect_handle_t self,
           }
           break;
 #endif
+        if (!pDownmixer->fold_supported) {
+            ALOGE("Multichannel configuration 0x%x is not supported", downmixInputChannelMask);
+            return -EINVAL;
+        }
+        {
+            // the vectorized kernels take whole groups of frames, the remainder (if any)
+            // goes through the code below
+            const size_t framesDone =
+                    Downmix_foldMatrixSimd(pDownmixer, pSrc, pDst, numFrames, accumulate);
+            pSrc += framesDone * pDownmixer->input_channel_count;
+            pDst += framesDone * 2;
+            numFrames -= framesDone;
+        }
         // optimize for the common formats
         switch((downmix_input_channel_mask_t)downmixInputChannelMask) {
         case CHANNEL_MASK_QUAD_BACK:
@@ -369,10 +387,11 @@ static int Downmix_Process(effect_handle_t self,
             Downmix_foldFrom7Point1(pSrc, pDst, numFrames, accumulate);
             break;
         default:
-            if (!Downmix_foldGeneric(
-                    downmixInputChannelMask, pSrc, pDst, numFrames, accumulate)) {
-                ALOGE("Multichannel configuration 0x%x is not supported", downmixInputChannelMask);
-                return -EINVAL;
+            // the generic fold is quicker than the matrix when there is no SIMD version
+            if (Downmix_isGenericFoldMask(downmixInputChannelMask)) {
+                Downmix_foldGeneric(downmixInputChannelMask, pSrc, pDst, numFrames, accumulate);
+            } else {
+                Downmix_foldMatrix(pDownmixer, pSrc, pDst, numFrames, accumulate);
             }
             break;
         }
@@ -663,6 +682,9 @@ int Downmix_Configure(downmix_module_t *pDwmModule, effect_config_t *pConfig, bo
         pDownmixer->input_channel_count = popcount(pConfig->inputCfg.channels);
     }
 
+    pDownmixer->fold_supported = Downmix_buildFoldMatrix(pConfig->inputCfg.channels,
+            pDownmixer->fold_left, pDownmixer->fold_right);
+
     Downmix_Reset(pDownmixer, init);
 
     return 0;
@@ -1030,6 +1052,22 @@ void Downmix_foldFrom7Point1(int16_t *pSrc, int16_t*pDst, size_t numFrames, bool
 }
 
 
+/*----------------------------------------------------------------------------
+ * Downmix_isGenericFoldMask()
+ *----------------------------------------------------------------------------
+ * Purpose:
+ * tell whether Downmix_foldGeneric() supports a channel mask, without logging anything
+ *
+ *----------------------------------------------------------------------------
+ */
+bool Downmix_isGenericFoldMask(uint32_t mask) {
+    return (mask & kUnsupported) == 0
+            && (mask & AUDIO_CHANNEL_OUT_STEREO) == AUDIO_CHANNEL_OUT_STEREO
+            && ((mask & kSides) == 0 || (mask & kSides) == kSides)
+            && ((mask & kBacks) == 0 || (mask & kBacks) == kBacks);
+}
+
+
 /*----------------------------------------------------------------------------
  * Downmix_foldGeneric()
  *----------------------------------------------------------------------------
@@ -1168,3 +1206,244 @@ bool Downmix_foldGeneric(
     }
     return true;
 }
+
+
+/*----------------------------------------------------------------------------
+ * Downmix_buildFoldMatrix()
+ *----------------------------------------------------------------------------
+ * Purpose:
+ * compute how much each channel of a multichannel signal contributes to the left and right
+ * channels of the downmix, with the same gains as the folds above:
+ *  - channels on the left (front, back, side, front left of center, top front and top back left)
+ *    go to the left channel at full gain, likewise for the right side
+ *  - channels in the middle (front, back and top centers, LFE) go to both channels at -3dB
+ * The result is then scaled down by 6dB when folding.
+ *
+ * Inputs:
+ *  mask       the channel mask of the signal to downmix
+ *
+ * Outputs:
+ *  pLeft      gain in Q19.12 applied to each channel, in channel order, for the left channel
+ *  pRight     same as pLeft for the right channel
+ *             both arrays must hold DOWNMIX_MAX_INPUT_CHANNELS gains
+ *
+ * Returns: false if the channel mask is not supported
+ *
+ *----------------------------------------------------------------------------
+ */
+bool Downmix_buildFoldMatrix(uint32_t mask, int16_t *pLeft, int16_t *pRight) {
+    if (mask == 0 || (mask & ~AUDIO_CHANNEL_OUT_ALL) != 0) {
+        ALOGE("Unsupported channel mask 0x%x", mask);
+        return false;
+    }
+
+    const uint32_t kLeft = AUDIO_CHANNEL_OUT_FRONT_LEFT |
+            AUDIO_CHANNEL_OUT_BACK_LEFT |
+            AUDIO_CHANNEL_OUT_SIDE_LEFT |
+            AUDIO_CHANNEL_OUT_FRONT_LEFT_OF_CENTER |
+            AUDIO_CHANNEL_OUT_TOP_FRONT_LEFT |
+            AUDIO_CHANNEL_OUT_TOP_BACK_LEFT;
+    const uint32_t kRight = AUDIO_CHANNEL_OUT_FRONT_RIGHT |
+            AUDIO_CHANNEL_OUT_BACK_RIGHT |
+            AUDIO_CHANNEL_OUT_SIDE_RIGHT |
+            AUDIO_CHANNEL_OUT_FRONT_RIGHT_OF_CENTER |
+            AUDIO_CHANNEL_OUT_TOP_FRONT_RIGHT |
+            AUDIO_CHANNEL_OUT_TOP_BACK_RIGHT;
+
+    memset(pLeft, 0, DOWNMIX_MAX_INPUT_CHANNELS * sizeof(int16_t));
+    memset(pRight, 0, DOWNMIX_MAX_INPUT_CHANNELS * sizeof(int16_t));
+
+    // samples are interleaved in the order of the channel mask bits, from the lowest
+    int index = 0;
+    uint32_t bit;
+    for (bit = 1; bit <= mask; bit <<= 1) {
+        if ((mask & bit) == 0) {
+            continue;
+        }
+        if (bit & kLeft) {
+            pLeft[index] = UNITY_GAIN_IN_Q19_12;
+        } else if (bit & kRight) {
+            pRight[index] = UNITY_GAIN_IN_Q19_12;
+        } else {
+            // centers and LFE
+            pLeft[index] = MINUS_3_DB_IN_Q19_12;
+            pRight[index] = MINUS_3_DB_IN_Q19_12;
+        }
+        index++;
+    }
+    return true;
+}
+
+
+/*----------------------------------------------------------------------------
+ * Downmix_foldMatrix()
+ *----------------------------------------------------------------------------
+ * Purpose:
+ * downmix to stereo a multichannel signal of any supported format, using the gains computed by
+ * Downmix_buildFoldMatrix(). Produces the same output as the folds above for the formats they
+ * handle.
+ *
+ * Inputs:
+ *  pDownmixer the downmixer holding the gains and channel count of pSrc
+ *  pSrc       multichannel audio buffer to downmix
+ *  numFrames  the number of multichannel frames to downmix
+ *  accumulate whether to mix (when true) the result of the downmix with the contents of pDst,
+ *               or overwrite pDst (when false)
+ *
+ * Outputs:
+ *  pDst       downmixed stereo audio samples
+ *
+ *----------------------------------------------------------------------------
+ */
+void Downmix_foldMatrix(downmix_object_t *pDownmixer,
+        int16_t *pSrc, int16_t*pDst, size_t numFrames, bool accumulate) {
+    const int numChan = pDownmixer->input_channel_count;
+    const int16_t *gainsLeft = pDownmixer->fold_left;
+    const int16_t *gainsRight = pDownmixer->fold_right;
+    int32_t lt, rt; // samples in Q19.12 format
+    int i;
+    // code is mostly duplicated between the two values of accumulate to avoid repeating the test
+    // for every sample
+    if (accumulate) {
+        while (numFrames) {
+            lt = 0;
+            rt = 0;
+            for (i = 0; i < numChan; i++) {
+                lt += pSrc[i] * gainsLeft[i];
+                rt += pSrc[i] * gainsRight[i];
+            }
+            // accumulate in destination
+            pDst[0] = clamp16(pDst[0] + (lt >> 13));
+            pDst[1] = clamp16(pDst[1] + (rt >> 13));
+            pSrc += numChan;
+            pDst += 2;
+            numFrames--;
+        }
+    } else {
+        while (numFrames) {
+            lt = 0;
+            rt = 0;
+            for (i = 0; i < numChan; i++) {
+                lt += pSrc[i] * gainsLeft[i];
+                rt += pSrc[i] * gainsRight[i];
+            }
+            // store in destination
+            pDst[0] = clamp16(lt >> 13); // differs from when accumulate is true above
+            pDst[1] = clamp16(rt >> 13); // differs from when accumulate is true above
+            pSrc += numChan;
+            pDst += 2;
+            numFrames--;
+        }
+    }
+}
+
+
+/*----------------------------------------------------------------------------
+ * Downmix_foldMatrixSimd()
+ *----------------------------------------------------------------------------
+ * Purpose:
+ * same as Downmix_foldMatrix(), 4 frames at a time, with SIMD instructions when the platform has
+ * them. Saturating the 32 bit sums to 16 bit gives the same result as clamp16(), the output is
+ * identical to Downmix_foldMatrix().
+ *
+ * Inputs:
+ *  pDownmixer the downmixer holding the gains and channel count of pSrc
+ *  pSrc       multichannel audio buffer to downmix
+ *  numFrames  the number of multichannel frames to downmix
+ *  accumulate whether to mix (when true) the result of the downmix with the contents of pDst,
+ *               or overwrite pDst (when false)
+ *
+ * Outputs:
+ *  pDst       downmixed stereo audio samples
+ *
+ * Returns: the number of frames downmixed, the caller downmixes the remaining ones
+ *
+ *----------------------------------------------------------------------------
+ */
+#ifdef __ARM_NEON__
+size_t Downmix_foldMatrixSimd(downmix_object_t *pDownmixer,
+        int16_t *pSrc, int16_t*pDst, size_t numFrames, bool accumulate) {
+    const int numChan = pDownmixer->input_channel_count;
+    const int16_t *gainsLeft = pDownmixer->fold_left;
+    const int16_t *gainsRight = pDownmixer->fold_right;
+    const size_t framesDone = numFrames & ~(size_t)3;
+    // the usual channel counts map onto the structure loads
+    const bool deinterleave = (numChan == 4) || (numChan == 6) || (numChan == 8);
+    int16x4_t chan[8]; // 4 consecutive samples of each channel
+    int32x4_t lt, rt; // samples in Q19.12 format
+    int i;
+
+    for (numFrames = framesDone; numFrames; numFrames -= 4) {
+        lt = vdupq_n_s32(0);
+        rt = vdupq_n_s32(0);
+
+        // deinterleave 4 frames
+        switch (numChan) {
+        case 4: {
+            const int16x4x4_t in = vld4_s16(pSrc);
+            for (i = 0; i < 4; i++) {
+                chan[i] = in.val[i];
+            }
+            } break;
+        case 6: {
+            // each vector holds channels i and i + 3 of every frame
+            const int16x8x3_t in = vld3q_s16(pSrc);
+            for (i = 0; i < 3; i++) {
+                const int16x8x2_t unzipped = vuzpq_s16(in.val[i], in.val[i]);
+                chan[i] = vget_low_s16(unzipped.val[0]);
+                chan[i + 3] = vget_low_s16(unzipped.val[1]);
+            }
+            } break;
+        case 8: {
+            // each vector holds channels i and i + 4 of every frame
+            const int16x8x4_t in = vld4q_s16(pSrc);
+            for (i = 0; i < 4; i++) {
+                const int16x8x2_t unzipped = vuzpq_s16(in.val[i], in.val[i]);
+                chan[i] = vget_low_s16(unzipped.val[0]);
+                chan[i + 4] = vget_low_s16(unzipped.val[1]);
+            }
+            } break;
+        default:
+            // gather each channel one sample at a time and mix it right away
+            for (i = 0; i < numChan; i++) {
+                int16x4_t samples = vdup_n_s16(0);
+                samples = vld1_lane_s16(pSrc + i, samples, 0);
+                samples = vld1_lane_s16(pSrc + numChan + i, samples, 1);
+                samples = vld1_lane_s16(pSrc + 2 * numChan + i, samples, 2);
+                samples = vld1_lane_s16(pSrc + 3 * numChan + i, samples, 3);
+                lt = vmlal_n_s16(lt, samples, gainsLeft[i]);
+                rt = vmlal_n_s16(rt, samples, gainsRight[i]);
+            }
+            break;
+        }
+        if (deinterleave) {
+            for (i = 0; i < numChan; i++) {
+                lt = vmlal_n_s16(lt, chan[i], gainsLeft[i]);
+                rt = vmlal_n_s16(rt, chan[i], gainsRight[i]);
+            }
+        }
+
+        lt = vshrq_n_s32(lt, 13);
+        rt = vshrq_n_s32(rt, 13);
+        if (accumulate) {
+            const int16x4x2_t dst = vld2_s16(pDst);
+            lt = vaddw_s16(lt, dst.val[0]);
+            rt = vaddw_s16(rt, dst.val[1]);
+        }
+        int16x4x2_t out;
+        out.val[0] = vqmovn_s32(lt);
+        out.val[1] = vqmovn_s32(rt);
+        vst2_s16(pDst, out);
+
+        pSrc += 4 * numChan;
+        pDst += 4 * 2;
+    }
+    return framesDone;
+}
+#else
+size_t Downmix_foldMatrixSimd(downmix_object_t *pDownmixer,
+        int16_t *pSrc, int16_t*pDst, size_t numFrames, bool accumulate) {
+    // the folds for each format are used instead
+    return 0;
+}
+#endif
@@ -28,6 +28,9 @@
 
 #define DOWNMIX_OUTPUT_CHANNELS AUDIO_CHANNEL_OUT_STEREO
 
+// one per channel position in AUDIO_CHANNEL_OUT_ALL
+#define DOWNMIX_MAX_INPUT_CHANNELS 18
+
 typedef enum {
     DOWNMIX_STATE_UNINITIALIZED,
     DOWNMIX_STATE_INITIALIZED,
@@ -40,6 +43,11 @@ typedef struct {
     downmix_type_t type;
     bool apply_volume_correction;
     uint8_t input_channel_count;
+    // false if the input channel mask can't be folded
+    bool fold_supported;
+    // contribution of each input channel to the left and right outputs, in Q19.12
+    int16_t fold_left[DOWNMIX_MAX_INPUT_CHANNELS];
+    int16_t fold_right[DOWNMIX_MAX_INPUT_CHANNELS];
 } downmix_object_t;
 
 
@@ -49,9 +57,9 @@ typedef struct downmix_module_s {
     downmix_object_t context;
 } downmix_module_t;
 
-const uint32_t kSides = AUDIO_CHANNEL_OUT_SIDE_LEFT | AUDIO_CHANNEL_OUT_SIDE_RIGHT;
-const uint32_t kBacks = AUDIO_CHANNEL_OUT_BACK_LEFT | AUDIO_CHANNEL_OUT_BACK_RIGHT;
-const uint32_t kUnsupported =
+static const uint32_t kSides = AUDIO_CHANNEL_OUT_SIDE_LEFT | AUDIO_CHANNEL_OUT_SIDE_RIGHT;
+static const uint32_t kBacks = AUDIO_CHANNEL_OUT_BACK_LEFT | AUDIO_CHANNEL_OUT_BACK_RIGHT;
+static const uint32_t kUnsupported =
         AUDIO_CHANNEL_OUT_FRONT_LEFT_OF_CENTER | AUDIO_CHANNEL_OUT_FRONT_RIGHT_OF_CENTER |
         AUDIO_CHANNEL_OUT_TOP_CENTER |
         AUDIO_CHANNEL_OUT_TOP_FRONT_LEFT |
@@ -105,5 +113,11 @@ void Downmix_foldFrom5Point1(int16_t *pSrc, int16_t*pDst, size_t numFrames, bool
 void Downmix_foldFrom7Point1(int16_t *pSrc, int16_t*pDst, size_t numFrames, bool accumulate);
 bool Downmix_foldGeneric(
         uint32_t mask, int16_t *pSrc, int16_t*pDst, size_t numFrames, bool accumulate);
+bool Downmix_isGenericFoldMask(uint32_t mask);
+bool Downmix_buildFoldMatrix(uint32_t mask, int16_t *pLeft, int16_t *pRight);
+void Downmix_foldMatrix(downmix_object_t *pDownmixer,
+        int16_t *pSrc, int16_t*pDst, size_t numFrames, bool accumulate);
+size_t Downmix_foldMatrixSimd(downmix_object_t *pDownmixer,
+        int16_t *pSrc, int16_t*pDst, size_t numFrames, bool accumulate);
 
 #endif /*ANDROID_EFFECTDOWNMIX_H_*/
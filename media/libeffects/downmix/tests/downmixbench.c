@@ -0,0 +1,341 @@
+/*
+ * Copyright (C) 2012 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "EffectDownmix.h"
+
+// Runs the downmix effect on random full scale audio for the common multichannel formats and a
+// few less common ones, in both buffer access modes, and reports how long processing takes and
+// whether the output differs from the per format folds the effect used to rely on.
+// Then checks Downmix_foldMatrixSimd() (followed by Downmix_foldMatrix() for the frames it leaves)
+// against Downmix_foldMatrix() alone for every channel count. Build it for the device to exercise
+// the NEON kernels, the host build only has the scalar stub.
+
+// from EffectDownmix.c
+int32_t DownmixLib_QueryEffect(uint32_t index, effect_descriptor_t *pDescriptor);
+int32_t DownmixLib_Create(const effect_uuid_t *uuid, int32_t sessionId, int32_t ioId,
+        effect_handle_t *pHandle);
+int32_t DownmixLib_Release(effect_handle_t handle);
+
+typedef void (*fold_t)(int16_t *pSrc, int16_t*pDst, size_t numFrames, bool accumulate);
+
+typedef struct {
+    const char *name;
+    uint32_t mask;
+    fold_t fold; // NULL to use Downmix_foldGeneric()
+    bool hasReference; // false if no fold handles this format
+} test_format_t;
+
+static const test_format_t kFormats[] = {
+    { "quad", AUDIO_CHANNEL_OUT_QUAD, Downmix_foldFromQuad, true },
+    { "quad side", AUDIO_CHANNEL_OUT_FRONT_LEFT | AUDIO_CHANNEL_OUT_FRONT_RIGHT |
+            AUDIO_CHANNEL_OUT_SIDE_LEFT | AUDIO_CHANNEL_OUT_SIDE_RIGHT,
+            Downmix_foldFromQuad, true },
+    { "surround", AUDIO_CHANNEL_OUT_SURROUND, Downmix_foldFromSurround, true },
+    { "5.1", AUDIO_CHANNEL_OUT_5POINT1, Downmix_foldFrom5Point1, true },
+    { "5.1 side", AUDIO_CHANNEL_OUT_FRONT_LEFT | AUDIO_CHANNEL_OUT_FRONT_RIGHT |
+            AUDIO_CHANNEL_OUT_FRONT_CENTER | AUDIO_CHANNEL_OUT_LOW_FREQUENCY |
+            AUDIO_CHANNEL_OUT_SIDE_LEFT | AUDIO_CHANNEL_OUT_SIDE_RIGHT,
+            Downmix_foldFrom5Point1, true },
+    { "7.1", AUDIO_CHANNEL_OUT_7POINT1, Downmix_foldFrom7Point1, true },
+    { "6.1", AUDIO_CHANNEL_OUT_5POINT1 | AUDIO_CHANNEL_OUT_BACK_CENTER, NULL, true },
+    { "8.1", AUDIO_CHANNEL_OUT_7POINT1 | AUDIO_CHANNEL_OUT_BACK_CENTER, NULL, true },
+    { "7.1 top front", AUDIO_CHANNEL_OUT_7POINT1 |
+            AUDIO_CHANNEL_OUT_TOP_FRONT_LEFT | AUDIO_CHANNEL_OUT_TOP_FRONT_RIGHT,
+            NULL, false },
+};
+
+static const int kNbFormats = sizeof(kFormats) / sizeof(kFormats[0]);
+
+static int64_t getNowUs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000ll + ts.tv_nsec / 1000;
+}
+
+static void usage(const char *me) {
+    fprintf(stderr, "usage: %s [-f frames] frames per buffer (default: 1024)\n"
+                    "\t\t[-n buffers] buffers processed per format (default: 2000)\n",
+                    me);
+
+    exit(1);
+}
+
+// returns the number of output samples that differ from the reference
+static int runFormat(const effect_uuid_t *uuid, const test_format_t *format,
+        size_t numFrames, int numBuffers, bool accumulate) {
+    const int numChan = popcount(format->mask);
+
+    effect_handle_t handle;
+    if (DownmixLib_Create(uuid, 0, 0, &handle) != 0) {
+        fprintf(stderr, "unable to create the downmix effect\n");
+        exit(1);
+    }
+
+    effect_config_t config;
+    memset(&config, 0, sizeof(config));
+    config.inputCfg.accessMode = EFFECT_BUFFER_ACCESS_READ;
+    config.inputCfg.format = AUDIO_FORMAT_PCM_16_BIT;
+    config.inputCfg.channels = format->mask;
+    config.inputCfg.samplingRate = 48000;
+    config.inputCfg.mask = EFFECT_CONFIG_ALL;
+    config.outputCfg.accessMode =
+            accumulate ? EFFECT_BUFFER_ACCESS_ACCUMULATE : EFFECT_BUFFER_ACCESS_WRITE;
+    config.outputCfg.format = AUDIO_FORMAT_PCM_16_BIT;
+    config.outputCfg.channels = AUDIO_CHANNEL_OUT_STEREO;
+    config.outputCfg.samplingRate = 48000;
+    config.outputCfg.mask = EFFECT_CONFIG_ALL;
+
+    int reply = 0;
+    uint32_t replySize = sizeof(reply);
+    (*handle)->command(handle, EFFECT_CMD_SET_CONFIG, sizeof(config), &config,
+            &replySize, &reply);
+    replySize = sizeof(reply);
+    (*handle)->command(handle, EFFECT_CMD_ENABLE, 0, NULL, &replySize, &reply);
+
+    int16_t *src = malloc(numFrames * numChan * sizeof(int16_t));
+    int16_t *initialDst = malloc(numFrames * 2 * sizeof(int16_t));
+    int16_t *dst = malloc(numFrames * 2 * sizeof(int16_t));
+    int16_t *refDst = malloc(numFrames * 2 * sizeof(int16_t));
+
+    int64_t effectTimeUs = 0;
+    int64_t refTimeUs = 0;
+    int mismatches = 0;
+    int i;
+    size_t j;
+
+    for (i = 0; i < numBuffers; i++) {
+        for (j = 0; j < numFrames * numChan; j++) {
+            src[j] = (int16_t)(rand() & 0xffff);
+        }
+        for (j = 0; j < numFrames * 2; j++) {
+            initialDst[j] = (int16_t)(rand() & 0xffff);
+        }
+
+        memcpy(dst, initialDst, numFrames * 2 * sizeof(int16_t));
+        audio_buffer_t in, out;
+        in.frameCount = numFrames;
+        in.s16 = src;
+        out.frameCount = numFrames;
+        out.s16 = dst;
+
+        int64_t startTimeUs = getNowUs();
+        if ((*handle)->process(handle, &in, &out) != 0) {
+            fprintf(stderr, "%s: process failed\n", format->name);
+            break;
+        }
+        effectTimeUs += getNowUs() - startTimeUs;
+
+        if (!format->hasReference) {
+            continue;
+        }
+
+        memcpy(refDst, initialDst, numFrames * 2 * sizeof(int16_t));
+        startTimeUs = getNowUs();
+        if (format->fold != NULL) {
+            format->fold(src, refDst, numFrames, accumulate);
+        } else {
+            Downmix_foldGeneric(format->mask, src, refDst, numFrames, accumulate);
+        }
+        refTimeUs += getNowUs() - startTimeUs;
+
+        for (j = 0; j < numFrames * 2; j++) {
+            if (dst[j] != refDst[j]) {
+                mismatches++;
+            }
+        }
+    }
+
+    if (format->hasReference) {
+        printf("%-14s %2d ch, %s: effect %lld us, fold %lld us, %d mismatches\n",
+                format->name, numChan, accumulate ? "accumulate" : "write",
+                (long long)effectTimeUs, (long long)refTimeUs, mismatches);
+    } else {
+        printf("%-14s %2d ch, %s: effect %lld us\n",
+                format->name, numChan, accumulate ? "accumulate" : "write",
+                (long long)effectTimeUs);
+    }
+
+    free(src);
+    free(initialDst);
+    free(dst);
+    free(refDst);
+    DownmixLib_Release(handle);
+
+    return mismatches;
+}
+
+// returns a random channel mask with numChan of the positions in AUDIO_CHANNEL_OUT_ALL, or the
+// lowest numChan positions when lowest is true
+static uint32_t makeMask(int numChan, bool lowest) {
+    uint32_t bits[DOWNMIX_MAX_INPUT_CHANNELS];
+    int numBits = 0;
+    uint32_t bit;
+    for (bit = 1; bit != 0 && bit <= AUDIO_CHANNEL_OUT_ALL; bit <<= 1) {
+        if (AUDIO_CHANNEL_OUT_ALL & bit) {
+            bits[numBits++] = bit;
+        }
+    }
+
+    uint32_t mask = 0;
+    int i;
+    for (i = 0; i < numChan; i++) {
+        // pick among the positions not taken yet, which are kept at the end of bits[]
+        const int pick = lowest ? i : i + rand() % (numBits - i);
+        mask |= bits[pick];
+        bits[pick] = bits[i];
+    }
+    return mask;
+}
+
+// returns the number of output samples where the SIMD fold differs from Downmix_foldMatrix()
+static int runMatrix(uint32_t mask, size_t numFrames, int numBuffers, bool accumulate) {
+    downmix_object_t downmixer;
+    memset(&downmixer, 0, sizeof(downmixer));
+    if (!Downmix_buildFoldMatrix(mask, downmixer.fold_left, downmixer.fold_right)) {
+        fprintf(stderr, "mask 0x%x: no fold matrix\n", mask);
+        return 1;
+    }
+    const int numChan = popcount(mask);
+    downmixer.input_channel_count = numChan;
+
+    // up to 3 extra frames so that the kernels also leave a remainder
+    const size_t maxFrames = numFrames + 3;
+    int16_t *src = malloc(maxFrames * numChan * sizeof(int16_t));
+    int16_t *initialDst = malloc(maxFrames * 2 * sizeof(int16_t));
+    int16_t *dst = malloc(maxFrames * 2 * sizeof(int16_t));
+    int16_t *refDst = malloc(maxFrames * 2 * sizeof(int16_t));
+
+    int64_t simdTimeUs = 0;
+    int64_t matrixTimeUs = 0;
+    int mismatches = 0;
+    int i;
+    size_t j;
+
+    for (i = 0; i < numBuffers; i++) {
+        const size_t frames = numFrames + i % 4;
+        for (j = 0; j < frames * numChan; j++) {
+            src[j] = (int16_t)(rand() & 0xffff);
+        }
+        for (j = 0; j < frames * 2; j++) {
+            initialDst[j] = (int16_t)(rand() & 0xffff);
+        }
+
+        memcpy(dst, initialDst, frames * 2 * sizeof(int16_t));
+        int64_t startTimeUs = getNowUs();
+        const size_t framesDone = Downmix_foldMatrixSimd(&downmixer, src, dst, frames, accumulate);
+        Downmix_foldMatrix(&downmixer, src + framesDone * numChan, dst + framesDone * 2,
+                frames - framesDone, accumulate);
+        simdTimeUs += getNowUs() - startTimeUs;
+
+        memcpy(refDst, initialDst, frames * 2 * sizeof(int16_t));
+        startTimeUs = getNowUs();
+        Downmix_foldMatrix(&downmixer, src, refDst, frames, accumulate);
+        matrixTimeUs += getNowUs() - startTimeUs;
+
+        for (j = 0; j < frames * 2; j++) {
+            if (dst[j] != refDst[j]) {
+                mismatches++;
+            }
+        }
+    }
+
+    printf("mask 0x%05x %2d ch, %s: simd %lld us, matrix %lld us, %d mismatches\n",
+            mask, numChan, accumulate ? "accumulate" : "write",
+            (long long)simdTimeUs, (long long)matrixTimeUs, mismatches);
+
+    free(src);
+    free(initialDst);
+    free(dst);
+    free(refDst);
+
+    return mismatches;
+}
+
+int main(int argc, char **argv) {
+    const char *me = argv[0];
+
+    size_t numFrames = 1024;
+    int numBuffers = 2000;
+
+    int res;
+    while ((res = getopt(argc, argv, "hf:n:")) >= 0) {
+        switch (res) {
+            case 'f':
+            {
+                int value = atoi(optarg);
+                if (value < 1) {
+                    usage(me);
+                }
+                numFrames = value;
+                break;
+            }
+
+            case 'n':
+            {
+                numBuffers = atoi(optarg);
+                if (numBuffers < 1) {
+                    usage(me);
+                }
+                break;
+            }
+
+            case '?':
+            case 'h':
+            default:
+            {
+                usage(me);
+            }
+        }
+    }
+
+    effect_descriptor_t desc;
+    if (DownmixLib_QueryEffect(0, &desc) != 0) {
+        fprintf(stderr, "unable to query the downmix effect\n");
+        return 1;
+    }
+
+    srand(1);
+
+    int mismatches = 0;
+    int i;
+    for (i = 0; i < kNbFormats; i++) {
+        mismatches += runFormat(&desc.uuid, &kFormats[i], numFrames, numBuffers, false);
+        mismatches += runFormat(&desc.uuid, &kFormats[i], numFrames, numBuffers, true);
+    }
+
+#ifdef __ARM_NEON__
+    printf("\nNEON fold matrix kernels\n");
+#else
+    printf("\nno SIMD fold matrix kernels, checking the scalar stub\n");
+#endif
+    int numChan;
+    for (numChan = 1; numChan <= DOWNMIX_MAX_INPUT_CHANNELS; numChan++) {
+        const uint32_t masks[2] = { makeMask(numChan, true), makeMask(numChan, false) };
+        for (i = 0; i < 2; i++) {
+            mismatches += runMatrix(masks[i], numFrames, numBuffers, false);
+            mismatches += runMatrix(masks[i], numFrames, numBuffers, true);
+        }
+    }
+
+    return mismatches == 0 ? 0 : 1;
+}
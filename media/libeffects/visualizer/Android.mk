@@ -10,14 +10,16 @@ LOCAL_CFLAGS+= -O2
 
 LOCAL_SHARED_LIBRARIES := \
 	libcutils \
-	libdl
+	libdl \
+	libaudioutils
 
 LOCAL_MODULE_PATH := $(TARGET_OUT_SHARED_LIBRARIES)/soundfx
 LOCAL_MODULE:= libvisualizer
 
 LOCAL_C_INCLUDES := \
 	$(call include-path-for, graphics corecg) \
-	$(call include-path-for, audio-effects)
+	$(call include-path-for, audio-effects) \
+	$(call include-path-for, audio-utils)
 
 
 include $(BUILD_SHARED_LIBRARY)
@@ -18,11 +18,14 @@
 //#define LOG_NDEBUG 0
 #include <cutils/log.h>
 #include <assert.h>
+#include <math.h>
 #include <stdlib.h>
 #include <string.h>
 #include <new>
 #include <time.h>
 #include <audio_effects/effect_visualizer.h>
+#include <audio_utils/fixedfft.h>
+#include <media/EffectVisualizerApi.h>
 
 
 extern "C" {
@@ -54,6 +57,20 @@ enum visualizer_state_e {
 
 #define CAPTURE_BUF_SIZE 65536 // "64k should be enough for everyone"
 
+// number of buffers peak and RMS are measured over, about half a second
+// with the usual 20 ms mixer buffers
+#define MEASUREMENT_WINDOW_SIZE_IN_BUFFERS 25
+
+// at most half of the capture buffer is returned by a streaming read, the
+// rest may be getting overwritten by process() as we copy
+#define MAX_READ_FRAMES (CAPTURE_BUF_SIZE / 2)
+
+struct BufferStats {
+    bool mIsValid;
+    uint16_t mPeakU16;      // absolute peak of the buffer
+    uint32_t mRmsSquared;   // mean of the squared samples
+};
+
 struct VisualizerContext {
     const struct effect_interface_s *mItfe;
     effect_config_t mConfig;
@@ -65,6 +82,12 @@ struct VisualizerContext {
     uint32_t mLatency;
     struct timespec mBufferUpdateTime;
     uint8_t mCaptureBuf[CAPTURE_BUF_SIZE];
+    // total number of samples captured, modulo 2^32. As CAPTURE_BUF_SIZE
+    // divides 2^32, the low bits are the position in mCaptureBuf.
+    uint32_t mFramesWritten;
+    uint32_t mMeasurementMode;
+    uint32_t mMeasurementBufferIdx;
+    BufferStats mPastMeasurements[MEASUREMENT_WINDOW_SIZE_IN_BUFFERS];
 };
 
 //
@@ -78,6 +101,13 @@ void Visualizer_reset(VisualizerContext *pContext)
     pContext->mBufferUpdateTime.tv_sec = 0;
     pContext->mLatency = 0;
     memset(pContext->mCaptureBuf, 0x80, CAPTURE_BUF_SIZE);
+    pContext->mFramesWritten = 0;
+    pContext->mMeasurementBufferIdx = 0;
+    for (uint32_t i = 0; i < MEASUREMENT_WINDOW_SIZE_IN_BUFFERS; i++) {
+        pContext->mPastMeasurements[i].mIsValid = false;
+        pContext->mPastMeasurements[i].mPeakU16 = 0;
+        pContext->mPastMeasurements[i].mRmsSquared = 0;
+    }
 }
 
 //----------------------------------------------------------------------------
@@ -167,12 +197,200 @@ int Visualizer_init(VisualizerContext *pContext)
 
     pContext->mCaptureSize = VISUALIZER_CAPTURE_SIZE_MAX;
     pContext->mScalingMode = VISUALIZER_SCALING_MODE_NORMALIZED;
+    pContext->mMeasurementMode = VISUALIZER_MEASUREMENT_MODE_NONE;
 
     Visualizer_setConfig(pContext, &pContext->mConfig);
 
     return 0;
 }
 
+// milliseconds since process() last updated the capture buffer, 0 if unknown
+uint32_t Visualizer_getDeltaTimeMsFromUpdatedTime(VisualizerContext *pContext)
+{
+    uint32_t deltaMs = 0;
+    if (pContext->mBufferUpdateTime.tv_sec != 0) {
+        struct timespec ts;
+        if (clock_gettime(CLOCK_MONOTONIC, &ts) == 0) {
+            time_t secs = ts.tv_sec - pContext->mBufferUpdateTime.tv_sec;
+            long nsec = ts.tv_nsec - pContext->mBufferUpdateTime.tv_nsec;
+            if (nsec < 0) {
+                --secs;
+                nsec += 1000000000;
+            }
+            deltaMs = secs * 1000 + nsec / 1000000;
+        }
+    }
+    return deltaMs;
+}
+
+//----------------------------------------------------------------------------
+// Visualizer_capture()
+//----------------------------------------------------------------------------
+// Purpose: Copy the mCaptureSize samples being played out, according to the
+//  latency set by the framework, or silence if playback has stalled.
+//
+// Inputs:
+//  pContext:   effect engine context
+//
+// Outputs:
+//  pCapture:   mCaptureSize 8 bit unsigned samples
+//
+//----------------------------------------------------------------------------
+
+void Visualizer_capture(VisualizerContext *pContext, uint8_t *pCapture)
+{
+    int32_t latencyMs = pContext->mLatency;
+    uint32_t deltaMs = Visualizer_getDeltaTimeMsFromUpdatedTime(pContext);
+    latencyMs -= deltaMs;
+    if (latencyMs < 0) {
+        latencyMs = 0;
+    }
+    uint32_t deltaSmpl = pContext->mConfig.inputCfg.samplingRate * latencyMs / 1000;
+
+    int32_t capturePoint = pContext->mCaptureIdx - pContext->mCaptureSize - deltaSmpl;
+    int32_t captureSize = pContext->mCaptureSize;
+    uint8_t *pDst = pCapture;
+    if (capturePoint < 0) {
+        int32_t size = -capturePoint;
+        if (size > captureSize) {
+            size = captureSize;
+        }
+        memcpy(pDst,
+               pContext->mCaptureBuf + CAPTURE_BUF_SIZE + capturePoint,
+               size);
+        pDst += size;
+        captureSize -= size;
+        capturePoint = 0;
+    }
+    memcpy(pDst,
+           pContext->mCaptureBuf + capturePoint,
+           captureSize);
+
+
+    // if audio framework has stopped playing audio although the effect is still
+    // active we must clear the capture buffer to return silence
+    if ((pContext->mLastCaptureIdx == pContext->mCaptureIdx) &&
+            (pContext->mBufferUpdateTime.tv_sec != 0)) {
+        if (deltaMs > MAX_STALL_TIME_MS) {
+            ALOGV("capture going to idle");
+            pContext->mBufferUpdateTime.tv_sec = 0;
+            memset(pCapture, 0x80, pContext->mCaptureSize);
+        }
+    }
+    pContext->mLastCaptureIdx = pContext->mCaptureIdx;
+}
+
+static int32_t Visualizer_toMillibels(double level)
+{
+    if (level < 1.0) {
+        return VISUALIZER_MEASUREMENT_SILENCE_MB;
+    }
+    int32_t mB = (int32_t)(2000.0 * log10(level / 32767.0));
+    return mB < VISUALIZER_MEASUREMENT_SILENCE_MB ? VISUALIZER_MEASUREMENT_SILENCE_MB : mB;
+}
+
+//----------------------------------------------------------------------------
+// Visualizer_measureLevels()
+//----------------------------------------------------------------------------
+// Purpose: Peak and RMS level over the buffers in the measurement window.
+//
+// Inputs:
+//  pContext:   effect engine context
+//
+// Outputs:
+//  pPeakMb:    peak level in millibels
+//  pRmsMb:     RMS level in millibels
+//
+//----------------------------------------------------------------------------
+
+void Visualizer_measureLevels(VisualizerContext *pContext, int32_t *pPeakMb, int32_t *pRmsMb)
+{
+    *pPeakMb = VISUALIZER_MEASUREMENT_SILENCE_MB;
+    *pRmsMb = VISUALIZER_MEASUREMENT_SILENCE_MB;
+
+    // nothing played for a while, the window holds stale values
+    if (pContext->mBufferUpdateTime.tv_sec == 0 ||
+            Visualizer_getDeltaTimeMsFromUpdatedTime(pContext) > MAX_STALL_TIME_MS) {
+        return;
+    }
+
+    uint16_t peakU16 = 0;
+    uint64_t sumRmsSquared = 0;
+    uint32_t nbValidMeasurements = 0;
+    for (uint32_t i = 0; i < MEASUREMENT_WINDOW_SIZE_IN_BUFFERS; i++) {
+        const BufferStats *stats = &pContext->mPastMeasurements[i];
+        if (!stats->mIsValid) {
+            continue;
+        }
+        if (stats->mPeakU16 > peakU16) {
+            peakU16 = stats->mPeakU16;
+        }
+        sumRmsSquared += stats->mRmsSquared;
+        nbValidMeasurements++;
+    }
+    if (nbValidMeasurements == 0) {
+        return;
+    }
+
+    *pPeakMb = Visualizer_toMillibels(peakU16);
+    *pRmsMb = Visualizer_toMillibels(sqrt((double)sumRmsSquared / nbValidMeasurements));
+}
+
+//----------------------------------------------------------------------------
+// Visualizer_measureSpectrum()
+//----------------------------------------------------------------------------
+// Purpose: Magnitude spectrum of the current capture, reduced to
+//  VISUALIZER_MEASUREMENT_BANDS bands holding the largest magnitude of the
+//  FFT bins they cover.
+//
+// Inputs:
+//  pContext:   effect engine context
+//
+// Outputs:
+//  pBands:     VISUALIZER_MEASUREMENT_BANDS magnitudes, low to high frequency
+//
+//----------------------------------------------------------------------------
+
+void Visualizer_measureSpectrum(VisualizerContext *pContext, uint16_t *pBands)
+{
+    uint32_t captureSize = pContext->mCaptureSize;
+    uint32_t numBins = captureSize >> 1;
+    uint8_t waveform[captureSize];
+    int32_t workspace[numBins];
+
+    memset(pBands, 0, VISUALIZER_MEASUREMENT_BANDS * sizeof(uint16_t));
+
+    Visualizer_capture(pContext, waveform);
+
+    // same input scaling as the framework's Visualizer::getFft()
+    int32_t nonzero = 0;
+    for (uint32_t i = 0; i < captureSize; i += 2) {
+        workspace[i >> 1] =
+                ((waveform[i] ^ 0x80) << 24) | ((waveform[i + 1] ^ 0x80) << 8);
+        nonzero |= workspace[i >> 1];
+    }
+    if (!nonzero) {
+        return;
+    }
+
+    fixed_fft_real(numBins, workspace);
+
+    uint32_t binsPerBand = numBins / VISUALIZER_MEASUREMENT_BANDS;
+    for (uint32_t band = 0; band < VISUALIZER_MEASUREMENT_BANDS; band++) {
+        uint32_t maxSquared = 0;
+        for (uint32_t bin = band * binsPerBand; bin < (band + 1) * binsPerBand; bin++) {
+            int32_t re = workspace[bin] >> 16;
+            int32_t im = (int16_t)workspace[bin];
+            uint32_t squared = (uint32_t)(re * re) + (uint32_t)(im * im);
+            if (squared > maxSquared) {
+                maxSquared = squared;
+            }
+        }
+        uint32_t magnitude = (uint32_t)sqrt((double)maxSquared);
+        pBands[band] = magnitude > 0xFFFF ? 0xFFFF : magnitude;
+    }
+}
+
 //
 //--- Effect Library Interface Implementation
 //
@@ -330,9 +548,29 @@ int Visualizer_process(
         buf[captIdx] = ((uint8_t)smp)^0x80;
     }
 
+    if (pContext->mMeasurementMode & VISUALIZER_MEASUREMENT_MODE_PEAK_RMS) {
+        int32_t peak = 0;
+        uint64_t sumSquares = 0;
+        int len = inBuffer->frameCount * 2;
+        for (int i = 0; i < len; i++) {
+            int32_t smp = inBuffer->s16[i];
+            sumSquares += smp * smp;
+            if (smp < 0) smp = -smp;
+            if (smp > peak) peak = smp;
+        }
+        BufferStats *stats = &pContext->mPastMeasurements[pContext->mMeasurementBufferIdx];
+        stats->mIsValid = true;
+        stats->mPeakU16 = (uint16_t)peak;
+        stats->mRmsSquared = (uint32_t)(sumSquares / len);
+        if (++pContext->mMeasurementBufferIdx >= MEASUREMENT_WINDOW_SIZE_IN_BUFFERS) {
+            pContext->mMeasurementBufferIdx = 0;
+        }
+    }
+
     // XXX the following two should really be atomic, though it probably doesn't
     // matter much for visualization purposes
     pContext->mCaptureIdx = captIdx;
+    pContext->mFramesWritten += inBuffer->frameCount;
     // update last buffer update time stamp
     if (clock_gettime(CLOCK_MONOTONIC, &pContext->mBufferUpdateTime) < 0) {
         pContext->mBufferUpdateTime.tv_sec = 0;
@@ -440,6 +678,12 @@ int Visualizer_command(effect_handle_t self, uint32_t cmdCode, uint32_t cmdSize,
             p->vsize = sizeof(uint32_t);
             *replySize += sizeof(uint32_t);
             break;
+        case VISUALIZER_PARAM_MEASUREMENT_MODE:
+            ALOGV("get mMeasurementMode = %d", pContext->mMeasurementMode);
+            *((uint32_t *)p->data + 1) = pContext->mMeasurementMode;
+            p->vsize = sizeof(uint32_t);
+            *replySize += sizeof(uint32_t);
+            break;
         default:
             p->status = -EINVAL;
         }
@@ -469,6 +713,22 @@ int Visualizer_command(effect_handle_t self, uint32_t cmdCode, uint32_t cmdSize,
             pContext->mLatency = *((uint32_t *)p->data + 1);
             ALOGV("set mLatency = %d", pContext->mLatency);
             break;
+        case VISUALIZER_PARAM_MEASUREMENT_MODE: {
+            uint32_t mode = *((uint32_t *)p->data + 1);
+            if (mode & ~(VISUALIZER_MEASUREMENT_MODE_PEAK_RMS | VISUALIZER_MEASUREMENT_MODE_FFT)) {
+                *(int32_t *)pReplyData = -EINVAL;
+                break;
+            }
+            if ((mode & VISUALIZER_MEASUREMENT_MODE_PEAK_RMS) &&
+                    !(pContext->mMeasurementMode & VISUALIZER_MEASUREMENT_MODE_PEAK_RMS)) {
+                // don't report levels from an earlier measurement
+                for (uint32_t i = 0; i < MEASUREMENT_WINDOW_SIZE_IN_BUFFERS; i++) {
+                    pContext->mPastMeasurements[i].mIsValid = false;
+                }
+            }
+            pContext->mMeasurementMode = mode;
+            ALOGV("set mMeasurementMode = %d", pContext->mMeasurementMode);
+            } break;
         default:
             *(int32_t *)pReplyData = -EINVAL;
         }
@@ -486,62 +746,80 @@ int Visualizer_command(effect_handle_t self, uint32_t cmdCode, uint32_t cmdSize,
             return -EINVAL;
         }
         if (pContext->mState == VISUALIZER_STATE_ACTIVE) {
-            int32_t latencyMs = pContext->mLatency;
-            uint32_t deltaMs = 0;
-            if (pContext->mBufferUpdateTime.tv_sec != 0) {
-                struct timespec ts;
-                if (clock_gettime(CLOCK_MONOTONIC, &ts) == 0) {
-                    time_t secs = ts.tv_sec - pContext->mBufferUpdateTime.tv_sec;
-                    long nsec = ts.tv_nsec - pContext->mBufferUpdateTime.tv_nsec;
-                    if (nsec < 0) {
-                        --secs;
-                        nsec += 1000000000;
-                    }
-                    deltaMs = secs * 1000 + nsec / 1000000;
-                    latencyMs -= deltaMs;
-                    if (latencyMs < 0) {
-                        latencyMs = 0;
-                    }
-                }
-            }
-            uint32_t deltaSmpl = pContext->mConfig.inputCfg.samplingRate * latencyMs / 1000;
-
-            int32_t capturePoint = pContext->mCaptureIdx - pContext->mCaptureSize - deltaSmpl;
-            int32_t captureSize = pContext->mCaptureSize;
-            if (capturePoint < 0) {
-                int32_t size = -capturePoint;
-                if (size > captureSize) {
-                    size = captureSize;
-                }
-                memcpy(pReplyData,
-                       pContext->mCaptureBuf + CAPTURE_BUF_SIZE + capturePoint,
-                       size);
-                pReplyData += size;
-                captureSize -= size;
-                capturePoint = 0;
-            }
-            memcpy(pReplyData,
-                   pContext->mCaptureBuf + capturePoint,
-                   captureSize);
-
-
-            // if audio framework has stopped playing audio although the effect is still
-            // active we must clear the capture buffer to return silence
-            if ((pContext->mLastCaptureIdx == pContext->mCaptureIdx) &&
-                    (pContext->mBufferUpdateTime.tv_sec != 0)) {
-                if (deltaMs > MAX_STALL_TIME_MS) {
-                    ALOGV("capture going to idle");
-                    pContext->mBufferUpdateTime.tv_sec = 0;
-                    memset(pReplyData, 0x80, pContext->mCaptureSize);
-                }
-            }
-            pContext->mLastCaptureIdx = pContext->mCaptureIdx;
+            Visualizer_capture(pContext, (uint8_t *)pReplyData);
         } else {
             memset(pReplyData, 0x80, pContext->mCaptureSize);
         }
 
         break;
 
+    case VISUALIZER_CMD_MEASURE: {
+        if (pReplyData == NULL || *replySize != sizeof(visualizer_measurement_t)) {
+            ALOGV("VISUALIZER_CMD_MEASURE() error *replySize %d", *replySize);
+            return -EINVAL;
+        }
+        visualizer_measurement_t *pMeasurement = (visualizer_measurement_t *)pReplyData;
+        memset(pMeasurement, 0, sizeof(visualizer_measurement_t));
+        pMeasurement->peakMb = VISUALIZER_MEASUREMENT_SILENCE_MB;
+        pMeasurement->rmsMb = VISUALIZER_MEASUREMENT_SILENCE_MB;
+        if (pContext->mState != VISUALIZER_STATE_ACTIVE) {
+            break;
+        }
+        if (pContext->mMeasurementMode & VISUALIZER_MEASUREMENT_MODE_PEAK_RMS) {
+            Visualizer_measureLevels(pContext, &pMeasurement->peakMb, &pMeasurement->rmsMb);
+        }
+        if (pContext->mMeasurementMode & VISUALIZER_MEASUREMENT_MODE_FFT) {
+            Visualizer_measureSpectrum(pContext, pMeasurement->bands);
+        }
+        } break;
+
+    case VISUALIZER_CMD_READ: {
+        if ((pCmdData != NULL && cmdSize != sizeof(uint32_t)) || pReplyData == NULL ||
+                *replySize < sizeof(visualizer_read_header_t)) {
+            ALOGV("VISUALIZER_CMD_READ() error cmdSize %d *replySize %d", cmdSize, *replySize);
+            return -EINVAL;
+        }
+        visualizer_read_header_t *pHeader = (visualizer_read_header_t *)pReplyData;
+        uint8_t *pDst = (uint8_t *)(pHeader + 1);
+        uint32_t framesWritten = pContext->mFramesWritten;
+        uint32_t position = (pCmdData != NULL) ? *(uint32_t *)pCmdData : framesWritten;
+        uint32_t available = framesWritten - position;
+        uint32_t lost = 0;
+
+        // a reader that fell behind, or a position from before a reset,
+        // restarts from the oldest samples still safe to read
+        if (available > MAX_READ_FRAMES || available > framesWritten) {
+            uint32_t oldest =
+                    framesWritten > MAX_READ_FRAMES ? framesWritten - MAX_READ_FRAMES : 0;
+            lost = (available > framesWritten) ? 0 : oldest - position;
+            position = oldest;
+            available = framesWritten - oldest;
+        }
+        uint32_t frames = *replySize - sizeof(visualizer_read_header_t);
+        if (frames > available) {
+            frames = available;
+        }
+        if (pContext->mState != VISUALIZER_STATE_ACTIVE) {
+            frames = 0;
+        }
+
+        uint32_t readIdx = position & (CAPTURE_BUF_SIZE - 1);
+        uint32_t size = frames;
+        if (readIdx + size > CAPTURE_BUF_SIZE) {
+            uint32_t part = CAPTURE_BUF_SIZE - readIdx;
+            memcpy(pDst, pContext->mCaptureBuf + readIdx, part);
+            pDst += part;
+            size -= part;
+            readIdx = 0;
+        }
+        memcpy(pDst, pContext->mCaptureBuf + readIdx, size);
+
+        pHeader->position = position + frames;
+        pHeader->frames = frames;
+        pHeader->lost = lost;
+        *replySize = sizeof(visualizer_read_header_t) + frames;
+        } break;
+
     default:
         ALOGW("Visualizer_command invalid command %d",cmdCode);
         return -EINVAL;
@@ -49,8 +49,13 @@ enum {
     GET_EXTENSION_INDEX,
     OBSERVER_ON_MSG,
     GET_GRAPHIC_BUFFER_USAGE,
+    OBSERVER_ON_MSGS,
 };
 
+// Upper bound on the number of messages in a single OBSERVER_ON_MSGS
+// transaction.
+static const size_t kMaxMessagesPerTransaction = 256;
+
 class BpOMX : public BpInterface<IOMX> {
 public:
     BpOMX(const sp<IBinder> &impl)
@@ -760,10 +765,45 @@ public:
 
         remote()->transact(OBSERVER_ON_MSG, data, &reply, IBinder::FLAG_ONEWAY);
     }
+
+    virtual void onMessages(const List<omx_message> &messages) {
+        List<omx_message>::const_iterator it = messages.begin();
+        while (it != messages.end()) {
+            Parcel data, reply;
+            data.writeInterfaceToken(IOMXObserver::getInterfaceDescriptor());
+
+            // Leave room for the count, filled in below.
+            size_t countPos = data.dataPosition();
+            data.writeInt32(0);
+
+            int32_t count = 0;
+            while (it != messages.end()
+                    && count < (int32_t)kMaxMessagesPerTransaction) {
+                data.write(&*it, sizeof(omx_message));
+                ++it;
+                ++count;
+            }
+
+            size_t endPos = data.dataPosition();
+            data.setDataPosition(countPos);
+            data.writeInt32(count);
+            data.setDataPosition(endPos);
+
+            remote()->transact(
+                    OBSERVER_ON_MSGS, data, &reply, IBinder::FLAG_ONEWAY);
+        }
+    }
 };
 
 IMPLEMENT_META_INTERFACE(OMXObserver, "android.hardware.IOMXObserver");
 
+void IOMXObserver::onMessages(const List<omx_message> &messages) {
+    for (List<omx_message>::const_iterator it = messages.begin();
+         it != messages.end(); ++it) {
+        onMessage(*it);
+    }
+}
+
 status_t BnOMXObserver::onTransact(
     uint32_t code, const Parcel &data, Parcel *reply, uint32_t flags) {
     switch (code) {
@@ -780,6 +820,30 @@ status_t BnOMXObserver::onTransact(
             return NO_ERROR;
         }
 
+        case OBSERVER_ON_MSGS:
+        {
+            CHECK_INTERFACE(IOMXObserver, data, reply);
+
+            int32_t count = data.readInt32();
+            if (count <= 0 || count > (int32_t)kMaxMessagesPerTransaction) {
+                return BAD_VALUE;
+            }
+
+            List<omx_message> messages;
+            for (int32_t i = 0; i < count; ++i) {
+                omx_message msg;
+                if (data.read(&msg, sizeof(msg)) != OK) {
+                    return BAD_VALUE;
+                }
+
+                messages.push_back(msg);
+            }
+
+            onMessages(messages);
+
+            return NO_ERROR;
+        }
+
         default:
             return BBinder::onTransact(code, data, reply, flags);
     }
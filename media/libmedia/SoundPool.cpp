@@ -23,6 +23,10 @@
 // XXX needed for timing latency
 #include <utils/Timers.h>
 
+#include <cutils/atomic.h>
+#include <binder/MemoryBase.h>
+#include <binder/MemoryHeapBase.h>
+#include <media/AudioSystem.h>
 #include <media/AudioTrack.h>
 #include <media/mediaplayer.h>
 
@@ -38,6 +42,9 @@ int kDefaultBufferCount = 4;
 uint32_t kMaxSampleRate = 48000;
 uint32_t kDefaultSampleRate = 44100;
 uint32_t kDefaultFrameCount = 1200;
+// how long a stopped track must stay idle before it's reused, well above the
+// AudioTrack callback thread's WAIT_PERIOD_MS
+nsecs_t kTrackQuiescentNs = milliseconds(50);
 
 SoundPool::SoundPool(int maxChannels, audio_stream_type_t streamType, int srcQuality)
 {
@@ -59,6 +66,18 @@ SoundPool::SoundPool(int maxChannels, audio_stream_type_t streamType, int srcQua
     mStreamType = streamType;
     mSrcQuality = srcQuality;
     mAllocated = 0;
+
+    // A positive srcQuality has samples converted to the output rate as
+    // they are loaded, so play() hands the mixer data it doesn't need to
+    // resample.
+    mResampleRate = 0;
+    if (srcQuality > 0) {
+        int outputRate;
+        if (AudioSystem::getOutputSamplingRate(&outputRate, streamType) == NO_ERROR
+                && outputRate > 0 && (uint32_t)outputRate <= kMaxSampleRate) {
+            mResampleRate = outputRate;
+        }
+    }
     mNextSampleID = 0;
     mNextChannelID = 0;
 
@@ -66,9 +85,17 @@ SoundPool::SoundPool(int maxChannels, audio_stream_type_t streamType, int srcQua
     mUserData = 0;
 
     mChannelPool = new SoundChannel[mMaxChannels];
+    mNextOrder = 0;
+    mChannelHeap.setCapacity(mMaxChannels);
+    mHeapIndex.setCapacity(mMaxChannels);
     for (int i = 0; i < mMaxChannels; ++i) {
         mChannelPool[i].init(this);
-        mChannels.push_back(&mChannelPool[i]);
+        ChannelEntry entry;
+        entry.priority = IDLE_PRIORITY;
+        entry.order = 0;
+        entry.channel = &mChannelPool[i];
+        mChannelHeap.push(entry);
+        mHeapIndex.push(i);
     }
 
     // start decode thread
@@ -83,7 +110,8 @@ SoundPool::~SoundPool()
 
     Mutex::Autolock lock(&mLock);
 
-    mChannels.clear();
+    mChannelHeap.clear();
+    mHeapIndex.clear();
     if (mChannelPool)
         delete [] mChannelPool;
     // clean up samples
@@ -243,6 +271,7 @@ int SoundPool::play(int sampleID, float leftVolume, float rightVolume,
 {
     ALOGV("play sampleID=%d, leftVolume=%f, rightVolume=%f, priority=%d, loop=%d, rate=%f",
             sampleID, leftVolume, rightVolume, priority, loop, rate);
+    nsecs_t playTime = systemTime();
     sp<Sample> sample;
     SoundChannel* channel;
     int channelID;
@@ -259,7 +288,9 @@ int SoundPool::play(int sampleID, float leftVolume, float rightVolume,
         return 0;
     }
 
+#if LOG_NDEBUG == 0
     dump();
+#endif
 
     // allocate a channel
     channel = allocateChannel_l(priority);
@@ -273,50 +304,74 @@ int SoundPool::play(int sampleID, float leftVolume, float rightVolume,
     channelID = ++mNextChannelID;
 
     ALOGV("play channel %p state = %d", channel, channel->state());
-    channel->play(sample, channelID, leftVolume, rightVolume, priority, loop, rate);
+    channel->play(sample, channelID, leftVolume, rightVolume, priority, loop, rate, playTime);
     return channelID;
 }
 
 SoundChannel* SoundPool::allocateChannel_l(int priority)
 {
-    List<SoundChannel*>::iterator iter;
-    SoundChannel* channel = NULL;
-
-    // allocate a channel
-    if (!mChannels.empty()) {
-        iter = mChannels.begin();
-        if (priority >= (*iter)->priority()) {
-            channel = *iter;
-            mChannels.erase(iter);
-            ALOGV("Allocated active channel");
-        }
+    // the top of the heap is the lowest priority channel, the longest
+    // playing one among equals
+    if (mChannelHeap.isEmpty() || priority < mChannelHeap[0].priority) {
+        return NULL;
     }
 
-    // update priority and put it back in the list
-    if (channel) {
-        channel->setPriority(priority);
-        for (iter = mChannels.begin(); iter != mChannels.end(); ++iter) {
-            if (priority < (*iter)->priority()) {
-                break;
-            }
-        }
-        mChannels.insert(iter, channel);
-    }
+    SoundChannel* channel = mChannelHeap[0].channel;
+    ALOGV("Allocated active channel");
+    channel->setPriority(priority);
+    updateChannel_l(channel, priority, ++mNextOrder);
     return channel;
 }
 
-// move a channel from its current position to the front of the list
-void SoundPool::moveToFront_l(SoundChannel* channel)
+// re-key a channel and restore the heap order
+void SoundPool::updateChannel_l(SoundChannel* channel, int priority, uint32_t order)
+{
+    size_t index = mHeapIndex[channel - mChannelPool];
+    ChannelEntry& entry = mChannelHeap.editItemAt(index);
+    entry.priority = priority;
+    entry.order = order;
+    siftChannel_l(index);
+}
+
+void SoundPool::siftChannel_l(size_t index)
 {
-    for (List<SoundChannel*>::iterator iter = mChannels.begin(); iter != mChannels.end(); ++iter) {
-        if (*iter == channel) {
-            mChannels.erase(iter);
-            mChannels.push_front(channel);
+    while (index > 0) {
+        size_t parent = (index - 1) / 2;
+        if (!(mChannelHeap[index] < mChannelHeap[parent])) {
             break;
         }
+        swapChannels_l(index, parent);
+        index = parent;
+    }
+
+    size_t size = mChannelHeap.size();
+    for (;;) {
+        size_t first = index;
+        size_t left = 2 * index + 1;
+        size_t right = left + 1;
+        if (left < size && mChannelHeap[left] < mChannelHeap[first]) {
+            first = left;
+        }
+        if (right < size && mChannelHeap[right] < mChannelHeap[first]) {
+            first = right;
+        }
+        if (first == index) {
+            break;
+        }
+        swapChannels_l(index, first);
+        index = first;
     }
 }
 
+void SoundPool::swapChannels_l(size_t a, size_t b)
+{
+    ChannelEntry entry = mChannelHeap[a];
+    mChannelHeap.editItemAt(a) = mChannelHeap[b];
+    mChannelHeap.editItemAt(b) = entry;
+    mHeapIndex.editItemAt(mChannelHeap[a].channel - mChannelPool) = a;
+    mHeapIndex.editItemAt(mChannelHeap[b].channel - mChannelPool) = b;
+}
+
 void SoundPool::pause(int channelID)
 {
     ALOGV("pause(%d)", channelID);
@@ -387,6 +442,8 @@ void SoundPool::setPriority(int channelID, int priority)
     SoundChannel* channel = findChannel(channelID);
     if (channel) {
         channel->setPriority(priority);
+        size_t index = mHeapIndex[channel - mChannelPool];
+        updateChannel_l(channel, priority, mChannelHeap[index].order);
     }
 }
 
@@ -410,6 +467,16 @@ void SoundPool::setRate(int channelID, float rate)
     }
 }
 
+nsecs_t SoundPool::startLatency(int channelID)
+{
+    Mutex::Autolock lock(&mLock);
+    SoundChannel* channel = findChannel(channelID);
+    if (channel) {
+        return channel->startLatency();
+    }
+    return -1;
+}
+
 // call with lock held
 void SoundPool::done_l(SoundChannel* channel)
 {
@@ -423,7 +490,8 @@ void SoundPool::done_l(SoundChannel* channel)
     // return to idle state
     else {
         ALOGV("move to front");
-        moveToFront_l(channel);
+        // idle channels are handed out longest idle first
+        updateChannel_l(channel, IDLE_PRIORITY, ++mNextOrder);
     }
 }
 
@@ -492,7 +560,59 @@ Sample::~Sample()
     delete mUrl;
 }
 
-status_t Sample::doLoad()
+// Converts 8 or 16 bit PCM from srcRate to dstRate by linear interpolation.
+static sp<IMemory> resample(const sp<IMemory>& src, audio_format_t format,
+        int numChannels, uint32_t srcRate, uint32_t dstRate)
+{
+    size_t sampleSize = (format == AUDIO_FORMAT_PCM_16_BIT) ? 2 : 1;
+    size_t frameSize = numChannels * sampleSize;
+    size_t srcFrames = src->size() / frameSize;
+    size_t dstFrames = (uint64_t)srcFrames * dstRate / srcRate;
+    if (dstFrames == 0) {
+        return 0;
+    }
+
+    sp<MemoryHeapBase> heap = new MemoryHeapBase(dstFrames * frameSize, 0, "SoundPool");
+    if (heap->getHeapID() < 0) {
+        return 0;
+    }
+
+    // source position in 32.32 fixed point
+    uint64_t step = ((uint64_t)srcRate << 32) / dstRate;
+    uint64_t pos = 0;
+
+    if (sampleSize == 2) {
+        const int16_t* in = static_cast<const int16_t*>(src->pointer());
+        int16_t* out = static_cast<int16_t*>(heap->getBase());
+        for (size_t i = 0; i < dstFrames; ++i, pos += step) {
+            size_t index = pos >> 32;
+            size_t next = (index + 1 < srcFrames) ? index + 1 : index;
+            int32_t frac = (pos >> 17) & 0x7fff;
+            for (int c = 0; c < numChannels; ++c) {
+                int32_t a = in[index * numChannels + c];
+                int32_t b = in[next * numChannels + c];
+                *out++ = a + (((b - a) * frac) >> 15);
+            }
+        }
+    } else {
+        const uint8_t* in = static_cast<const uint8_t*>(src->pointer());
+        uint8_t* out = static_cast<uint8_t*>(heap->getBase());
+        for (size_t i = 0; i < dstFrames; ++i, pos += step) {
+            size_t index = pos >> 32;
+            size_t next = (index + 1 < srcFrames) ? index + 1 : index;
+            int32_t frac = (pos >> 17) & 0x7fff;
+            for (int c = 0; c < numChannels; ++c) {
+                int32_t a = in[index * numChannels + c];
+                int32_t b = in[next * numChannels + c];
+                *out++ = a + (((b - a) * frac) >> 15);
+            }
+        }
+    }
+
+    return new MemoryBase(heap, 0, dstFrames * frameSize);
+}
+
+status_t Sample::doLoad(uint32_t resampleRate)
 {
     uint32_t sampleRate;
     int numChannels;
@@ -528,6 +648,21 @@ status_t Sample::doLoad()
     uint8_t* q = static_cast<uint8_t*>(p->pointer()) + p->size() - 10;
     //_dumpBuffer(q, 10, 10, false);
 
+    // The decoded memory may be shared with other SoundPools, so this
+    // converts into a copy of our own.
+    if (resampleRate != 0 && resampleRate != sampleRate
+            && (format == AUDIO_FORMAT_PCM_16_BIT || format == AUDIO_FORMAT_PCM_8_BIT)) {
+        sp<IMemory> resampled = resample(p, format, numChannels, sampleRate, resampleRate);
+        if (resampled == 0) {
+            ALOGE("Unable to resample sample from %u to %u Hz", sampleRate, resampleRate);
+            return -1;
+        }
+        ALOGV("resampled from %u to %u Hz, size = %u", sampleRate, resampleRate,
+                resampled->size());
+        p = resampled;
+        sampleRate = resampleRate;
+    }
+
     mData = p;
     mSize = p->size();
     mSampleRate = sampleRate;
@@ -545,11 +680,11 @@ void SoundChannel::init(SoundPool* soundPool)
 
 // call with sound pool lock held
 void SoundChannel::play(const sp<Sample>& sample, int nextChannelID, float leftVolume,
-        float rightVolume, int priority, int loop, float rate)
+        float rightVolume, int priority, int loop, float rate, nsecs_t playTime)
 {
-    AudioTrack* oldTrack;
-    AudioTrack* newTrack;
-    status_t status;
+    AudioTrack* oldTrack = NULL;
+    AudioTrack* newTrack = NULL;
+    status_t status = NO_ERROR;
 
     { // scope for the lock
         Mutex::Autolock lock(&mLock);
@@ -562,7 +697,8 @@ void SoundChannel::play(const sp<Sample>& sample, int nextChannelID, float leftV
         // if not idle, this voice is being stolen
         if (mState != IDLE) {
             ALOGV("channel %d stolen - event queued for channel %d", channelID(), nextChannelID);
-            mNextEvent.set(sample, nextChannelID, leftVolume, rightVolume, priority, loop, rate);
+            mNextEvent.set(sample, nextChannelID, leftVolume, rightVolume, priority, loop, rate,
+                    playTime);
             stop_l();
             return;
         }
@@ -600,25 +736,46 @@ void SoundChannel::play(const sp<Sample>& sample, int nextChannelID, float leftV
         // as callback user data. This enables the detection of callbacks received from the old
         // audio track while the new one is being started and avoids processing them with
         // wrong audio audio buffer size  (mAudioBufferSize)
-        unsigned long toggle = mToggle ^ 1;
-        void *userData = (void *)((unsigned long)this | toggle);
-        uint32_t channels = (numChannels == 2) ?
-                AUDIO_CHANNEL_OUT_STEREO : AUDIO_CHANNEL_OUT_MONO;
+        unsigned long toggle = mToggle;
+
+        // do not create a new audio track if current track is compatible with sample parameters:
+        // creating one takes several round trips to AudioFlinger and a new callback thread.
+        // Callbacks from the previous sound would pass the toggle check, so only a track
+        // whose callback thread has gone quiet is reused: a channel restarted right after
+        // being stolen gets a new track.
+#ifdef USE_SHARED_MEM_BUFFER
+        bool reuse = false;
+#else
+        bool reuse = mAudioTrack != NULL && mTrackSampleRate == sampleRate
+                && mTrackFrameCount == frameCount && mTrackFormat == sample->format()
+                && mNumChannels == numChannels
+                && android_atomic_acquire_load(&mCallbacksInFlight) == 0
+                && systemTime() - mStopTime >= kTrackQuiescentNs;
+#endif
+        if (reuse) {
+            ALOGV("reuse track %p", mAudioTrack);
+            newTrack = mAudioTrack;
+            newTrack->flush();
+        } else {
+            toggle ^= 1;
+            void *userData = (void *)((unsigned long)this | toggle);
+            uint32_t channels = (numChannels == 2) ?
+                    AUDIO_CHANNEL_OUT_STEREO : AUDIO_CHANNEL_OUT_MONO;
 
-        // do not create a new audio track if current track is compatible with sample parameters
 #ifdef USE_SHARED_MEM_BUFFER
-        newTrack = new AudioTrack(streamType, sampleRate, sample->format(),
-                channels, sample->getIMemory(), AUDIO_OUTPUT_FLAG_NONE, callback, userData);
+            newTrack = new AudioTrack(streamType, sampleRate, sample->format(),
+                    channels, sample->getIMemory(), AUDIO_OUTPUT_FLAG_NONE, callback, userData);
 #else
-        newTrack = new AudioTrack(streamType, sampleRate, sample->format(),
-                channels, frameCount, AUDIO_OUTPUT_FLAG_FAST, callback, userData,
-                bufferFrames);
+            newTrack = new AudioTrack(streamType, sampleRate, sample->format(),
+                    channels, frameCount, AUDIO_OUTPUT_FLAG_FAST, callback, userData,
+                    bufferFrames);
 #endif
-        oldTrack = mAudioTrack;
-        status = newTrack->initCheck();
-        if (status != NO_ERROR) {
-            ALOGE("Error creating AudioTrack");
-            goto exit;
+            oldTrack = mAudioTrack;
+            status = newTrack->initCheck();
+            if (status != NO_ERROR) {
+                ALOGE("Error creating AudioTrack");
+                goto exit;
+            }
         }
         ALOGV("setVolume %p", newTrack);
         newTrack->setVolume(leftVolume, rightVolume);
@@ -627,6 +784,11 @@ void SoundChannel::play(const sp<Sample>& sample, int nextChannelID, float leftV
         // From now on, AudioTrack callbacks received with previous toggle value will be ignored.
         mToggle = toggle;
         mAudioTrack = newTrack;
+        mTrackSampleRate = sampleRate;
+        mTrackFrameCount = frameCount;
+        mTrackFormat = sample->format();
+        mPlayTime = playTime;
+        mStartLatency = -1;
         mPos = 0;
         mSample = sample;
         mChannelID = nextChannelID;
@@ -660,6 +822,7 @@ void SoundChannel::nextEvent()
     int priority;
     int loop;
     float rate;
+    nsecs_t playTime;
 
     // check for valid event
     {
@@ -676,17 +839,21 @@ void SoundChannel::nextEvent()
         priority = mNextEvent.priority();
         loop = mNextEvent.loop();
         rate = mNextEvent.rate();
+        playTime = mNextEvent.playTime();
     }
 
     ALOGV("Starting stolen channel %d -> %d", channelID(), nextChannelID);
-    play(sample, nextChannelID, leftVolume, rightVolume, priority, loop, rate);
+    play(sample, nextChannelID, leftVolume, rightVolume, priority, loop, rate, playTime);
 }
 
 void SoundChannel::callback(int event, void* user, void *info)
 {
     SoundChannel* channel = static_cast<SoundChannel*>((void *)((unsigned long)user & ~1));
 
+    // counted before blocking on the channel lock, see play()
+    android_atomic_inc(&channel->mCallbacksInFlight);
     channel->process(event, info, (unsigned long)user & 1);
+    android_atomic_dec(&channel->mCallbacksInFlight);
 }
 
 void SoundChannel::process(int event, void *info, unsigned long toggle)
@@ -734,6 +901,9 @@ void SoundChannel::process(int event, void *info, unsigned long toggle)
                     count = b->size;
                 }
                 memcpy(q, p, count);
+                if (mStartLatency < 0) {
+                    mStartLatency = systemTime() - mPlayTime;
+                }
 //              ALOGV("fill: q=%p, p=%p, mPos=%u, b->size=%u, count=%d", q, p, mPos, b->size, count);
             } else if (mPos < mAudioBufferSize) {
                 count = mAudioBufferSize - mPos;
@@ -764,6 +934,7 @@ bool SoundChannel::doStop_l()
         setVolume_l(0, 0);
         ALOGV("stop");
         mAudioTrack->stop();
+        mStopTime = systemTime();
         mSample.clear();
         mState = IDLE;
         mPriority = IDLE_PRIORITY;
@@ -843,7 +1014,9 @@ void SoundChannel::setRate(float rate)
     Mutex::Autolock lock(&mLock);
     if (mAudioTrack != NULL && mSample != 0) {
         uint32_t sampleRate = uint32_t(float(mSample->sampleRate()) * rate + 0.5);
-        mAudioTrack->setSampleRate(sampleRate);
+        if (mAudioTrack->setSampleRate(sampleRate) == NO_ERROR) {
+            mTrackSampleRate = sampleRate;
+        }
         mRate = rate;
     }
 }
@@ -887,6 +1060,12 @@ SoundChannel::~SoundChannel()
     delete mAudioTrack;
 }
 
+nsecs_t SoundChannel::startLatency()
+{
+    Mutex::Autolock lock(&mLock);
+    return mStartLatency;
+}
+
 void SoundChannel::dump()
 {
     ALOGV("mState = %d mChannelID=%d, mNumChannels=%d, mPos = %d, mPriority=%d, mLoop=%d",
@@ -894,7 +1073,7 @@ void SoundChannel::dump()
 }
 
 void SoundEvent::set(const sp<Sample>& sample, int channelID, float leftVolume,
-            float rightVolume, int priority, int loop, float rate)
+            float rightVolume, int priority, int loop, float rate, nsecs_t playTime)
 {
     mSample = sample;
     mChannelID = channelID;
@@ -903,6 +1082,7 @@ void SoundEvent::set(const sp<Sample>& sample, int channelID, float leftVolume,
     mPriority = priority;
     mLoop = loop;
     mRate =rate;
+    mPlayTime = playTime;
 }
 
 } // end namespace android
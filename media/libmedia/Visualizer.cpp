@@ -21,6 +21,7 @@
 #include <utils/Log.h>
 
 #include <stdint.h>
+#include <stdlib.h>
 #include <sys/types.h>
 #include <limits.h>
 
@@ -43,7 +44,10 @@ Visualizer::Visualizer (int32_t priority,
         mSampleRate(44100000),
         mScalingMode(VISUALIZER_SCALING_MODE_NORMALIZED),
         mCaptureCallBack(NULL),
-        mCaptureCbkUser(NULL)
+        mCaptureCbkUser(NULL),
+        mMeasurementMode(VISUALIZER_MEASUREMENT_MODE_NONE),
+        mStreamStarted(false),
+        mStreamPosition(0)
 {
     initCaptureSize();
 }
@@ -72,6 +76,8 @@ status_t Visualizer::setEnabled(bool enabled)
     status_t status = AudioEffect::setEnabled(enabled);
 
     if (status == NO_ERROR) {
+        // the effect may have been reset meanwhile, restart the stream
+        mStreamStarted = false;
         if (t != 0) {
             if (enabled) {
                 t->run("Visualizer");
@@ -184,6 +190,121 @@ status_t Visualizer::setScalingMode(uint32_t mode) {
     return status;
 }
 
+status_t Visualizer::setMeasurementMode(uint32_t mode) {
+    if ((mode & ~(VISUALIZER_MEASUREMENT_MODE_PEAK_RMS | VISUALIZER_MEASUREMENT_MODE_FFT)) != 0) {
+        return BAD_VALUE;
+    }
+
+    Mutex::Autolock _l(mCaptureLock);
+
+    uint32_t buf32[sizeof(effect_param_t) / sizeof(uint32_t) + 2];
+    effect_param_t *p = (effect_param_t *)buf32;
+
+    p->psize = sizeof(uint32_t);
+    p->vsize = sizeof(uint32_t);
+    *(int32_t *)p->data = VISUALIZER_PARAM_MEASUREMENT_MODE;
+    *((int32_t *)p->data + 1)= mode;
+    status_t status = setParameter(p);
+
+    ALOGV("setMeasurementMode mode %d  status %d p->status %d", mode, status, p->status);
+
+    if (status == NO_ERROR) {
+        status = p->status;
+        if (status == NO_ERROR) {
+            mMeasurementMode = mode;
+        }
+    }
+
+    return status;
+}
+
+status_t Visualizer::getMeasurement(visualizer_measurement_t *measurement)
+{
+    if (measurement == NULL) {
+        return BAD_VALUE;
+    }
+
+    status_t status = NO_ERROR;
+    if (mEnabled) {
+        uint32_t replySize = sizeof(visualizer_measurement_t);
+        status = command(VISUALIZER_CMD_MEASURE, 0, NULL, &replySize, measurement);
+        ALOGV("getMeasurement() command returned %d", status);
+        if ((status == NO_ERROR) && (replySize != sizeof(visualizer_measurement_t))) {
+            status = NOT_ENOUGH_DATA;
+        }
+    } else {
+        ALOGV("getMeasurement() disabled");
+        memset(measurement, 0, sizeof(visualizer_measurement_t));
+        measurement->peakMb = VISUALIZER_MEASUREMENT_SILENCE_MB;
+        measurement->rmsMb = VISUALIZER_MEASUREMENT_SILENCE_MB;
+    }
+    return status;
+}
+
+status_t Visualizer::readStream(uint8_t *buffer, uint32_t size, uint32_t *frames, uint32_t *lost)
+{
+    if (buffer == NULL || frames == NULL) {
+        return BAD_VALUE;
+    }
+
+    *frames = 0;
+    if (lost != NULL) {
+        *lost = 0;
+    }
+
+    Mutex::Autolock _l(mCaptureLock);
+
+    if (!mEnabled) {
+        return NO_ERROR;
+    }
+
+    visualizer_read_header_t header;
+    status_t status;
+    if (!mStreamStarted) {
+        uint32_t replySize = sizeof(visualizer_read_header_t);
+        status = command(VISUALIZER_CMD_READ, 0, NULL, &replySize, &header);
+        if (status != NO_ERROR) {
+            return status;
+        }
+        if (replySize < sizeof(visualizer_read_header_t)) {
+            return NOT_ENOUGH_DATA;
+        }
+        mStreamPosition = header.position;
+        mStreamStarted = true;
+        return NO_ERROR;
+    }
+
+    uint32_t replySize = sizeof(visualizer_read_header_t) + size;
+    uint8_t *reply = (uint8_t *)malloc(replySize);
+    if (reply == NULL) {
+        return NO_MEMORY;
+    }
+
+    uint32_t position = mStreamPosition;
+    status = command(VISUALIZER_CMD_READ, sizeof(uint32_t), &position, &replySize, reply);
+    ALOGV("readStream() command returned %d replySize %d", status, replySize);
+    if (status == NO_ERROR && replySize < sizeof(visualizer_read_header_t)) {
+        status = NOT_ENOUGH_DATA;
+    }
+    if (status == NO_ERROR) {
+        memcpy(&header, reply, sizeof(visualizer_read_header_t));
+        if (header.frames > size ||
+                replySize < sizeof(visualizer_read_header_t) + header.frames) {
+            status = NOT_ENOUGH_DATA;
+        } else {
+            memcpy(buffer, reply + sizeof(visualizer_read_header_t), header.frames);
+            mStreamPosition = header.position;
+            *frames = header.frames;
+            if (lost != NULL) {
+                *lost = header.lost;
+            }
+        }
+    }
+
+    free(reply);
+    return status;
+}
+
 status_t Visualizer::getWaveForm(uint8_t *waveform)
 {
     if (waveform == NULL) {
@@ -328,6 +449,8 @@ void Visualizer::controlStatusChanged(bool controlGranted) {
         setScalingMode(mScalingMode);
         ALOGV("    capture size reset to %d", mCaptureSize);
         setCaptureSize(mCaptureSize);
+        ALOGV("    measurement mode reset to %d", mMeasurementMode);
+        setMeasurementMode(mMeasurementMode);
     }
     AudioEffect::controlStatusChanged(controlGranted);
 }
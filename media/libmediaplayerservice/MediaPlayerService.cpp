@@ -53,7 +53,9 @@
 #include <media/Metadata.h>
 #include <media/AudioTrack.h>
 #include <media/MemoryLeakTrackUtil.h>
+#include <media/stagefright/ACodec.h>
 #include <media/stagefright/MediaErrors.h>
+#include <media/stagefright/foundation/AString.h>
 
 #include <system/audio.h>
 
@@ -508,11 +510,19 @@ status_t MediaPlayerService::AudioOutput::dump(int fd, const Vector<String16>& a
     return NO_ERROR;
 }
 
-status_t MediaPlayerService::Client::dump(int fd, const Vector<String16>& args) const
+status_t MediaPlayerService::Client::dump(int fd, const Vector<String16>& args)
 {
     const size_t SIZE = 256;
     char buffer[SIZE];
     String8 result;
+    if (checkCallingPermission(String16("android.permission.DUMP")) == false) {
+        snprintf(buffer, SIZE, "Permission Denial: "
+                "can't dump MediaPlayerService::Client from pid=%d, uid=%d\n",
+                IPCThreadState::self()->getCallingPid(),
+                IPCThreadState::self()->getCallingUid());
+        write(fd, buffer, strlen(buffer));
+        return NO_ERROR;
+    }
     result.append(" Client\n");
      #ifdef CFG_WMT_WPLAYER
 	 
@@ -526,8 +536,9 @@ status_t MediaPlayerService::Client::dump(int fd, const Vector<String16>& args)
 	#endif		
     result.append(buffer);
     write(fd, result.string(), result.size());
-    if (mPlayer != NULL) {
-        mPlayer->dump(fd, args);
+    sp<MediaPlayerBase> p = getPlayer();
+    if (p != NULL) {
+        p->dump(fd, args);
     }
     if (mAudioOutput != 0) {
         mAudioOutput->dump(fd, args);
@@ -568,6 +579,11 @@ status_t MediaPlayerService::dump(int fd, const Vector<String16>& args)
             }
         }
 
+        AString codecPool;
+        ACodec::DumpComponentPool(&codecPool);
+        result.append(codecPool.c_str());
+        result.append("\n");
+
         result.append(" Files opened and/or mapped:\n");
         snprintf(buffer, SIZE, "/proc/%d/maps", gettid());
         FILE *f = fopen(buffer, "r");
@@ -1499,12 +1515,64 @@ Exit:
     return mem;
 }
 
+bool MediaPlayerService::DecodeKey::operator<(const DecodeKey &other) const
+{
+    if (dev != other.dev) return dev < other.dev;
+    if (ino != other.ino) return ino < other.ino;
+    if (fileSize != other.fileSize) return fileSize < other.fileSize;
+    if (mtime != other.mtime) return mtime < other.mtime;
+    if (mtimeNsec != other.mtimeNsec) return mtimeNsec < other.mtimeNsec;
+    if (offset != other.offset) return offset < other.offset;
+    return length < other.length;
+}
+
+// static
+bool MediaPlayerService::makeDecodeKey(
+        int fd, int64_t offset, int64_t length, DecodeKey *key)
+{
+    struct stat sb;
+    if (fstat(fd, &sb) != 0 || !S_ISREG(sb.st_mode)) {
+        return false;
+    }
+
+    key->dev = sb.st_dev;
+    key->ino = sb.st_ino;
+    key->fileSize = sb.st_size;
+    key->mtime = sb.st_mtime;
+    // a file rewritten within the same second must not match
+    key->mtimeNsec = sb.st_mtime_nsec;
+    key->offset = offset;
+    key->length = length;
+    return true;
+}
+
 sp<IMemory> MediaPlayerService::decode(int fd, int64_t offset, int64_t length, uint32_t *pSampleRate, int* pNumChannels, audio_format_t* pFormat)
 {
     ALOGV("decode(%d, %lld, %lld)", fd, offset, length);
     sp<MemoryBase> mem;
     sp<MediaPlayerBase> player;
 
+    DecodeKey key;
+    bool cacheable = makeDecodeKey(fd, offset, length, &key);
+
+    if (cacheable) {
+        Mutex::Autolock lock(mDecodeCacheLock);
+        ssize_t index = mDecodeCache.indexOfKey(key);
+        if (index >= 0) {
+            const DecodedAudio &decoded = mDecodeCache.valueAt(index);
+            sp<IMemory> cached = decoded.mem.promote();
+            if (cached != 0) {
+                ALOGV("decode: reusing memory @ %p", cached->pointer());
+                *pSampleRate = decoded.sampleRate;
+                *pNumChannels = decoded.numChannels;
+                *pFormat = decoded.format;
+                ::close(fd);
+                return cached;
+            }
+            mDecodeCache.removeItemsAt(index);
+        }
+    }
+
     player_type playerType = MediaPlayerFactory::getPlayerType(NULL /* client */,
                                                                fd,
                                                                offset,
@@ -1544,6 +1612,24 @@ sp<IMemory> MediaPlayerService::decode(int fd, int64_t offset, int64_t length, u
     *pFormat = cache->format();
     ALOGV("return memory @ %p, sampleRate=%u, channelCount = %d, format = %d", mem->pointer(), *pSampleRate, *pNumChannels, *pFormat);
 
+    if (cacheable) {
+        Mutex::Autolock lock(mDecodeCacheLock);
+
+        // Drop entries whose memory is gone while we're here.
+        for (size_t i = mDecodeCache.size(); i-- > 0;) {
+            if (mDecodeCache.valueAt(i).mem.promote() == 0) {
+                mDecodeCache.removeItemsAt(i);
+            }
+        }
+
+        DecodedAudio decoded;
+        decoded.mem = mem;
+        decoded.sampleRate = *pSampleRate;
+        decoded.numChannels = *pNumChannels;
+        decoded.format = *pFormat;
+        mDecodeCache.replaceValueFor(key, decoded);
+    }
+
 Exit:
     if (player != 0) player->reset();
     ::close(fd);
@@ -1959,8 +2045,9 @@ MediaPlayerService::AudioCache::AudioCache(const char* name) :
     mChannelCount(0), mFrameCount(1024), mSampleRate(0), mSize(0),
     mError(NO_ERROR), mCommandComplete(false)
 {
-    // create ashmem heap
-    mHeap = new MemoryHeapBase(kDefaultHeapSize, 0, name);
+    // create ashmem heap, clients only get to read it: the PCM decode(fd, ...)
+    // returns may be shared by several apps
+    mHeap = new MemoryHeapBase(kDefaultHeapSize, MemoryHeapBase::READ_ONLY, name);
 }
 
 uint32_t MediaPlayerService::AudioCache::latency () const
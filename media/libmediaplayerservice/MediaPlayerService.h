@@ -358,7 +358,9 @@ private:
                                        int ext1, int ext2, const Parcel *obj);
 
                 pid_t           pid() const { return mPid; }
-        virtual status_t        dump(int fd, const Vector<String16>& args) const;
+        // Not const, so that it overrides BBinder::dump() and the player
+        // state can also be dumped through the client's own binder.
+        virtual status_t        dump(int fd, const Vector<String16>& args);
 
                 int             getAudioSessionId() { return mAudioSessionId; }
 
@@ -431,6 +433,36 @@ private:
                             MediaPlayerService();
     virtual                 ~MediaPlayerService();
 
+    // Identifies the file range handed to decode(fd, ...).
+    struct DecodeKey {
+        dev_t       dev;
+        ino_t       ino;
+        off_t       fileSize;
+        time_t      mtime;
+        long        mtimeNsec;
+        int64_t     offset;
+        int64_t     length;
+
+        bool operator<(const DecodeKey &other) const;
+    };
+
+    struct DecodedAudio {
+        wp<IMemory>     mem;
+        uint32_t        sampleRate;
+        int             numChannels;
+        audio_format_t  format;
+    };
+
+    static  bool                makeDecodeKey(int fd, int64_t offset, int64_t length,
+                                              DecodeKey *key);
+
+    // PCM returned by decode(fd, ...), so that a sound loaded by several
+    // SoundPools, in one or many apps, is decoded and held only once.
+    // Entries don't keep the memory alive, it goes away with the last
+    // client reference.
+                Mutex                       mDecodeCacheLock;
+                KeyedVector<DecodeKey, DecodedAudio> mDecodeCache;
+
     mutable     Mutex                       mLock;
                 SortedVector< wp<Client> >  mClients;
                 SortedVector< wp<MediaRecorderClient> > mMediaRecorderClients;
@@ -19,7 +19,10 @@
 #include "ANetworkSession.h"
 #include "source/WifiDisplaySource.h"
 
+#include <binder/IPCThreadState.h>
+#include <binder/IServiceManager.h>
 #include <media/IRemoteDisplayClient.h>
+#include <utils/String8.h>
 
 namespace android {
 
@@ -49,4 +52,17 @@ status_t RemoteDisplay::dispose() {
     return OK;
 }
 
+status_t RemoteDisplay::dump(int fd, const Vector<String16> &args) {
+    if (checkCallingPermission(String16("android.permission.DUMP")) == false) {
+        String8 result = String8::format(
+                "Permission Denial: can't dump RemoteDisplay from pid=%d, uid=%d\n",
+                IPCThreadState::self()->getCallingPid(),
+                IPCThreadState::self()->getCallingUid());
+        write(fd, result.string(), result.size());
+        return NO_ERROR;
+    }
+
+    return mSource->dump(fd, args);
+}
+
 }  // namespace android
@@ -165,6 +165,22 @@ player_type StagefrightPlayer::playerType() {
     return STAGEFRIGHT_PLAYER;
 }
 
+status_t StagefrightPlayer::setNextPlayer(const sp<MediaPlayerBase> &next) {
+    ALOGV("setNextPlayer");
+
+    if (next == NULL || next->playerType() != STAGEFRIGHT_PLAYER) {
+        return OK;
+    }
+
+    return static_cast<StagefrightPlayer *>(next.get())->prerollAsNextPlayer();
+}
+
+status_t StagefrightPlayer::prerollAsNextPlayer() {
+    ALOGV("prerollAsNextPlayer");
+
+    return mPlayer->prerollAudio();
+}
+
 status_t StagefrightPlayer::invoke(const Parcel &request, Parcel *reply) {
     ALOGV("invoke()");
     return mPlayer->invoke(request, reply);
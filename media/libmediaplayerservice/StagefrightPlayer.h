@@ -58,12 +58,17 @@ public:
     virtual void setAudioSink(const sp<AudioSink> &audioSink);
     virtual status_t setParameter(int key, const Parcel &request);
     virtual status_t getParameter(int key, Parcel *reply);
+    virtual status_t setNextPlayer(const sp<MediaPlayerBase> &next);
 
     virtual status_t getMetadata(
             const media::Metadata::Filter& ids, Parcel *records);
 
     virtual status_t dump(int fd, const Vector<String16> &args) const;
 
+    // Decodes ahead so that playback can start without a gap once the
+    // player before this one completes.
+    status_t prerollAsNextPlayer();
+
 private:
     AwesomePlayer *mPlayer;
 
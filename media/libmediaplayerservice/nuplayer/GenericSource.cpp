@@ -232,6 +232,11 @@ void NuPlayer::GenericSource::readBuffer(
 
             buffer->meta()->setInt64("timeUs", timeUs);
 
+            int32_t isSync;
+            if (mbuf->meta_data()->findInt32(kKeyIsSyncFrame, &isSync)) {
+                buffer->meta()->setInt32("isSync", isSync);
+            }
+
             if (actualTimeUs) {
                 *actualTimeUs = timeUs;
             }
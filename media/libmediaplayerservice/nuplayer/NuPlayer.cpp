@@ -70,6 +70,10 @@ NuPlayer::NuPlayer()
       mVideoLateByUs(0ll),
       mNumFramesTotal(0ll),
       mNumFramesDropped(0ll),
+      mSkipVideoUntilSyncFrame(false),
+      mIgnoreVideoLatenessUntilMediaTimeUs(-1ll),
+      mNumFramesSkipped(0ll),
+      mNumFramesDroppedLate(0ll),
       mVideoScalingMode(NATIVE_WINDOW_SCALING_MODE_SCALE_TO_WINDOW) {
 }
 
@@ -245,9 +249,11 @@ void NuPlayer::onMessageReceived(const sp<AMessage> &msg) {
             mVideoEOS = false;
             mSkipRenderingAudioUntilMediaTimeUs = -1;
             mSkipRenderingVideoUntilMediaTimeUs = -1;
-            mVideoLateByUs = 0;
+            resetVideoLateness();
             mNumFramesTotal = 0;
             mNumFramesDropped = 0;
+            mNumFramesSkipped = 0;
+            mNumFramesDroppedLate = 0;
 
             mSource->start();
 
@@ -374,7 +380,7 @@ void NuPlayer::onMessageReceived(const sp<AMessage> &msg) {
                     CHECK(IsFlushingState(mFlushingVideo, &needShutdown));
                     mFlushingVideo = FLUSHED;
 
-                    mVideoLateByUs = 0;
+                    resetVideoLateness();
                 }
 
                 ALOGV("decoder %s flush completed", audio ? "audio" : "video");
@@ -527,17 +533,28 @@ void NuPlayer::onMessageReceived(const sp<AMessage> &msg) {
                 int64_t positionUs;
                 CHECK(msg->findInt64("positionUs", &positionUs));
 
-                CHECK(msg->findInt64("videoLateByUs", &mVideoLateByUs));
-
                 if (mDriver != NULL) {
                     sp<NuPlayerDriver> driver = mDriver.promote();
                     if (driver != NULL) {
                         driver->notifyPosition(positionUs);
 
                         driver->notifyFrameStats(
-                                mNumFramesTotal, mNumFramesDropped);
+                                mNumFramesTotal, mNumFramesDropped,
+                                mNumFramesSkipped, mNumFramesDroppedLate);
                     }
                 }
+            } else if (what == Renderer::kWhatVideoLateBy) {
+                int64_t mediaTimeUs, lateByUs;
+                CHECK(msg->findInt64("mediaTimeUs", &mediaTimeUs));
+                CHECK(msg->findInt64("lateByUs", &lateByUs));
+                CHECK(msg->findInt64(
+                            "numFramesDroppedLate", &mNumFramesDroppedLate));
+
+                // Frames decoded before we skipped ahead are late by
+                // definition, they say nothing about how we're doing now.
+                if (mediaTimeUs >= mIgnoreVideoLatenessUntilMediaTimeUs) {
+                    mVideoLateByUs = lateByUs;
+                }
             } else if (what == Renderer::kWhatFlushComplete) {
                 CHECK_EQ(what, (int32_t)Renderer::kWhatFlushComplete);
 
@@ -841,17 +858,11 @@ status_t NuPlayer::feedDecoderInputData(bool audio, const sp<AMessage> &msg) {
             return OK;
         }
 
+        dropAccessUnit = false;
         if (!audio) {
             ++mNumFramesTotal;
-        }
 
-        dropAccessUnit = false;
-        if (!audio
-                && mVideoLateByUs > 100000ll
-                && mVideoIsAVC
-                && !IsAVCReferenceFrame(accessUnit)) {
-            dropAccessUnit = true;
-            ++mNumFramesDropped;
+            dropAccessUnit = skipVideoAccessUnit(accessUnit);
         }
     } while (dropAccessUnit);
 
@@ -871,6 +882,79 @@ status_t NuPlayer::feedDecoderInputData(bool audio, const sp<AMessage> &msg) {
     return OK;
 }
 
+// Returns true iff the current access unit's sync frame status is known,
+// in which case "*isSync" is set accordingly.
+static bool GetSyncFrameStatus(
+        bool isAVC, const sp<ABuffer> &accessUnit, bool *isSync) {
+    int32_t sync;
+    if (accessUnit->meta()->findInt32("isSync", &sync)) {
+        *isSync = sync != 0;
+        return true;
+    }
+
+    if (isAVC) {
+        *isSync = IsIDR(accessUnit);
+        return true;
+    }
+
+    return false;
+}
+
+void NuPlayer::resetVideoLateness() {
+    mVideoLateByUs = 0;
+    mSkipVideoUntilSyncFrame = false;
+    mIgnoreVideoLatenessUntilMediaTimeUs = -1;
+}
+
+bool NuPlayer::skipVideoAccessUnit(const sp<ABuffer> &accessUnit) {
+    // Late by more than this and dropping non-reference frames won't
+    // get us back in time, jump to the next sync frame instead.
+    static const int64_t kSkipToSyncFrameLateByUs = 500000ll;
+
+    // Late by more than this and non-reference frames are dropped.
+    static const int64_t kDropNonReferenceLateByUs = 100000ll;
+
+    bool isSync;
+    bool syncKnown = GetSyncFrameStatus(mVideoIsAVC, accessUnit, &isSync);
+
+    if (!mSkipVideoUntilSyncFrame
+            && syncKnown
+            && !isSync
+            && mVideoLateByUs > kSkipToSyncFrameLateByUs) {
+        ALOGI("video late by %lld us, skipping to the next sync frame",
+              mVideoLateByUs);
+
+        mSkipVideoUntilSyncFrame = true;
+    }
+
+    if (mSkipVideoUntilSyncFrame) {
+        if (!syncKnown || !isSync) {
+            ++mNumFramesSkipped;
+            return true;
+        }
+
+        int64_t mediaTimeUs;
+        CHECK(accessUnit->meta()->findInt64("timeUs", &mediaTimeUs));
+
+        ALOGV("resuming video at sync frame, media time %.2f secs",
+              mediaTimeUs / 1E6);
+
+        mSkipVideoUntilSyncFrame = false;
+        mVideoLateByUs = 0;
+        mIgnoreVideoLatenessUntilMediaTimeUs = mediaTimeUs;
+        return false;
+    }
+
+    if (mVideoLateByUs > kDropNonReferenceLateByUs
+            && mVideoIsAVC
+            && !IsAVCReferenceFrame(accessUnit)) {
+        ++mNumFramesDropped;
+        return true;
+    }
+
+    return false;
+}
+
 void NuPlayer::renderBuffer(bool audio, const sp<AMessage> &msg) {
     // ALOGV("renderBuffer %s", audio ? "audio" : "video");
 
@@ -133,6 +133,14 @@ private:
     int64_t mVideoLateByUs;
     int64_t mNumFramesTotal, mNumFramesDropped;
 
+    // Once video is too far behind to catch up by dropping non-reference
+    // frames, input is skipped up to the next sync frame, and lateness
+    // reports about frames preceding it are ignored afterwards.
+    bool mSkipVideoUntilSyncFrame;
+    int64_t mIgnoreVideoLatenessUntilMediaTimeUs;
+    int64_t mNumFramesSkipped;
+    int64_t mNumFramesDroppedLate;
+
     int32_t mVideoScalingMode;
 
     status_t instantiateDecoder(bool audio, sp<Decoder> *decoder);
@@ -148,6 +156,9 @@ private:
 
     static bool IsFlushingState(FlushStatus state, bool *needShutdown = NULL);
 
+    void resetVideoLateness();
+    bool skipVideoAccessUnit(const sp<ABuffer> &accessUnit);
+
     void finishReset();
     void postScanSources();
 
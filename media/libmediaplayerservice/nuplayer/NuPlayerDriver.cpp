@@ -33,6 +33,8 @@ NuPlayerDriver::NuPlayerDriver()
       mPositionUs(-1),
       mNumFramesTotal(0),
       mNumFramesDropped(0),
+      mNumFramesSkipped(0),
+      mNumFramesDroppedLate(0),
       mLooper(new ALooper),
       mState(UNINITIALIZED),
       mAtEOS(false),
@@ -323,10 +325,13 @@ void NuPlayerDriver::notifySeekComplete() {
 }
 
 void NuPlayerDriver::notifyFrameStats(
-        int64_t numFramesTotal, int64_t numFramesDropped) {
+        int64_t numFramesTotal, int64_t numFramesDropped,
+        int64_t numFramesSkipped, int64_t numFramesDroppedLate) {
     Mutex::Autolock autoLock(mLock);
     mNumFramesTotal = numFramesTotal;
     mNumFramesDropped = numFramesDropped;
+    mNumFramesSkipped = numFramesSkipped;
+    mNumFramesDroppedLate = numFramesDroppedLate;
 }
 
 status_t NuPlayerDriver::dump(int fd, const Vector<String16> &args) const {
@@ -341,6 +346,14 @@ status_t NuPlayerDriver::dump(int fd, const Vector<String16> &args) const {
                  mNumFramesDropped,
                  mNumFramesTotal == 0
                     ? 0.0 : (double)mNumFramesDropped / mNumFramesTotal);
+    fprintf(out, "  numFramesSkipped(%lld), numFramesDroppedLate(%lld), "
+                 "percentageNotRendered(%.2f)\n",
+                 mNumFramesSkipped,
+                 mNumFramesDroppedLate,
+                 mNumFramesTotal == 0
+                    ? 0.0
+                    : (double)(mNumFramesDropped + mNumFramesSkipped
+                            + mNumFramesDroppedLate) / mNumFramesTotal);
 
     fclose(out);
     out = NULL;
@@ -65,7 +65,9 @@ struct NuPlayerDriver : public MediaPlayerInterface {
     void notifyDuration(int64_t durationUs);
     void notifyPosition(int64_t positionUs);
     void notifySeekComplete();
-    void notifyFrameStats(int64_t numFramesTotal, int64_t numFramesDropped);
+    void notifyFrameStats(
+            int64_t numFramesTotal, int64_t numFramesDropped,
+            int64_t numFramesSkipped, int64_t numFramesDroppedLate);
     void notifyListener(int msg, int ext1 = 0, int ext2 = 0);
 
 protected:
@@ -82,6 +84,8 @@ private:
     int64_t mPositionUs;
     int64_t mNumFramesTotal;
     int64_t mNumFramesDropped;
+    int64_t mNumFramesSkipped;
+    int64_t mNumFramesDroppedLate;
     // <<<
 
     sp<ALooper> mLooper;
@@ -28,6 +28,7 @@ namespace android {
 
 // static
 const int64_t NuPlayer::Renderer::kMinPositionUpdateDelayUs = 100000ll;
+const int64_t NuPlayer::Renderer::kMaxVideoLateByUs = 40000ll;
 
 NuPlayer::Renderer::Renderer(
         const sp<MediaPlayerBase::AudioSink> &sink,
@@ -49,7 +50,9 @@ NuPlayer::Renderer::Renderer(
       mPaused(false),
       mVideoRenderingStarted(false),
       mLastPositionUpdateUs(-1ll),
-      mVideoLateByUs(0ll) {
+      mVideoLateByUs(0ll),
+      mVideoLateReported(false),
+      mNumVideoFramesDroppedLate(0ll) {
 }
 
 NuPlayer::Renderer::~Renderer() {
@@ -363,6 +366,7 @@ void NuPlayer::Renderer::onDrainVideoQueue() {
         entry = NULL;
 
         mVideoLateByUs = 0ll;
+        mVideoLateReported = false;
 
         notifyPosition();
         return;
@@ -374,15 +378,25 @@ void NuPlayer::Renderer::onDrainVideoQueue() {
     int64_t realTimeUs = mediaTimeUs - mAnchorTimeMediaUs + mAnchorTimeRealUs;
     mVideoLateByUs = ALooper::GetNowUs() - realTimeUs;
 
-    bool tooLate = (mVideoLateByUs > 40000);
+    bool tooLate = (mVideoLateByUs > kMaxVideoLateByUs);
 
     if (tooLate) {
         ALOGV("video late by %lld us (%.2f secs)",
              mVideoLateByUs, mVideoLateByUs / 1E6);
+
+        ++mNumVideoFramesDroppedLate;
     } else {
         ALOGV("rendering video at media time %.2f secs", mediaTimeUs / 1E6);
     }
 
+    // Position updates are rate limited, the decoder hears about late
+    // frames right away so it can start skipping work before more of
+    // them pile up, and again once we have caught up.
+    if (tooLate || mVideoLateReported) {
+        notifyVideoLateBy(mediaTimeUs, mVideoLateByUs);
+        mVideoLateReported = tooLate;
+    }
+
     entry->mNotifyConsumed->setInt32("render", !tooLate);
     entry->mNotifyConsumed->post();
     mVideoQueue.erase(mVideoQueue.begin());
@@ -396,6 +410,16 @@ void NuPlayer::Renderer::onDrainVideoQueue() {
     notifyPosition();
 }
 
+void NuPlayer::Renderer::notifyVideoLateBy(
+        int64_t mediaTimeUs, int64_t lateByUs) {
+    sp<AMessage> notify = mNotify->dup();
+    notify->setInt32("what", kWhatVideoLateBy);
+    notify->setInt64("mediaTimeUs", mediaTimeUs);
+    notify->setInt64("lateByUs", lateByUs);
+    notify->setInt64("numFramesDroppedLate", mNumVideoFramesDroppedLate);
+    notify->post();
+}
+
 void NuPlayer::Renderer::notifyVideoRenderingStart() {
     sp<AMessage> notify = mNotify->dup();
     notify->setInt32("what", kWhatVideoRenderingStart);
@@ -545,6 +569,9 @@ void NuPlayer::Renderer::onFlush(const sp<AMessage> &msg) {
     } else {
         flushQueue(&mVideoQueue);
 
+        mVideoLateByUs = 0ll;
+        mVideoLateReported = false;
+
         Mutex::Autolock autoLock(mFlushLock);
         mFlushingVideo = false;
 
@@ -627,7 +654,6 @@ void NuPlayer::Renderer::notifyPosition() {
     sp<AMessage> notify = mNotify->dup();
     notify->setInt32("what", kWhatPosition);
     notify->setInt64("positionUs", positionUs);
-    notify->setInt64("videoLateByUs", mVideoLateByUs);
     notify->post();
 }
 
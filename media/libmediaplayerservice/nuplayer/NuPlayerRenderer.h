@@ -49,6 +49,7 @@ struct NuPlayer::Renderer : public AHandler {
         kWhatFlushComplete       = 'fluC',
         kWhatPosition            = 'posi',
         kWhatVideoRenderingStart = 'vdrd',
+        kWhatVideoLateBy         = 'vlat',
     };
 
 protected:
@@ -76,6 +77,7 @@ private:
     };
 
     static const int64_t kMinPositionUpdateDelayUs;
+    static const int64_t kMaxVideoLateByUs;
 
     sp<MediaPlayerBase::AudioSink> mAudioSink;
     sp<AMessage> mNotify;
@@ -105,6 +107,10 @@ private:
     int64_t mLastPositionUpdateUs;
     int64_t mVideoLateByUs;
 
+    // Whether the decoder was last told that video is running late.
+    bool mVideoLateReported;
+    int64_t mNumVideoFramesDroppedLate;
+
     bool onDrainAudioQueue();
     void postDrainAudioQueue(int64_t delayUs = 0);
 
@@ -121,7 +127,7 @@ private:
     void notifyEOS(bool audio, status_t finalResult);
     void notifyFlushComplete(bool audio);
     void notifyPosition();
-    void notifyVideoLateBy(int64_t lateByUs);
+    void notifyVideoLateBy(int64_t mediaTimeUs, int64_t lateByUs);
     void notifyVideoRenderingStart();
 
     void flushQueue(List<QueueEntry> *queue);
@@ -20,10 +20,14 @@
 #include <media/stagefright/ACodec.h>
 
 #include <binder/MemoryDealer.h>
+#include <cutils/properties.h>
+#include <unistd.h>
 
 #include <media/stagefright/foundation/hexdump.h>
 #include <media/stagefright/foundation/ABuffer.h>
 #include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/foundation/AHandler.h>
+#include <media/stagefright/foundation/ALooper.h>
 #include <media/stagefright/foundation/AMessage.h>
 
 #include <media/stagefright/MediaCodecList.h>
@@ -53,12 +57,17 @@ struct CodecObserver : public BnOMXObserver {
     CodecObserver() {}
 
     void setNotificationMessage(const sp<AMessage> &msg) {
+        Mutex::Autolock autoLock(mLock);
         mNotify = msg;
     }
 
     // from IOMXObserver
     virtual void onMessage(const omx_message &omx_msg) {
-        sp<AMessage> msg = mNotify->dup();
+        sp<AMessage> msg;
+        {
+            Mutex::Autolock autoLock(mLock);
+            msg = mNotify->dup();
+        }
 
         msg->setInt32("type", omx_msg.type);
         msg->setPointer("node", omx_msg.node);
@@ -115,6 +124,9 @@ protected:
     virtual ~CodecObserver() {}
 
 private:
+    // The observer outlives its codec when the node is pooled, the
+    // notification target is switched while OMX may be calling us.
+    Mutex mLock;
     sp<AMessage> mNotify;
 
     DISALLOW_EVIL_CONSTRUCTORS(CodecObserver);
@@ -122,6 +134,303 @@ private:
 
 ////////////////////////////////////////////////////////////////////////////////
 
+// Holds on to the nodes of hardware decoders that were shut down cleanly,
+// still in Loaded state, so that the next codec asking for the same
+// component can skip allocateNode() and go straight to configuration.
+// Idle nodes are freed after kIdleTimeoutUs or when the pool is full.
+// An idle node keeps its hardware resources, which are shared by all
+// processes: while it is pooled, allocations in other processes can fail
+// and only this process retries after flushing its own pool. The hold is
+// therefore kept short, just long enough to cover a seek or a restart.
+struct ComponentPool : public AHandler {
+    static sp<ComponentPool> Get();
+
+    // Like Get(), but doesn't create the pool if no codec has used it yet.
+    static sp<ComponentPool> Peek();
+
+    // Hands out an idle node of the given component, if there is one.
+    bool acquire(
+            const char *componentName,
+            sp<IOMX> *omx, IOMX::node_id *node,
+            sp<CodecObserver> *observer);
+
+    // Takes ownership of the node, returns false if the caller has to
+    // free it itself.
+    bool release(
+            const AString &componentName,
+            const sp<IOMX> &omx, IOMX::node_id node,
+            const sp<CodecObserver> &observer);
+
+    // Frees all idle nodes, returns the number of nodes that were freed.
+    size_t flush();
+
+    void dump(AString *out);
+
+protected:
+    virtual ~ComponentPool();
+
+    virtual void onMessageReceived(const sp<AMessage> &msg);
+
+private:
+    enum {
+        kWhatExpire        = 'expi',
+        kWhatStrayMessage  = 'stry',
+    };
+
+    enum {
+        kDefaultMaxEntries = 4,
+    };
+
+    static const int64_t kIdleTimeoutUs = 3000000ll;
+
+    struct Entry {
+        int32_t mID;
+        AString mComponentName;
+        sp<IOMX> mOMX;
+        IOMX::node_id mNode;
+        sp<CodecObserver> mObserver;
+        int64_t mReleaseTimeUs;
+    };
+
+    Mutex mLock;
+    sp<ALooper> mLooper;
+
+    // Least recently released first.
+    List<Entry> mEntries;
+    int32_t mNextID;
+    size_t mMaxEntries;
+
+    uint32_t mHits;
+    uint32_t mMisses;
+    uint32_t mReleases;
+    uint32_t mRejections;
+    uint32_t mEvictions;
+    uint32_t mExpirations;
+
+    static Mutex gLock;
+    static sp<ComponentPool> gInstance;
+
+    ComponentPool();
+
+    static void FreeEntry(const Entry &entry);
+
+    DISALLOW_EVIL_CONSTRUCTORS(ComponentPool);
+};
+
+Mutex ComponentPool::gLock;
+sp<ComponentPool> ComponentPool::gInstance;
+
+// static
+sp<ComponentPool> ComponentPool::Get() {
+    Mutex::Autolock autoLock(gLock);
+
+    if (gInstance == NULL) {
+        gInstance = new ComponentPool;
+
+        gInstance->mLooper = new ALooper;
+        gInstance->mLooper->setName("ComponentPool");
+        gInstance->mLooper->start();
+        gInstance->mLooper->registerHandler(gInstance);
+    }
+
+    return gInstance;
+}
+
+// static
+sp<ComponentPool> ComponentPool::Peek() {
+    Mutex::Autolock autoLock(gLock);
+
+    return gInstance;
+}
+
+ComponentPool::ComponentPool()
+    : mNextID(1),
+      mMaxEntries(kDefaultMaxEntries),
+      mHits(0),
+      mMisses(0),
+      mReleases(0),
+      mRejections(0),
+      mEvictions(0),
+      mExpirations(0) {
+    char value[PROPERTY_VALUE_MAX];
+    if (property_get("media.stagefright.codec-pool", value, NULL)) {
+        mMaxEntries = atoi(value) > 0 ? atoi(value) : 0;
+    }
+}
+
+ComponentPool::~ComponentPool() {
+    flush();
+}
+
+// static
+void ComponentPool::FreeEntry(const Entry &entry) {
+    ALOGV("freeing idle %s", entry.mComponentName.c_str());
+
+    status_t err = entry.mOMX->freeNode(entry.mNode);
+
+    if (err != OK) {
+        ALOGW("failed to free idle %s (err %d)",
+              entry.mComponentName.c_str(), err);
+    }
+}
+
+bool ComponentPool::acquire(
+        const char *componentName,
+        sp<IOMX> *omx, IOMX::node_id *node,
+        sp<CodecObserver> *observer) {
+    Mutex::Autolock autoLock(mLock);
+
+    List<Entry>::iterator it = mEntries.end();
+    while (it != mEntries.begin()) {
+        --it;
+
+        if (it->mComponentName == componentName) {
+            *omx = it->mOMX;
+            *node = it->mNode;
+            *observer = it->mObserver;
+
+            mEntries.erase(it);
+            ++mHits;
+
+            return true;
+        }
+    }
+
+    ++mMisses;
+
+    return false;
+}
+
+bool ComponentPool::release(
+        const AString &componentName,
+        const sp<IOMX> &omx, IOMX::node_id node,
+        const sp<CodecObserver> &observer) {
+    Entry evicted;
+    bool haveEvicted = false;
+
+    {
+        Mutex::Autolock autoLock(mLock);
+
+        if (mMaxEntries == 0) {
+            ++mRejections;
+            return false;
+        }
+
+        if (mEntries.size() >= mMaxEntries) {
+            evicted = *mEntries.begin();
+            haveEvicted = true;
+
+            mEntries.erase(mEntries.begin());
+            ++mEvictions;
+        }
+
+        Entry entry;
+        entry.mID = mNextID++;
+        entry.mComponentName = componentName;
+        entry.mOMX = omx;
+        entry.mNode = node;
+        entry.mObserver = observer;
+        entry.mReleaseTimeUs = ALooper::GetNowUs();
+
+        // Whatever the node still has to say is of no interest to the
+        // codec that just let go of it.
+        observer->setNotificationMessage(new AMessage(kWhatStrayMessage, id()));
+
+        mEntries.push_back(entry);
+        ++mReleases;
+
+        sp<AMessage> msg = new AMessage(kWhatExpire, id());
+        msg->setInt32("entryID", entry.mID);
+        msg->post(kIdleTimeoutUs);
+    }
+
+    if (haveEvicted) {
+        FreeEntry(evicted);
+    }
+
+    return true;
+}
+
+size_t ComponentPool::flush() {
+    List<Entry> entries;
+
+    {
+        Mutex::Autolock autoLock(mLock);
+        entries = mEntries;
+        mEntries.clear();
+    }
+
+    for (List<Entry>::iterator it = entries.begin();
+            it != entries.end(); ++it) {
+        FreeEntry(*it);
+    }
+
+    return entries.size();
+}
+
+void ComponentPool::dump(AString *out) {
+    Mutex::Autolock autoLock(mLock);
+
+    int64_t nowUs = ALooper::GetNowUs();
+
+    out->append(StringPrintf(
+            " Codec pool: %zu/%zu idle, hits(%u), misses(%u), releases(%u), "
+            "rejections(%u), evictions(%u), expirations(%u)\n",
+            mEntries.size(), mMaxEntries, mHits, mMisses, mReleases,
+            mRejections, mEvictions, mExpirations).c_str());
+
+    for (List<Entry>::iterator it = mEntries.begin();
+            it != mEntries.end(); ++it) {
+        out->append(StringPrintf(
+                "  %s, idle for %lld ms\n",
+                it->mComponentName.c_str(),
+                (nowUs - it->mReleaseTimeUs) / 1000ll).c_str());
+    }
+}
+
+void ComponentPool::onMessageReceived(const sp<AMessage> &msg) {
+    switch (msg->what()) {
+        case kWhatExpire:
+        {
+            int32_t entryID;
+            CHECK(msg->findInt32("entryID", &entryID));
+
+            Entry expired;
+            bool found = false;
+
+            {
+                Mutex::Autolock autoLock(mLock);
+
+                for (List<Entry>::iterator it = mEntries.begin();
+                        it != mEntries.end(); ++it) {
+                    if (it->mID == entryID) {
+                        expired = *it;
+                        found = true;
+
+                        mEntries.erase(it);
+                        ++mExpirations;
+                        break;
+                    }
+                }
+            }
+
+            if (found) {
+                FreeEntry(expired);
+            }
+            break;
+        }
+
+        case kWhatStrayMessage:
+            break;
+
+        default:
+            TRESPASS();
+            break;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 struct ACodec::BaseState : public AState {
     BaseState(ACodec *codec, const sp<AState> &parentState = NULL);
 
@@ -337,6 +646,7 @@ ACodec::ACodec()
       mNode(NULL),
       mSentFormat(false),
       mIsEncoder(false),
+      mComponentFailed(false),
       mShutdownInProgress(false),
       mEncoderDelay(0),
       mEncoderPadding(0),
@@ -409,6 +719,12 @@ void ACodec::signalRequestIDRFrame() {
     (new AMessage(kWhatRequestIDRFrame, id()))->post();
 }
 
+void ACodec::signalSetParameters(const sp<AMessage> &params) {
+    sp<AMessage> msg = new AMessage(kWhatSetParameters, id());
+    msg->setMessage("params", params);
+    msg->post();
+}
+
 status_t ACodec::allocateBuffersOnPort(OMX_U32 portIndex) {
     CHECK(portIndex == kPortIndexInput || portIndex == kPortIndexOutput);
 
@@ -447,7 +763,17 @@ status_t ACodec::allocateBuffersOnPort(OMX_U32 portIndex) {
                         ? OMXCodec::kRequiresAllocateBufferOnInputPorts
                         : OMXCodec::kRequiresAllocateBufferOnOutputPorts;
 
-                if (portIndex == kPortIndexInput && (mFlags & kFlagIsSecure)) {
+                // Components that defer output buffer allocation don't
+                // hand out a valid pointer yet, they keep the backup copy.
+                bool defersAllocation = portIndex == kPortIndexOutput
+                        && (mQuirks & OMXCodec::kDefersOutputBufferAllocation);
+
+                if ((portIndex == kPortIndexInput && (mFlags & kFlagIsSecure))
+                        || ((mQuirks & requiresAllocateBufferBit)
+                            && !defersAllocation
+                            && mOMX->livesLocally(mNode, getpid()))) {
+                    // The component's own buffers are directly addressable,
+                    // use them instead of shadowing them with backup copies.
                     mem.clear();
 
                     void *ptr;
@@ -455,6 +781,10 @@ status_t ACodec::allocateBuffersOnPort(OMX_U32 portIndex) {
                             mNode, portIndex, def.nBufferSize, &info.mBufferID,
                             &ptr);
 
+                    if (err != OK) {
+                        break;
+                    }
+
                     info.mData = new ABuffer(ptr, def.nBufferSize);
                 } else if (mQuirks & requiresAllocateBufferBit) {
                     err = mOMX->allocateBufferWithBackup(
@@ -2186,6 +2516,8 @@ void ACodec::sendFormatChange() {
 }
 
 void ACodec::signalError(OMX_ERRORTYPE error, status_t internalError) {
+    mComponentFailed = true;
+
     sp<AMessage> notify = mNotify->dup();
     notify->setInt32("what", ACodec::kWhatError);
     notify->setInt32("omx-error", error);
@@ -2193,6 +2525,33 @@ void ACodec::signalError(OMX_ERRORTYPE error, status_t internalError) {
     notify->post();
 }
 
+bool ACodec::isComponentPoolable() const {
+    // Software components are cheap to instantiate and don't all reset
+    // their state on the way back to Loaded. Encoders and secure decoders
+    // are rare enough that keeping them around isn't worth their memory.
+    if (mComponentFailed
+            || (mFlags & kFlagIsSecure)
+            || !strncmp("OMX.google.", mComponentName.c_str(), 11)) {
+        return false;
+    }
+
+    const MediaCodecList *list = MediaCodecList::getInstance();
+    ssize_t index = list->findCodecByName(mComponentName.c_str());
+
+    return index >= 0 && !list->isEncoder(index);
+}
+
+// static
+void ACodec::DumpComponentPool(AString *out) {
+    // Dumping shouldn't start the pool's looper thread.
+    sp<ComponentPool> pool = ComponentPool::Peek();
+    if (pool == NULL) {
+        return;
+    }
+
+    pool->dump(out);
+}
+
 status_t ACodec::pushBlankBuffersToNativeWindow() {
     status_t err = NO_ERROR;
     ANativeWindowBuffer* anb = NULL;
@@ -2353,6 +2712,36 @@ status_t ACodec::requestIDRFrame() {
             sizeof(params));
 }
 
+status_t ACodec::setParameters(const sp<AMessage> &params) {
+    int32_t videoBitrate;
+    if (params->findInt32("videoBitrate", &videoBitrate)) {
+        if (!mIsEncoder) {
+            return ERROR_UNSUPPORTED;
+        }
+
+        OMX_VIDEO_CONFIG_BITRATETYPE configParams;
+        InitOMXParams(&configParams);
+
+        configParams.nPortIndex = kPortIndexOutput;
+        configParams.nEncodeBitrate = videoBitrate;
+
+        status_t err = mOMX->setConfig(
+                mNode,
+                OMX_IndexConfigVideoBitrate,
+                &configParams,
+                sizeof(configParams));
+
+        if (err != OK) {
+            ALOGE("setConfig(OMX_IndexConfigVideoBitrate, %d) failed w/ err %d",
+                  videoBitrate, err);
+
+            return err;
+        }
+    }
+
+    return OK;
+}
+
 void ACodec::PortDescription::addBuffer(
         IOMX::buffer_id id, const sp<ABuffer> &buffer) {
     mBufferIDs.push_back(id);
@@ -3052,7 +3441,9 @@ bool ACodec::UninitializedState::onAllocateComponent(const sp<AMessage> &msg) {
                 &matchingCodecs);
     }
 
-    sp<CodecObserver> observer = new CodecObserver;
+    // Only created once a node is released into it, see onShutdown().
+    sp<ComponentPool> pool = ComponentPool::Peek();
+    sp<CodecObserver> observer;
     IOMX::node_id node = NULL;
 
     for (size_t matchIndex = 0; matchIndex < matchingCodecs.size();
@@ -3060,6 +3451,16 @@ bool ACodec::UninitializedState::onAllocateComponent(const sp<AMessage> &msg) {
         componentName = matchingCodecs.itemAt(matchIndex).mName.string();
         quirks = matchingCodecs.itemAt(matchIndex).mQuirks;
 
+        if (pool != NULL
+                && strncmp("OMX.google.", componentName.c_str(), 11)
+                && pool->acquire(
+                    componentName.c_str(), &omx, &node, &observer)) {
+            ALOGV("[%s] reusing idle component", componentName.c_str());
+            break;
+        }
+
+        observer = new CodecObserver;
+
         pid_t tid = androidGetTid();
         int prevPriority = androidGetThreadPriority(tid);
         androidSetThreadPriority(tid, ANDROID_PRIORITY_FOREGROUND);
@@ -3071,6 +3472,23 @@ bool ACodec::UninitializedState::onAllocateComponent(const sp<AMessage> &msg) {
         }
 
         node = NULL;
+
+        // The idle components may be holding on to exactly the hardware
+        // resources this one needs, release them and try once more.
+        if (pool != NULL && pool->flush() > 0) {
+            ALOGI("[%s] freed idle components, retrying allocation",
+                  componentName.c_str());
+
+            androidSetThreadPriority(tid, ANDROID_PRIORITY_FOREGROUND);
+            err = omx->allocateNode(componentName.c_str(), observer, &node);
+            androidSetThreadPriority(tid, prevPriority);
+
+            if (err == OK) {
+                break;
+            }
+
+            node = NULL;
+        }
     }
 
     if (node == NULL) {
@@ -3098,6 +3516,8 @@ bool ACodec::UninitializedState::onAllocateComponent(const sp<AMessage> &msg) {
     mCodec->mQuirks = quirks;
     mCodec->mOMX = omx;
     mCodec->mNode = node;
+    mCodec->mObserver = observer;
+    mCodec->mComponentFailed = false;
 
     mCodec->mPortEOS[kPortIndexInput] =
         mCodec->mPortEOS[kPortIndexOutput] = false;
@@ -3137,10 +3557,16 @@ void ACodec::LoadedState::stateEntered() {
 
 void ACodec::LoadedState::onShutdown(bool keepComponentAllocated) {
     if (!keepComponentAllocated) {
-        CHECK_EQ(mCodec->mOMX->freeNode(mCodec->mNode), (status_t)OK);
+        if (!mCodec->isComponentPoolable()
+                || !ComponentPool::Get()->release(
+                        mCodec->mComponentName, mCodec->mOMX,
+                        mCodec->mNode, mCodec->mObserver)) {
+            CHECK_EQ(mCodec->mOMX->freeNode(mCodec->mNode), (status_t)OK);
+        }
 
         mCodec->mNativeWindow.clear();
         mCodec->mNode = NULL;
+        mCodec->mObserver.clear();
         mCodec->mOMX.clear();
         mCodec->mQuirks = 0;
         mCodec->mFlags = 0;
@@ -3489,6 +3915,20 @@ bool ACodec::ExecutingState::onMessageReceived(const sp<AMessage> &msg) {
             break;
         }
 
+        case kWhatSetParameters:
+        {
+            sp<AMessage> params;
+            CHECK(msg->findMessage("params", &params));
+
+            status_t err = mCodec->setParameters(params);
+            if (err != OK) {
+                ALOGW("Applying codec parameters failed (err %d).", err);
+            }
+
+            handled = true;
+            break;
+        }
+
         default:
             handled = BaseState::onMessageReceived(msg);
             break;
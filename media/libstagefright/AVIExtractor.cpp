@@ -658,6 +658,10 @@ status_t AVIExtractor::parseStreamHeader(off64_t offset, size_t size) {
     track->mScale = scale;
     track->mBytesPerSample = sampleSize;
     track->mKind = kind;
+    track->mNumSamples = 0;
+    track->mLastOffset = 0;
+    track->mLastSize = 0;
+    track->mDecodedBlock = -1;
     track->mNumSyncSamples = 0;
     track->mThumbnailSampleSize = 0;
     track->mThumbnailSampleIndex = -1;
@@ -766,21 +770,151 @@ bool AVIExtractor::IsCorrectChunkType(
     return true;
 }
 
+static uint8_t *PutVarint(uint8_t *dst, uint64_t x) {
+    while (x > 127) {
+        *dst++ = (x & 0x7f) | 0x80;
+        x >>= 7;
+    }
+    *dst++ = x;
+    return dst;
+}
+
+static const uint8_t *GetVarint(const uint8_t *src, uint64_t *x) {
+    *x = 0;
+    for (unsigned shift = 0;; shift += 7) {
+        uint8_t byte = *src++;
+        *x |= (uint64_t)(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            return src;
+        }
+    }
+}
+
+static uint32_t ZigZag(int32_t x) {
+    return ((uint32_t)x << 1) ^ (uint32_t)(x >> 31);
+}
+
+static int32_t UnZigZag(uint32_t x) {
+    return (int32_t)(x >> 1) ^ -(int32_t)(x & 1);
+}
+
+// Each sample is stored as the difference of its offset to the end of the
+// track's previous chunk (with the sync flag in the lowest bit) and the
+// difference of its size to the previous one. In interleaved files both
+// are small, the whole entry typically takes 3-5 bytes instead of 16 in
+// the "idx1" chunk.
+// static
+void AVIExtractor::appendSample(
+        Track *track, uint32_t offset, uint32_t size, bool isKey) {
+    if ((track->mNumSamples % kSamplesPerBlock) == 0) {
+        IndexBlock block;
+        block.mPackedOffset = track->mPackedIndex.size();
+        block.mFirstOffset = offset;
+        block.mFirstSize = size;
+        track->mIndexBlocks.push(block);
+
+        track->mLastOffset = offset;
+        track->mLastSize = size;
+    }
+
+    uint32_t expectedOffset =
+        (track->mNumSamples % kSamplesPerBlock) == 0
+            ? offset : track->mLastOffset + 8 + track->mLastSize;
+
+    uint8_t tmp[20];
+    uint8_t *dst = PutVarint(
+            tmp,
+            ((uint64_t)ZigZag((int32_t)(offset - expectedOffset)) << 1)
+                | (isKey ? 1 : 0));
+    dst = PutVarint(dst, ZigZag((int32_t)(size - track->mLastSize)));
+
+    track->mPackedIndex.appendArray(tmp, dst - tmp);
+
+    track->mLastOffset = offset;
+    track->mLastSize = size;
+
+    if (isKey) {
+        ++track->mNumSyncSamples;
+
+        if (track->mNumSyncSamples <= track->mNumSamples) {
+            // Not all samples are sync samples, so we need the list.
+            track->mSyncSamples.push(track->mNumSamples);
+        }
+    } else if (track->mNumSyncSamples == track->mNumSamples) {
+        // The first sample that isn't a sync sample, the ones before are.
+        track->mSyncSamples.setCapacity(track->mNumSamples + 1);
+        for (size_t i = 0; i < track->mNumSamples; ++i) {
+            track->mSyncSamples.push(i);
+        }
+    }
+
+    ++track->mNumSamples;
+}
+
+// static
+void AVIExtractor::decodeBlock(Track *track, size_t blockIndex) {
+    const IndexBlock &block = track->mIndexBlocks.itemAt(blockIndex);
+
+    const uint8_t *src = track->mPackedIndex.array() + block.mPackedOffset;
+
+    size_t numSamples = track->mNumSamples - blockIndex * kSamplesPerBlock;
+    if (numSamples > kSamplesPerBlock) {
+        numSamples = kSamplesPerBlock;
+    }
+
+    uint32_t lastOffset = block.mFirstOffset;
+    uint32_t lastSize = block.mFirstSize;
+
+    for (size_t i = 0; i < numSamples; ++i) {
+        uint64_t x;
+        src = GetVarint(src, &x);
+
+        SampleInfo *info = &track->mDecodedSamples[i];
+
+        uint32_t expectedOffset =
+            (i == 0) ? block.mFirstOffset : lastOffset + 8 + lastSize;
+
+        info->mOffset = expectedOffset + UnZigZag((uint32_t)(x >> 1));
+        info->mIsKey = (x & 1) != 0;
+
+        src = GetVarint(src, &x);
+        info->mSize = lastSize + UnZigZag((uint32_t)x);
+
+        lastOffset = info->mOffset;
+        lastSize = info->mSize;
+    }
+
+    track->mDecodedBlock = blockIndex;
+}
+
 status_t AVIExtractor::parseIndex(off64_t offset, size_t size) {
     if ((size % 16) != 0) {
         return ERROR_MALFORMED;
     }
 
-    sp<ABuffer> buffer = new ABuffer(size);
-    ssize_t n = mDataSource->readAt(offset, buffer->data(), buffer->size());
+    // The index is read in pieces of this size, instead of all at once.
+    static const size_t kReadSize = 64 * 1024;
 
-    if (n < (ssize_t)size) {
-        return n < 0 ? (status_t)n : ERROR_MALFORMED;
-    }
+    sp<ABuffer> buffer = new ABuffer(size < kReadSize ? size : kReadSize);
 
-    const uint8_t *data = buffer->data();
+    const uint8_t *data = NULL;
+    size_t remaining = 0;
 
     while (size > 0) {
+        if (remaining == 0) {
+            size_t n = size < buffer->size() ? size : buffer->size();
+
+            ssize_t res = mDataSource->readAt(offset, buffer->data(), n);
+
+            if (res < (ssize_t)n) {
+                return res < 0 ? (status_t)res : ERROR_MALFORMED;
+            }
+
+            offset += n;
+            data = buffer->data();
+            remaining = n;
+        }
+
         uint32_t chunkType = U32_AT(data);
 
         uint8_t hi = chunkType >> 24;
@@ -805,54 +939,51 @@ status_t AVIExtractor::parseIndex(off64_t offset, size_t size) {
         if (track->mKind == Track::OTHER) {
             data += 16;
             size -= 16;
+            remaining -= 16;
             continue;
         }
 
         uint32_t flags = U32LE_AT(&data[4]);
-        uint32_t offset = U32LE_AT(&data[8]);
+        uint32_t chunkOffset = U32LE_AT(&data[8]);
         uint32_t chunkSize = U32LE_AT(&data[12]);
 
+        if (chunkSize > 0x7fffffff) {
+            return ERROR_MALFORMED;
+        }
+
         if (chunkSize > track->mMaxSampleSize) {
             track->mMaxSampleSize = chunkSize;
         }
 
-        track->mSamples.push();
+        bool isKey = (flags & 0x10) != 0;
 
-        SampleInfo *info =
-            &track->mSamples.editItemAt(track->mSamples.size() - 1);
-
-        info->mOffset = offset;
-        info->mIsKey = (flags & 0x10) != 0;
-
-        if (info->mIsKey) {
+        if (isKey) {
             static const size_t kMaxNumSyncSamplesToScan = 20;
 
             if (track->mNumSyncSamples < kMaxNumSyncSamplesToScan) {
                 if (chunkSize > track->mThumbnailSampleSize) {
                     track->mThumbnailSampleSize = chunkSize;
 
-                    track->mThumbnailSampleIndex =
-                        track->mSamples.size() - 1;
+                    track->mThumbnailSampleIndex = track->mNumSamples;
                 }
             }
-
-            ++track->mNumSyncSamples;
         }
 
+        appendSample(track, chunkOffset, chunkSize, isKey);
+
         data += 16;
         size -= 16;
+        remaining -= 16;
     }
 
+    buffer.clear();
+
     if (!mTracks.isEmpty()) {
-        off64_t offset;
-        size_t size;
-        bool isKey;
-        int64_t timeUs;
-        status_t err = getSampleInfo(0, 0, &offset, &size, &isKey, &timeUs);
+        status_t err = checkSampleChunk(0, 0);
 
         if (err != OK) {
             mOffsetsAreAbsolute = !mOffsetsAreAbsolute;
-            err = getSampleInfo(0, 0, &offset, &size, &isKey, &timeUs);
+            err = checkSampleChunk(0, 0);
 
             if (err != OK) {
                 return err;
@@ -872,7 +1003,7 @@ status_t AVIExtractor::parseIndex(off64_t offset, size_t size) {
             // Compute the avg. size of the first 128 chunks (if there are
             // that many), but exclude the size of the first one, since
             // it may be an outlier.
-            size_t numSamplesToAverage = track->mSamples.size();
+            size_t numSamplesToAverage = track->mNumSamples;
             if (numSamplesToAverage > 256) {
                 numSamplesToAverage = 256;
             }
@@ -909,7 +1040,7 @@ status_t AVIExtractor::parseIndex(off64_t offset, size_t size) {
 
         int64_t durationUs;
         CHECK_EQ((status_t)OK,
-                 getSampleTime(i, track->mSamples.size() - 1, &durationUs));
+                 getSampleTime(i, track->mNumSamples - 1, &durationUs));
 
         ALOGV("track %d duration = %.2f secs", i, durationUs / 1E6);
 
@@ -1107,17 +1238,25 @@ status_t AVIExtractor::getSampleInfo(
         size_t trackIndex, size_t sampleIndex,
         off64_t *offset, size_t *size, bool *isKey,
         int64_t *sampleTimeUs) {
+    Mutex::Autolock autoLock(mLock);
+
     if (trackIndex >= mTracks.size()) {
         return -ERANGE;
     }
 
-    const Track &track = mTracks.itemAt(trackIndex);
+    Track *track = &mTracks.editItemAt(trackIndex);
 
-    if (sampleIndex >= track.mSamples.size()) {
+    if (sampleIndex >= track->mNumSamples) {
         return -ERANGE;
     }
 
-    const SampleInfo &info = track.mSamples.itemAt(sampleIndex);
+    size_t blockIndex = sampleIndex / kSamplesPerBlock;
+    if (track->mDecodedBlock != (ssize_t)blockIndex) {
+        decodeBlock(track, blockIndex);
+    }
+
+    const SampleInfo &info =
+        track->mDecodedSamples[sampleIndex % kSamplesPerBlock];
 
     if (!mOffsetsAreAbsolute) {
         *offset = info.mOffset + mMovieOffset + 8;
@@ -1125,39 +1264,55 @@ status_t AVIExtractor::getSampleInfo(
         *offset = info.mOffset;
     }
 
-    *size = 0;
-
-    uint8_t tmp[8];
-    ssize_t n = mDataSource->readAt(*offset, tmp, 8);
-
-    if (n < 8) {
-        return n < 0 ? (status_t)n : (status_t)ERROR_MALFORMED;
-    }
-
-    uint32_t chunkType = U32_AT(tmp);
-
-    if (!IsCorrectChunkType(trackIndex, track.mKind, chunkType)) {
-        return ERROR_MALFORMED;
-    }
-
+    // Skip the chunk header, checkSampleChunk() verifies that it's there.
     *offset += 8;
-    *size = U32LE_AT(&tmp[4]);
+    *size = info.mSize;
 
     *isKey = info.mIsKey;
 
-    if (track.mBytesPerSample > 0) {
+    if (track->mBytesPerSample > 0) {
         size_t sampleStartInBytes;
         if (sampleIndex == 0) {
             sampleStartInBytes = 0;
         } else {
             sampleStartInBytes =
-                track.mFirstChunkSize + track.mAvgChunkSize * (sampleIndex - 1);
+                track->mFirstChunkSize + track->mAvgChunkSize * (sampleIndex - 1);
         }
 
-        sampleIndex = sampleStartInBytes / track.mBytesPerSample;
+        sampleIndex = sampleStartInBytes / track->mBytesPerSample;
     }
 
-    *sampleTimeUs = (sampleIndex * 1000000ll * track.mRate) / track.mScale;
+    *sampleTimeUs = (sampleIndex * 1000000ll * track->mRate) / track->mScale;
+
+    return OK;
+}
+
+status_t AVIExtractor::checkSampleChunk(
+        size_t trackIndex, size_t sampleIndex) {
+    off64_t offset;
+    size_t size;
+    bool isKey;
+    int64_t timeUs;
+    status_t err = getSampleInfo(
+            trackIndex, sampleIndex, &offset, &size, &isKey, &timeUs);
+
+    if (err != OK) {
+        return err;
+    }
+
+    uint8_t tmp[8];
+    ssize_t n = mDataSource->readAt(offset - 8, tmp, 8);
+
+    if (n < 8) {
+        return n < 0 ? (status_t)n : (status_t)ERROR_MALFORMED;
+    }
+
+    uint32_t chunkType = U32_AT(tmp);
+
+    if (!IsCorrectChunkType(
+                trackIndex, mTracks.itemAt(trackIndex).mKind, chunkType)) {
+        return ERROR_MALFORMED;
+    }
 
     return OK;
 }
@@ -1200,7 +1355,11 @@ status_t AVIExtractor::getSampleIndexAtTime(
         closestSampleIndex = timeUs / track.mRate * track.mScale / 1000000ll;
     }
 
-    ssize_t numSamples = track.mSamples.size();
+    ssize_t numSamples = track.mNumSamples;
+
+    if (numSamples == 0) {
+        return UNKNOWN_ERROR;
+    }
 
     if (closestSampleIndex < 0) {
         closestSampleIndex = 0;
@@ -1214,28 +1373,36 @@ status_t AVIExtractor::getSampleIndexAtTime(
         return OK;
     }
 
-    ssize_t prevSyncSampleIndex = closestSampleIndex;
-    while (prevSyncSampleIndex >= 0) {
-        const SampleInfo &info =
-            track.mSamples.itemAt(prevSyncSampleIndex);
+    ssize_t prevSyncSampleIndex;
+    ssize_t nextSyncSampleIndex;
 
-        if (info.mIsKey) {
-            break;
+    if (track.mNumSyncSamples == track.mNumSamples) {
+        prevSyncSampleIndex = nextSyncSampleIndex = closestSampleIndex;
+    } else {
+        // Find the first sync sample past the closest sample.
+        size_t left = 0;
+        size_t right = track.mSyncSamples.size();
+        while (left < right) {
+            size_t center = left + (right - left) / 2;
+
+            if (track.mSyncSamples.itemAt(center)
+                    <= (uint32_t)closestSampleIndex) {
+                left = center + 1;
+            } else {
+                right = center;
+            }
         }
 
-        --prevSyncSampleIndex;
-    }
-
-    ssize_t nextSyncSampleIndex = closestSampleIndex;
-    while (nextSyncSampleIndex < numSamples) {
-        const SampleInfo &info =
-            track.mSamples.itemAt(nextSyncSampleIndex);
+        prevSyncSampleIndex =
+            (left > 0) ? (ssize_t)track.mSyncSamples.itemAt(left - 1) : -1;
 
-        if (info.mIsKey) {
-            break;
+        if (prevSyncSampleIndex == closestSampleIndex) {
+            nextSyncSampleIndex = closestSampleIndex;
+        } else if (left < track.mSyncSamples.size()) {
+            nextSyncSampleIndex = track.mSyncSamples.itemAt(left);
+        } else {
+            nextSyncSampleIndex = numSamples;
         }
-
-        ++nextSyncSampleIndex;
     }
 
     switch (mode) {
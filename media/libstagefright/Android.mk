@@ -20,6 +20,7 @@ LOCAL_SRC_FILES:=                         \
         FileSource.cpp                    \
         FLACExtractor.cpp                 \
         FragmentedMP4Extractor.cpp        \
+        FrameIndexSeeker.cpp              \
         HTTPBase.cpp                      \
         JPEGSource.cpp                    \
         MP3Extractor.cpp                  \
@@ -19,6 +19,7 @@
 #include <utils/Log.h>
 
 #include <binder/IPCThreadState.h>
+#include <cutils/atomic.h>
 #include <media/AudioTrack.h>
 #include <media/stagefright/foundation/ADebug.h>
 #include <media/stagefright/foundation/ALooper.h>
@@ -30,8 +31,25 @@
 
 #include "include/AwesomePlayer.h"
 
+#include <sys/prctl.h>
+
 namespace android {
 
+// How much PCM the decoder thread keeps ready ahead of playback.
+static const int64_t kRingDurationUs = 500000ll;
+
+// The decoder thread refills the ring in bursts, once at least this
+// fraction of it has been played out.
+static const size_t kRefillDivisor = 2;
+
+// Upper bound on how long the decoder thread sleeps between checks, the
+// audio callback's wakeup is not synchronized with its wait.
+static const int64_t kDecoderWaitUs = 100000ll;
+
+// The callback only copies out of the ring, the sink needs no more
+// buffering than it takes to cover the callback thread's scheduling.
+static const int kSinkBufferCount = 2;
+
 AudioPlayer::AudioPlayer(
         const sp<MediaPlayerBase::AudioSink> &audioSink,
         bool allowDeepBuffering,
@@ -39,8 +57,26 @@ AudioPlayer::AudioPlayer(
     : mAudioTrack(NULL),
       mInputBuffer(NULL),
       mSampleRate(0),
+      mNumChannels(0),
+      mChannelMask(0),
       mLatencyUs(0),
       mFrameSize(0),
+      mRingData(NULL),
+      mRingSize(0),
+      mRingReadPos(0),
+      mRingWritePos(0),
+      mMarkerReadIndex(0),
+      mMarkerWriteIndex(0),
+      mDecoderThreadStarted(false),
+      mDecoderExit(false),
+      mDecoderEOS(false),
+      mDecoderSeekPending(false),
+      mGeneration(0),
+      mFlushPending(false),
+      mFlushPos(0),
+      mFlushGeneration(0),
+      mPrerolled(false),
+      mStartedSource(false),
       mNumFramesPlayed(0),
       mNumFramesPlayedSysTimeUs(ALooper::GetNowUs()),
       mPositionTimeMediaUs(-1),
@@ -49,9 +85,6 @@ AudioPlayer::AudioPlayer(
       mReachedEOS(false),
       mFinalStatus(OK),
       mStarted(false),
-      mIsFirstBuffer(false),
-      mFirstBufferResult(OK),
-      mFirstBuffer(NULL),
       mAudioSink(audioSink),
       mAllowDeepBuffering(allowDeepBuffering),
       mObserver(observer),
@@ -61,6 +94,9 @@ AudioPlayer::AudioPlayer(
 AudioPlayer::~AudioPlayer() {
     if (mStarted) {
         reset();
+    } else {
+        // Prerolled but never started, the source stays with the caller.
+        stopDecoding();
     }
 }
 
@@ -69,81 +105,63 @@ void AudioPlayer::setSource(const sp<MediaSource> &source) {
     mSource = source;
 }
 
-status_t AudioPlayer::start(bool sourceAlreadyStarted) {
+status_t AudioPlayer::preroll(bool sourceAlreadyStarted) {
     CHECK(!mStarted);
     CHECK(mSource != NULL);
 
-    status_t err;
-    if (!sourceAlreadyStarted) {
-        err = mSource->start();
-
-        if (err != OK) {
-            return err;
-        }
+    if (mPrerolled) {
+        return OK;
     }
 
-    // We allow an optional INFO_FORMAT_CHANGED at the very beginning
-    // of playback, if there is one, getFormat below will retrieve the
-    // updated format, if there isn't, we'll stash away the valid buffer
-    // of data to be used on the first audio callback.
-
-    CHECK(mFirstBuffer == NULL);
+    status_t err = startDecoding(sourceAlreadyStarted);
 
-    MediaSource::ReadOptions options;
-    if (mSeeking) {
-        options.setSeekTo(mSeekTimeUs);
-        mSeeking = false;
+    if (err == OK) {
+        mPrerolled = true;
     }
 
-    mFirstBufferResult = mSource->read(&mFirstBuffer, &options);
-    if (mFirstBufferResult == INFO_FORMAT_CHANGED) {
-        ALOGV("INFO_FORMAT_CHANGED!!!");
+    return err;
+}
 
-        CHECK(mFirstBuffer == NULL);
-        mFirstBufferResult = OK;
-        mIsFirstBuffer = false;
-    } else {
-        mIsFirstBuffer = true;
-    }
+status_t AudioPlayer::start(bool sourceAlreadyStarted) {
+    CHECK(!mStarted);
+    CHECK(mSource != NULL);
 
-    sp<MetaData> format = mSource->getFormat();
-    const char *mime;
-    bool success = format->findCString(kKeyMIMEType, &mime);
-    CHECK(success);
-    CHECK(!strcasecmp(mime, MEDIA_MIMETYPE_AUDIO_RAW));
+    status_t err;
 
-    success = format->findInt32(kKeySampleRate, &mSampleRate);
-    CHECK(success);
+    if (mPrerolled && isSeeking()) {
+        // Callers expect a seek requested before start() to be complete
+        // once it returns, the prerolled data is of no use anyway.
+        stopDecoding();
+        mPrerolled = false;
+        sourceAlreadyStarted = true;
+    }
 
-    int32_t numChannels, channelMask;
-    success = format->findInt32(kKeyChannelCount, &numChannels);
-    CHECK(success);
+    if (!mPrerolled) {
+        err = startDecoding(sourceAlreadyStarted);
 
-    if(!format->findInt32(kKeyChannelMask, &channelMask)) {
-        // log only when there's a risk of ambiguity of channel mask selection
-        ALOGI_IF(numChannels > 2,
-                "source format didn't specify channel mask, using (%d) channel order", numChannels);
-        channelMask = CHANNEL_MASK_USE_CHANNEL_ORDER;
+        if (err != OK) {
+            return err;
+        }
     }
 
+    mPrerolled = false;
+
     if (mAudioSink.get() != NULL) {
 
         status_t err = mAudioSink->open(
-                mSampleRate, numChannels, channelMask, AUDIO_FORMAT_PCM_16_BIT,
-                DEFAULT_AUDIOSINK_BUFFERCOUNT,
+                mSampleRate, mNumChannels, mChannelMask, AUDIO_FORMAT_PCM_16_BIT,
+                kSinkBufferCount,
                 &AudioPlayer::AudioSinkCallback,
                 this,
                 (mAllowDeepBuffering ?
                             AUDIO_OUTPUT_FLAG_DEEP_BUFFER :
                             AUDIO_OUTPUT_FLAG_NONE));
         if (err != OK) {
-            if (mFirstBuffer != NULL) {
-                mFirstBuffer->release();
-                mFirstBuffer = NULL;
-            }
+            stopDecoding();
 
-            if (!sourceAlreadyStarted) {
+            if (mStartedSource) {
                 mSource->stop();
+                mStartedSource = false;
             }
 
             return err;
@@ -155,9 +173,16 @@ status_t AudioPlayer::start(bool sourceAlreadyStarted) {
         mAudioSink->start();
     } else {
         // playing to an AudioTrack, set up mask if necessary
-        audio_channel_mask_t audioMask = channelMask == CHANNEL_MASK_USE_CHANNEL_ORDER ?
-                audio_channel_out_mask_from_count(numChannels) : channelMask;
+        audio_channel_mask_t audioMask = mChannelMask == CHANNEL_MASK_USE_CHANNEL_ORDER ?
+                audio_channel_out_mask_from_count(mNumChannels) : mChannelMask;
         if (0 == audioMask) {
+            stopDecoding();
+
+            if (mStartedSource) {
+                mSource->stop();
+                mStartedSource = false;
+            }
+
             return BAD_VALUE;
         }
 
@@ -169,13 +194,11 @@ status_t AudioPlayer::start(bool sourceAlreadyStarted) {
             delete mAudioTrack;
             mAudioTrack = NULL;
 
-            if (mFirstBuffer != NULL) {
-                mFirstBuffer->release();
-                mFirstBuffer = NULL;
-            }
+            stopDecoding();
 
-            if (!sourceAlreadyStarted) {
+            if (mStartedSource) {
                 mSource->stop();
+                mStartedSource = false;
             }
 
             return err;
@@ -193,6 +216,313 @@ status_t AudioPlayer::start(bool sourceAlreadyStarted) {
     return OK;
 }
 
+status_t AudioPlayer::startDecoding(bool sourceAlreadyStarted) {
+    CHECK(!mDecoderThreadStarted);
+
+    status_t err;
+    if (!sourceAlreadyStarted) {
+        err = mSource->start();
+
+        if (err != OK) {
+            return err;
+        }
+
+        mStartedSource = true;
+    }
+
+    // We allow an optional INFO_FORMAT_CHANGED at the very beginning
+    // of playback, if there is one, getFormat below will retrieve the
+    // updated format, if there isn't, the valid buffer of data is the
+    // first thing to go into the ring.
+
+    CHECK(mInputBuffer == NULL);
+
+    MediaSource::ReadOptions options;
+    {
+        Mutex::Autolock autoLock(mLock);
+        if (mSeeking) {
+            options.setSeekTo(mSeekTimeUs);
+            mSeeking = false;
+        }
+    }
+
+    status_t firstBufferResult = mSource->read(&mInputBuffer, &options);
+    if (firstBufferResult == INFO_FORMAT_CHANGED) {
+        ALOGV("INFO_FORMAT_CHANGED!!!");
+
+        CHECK(mInputBuffer == NULL);
+        firstBufferResult = OK;
+    }
+
+    sp<MetaData> format = mSource->getFormat();
+    const char *mime;
+    bool success = format->findCString(kKeyMIMEType, &mime);
+    CHECK(success);
+    CHECK(!strcasecmp(mime, MEDIA_MIMETYPE_AUDIO_RAW));
+
+    success = format->findInt32(kKeySampleRate, &mSampleRate);
+    CHECK(success);
+
+    success = format->findInt32(kKeyChannelCount, &mNumChannels);
+    CHECK(success);
+
+    if(!format->findInt32(kKeyChannelMask, &mChannelMask)) {
+        // log only when there's a risk of ambiguity of channel mask selection
+        ALOGI_IF(mNumChannels > 2,
+                "source format didn't specify channel mask, using (%d) channel order", mNumChannels);
+        mChannelMask = CHANNEL_MASK_USE_CHANNEL_ORDER;
+    }
+
+    size_t ringBytes =
+        (mSampleRate * kRingDurationUs / 1000000ll)
+            * mNumChannels * sizeof(int16_t);
+
+    mRingSize = 1;
+    while (mRingSize < ringBytes) {
+        mRingSize <<= 1;
+    }
+
+    mRingData = new uint8_t[mRingSize];
+    mRingReadPos = mRingWritePos = 0;
+    mMarkerReadIndex = mMarkerWriteIndex = 0;
+
+    mGeneration = mFlushGeneration = 0;
+    mFlushPending = false;
+    mDecoderEOS = false;
+    mDecoderSeekPending = false;
+    mDecoderExit = false;
+
+    // The decoder thread isn't running yet, the first buffer goes into
+    // the ring right away so that the first callback finds it there.
+    if (firstBufferResult != OK || mInputBuffer != NULL) {
+        if (queueReadResult(firstBufferResult)) {
+            writeInputBuffer();
+        }
+    }
+
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_JOINABLE);
+
+    pthread_create(&mDecoderThread, &attr, DecoderThreadWrapper, this);
+
+    pthread_attr_destroy(&attr);
+
+    mDecoderThreadStarted = true;
+
+    return OK;
+}
+
+void AudioPlayer::stopDecoding() {
+    if (mDecoderThreadStarted) {
+        {
+            Mutex::Autolock autoLock(mLock);
+            mDecoderExit = true;
+            mDecoderCondition.signal();
+        }
+
+        void *dummy;
+        pthread_join(mDecoderThread, &dummy);
+
+        mDecoderThreadStarted = false;
+    }
+
+    if (mInputBuffer != NULL) {
+        ALOGV("AudioPlayer releasing input buffer.");
+
+        mInputBuffer->release();
+        mInputBuffer = NULL;
+    }
+
+    delete[] mRingData;
+    mRingData = NULL;
+    mRingSize = 0;
+    mRingReadPos = mRingWritePos = 0;
+    mMarkerReadIndex = mMarkerWriteIndex = 0;
+    mFlushPending = false;
+}
+
+// static
+void *AudioPlayer::DecoderThreadWrapper(void *me) {
+    androidSetThreadPriority(0, ANDROID_PRIORITY_AUDIO);
+
+    static_cast<AudioPlayer *>(me)->decoderThread();
+
+    return NULL;
+}
+
+void AudioPlayer::decoderThread() {
+    prctl(PR_SET_NAME, (unsigned long)"AudioPlayerDecode", 0, 0, 0);
+
+    bool filling = true;
+
+    for (;;) {
+        MediaSource::ReadOptions options;
+
+        {
+            Mutex::Autolock autoLock(mLock);
+
+            for (;;) {
+                if (mDecoderExit) {
+                    return;
+                }
+
+                if (mDecoderSeekPending) {
+                    mDecoderSeekPending = false;
+                    options.setSeekTo(mSeekTimeUs);
+
+                    if (mInputBuffer != NULL) {
+                        mInputBuffer->release();
+                        mInputBuffer = NULL;
+                    }
+
+                    mDecoderEOS = false;
+
+                    // Everything written from here on belongs to the new
+                    // position, the callback drops what came before,
+                    // markers included. The read below still has to wait
+                    // for marker space like any other.
+                    ++mGeneration;
+                    mFlushPos = (uint32_t)mRingWritePos;
+                    mFlushGeneration = mGeneration;
+                    mFlushPending = true;
+
+                    filling = true;
+                }
+
+                if (!mDecoderEOS && canWrite()) {
+                    if (filling) {
+                        break;
+                    }
+
+                    uint32_t used =
+                        (uint32_t)mRingWritePos
+                            - (uint32_t)android_atomic_acquire_load(
+                                    &mRingReadPos);
+
+                    if (mRingSize - used >= mRingSize / kRefillDivisor) {
+                        filling = true;
+                        break;
+                    }
+                }
+
+                filling = false;
+                mDecoderCondition.waitRelative(mLock, kDecoderWaitUs * 1000ll);
+            }
+        }
+
+        decodeOneBuffer(&options);
+    }
+}
+
+void AudioPlayer::decodeOneBuffer(MediaSource::ReadOptions *options) {
+    if (mInputBuffer == NULL) {
+        status_t err = mSource->read(&mInputBuffer, options);
+
+        if (!queueReadResult(err)) {
+            return;
+        }
+    }
+
+    writeInputBuffer();
+}
+
+bool AudioPlayer::queueReadResult(status_t err) {
+    CHECK((err == OK && mInputBuffer != NULL)
+           || (err != OK && mInputBuffer == NULL));
+
+    Marker marker;
+    marker.mPos = (uint32_t)mRingWritePos;
+    marker.mGeneration = mGeneration;
+    marker.mMediaTimeUs = -1;
+    marker.mEOS = (err != OK);
+    marker.mFinalStatus = err;
+
+    if (err != OK) {
+        pushMarker(marker);
+
+        Mutex::Autolock autoLock(mLock);
+        mDecoderEOS = true;
+        return false;
+    }
+
+    if (mInputBuffer->range_length() == 0) {
+        mInputBuffer->release();
+        mInputBuffer = NULL;
+        return false;
+    }
+
+    CHECK(mInputBuffer->meta_data()->findInt64(
+                kKeyTime, &marker.mMediaTimeUs));
+
+    pushMarker(marker);
+
+    return true;
+}
+
+void AudioPlayer::writeInputBuffer() {
+    size_t n = writeToRing(
+            (const uint8_t *)mInputBuffer->data()
+                + mInputBuffer->range_offset(),
+            mInputBuffer->range_length());
+
+    mInputBuffer->set_range(
+            mInputBuffer->range_offset() + n,
+            mInputBuffer->range_length() - n);
+
+    if (mInputBuffer->range_length() == 0) {
+        mInputBuffer->release();
+        mInputBuffer = NULL;
+    }
+}
+
+// Called by the decoder thread only.
+bool AudioPlayer::canWrite() const {
+    uint32_t used =
+        (uint32_t)mRingWritePos
+            - (uint32_t)android_atomic_acquire_load(&mRingReadPos);
+
+    int32_t markersUsed =
+        mMarkerWriteIndex - android_atomic_acquire_load(&mMarkerReadIndex);
+
+    // A new input buffer needs a marker, a partially written one doesn't.
+    return used < mRingSize
+        && (mInputBuffer != NULL || markersUsed < kMaxMarkers);
+}
+
+void AudioPlayer::pushMarker(const Marker &marker) {
+    int32_t index = mMarkerWriteIndex;
+    CHECK_LT(index - android_atomic_acquire_load(&mMarkerReadIndex),
+             (int32_t)kMaxMarkers);
+
+    mMarkers[(uint32_t)index & (kMaxMarkers - 1)] = marker;
+
+    android_atomic_release_store(index + 1, &mMarkerWriteIndex);
+}
+
+size_t AudioPlayer::writeToRing(const uint8_t *data, size_t size) {
+    uint32_t writePos = (uint32_t)mRingWritePos;
+    uint32_t readPos = (uint32_t)android_atomic_acquire_load(&mRingReadPos);
+
+    size_t n = mRingSize - (writePos - readPos);
+    if (n > size) {
+        n = size;
+    }
+
+    size_t offset = writePos & (mRingSize - 1);
+    size_t first = mRingSize - offset;
+    if (first > n) {
+        first = n;
+    }
+
+    memcpy(mRingData + offset, data, first);
+    memcpy(mRingData, data + first, n - first);
+
+    android_atomic_release_store((int32_t)(writePos + n), &mRingWritePos);
+
+    return n;
+}
+
 void AudioPlayer::pause(bool playPendingSamples) {
     CHECK(mStarted);
 
@@ -239,22 +569,12 @@ void AudioPlayer::reset() {
         mAudioTrack = NULL;
     }
 
-    // Make sure to release any buffer we hold onto so that the
-    // source is able to stop().
-
-    if (mFirstBuffer != NULL) {
-        mFirstBuffer->release();
-        mFirstBuffer = NULL;
-    }
-
-    if (mInputBuffer != NULL) {
-        ALOGV("AudioPlayer releasing input buffer.");
-
-        mInputBuffer->release();
-        mInputBuffer = NULL;
-    }
+    // Make sure to stop decoding and release any buffer we hold onto so
+    // that the source is able to stop().
+    stopDecoding();
 
     mSource->stop();
+    mStartedSource = false;
 
     // The following hack is necessary to ensure that the OMX
     // component is completely released by the time we may try
@@ -357,94 +677,98 @@ size_t AudioPlayer::fillBuffer(void *data, size_t size) {
     bool postEOS = false;
     int64_t postEOSDelayUs = 0;
 
-    size_t size_done = 0;
-    size_t size_remaining = size;
-    while (size_remaining > 0) {
-        MediaSource::ReadOptions options;
+    int32_t generation;
 
-        {
-            Mutex::Autolock autoLock(mLock);
-
-            if (mSeeking) {
-                if (mIsFirstBuffer) {
-                    if (mFirstBuffer != NULL) {
-                        mFirstBuffer->release();
-                        mFirstBuffer = NULL;
-                    }
-                    mIsFirstBuffer = false;
-                }
-
-                options.setSeekTo(mSeekTimeUs);
-
-                if (mInputBuffer != NULL) {
-                    mInputBuffer->release();
-                    mInputBuffer = NULL;
-                }
+    {
+        Mutex::Autolock autoLock(mLock);
 
-                mSeeking = false;
-                if (mObserver) {
-                    postSeekComplete = true;
-                }
+        if (mFlushPending) {
+            android_atomic_release_store(
+                    (int32_t)mFlushPos, &mRingReadPos);
+
+            // Free the markers of the old position, the decoder waits for
+            // marker space before its first read at the new one.
+            int32_t index = mMarkerReadIndex;
+            while (index != android_atomic_acquire_load(&mMarkerWriteIndex)
+                    && mMarkers[(uint32_t)index & (kMaxMarkers - 1)].mGeneration
+                        - mFlushGeneration < 0) {
+                ++index;
             }
+            android_atomic_release_store(index, &mMarkerReadIndex);
+
+            mFlushPending = false;
+            mDecoderCondition.signal();
         }
 
-        if (mInputBuffer == NULL) {
-            status_t err;
+        if (mDecoderSeekPending) {
+            // The decoder thread hasn't gotten around to the seek yet,
+            // whatever is in the ring is from before it.
+            return 0;
+        }
 
-            if (mIsFirstBuffer) {
-                mInputBuffer = mFirstBuffer;
-                mFirstBuffer = NULL;
-                err = mFirstBufferResult;
+        generation = mFlushGeneration;
+    }
 
-                mIsFirstBuffer = false;
-            } else {
-                err = mSource->read(&mInputBuffer, &options);
+    size_t size_done = 0;
+    while (size_done < size) {
+        uint32_t readPos = (uint32_t)mRingReadPos;
+
+        // Load the write position before looking at the markers, any data
+        // we see is then guaranteed to have its marker visible as well.
+        uint32_t writePos =
+            (uint32_t)android_atomic_acquire_load(&mRingWritePos);
+
+        size_t available = writePos - readPos;
+        bool stale = false;
+        bool eos = false;
+        status_t finalStatus = OK;
+
+        for (;;) {
+            int32_t index = mMarkerReadIndex;
+            if (index == android_atomic_acquire_load(&mMarkerWriteIndex)) {
+                break;
             }
 
-            CHECK((err == OK && mInputBuffer != NULL)
-                   || (err != OK && mInputBuffer == NULL));
+            const Marker &marker = mMarkers[(uint32_t)index & (kMaxMarkers - 1)];
 
-            Mutex::Autolock autoLock(mLock);
-
-            if (err != OK) {
-                if (mObserver && !mReachedEOS) {
-                    // We don't want to post EOS right away but only
-                    // after all frames have actually been played out.
-
-                    // These are the number of frames submitted to the
-                    // AudioTrack that you haven't heard yet.
-                    uint32_t numFramesPendingPlayout =
-                        getNumFramesPendingPlayout();
-
-                    // These are the number of frames we're going to
-                    // submit to the AudioTrack by returning from this
-                    // callback.
-                    uint32_t numAdditionalFrames = size_done / mFrameSize;
-
-                    numFramesPendingPlayout += numAdditionalFrames;
+            if (marker.mGeneration - generation < 0) {
+                android_atomic_release_store(index + 1, &mMarkerReadIndex);
+                continue;
+            } else if (marker.mGeneration != generation) {
+                // A seek that we'll pick up on the next callback.
+                stale = true;
+                break;
+            }
 
-                    int64_t timeToCompletionUs =
-                        (1000000ll * numFramesPendingPlayout) / mSampleRate;
+            if (marker.mPos != readPos) {
+                if (marker.mPos - readPos < available) {
+                    available = marker.mPos - readPos;
+                }
+                break;
+            }
 
-                    ALOGV("total number of frames played: %lld (%lld us)",
-                            (mNumFramesPlayed + numAdditionalFrames),
-                            1000000ll * (mNumFramesPlayed + numAdditionalFrames)
-                                / mSampleRate);
+            Mutex::Autolock autoLock(mLock);
 
-                    ALOGV("%d frames left to play, %lld us (%.2f secs)",
-                         numFramesPendingPlayout,
-                         timeToCompletionUs, timeToCompletionUs / 1E6);
+            if (mDecoderSeekPending || generation != mFlushGeneration) {
+                // Seeked meanwhile, don't let the old position overwrite
+                // the new one.
+                stale = true;
+                break;
+            }
 
-                    postEOS = true;
-                    if (mAudioSink->needsTrailingPadding()) {
-                        postEOSDelayUs = timeToCompletionUs + mLatencyUs;
-                    } else {
-                        postEOSDelayUs = 0;
-                    }
+            if (mSeeking) {
+                // The first buffer (or EOS) at the new position completes
+                // the seek, only now does the media time make sense again.
+                mSeeking = false;
+                if (mObserver) {
+                    postSeekComplete = true;
                 }
+            }
 
-                mReachedEOS = true;
-                mFinalStatus = err;
+            if (marker.mEOS) {
+                eos = true;
+                finalStatus = marker.mFinalStatus;
+                android_atomic_release_store(index + 1, &mMarkerReadIndex);
                 break;
             }
 
@@ -454,40 +778,92 @@ size_t AudioPlayer::fillBuffer(void *data, size_t size) {
                 mLatencyUs = (int64_t)mAudioTrack->latency() * 1000;
             }
 
-            CHECK(mInputBuffer->meta_data()->findInt64(
-                        kKeyTime, &mPositionTimeMediaUs));
+            mPositionTimeMediaUs = marker.mMediaTimeUs;
 
             mPositionTimeRealUs =
                 ((mNumFramesPlayed + size_done / mFrameSize) * 1000000)
                     / mSampleRate;
 
-            ALOGV("buffer->size() = %d, "
-                 "mPositionTimeMediaUs=%.2f mPositionTimeRealUs=%.2f",
-                 mInputBuffer->range_length(),
+            ALOGV("mPositionTimeMediaUs=%.2f mPositionTimeRealUs=%.2f",
                  mPositionTimeMediaUs / 1E6, mPositionTimeRealUs / 1E6);
+
+            android_atomic_release_store(index + 1, &mMarkerReadIndex);
         }
 
-        if (mInputBuffer->range_length() == 0) {
-            mInputBuffer->release();
-            mInputBuffer = NULL;
+        if (eos) {
+            Mutex::Autolock autoLock(mLock);
+
+            if (mObserver && !mReachedEOS) {
+                // We don't want to post EOS right away but only
+                // after all frames have actually been played out.
+
+                // These are the number of frames submitted to the
+                // AudioTrack that you haven't heard yet.
+                uint32_t numFramesPendingPlayout =
+                    getNumFramesPendingPlayout();
+
+                // These are the number of frames we're going to
+                // submit to the AudioTrack by returning from this
+                // callback.
+                uint32_t numAdditionalFrames = size_done / mFrameSize;
+
+                numFramesPendingPlayout += numAdditionalFrames;
 
-            continue;
+                int64_t timeToCompletionUs =
+                    (1000000ll * numFramesPendingPlayout) / mSampleRate;
+
+                ALOGV("total number of frames played: %lld (%lld us)",
+                        (mNumFramesPlayed + numAdditionalFrames),
+                        1000000ll * (mNumFramesPlayed + numAdditionalFrames)
+                            / mSampleRate);
+
+                ALOGV("%d frames left to play, %lld us (%.2f secs)",
+                     numFramesPendingPlayout,
+                     timeToCompletionUs, timeToCompletionUs / 1E6);
+
+                postEOS = true;
+                if (mAudioSink->needsTrailingPadding()) {
+                    postEOSDelayUs = timeToCompletionUs + mLatencyUs;
+                } else {
+                    postEOSDelayUs = 0;
+                }
+            }
+
+            mReachedEOS = true;
+            mFinalStatus = finalStatus;
+            break;
+        }
+
+        if (stale || available == 0) {
+            // Nothing decoded yet, play what we have.
+            break;
         }
 
-        size_t copy = size_remaining;
-        if (copy > mInputBuffer->range_length()) {
-            copy = mInputBuffer->range_length();
+        size_t copy = size - size_done;
+        if (copy > available) {
+            copy = available;
         }
 
-        memcpy((char *)data + size_done,
-               (const char *)mInputBuffer->data() + mInputBuffer->range_offset(),
-               copy);
+        size_t offset = readPos & (mRingSize - 1);
+        size_t first = mRingSize - offset;
+        if (first > copy) {
+            first = copy;
+        }
+
+        memcpy((char *)data + size_done, mRingData + offset, first);
+        memcpy((char *)data + size_done + first, mRingData, copy - first);
 
-        mInputBuffer->set_range(mInputBuffer->range_offset() + copy,
-                                mInputBuffer->range_length() - copy);
+        android_atomic_release_store((int32_t)(readPos + copy), &mRingReadPos);
 
         size_done += copy;
-        size_remaining -= copy;
+    }
+
+    uint32_t used =
+        (uint32_t)android_atomic_acquire_load(&mRingWritePos)
+            - (uint32_t)mRingReadPos;
+
+    if (mRingSize - used >= mRingSize / kRefillDivisor) {
+        mDecoderCondition.signal();
     }
 
     {
@@ -575,13 +951,18 @@ status_t AudioPlayer::seekTo(int64_t time_us) {
     mReachedEOS = false;
     mSeekTimeUs = time_us;
 
+    if (mDecoderThreadStarted) {
+        mDecoderSeekPending = true;
+        mDecoderCondition.signal();
+    }
+
     // Flush resets the number of played frames
     mNumFramesPlayed = 0;
     mNumFramesPlayedSysTimeUs = ALooper::GetNowUs();
 
     if (mAudioSink != NULL) {
         mAudioSink->flush();
-    } else {
+    } else if (mAudioTrack != NULL) {
         mAudioTrack->flush();
     }
 
@@ -230,18 +230,18 @@ AwesomePlayer::~AwesomePlayer() {
 }
 
 void AwesomePlayer::cancelPlayerEvents(bool keepNotifications) {
-    mQueue.cancelEvent(mVideoEvent->eventID());
+    mQueue.cancelEvent(mVideoEvent);
     mVideoEventPending = false;
-    mQueue.cancelEvent(mVideoLagEvent->eventID());
+    mQueue.cancelEvent(mVideoLagEvent);
     mVideoLagEventPending = false;
 
     if (!keepNotifications) {
-        mQueue.cancelEvent(mStreamDoneEvent->eventID());
+        mQueue.cancelEvent(mStreamDoneEvent);
         mStreamDoneEventPending = false;
-        mQueue.cancelEvent(mCheckAudioStatusEvent->eventID());
+        mQueue.cancelEvent(mCheckAudioStatusEvent);
         mAudioStatusEventPending = false;
 
-        mQueue.cancelEvent(mBufferingEvent->eventID());
+        mQueue.cancelEvent(mBufferingEvent);
         mBufferingEventPending = false;
     }
 }
@@ -533,6 +533,14 @@ void AwesomePlayer::reset_l() {
     // If we did this later, audio would continue playing while we
     // shutdown the video-related resources and the player appear to
     // not be as responsive to a reset request.
+    if (mAudioPlayer != NULL && !(mFlags & AUDIOPLAYER_STARTED)) {
+        // A prerolled audio player still reads from the source on its
+        // own thread, it has to go away before the source is stopped.
+        delete mAudioPlayer;
+        mAudioPlayer = NULL;
+        mTimeSource = NULL;
+    }
+
     if ((mAudioPlayer == NULL || !(mFlags & AUDIOPLAYER_STARTED))
             && mAudioSource != NULL) {
         // If we had an audio player, it would have effectively
@@ -977,28 +985,7 @@ status_t AwesomePlayer::play_l() {
     if (mAudioSource != NULL) {
         if (mAudioPlayer == NULL) {
             if (mAudioSink != NULL) {
-                bool allowDeepBuffering;
-                int64_t cachedDurationUs;
-                bool eos;
-                if (mVideoSource == NULL
-                        && (mDurationUs > AUDIO_SINK_MIN_DEEP_BUFFER_DURATION_US ||
-                        (getCachedDuration_l(&cachedDurationUs, &eos) &&
-                        cachedDurationUs > AUDIO_SINK_MIN_DEEP_BUFFER_DURATION_US))) {
-                    allowDeepBuffering = true;
-                } else {
-                    allowDeepBuffering = false;
-                }
-
-                mAudioPlayer = new AudioPlayer(mAudioSink, allowDeepBuffering, this);
-                mAudioPlayer->setSource(mAudioSource);
-
-                mTimeSource = mAudioPlayer;
-
-                // If there was a seek request before we ever started,
-                // honor the request now.
-                // Make sure to do this before starting the audio player
-                // to avoid a race condition.
-                seekAudioIfNecessary_l();
+                createAudioPlayer_l();
             }
         }
 
@@ -1059,6 +1046,61 @@ status_t AwesomePlayer::play_l() {
     return OK;
 }
 
+void AwesomePlayer::createAudioPlayer_l() {
+    CHECK(mAudioPlayer == NULL);
+    CHECK(mAudioSink != NULL);
+
+    bool allowDeepBuffering;
+    int64_t cachedDurationUs;
+    bool eos;
+    if (mVideoSource == NULL
+            && (mDurationUs > AUDIO_SINK_MIN_DEEP_BUFFER_DURATION_US ||
+            (getCachedDuration_l(&cachedDurationUs, &eos) &&
+            cachedDurationUs > AUDIO_SINK_MIN_DEEP_BUFFER_DURATION_US))) {
+        allowDeepBuffering = true;
+    } else {
+        allowDeepBuffering = false;
+    }
+
+    mAudioPlayer = new AudioPlayer(mAudioSink, allowDeepBuffering, this);
+    mAudioPlayer->setSource(mAudioSource);
+
+    mTimeSource = mAudioPlayer;
+
+    // If there was a seek request before we ever started,
+    // honor the request now.
+    // Make sure to do this before starting the audio player
+    // to avoid a race condition.
+    seekAudioIfNecessary_l();
+}
+
+status_t AwesomePlayer::prerollAudio() {
+    Mutex::Autolock autoLock(mLock);
+
+    if (!(mFlags & PREPARED) || (mFlags & PLAYING)
+            || mAudioSource == NULL || mVideoSource != NULL
+            || mAudioSink == NULL || mAudioPlayer != NULL) {
+        // Only audio-only playback benefits, with video the audio player
+        // isn't started until the first frame is ready anyway.
+        return OK;
+    }
+
+    createAudioPlayer_l();
+
+    // The source was started by initAudioDecoder().
+    status_t err = mAudioPlayer->preroll(true /* sourceAlreadyStarted */);
+
+    if (err != OK) {
+        ALOGW("failed to preroll audio (%d)", err);
+
+        delete mAudioPlayer;
+        mAudioPlayer = NULL;
+        mTimeSource = NULL;
+    }
+
+    return err;
+}
+
 status_t AwesomePlayer::startAudioPlayer_l(bool sendErrorNotification) {
     CHECK(!(mFlags & AUDIO_RUNNING));
 
@@ -2529,6 +2571,14 @@ status_t AwesomePlayer::selectAudioTrack_l(
     int64_t curTimeUs;
     CHECK_EQ(getPosition(&curTimeUs), (status_t)OK);
 
+    if (mAudioPlayer != NULL && !(mFlags & AUDIOPLAYER_STARTED)) {
+        // A prerolled audio player still reads from the source on its
+        // own thread, it has to go away before the source is stopped.
+        delete mAudioPlayer;
+        mAudioPlayer = NULL;
+        mTimeSource = NULL;
+    }
+
     if ((mAudioPlayer == NULL || !(mFlags & AUDIOPLAYER_STARTED))
             && mAudioSource != NULL) {
         // If we had an audio player, it would have effectively
@@ -89,8 +89,6 @@ ssize_t FileSource::readAt(off64_t offset, void *data, size_t size) {
         return NO_INIT;
     }
 
-    Mutex::Autolock autoLock(mLock);
-
     if (mLength >= 0) {
         if (offset >= mLength) {
             return 0;  // read beyond EOF.
@@ -103,16 +101,14 @@ ssize_t FileSource::readAt(off64_t offset, void *data, size_t size) {
 
     if (mDecryptHandle != NULL && DecryptApiType::CONTAINER_BASED
             == mDecryptHandle->decryptApiType) {
-        return readAtDRM(offset, data, size);
-   } else {
-        off64_t result = lseek64(mFd, offset + mOffset, SEEK_SET);
-        if (result == -1) {
-            ALOGE("seek to %lld failed", offset + mOffset);
-            return UNKNOWN_ERROR;
-        }
+        Mutex::Autolock autoLock(mLock);
 
-        return ::read(mFd, data, size);
+        return readAtDRM(offset, data, size);
     }
+
+    // pread() leaves the file offset alone, so readers on different
+    // threads (e.g. the tracks of an extractor) don't have to take turns.
+    return pread64(mFd, data, size, offset + mOffset);
 }
 
 status_t FileSource::getSize(off64_t *size) {
@@ -0,0 +1,295 @@
+/*
+ * Copyright (C) 2012 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "FrameIndexSeeker"
+#include <utils/Log.h>
+
+#include "include/FrameIndexSeeker.h"
+
+#include "include/avc_utils.h"
+
+#include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/foundation/ALooper.h>
+#include <media/stagefright/DataSource.h>
+#include <media/stagefright/Utils.h>
+
+#include <sys/prctl.h>
+
+namespace android {
+
+// Same as in MP3Extractor, the bits that must not change from one frame
+// to the next.
+static const uint32_t kMask = 0xfffe0c00;
+
+// The index is built from reads this large, instead of the 4 byte header
+// reads MP3Source does while playing.
+static const size_t kReadSize = 64 * 1024;
+
+// Give up on indexing if no valid frame shows up within this many bytes
+// after losing sync, it's most likely trailing junk or a tag.
+static const off64_t kMaxResyncBytes = 64 * 1024;
+
+// static
+sp<FrameIndexSeeker> FrameIndexSeeker::CreateFromSource(
+        const sp<DataSource> &source,
+        off64_t first_frame_pos, uint32_t fixed_header) {
+    if (source->flags()
+            & (DataSource::kIsCachingDataSource
+                | DataSource::kIsHTTPBasedSource)) {
+        return NULL;
+    }
+
+    off64_t fileSize;
+    if (source->getSize(&fileSize) != OK || fileSize <= first_frame_pos) {
+        return NULL;
+    }
+
+    size_t frameSize;
+    int sampleRate;
+    int samplesPerFrame;
+    if (!GetMPEGAudioFrameSize(
+                fixed_header, &frameSize, &sampleRate, NULL, NULL,
+                &samplesPerFrame)) {
+        return NULL;
+    }
+
+    return new FrameIndexSeeker(
+            source, first_frame_pos, fixed_header,
+            sampleRate, samplesPerFrame);
+}
+
+FrameIndexSeeker::FrameIndexSeeker(
+        const sp<DataSource> &source, off64_t first_frame_pos,
+        uint32_t fixed_header,
+        int32_t sample_rate, int32_t samples_per_frame)
+    : mSource(source),
+      mFirstFramePos(first_frame_pos),
+      mFixedHeader(fixed_header),
+      mSampleRate(sample_rate),
+      mSamplesPerFrame(samples_per_frame),
+      mNumFrames(0),
+      mComplete(false),
+      mAbort(false),
+      mThreadStarted(false) {
+}
+
+FrameIndexSeeker::~FrameIndexSeeker() {
+    if (mThreadStarted) {
+        {
+            Mutex::Autolock autoLock(mLock);
+            mAbort = true;
+        }
+
+        void *dummy;
+        pthread_join(mThread, &dummy);
+    }
+}
+
+void FrameIndexSeeker::startIndexing_l() {
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_JOINABLE);
+
+    int res = pthread_create(&mThread, &attr, ThreadWrapper, this);
+
+    pthread_attr_destroy(&attr);
+
+    if (res != 0) {
+        // Seeks keep using the bitrate estimate, try again on the next.
+        return;
+    }
+
+    mThreadStarted = true;
+}
+
+int64_t FrameIndexSeeker::getTimeUsForFrame(int64_t frame) const {
+    return frame * mSamplesPerFrame * 1000000ll / mSampleRate;
+}
+
+bool FrameIndexSeeker::getDuration(int64_t *durationUs) {
+    Mutex::Autolock autoLock(mLock);
+
+    if (!mComplete) {
+        return false;
+    }
+
+    *durationUs = getTimeUsForFrame(mNumFrames);
+
+    return true;
+}
+
+bool FrameIndexSeeker::getOffsetForTime(int64_t *timeUs, off64_t *pos) {
+    int64_t targetFrame =
+        (*timeUs < 0 ? 0 : *timeUs) * mSampleRate
+            / (1000000ll * mSamplesPerFrame);
+
+    int64_t frame;
+    off64_t offset;
+
+    {
+        Mutex::Autolock autoLock(mLock);
+
+        if (!mThreadStarted) {
+            startIndexing_l();
+        }
+
+        size_t index = targetFrame / kFramesPerEntry;
+
+        if (index >= mOffsets.size()) {
+            if (!mComplete || mOffsets.isEmpty()) {
+                // Not indexed yet.
+                return false;
+            }
+
+            index = mOffsets.size() - 1;
+            targetFrame = mNumFrames;
+        }
+
+        frame = (int64_t)index * kFramesPerEntry;
+        offset = mFirstFramePos + mOffsets.itemAt(index);
+    }
+
+    // Step over the remaining frames, at most kFramesPerEntry - 1 of them,
+    // so that playback resumes with the frame that contains the target.
+    while (frame < targetFrame) {
+        uint8_t tmp[4];
+        if (mSource->readAt(offset, tmp, sizeof(tmp)) < (ssize_t)sizeof(tmp)) {
+            break;
+        }
+
+        uint32_t header = U32_AT(tmp);
+
+        size_t frameSize;
+        if ((header & kMask) != (mFixedHeader & kMask)
+                || !GetMPEGAudioFrameSize(header, &frameSize)) {
+            break;
+        }
+
+        offset += frameSize;
+        ++frame;
+    }
+
+    *timeUs = getTimeUsForFrame(frame);
+    *pos = offset;
+
+    return true;
+}
+
+// static
+void *FrameIndexSeeker::ThreadWrapper(void *me) {
+    androidSetThreadPriority(0, ANDROID_PRIORITY_BACKGROUND);
+
+    static_cast<FrameIndexSeeker *>(me)->buildIndex();
+
+    return NULL;
+}
+
+void FrameIndexSeeker::buildIndex() {
+    prctl(PR_SET_NAME, (unsigned long)"MP3FrameIndex", 0, 0, 0);
+
+    int64_t startUs = ALooper::GetNowUs();
+
+    uint8_t *buffer = new uint8_t[kReadSize];
+    off64_t bufferPos = mFirstFramePos;
+    size_t bufferSize = 0;
+
+    off64_t pos = mFirstFramePos;
+    off64_t lostSyncPos = -1;
+    int64_t numFrames = 0;
+
+    for (;;) {
+        if (pos - mFirstFramePos > 0xffffffffll) {
+            // Offsets are stored in 32 bits.
+            break;
+        }
+
+        if (pos + 4 > bufferPos + (off64_t)bufferSize) {
+            {
+                Mutex::Autolock autoLock(mLock);
+                if (mAbort) {
+                    break;
+                }
+            }
+
+            ssize_t n = mSource->readAt(pos, buffer, kReadSize);
+            if (n < 4) {
+                break;
+            }
+
+            bufferPos = pos;
+            bufferSize = n;
+        }
+
+        uint32_t header = U32_AT(&buffer[pos - bufferPos]);
+
+        size_t frameSize;
+        bool valid = (header & kMask) == (mFixedHeader & kMask)
+            && GetMPEGAudioFrameSize(header, &frameSize);
+
+        if (valid && lostSyncPos >= 0) {
+            // Don't trust a single header after losing sync, its successor
+            // has to match as well if we have it at hand.
+            off64_t nextPos = pos + frameSize;
+            if (nextPos + 4 <= bufferPos + (off64_t)bufferSize) {
+                uint32_t nextHeader = U32_AT(&buffer[nextPos - bufferPos]);
+                size_t nextFrameSize;
+                valid = (nextHeader & kMask) == (mFixedHeader & kMask)
+                    && GetMPEGAudioFrameSize(nextHeader, &nextFrameSize);
+            }
+        }
+
+        if (!valid) {
+            if (lostSyncPos < 0) {
+                ALOGV("lost sync at %lld", pos);
+                lostSyncPos = pos;
+            } else if (pos - lostSyncPos > kMaxResyncBytes) {
+                break;
+            }
+
+            ++pos;
+            continue;
+        }
+
+        lostSyncPos = -1;
+
+        if ((numFrames % kFramesPerEntry) == 0) {
+            Mutex::Autolock autoLock(mLock);
+            mOffsets.push((uint32_t)(pos - mFirstFramePos));
+        }
+
+        ++numFrames;
+        pos += frameSize;
+    }
+
+    delete[] buffer;
+    buffer = NULL;
+
+    Mutex::Autolock autoLock(mLock);
+
+    if (mAbort) {
+        return;
+    }
+
+    mNumFrames = numFrames;
+    mComplete = true;
+
+    ALOGV("indexed %lld frames (%.2f secs) in %lld us, %d entries",
+         numFrames, getTimeUsForFrame(numFrames) / 1E6,
+         ALooper::GetNowUs() - startUs, mOffsets.size());
+}
+
+}  // namespace android
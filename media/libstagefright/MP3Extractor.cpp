@@ -21,6 +21,7 @@
 #include "include/MP3Extractor.h"
 
 #include "include/avc_utils.h"
+#include "include/FrameIndexSeeker.h"
 #include "include/ID3.h"
 #include "include/VBRISeeker.h"
 #include "include/XINGSeeker.h"
@@ -391,6 +392,15 @@ sp<MediaSource> MP3Extractor::getTrack(size_t index) {
         return NULL;
     }
 
+    if (mSeeker == NULL) {
+        // No XING/VBRI table, build our own in the background, starting
+        // with the first seek, rather than estimate from the bitrate. Not
+        // done in the constructor since the extractor is also used for
+        // metadata only.
+        mSeeker = FrameIndexSeeker::CreateFromSource(
+                mDataSource, mFirstFramePos, mFixedHeader);
+    }
+
     return new MP3Source(
             mMeta, mDataSource, mFirstFramePos, mFixedHeader,
             mSeeker);
@@ -84,8 +84,23 @@ private:
 
     uint8_t *mSrcBuffer;
 
+    enum {
+        kMaxReadAheadSize = 256 * 1024,
+    };
+
+    // Samples of a chunk are adjacent in the file, so instead of one read
+    // per sample the remainder of the chunk is read in one go and the
+    // following samples are copied out of here. Each track has its own,
+    // poorly interleaved tracks don't evict each other's data.
+    uint8_t *mReadAheadBuffer;
+    off64_t mReadAheadOffset;
+    size_t mReadAheadSize;
+
     size_t parseNALSize(const uint8_t *data) const;
 
+    ssize_t readSample(
+            off64_t offset, void *data, size_t size, off64_t chunkEndOffset);
+
     MPEG4Source(const MPEG4Source &);
     MPEG4Source &operator=(const MPEG4Source &);
 };
@@ -150,14 +165,17 @@ status_t MPEG4DataSource::initCheck() const {
 }
 
 ssize_t MPEG4DataSource::readAt(off64_t offset, void *data, size_t size) {
-    Mutex::Autolock autoLock(mLock);
+    {
+        Mutex::Autolock autoLock(mLock);
 
-    if (offset >= mCachedOffset
-            && offset + size <= mCachedOffset + mCachedSize) {
-        memcpy(data, &mCache[offset - mCachedOffset], size);
-        return size;
+        if (offset >= mCachedOffset
+                && offset + size <= mCachedOffset + mCachedSize) {
+            memcpy(data, &mCache[offset - mCachedOffset], size);
+            return size;
+        }
     }
 
+    // Not holding the lock here, the tracks' sources read concurrently.
     return mSource->readAt(offset, data, size);
 }
 
@@ -272,6 +290,7 @@ MPEG4Extractor::MPEG4Extractor(const sp<DataSource> &source)
     : mDataSource(source),
       mInitCheck(NO_INIT),
       mHasVideo(false),
+      mLazyParsing(false),
       mFirstTrack(NULL),
       mLastTrack(NULL),
       mFileMetaData(new MetaData),
@@ -299,6 +318,13 @@ MPEG4Extractor::~MPEG4Extractor() {
     mFirstSINF = NULL;
 }
 
+void MPEG4Extractor::setLazyParsing(bool lazy) {
+    // Too late once the file has been parsed.
+    if (mInitCheck == NO_INIT) {
+        mLazyParsing = lazy;
+    }
+}
+
 sp<MetaData> MPEG4Extractor::getMetaData() {
     status_t err;
     if ((err = readMetaData()) != OK) {
@@ -346,7 +372,8 @@ sp<MetaData> MPEG4Extractor::getTrackMetaData(
     }
 
     if ((flags & kIncludeExtensiveMetaData)
-            && !track->includes_expensive_metadata) {
+            && !track->includes_expensive_metadata
+            && loadSampleTables(track) == OK) {
         track->includes_expensive_metadata = true;
 
         const char *mime;
@@ -691,7 +718,10 @@ status_t MPEG4Extractor::parseChunk(off64_t *offset, int depth) {
         case FOURCC('u', 'd', 't', 'a'):
         case FOURCC('i', 'l', 's', 't'):
         {
-            if (chunk_type == FOURCC('s', 't', 'b', 'l')) {
+            if (chunk_type == FOURCC('s', 't', 'b', 'l') && mLazyParsing) {
+                mLastTrack->stblOffset = *offset;
+                mLastTrack->stblSize = chunk_size;
+            } else if (chunk_type == FOURCC('s', 't', 'b', 'l')) {
                 ALOGV("sampleTable chunk is %d bytes long.", (size_t)chunk_size);
 
                 if (mDataSource->flags()
@@ -725,6 +755,8 @@ status_t MPEG4Extractor::parseChunk(off64_t *offset, int depth) {
                 track->includes_expensive_metadata = false;
                 track->skipTrack = false;
                 track->timescale = 0;
+                track->stblOffset = 0;
+                track->stblSize = 0;
                 track->meta->setCString(kKeyMIMEType, "application/octet-stream");
             }
 
@@ -1036,112 +1068,26 @@ status_t MPEG4Extractor::parseChunk(off64_t *offset, int depth) {
 
         case FOURCC('s', 't', 'c', 'o'):
         case FOURCC('c', 'o', '6', '4'):
-        {
-            status_t err =
-                mLastTrack->sampleTable->setChunkOffsetParams(
-                        chunk_type, data_offset, chunk_data_size);
-
-            if (err != OK) {
-                return err;
-            }
-
-            *offset += chunk_size;
-            break;
-        }
-
         case FOURCC('s', 't', 's', 'c'):
-        {
-            status_t err =
-                mLastTrack->sampleTable->setSampleToChunkParams(
-                        data_offset, chunk_data_size);
-
-            if (err != OK) {
-                return err;
-            }
-
-            *offset += chunk_size;
-            break;
-        }
-
         case FOURCC('s', 't', 's', 'z'):
         case FOURCC('s', 't', 'z', '2'):
-        {
-            status_t err =
-                mLastTrack->sampleTable->setSampleSizeParams(
-                        chunk_type, data_offset, chunk_data_size);
-
-            if (err != OK) {
-                return err;
-            }
-
-            size_t max_size;
-            err = mLastTrack->sampleTable->getMaxSampleSize(&max_size);
-
-            if (err != OK) {
-                return err;
-            }
-
-            // Assume that a given buffer only contains at most 10 fragments,
-            // each fragment originally prefixed with a 2 byte length will
-            // have a 4 byte header (0x00 0x00 0x00 0x01) after conversion,
-            // and thus will grow by 2 bytes per fragment.
-            mLastTrack->meta->setInt32(kKeyMaxInputSize, max_size + 10 * 2);
-            *offset += chunk_size;
-
-            // Calculate average frame rate.
-            const char *mime;
-            CHECK(mLastTrack->meta->findCString(kKeyMIMEType, &mime));
-            if (!strncasecmp("video/", mime, 6)) {
-                size_t nSamples = mLastTrack->sampleTable->countSamples();
-                int64_t durationUs;
-                if (mLastTrack->meta->findInt64(kKeyDuration, &durationUs)) {
-                    if (durationUs > 0) {
-                        int32_t frameRate = (nSamples * 1000000LL +
-                                    (durationUs >> 1)) / durationUs;
-                        mLastTrack->meta->setInt32(kKeyFrameRate, frameRate);
-                    }
-                }
-            }
-
-            break;
-        }
-
         case FOURCC('s', 't', 't', 's'):
-        {
-            status_t err =
-                mLastTrack->sampleTable->setTimeToSampleParams(
-                        data_offset, chunk_data_size);
-
-            if (err != OK) {
-                return err;
-            }
-
-            *offset += chunk_size;
-            break;
-        }
-
         case FOURCC('c', 't', 't', 's'):
-        {
-            status_t err =
-                mLastTrack->sampleTable->setCompositionTimeToSampleParams(
-                        data_offset, chunk_data_size);
-
-            if (err != OK) {
-                return err;
-            }
-
-            *offset += chunk_size;
-            break;
-        }
-
         case FOURCC('s', 't', 's', 's'):
         {
-            status_t err =
-                mLastTrack->sampleTable->setSyncSampleParams(
-                        data_offset, chunk_data_size);
+            if (mLazyParsing) {
+                SampleTableBox box;
+                box.type = chunk_type;
+                box.data_offset = data_offset;
+                box.data_size = chunk_data_size;
+                mLastTrack->sampleTableBoxes.push(box);
+            } else {
+                status_t err = parseSampleTableBox(
+                        mLastTrack, chunk_type, data_offset, chunk_data_size);
 
-            if (err != OK) {
-                return err;
+                if (err != OK) {
+                    return err;
+                }
             }
 
             *offset += chunk_size;
@@ -1764,6 +1710,10 @@ sp<MediaSource> MPEG4Extractor::getTrack(size_t index) {
         return NULL;
     }
 
+    if (loadSampleTables(track) != OK) {
+        return NULL;
+    }
+
     return new MPEG4Source(
             track->meta, mDataSource, track->timescale, track->sampleTable);
 }
@@ -1789,8 +1739,159 @@ status_t MPEG4Extractor::verifyTrack(Track *track) {
         }
     }
 
+    if (track->sampleTable != NULL) {
+        if (!track->sampleTable->isValid()) {
+            // Make sure we have all the metadata we need.
+            return ERROR_MALFORMED;
+        }
+    } else {
+        // Parsing was deferred, at least make sure the boxes are there.
+        uint32_t found = 0;
+        for (size_t i = 0; i < track->sampleTableBoxes.size(); ++i) {
+            switch (track->sampleTableBoxes.itemAt(i).type) {
+                case FOURCC('s', 't', 'c', 'o'):
+                case FOURCC('c', 'o', '6', '4'):
+                    found |= 1;
+                    break;
+                case FOURCC('s', 't', 's', 'c'):
+                    found |= 2;
+                    break;
+                case FOURCC('s', 't', 's', 'z'):
+                case FOURCC('s', 't', 'z', '2'):
+                    found |= 4;
+                    break;
+                case FOURCC('s', 't', 't', 's'):
+                    found |= 8;
+                    break;
+                default:
+                    break;
+            }
+        }
+
+        if (found != 15) {
+            return ERROR_MALFORMED;
+        }
+    }
+
+    return OK;
+}
+
+status_t MPEG4Extractor::parseSampleTableBox(
+        Track *track, uint32_t type, off64_t data_offset, off64_t data_size) {
+    switch (type) {
+        case FOURCC('s', 't', 'c', 'o'):
+        case FOURCC('c', 'o', '6', '4'):
+        {
+            return track->sampleTable->setChunkOffsetParams(
+                    type, data_offset, data_size);
+        }
+
+        case FOURCC('s', 't', 's', 'c'):
+        {
+            return track->sampleTable->setSampleToChunkParams(
+                    data_offset, data_size);
+        }
+
+        case FOURCC('s', 't', 's', 'z'):
+        case FOURCC('s', 't', 'z', '2'):
+        {
+            status_t err =
+                track->sampleTable->setSampleSizeParams(
+                        type, data_offset, data_size);
+
+            if (err != OK) {
+                return err;
+            }
+
+            size_t max_size;
+            err = track->sampleTable->getMaxSampleSize(&max_size);
+
+            if (err != OK) {
+                return err;
+            }
+
+            // Assume that a given buffer only contains at most 10 fragments,
+            // each fragment originally prefixed with a 2 byte length will
+            // have a 4 byte header (0x00 0x00 0x00 0x01) after conversion,
+            // and thus will grow by 2 bytes per fragment.
+            track->meta->setInt32(kKeyMaxInputSize, max_size + 10 * 2);
+
+            // Calculate average frame rate.
+            const char *mime;
+            CHECK(track->meta->findCString(kKeyMIMEType, &mime));
+            if (!strncasecmp("video/", mime, 6)) {
+                size_t nSamples = track->sampleTable->countSamples();
+                int64_t durationUs;
+                if (track->meta->findInt64(kKeyDuration, &durationUs)) {
+                    if (durationUs > 0) {
+                        int32_t frameRate = (nSamples * 1000000LL +
+                                    (durationUs >> 1)) / durationUs;
+                        track->meta->setInt32(kKeyFrameRate, frameRate);
+                    }
+                }
+            }
+
+            return OK;
+        }
+
+        case FOURCC('s', 't', 't', 's'):
+        {
+            return track->sampleTable->setTimeToSampleParams(
+                    data_offset, data_size);
+        }
+
+        case FOURCC('c', 't', 't', 's'):
+        {
+            return track->sampleTable->setCompositionTimeToSampleParams(
+                    data_offset, data_size);
+        }
+
+        case FOURCC('s', 't', 's', 's'):
+        {
+            return track->sampleTable->setSyncSampleParams(
+                    data_offset, data_size);
+        }
+
+        default:
+            TRESPASS();
+            return ERROR_MALFORMED;
+    }
+}
+
+status_t MPEG4Extractor::loadSampleTables(Track *track) {
+    if (track->sampleTable != NULL) {
+        return OK;
+    }
+
+    sp<DataSource> source = mDataSource;
+
+    if (mDataSource->flags()
+            & (DataSource::kWantsPrefetching
+                | DataSource::kIsCachingDataSource)) {
+        sp<MPEG4DataSource> cachedSource = new MPEG4DataSource(mDataSource);
+
+        if (cachedSource->setCachedRange(
+                    track->stblOffset, track->stblSize) == OK) {
+            source = cachedSource;
+        }
+    }
+
+    track->sampleTable = new SampleTable(source);
+
+    for (size_t i = 0; i < track->sampleTableBoxes.size(); ++i) {
+        const SampleTableBox &box = track->sampleTableBoxes.itemAt(i);
+
+        status_t err = parseSampleTableBox(
+                track, box.type, box.data_offset, box.data_size);
+
+        if (err != OK) {
+            track->sampleTable.clear();
+            return err;
+        }
+    }
+
     if (!track->sampleTable->isValid()) {
-        // Make sure we have all the metadata we need.
+        track->sampleTable.clear();
         return ERROR_MALFORMED;
     }
 
@@ -1920,7 +2021,10 @@ MPEG4Source::MPEG4Source(
       mGroup(NULL),
       mBuffer(NULL),
       mWantsNALFragments(false),
-      mSrcBuffer(NULL) {
+      mSrcBuffer(NULL),
+      mReadAheadBuffer(NULL),
+      mReadAheadOffset(0),
+      mReadAheadSize(0) {
     const char *mime;
     bool success = mFormat->findCString(kKeyMIMEType, &mime);
     CHECK(success);
@@ -1971,6 +2075,14 @@ status_t MPEG4Source::start(MetaData *params) {
 
     mSrcBuffer = new uint8_t[max_size];
 
+    // Reading ahead on a caching source could stall the current sample
+    // until data it doesn't need yet has arrived over the network.
+    if (!(mDataSource->flags() & DataSource::kIsCachingDataSource)) {
+        mReadAheadBuffer = new uint8_t[kMaxReadAheadSize];
+    }
+    mReadAheadOffset = 0;
+    mReadAheadSize = 0;
+
     mStarted = true;
 
     return OK;
@@ -1989,6 +2101,10 @@ status_t MPEG4Source::stop() {
     delete[] mSrcBuffer;
     mSrcBuffer = NULL;
 
+    delete[] mReadAheadBuffer;
+    mReadAheadBuffer = NULL;
+    mReadAheadSize = 0;
+
     delete mGroup;
     mGroup = NULL;
 
@@ -2023,6 +2139,44 @@ size_t MPEG4Source::parseNALSize(const uint8_t *data) const {
     return 0;
 }
 
+ssize_t MPEG4Source::readSample(
+        off64_t offset, void *data, size_t size, off64_t chunkEndOffset) {
+    if (mReadAheadBuffer == NULL) {
+        return mDataSource->readAt(offset, data, size);
+    }
+
+    if (offset >= mReadAheadOffset
+            && offset + size <= mReadAheadOffset + mReadAheadSize) {
+        memcpy(data, &mReadAheadBuffer[offset - mReadAheadOffset], size);
+        return size;
+    }
+
+    off64_t endOffset = chunkEndOffset;
+    if (endOffset > offset + kMaxReadAheadSize) {
+        endOffset = offset + kMaxReadAheadSize;
+    }
+
+    if (endOffset <= offset + (off64_t)size) {
+        // Last sample of its chunk or too large to be buffered.
+        return mDataSource->readAt(offset, data, size);
+    }
+
+    ssize_t n = mDataSource->readAt(
+            offset, mReadAheadBuffer, endOffset - offset);
+
+    if (n < (ssize_t)size) {
+        mReadAheadSize = 0;
+        return n;
+    }
+
+    mReadAheadOffset = offset;
+    mReadAheadSize = n;
+
+    memcpy(data, mReadAheadBuffer, size);
+
+    return size;
+}
+
 status_t MPEG4Source::read(
         MediaBuffer **out, const ReadOptions *options) {
     Mutex::Autolock autoLock(mLock);
@@ -2118,13 +2272,15 @@ status_t MPEG4Source::read(
     size_t size;
     uint32_t cts;
     bool isSyncSample;
+    off64_t chunkEndOffset;
     bool newBuffer = false;
     if (mBuffer == NULL) {
         newBuffer = true;
 
         status_t err =
             mSampleTable->getMetaDataForSample(
-                    mCurrentSampleIndex, &offset, &size, &cts, &isSyncSample);
+                    mCurrentSampleIndex, &offset, &size, &cts, &isSyncSample,
+                    &chunkEndOffset);
 
         if (err != OK) {
             return err;
@@ -2140,8 +2296,8 @@ status_t MPEG4Source::read(
 
     if (!mIsAVC || mWantsNALFragments) {
         if (newBuffer) {
-            ssize_t num_bytes_read =
-                mDataSource->readAt(offset, (uint8_t *)mBuffer->data(), size);
+            ssize_t num_bytes_read = readSample(
+                    offset, (uint8_t *)mBuffer->data(), size, chunkEndOffset);
 
             if (num_bytes_read < (ssize_t)size) {
                 mBuffer->release();
@@ -2217,10 +2373,11 @@ status_t MPEG4Source::read(
         int32_t drm = 0;
         bool usesDRM = (mFormat->findInt32(kKeyIsDRM, &drm) && drm != 0);
         if (usesDRM) {
-            num_bytes_read =
-                mDataSource->readAt(offset, (uint8_t*)mBuffer->data(), size);
+            num_bytes_read = readSample(
+                    offset, (uint8_t*)mBuffer->data(), size, chunkEndOffset);
         } else {
-            num_bytes_read = mDataSource->readAt(offset, mSrcBuffer, size);
+            num_bytes_read = readSample(
+                    offset, mSrcBuffer, size, chunkEndOffset);
         }
 
         if (num_bytes_read < (ssize_t)size) {
@@ -31,6 +31,10 @@
 #include <media/stagefright/MetaData.h>
 #include <media/stagefright/Utils.h>
 #include <utils/String8.h>
+#include <utils/threads.h>
+
+#include <pthread.h>
+#include <sys/prctl.h>
 
 extern "C" {
     #include <Tremolo/codec_internal.h>
@@ -79,6 +83,10 @@ struct MyVorbisExtractor {
 
     status_t init();
 
+    // Builds the table of contents on a background thread, seeks bisect on
+    // the pages' granule positions until it is ready.
+    void startTableOfContents();
+
     sp<MetaData> getFileMetaData() { return mFileMeta; }
 
 private:
@@ -113,11 +121,30 @@ private:
     sp<MetaData> mMeta;
     sp<MetaData> mFileMeta;
 
+    // Only known if it's cheap to read anywhere in the file, neither
+    // bisection nor the table of contents are used otherwise.
+    off64_t mFileSize;
+
+    Mutex mTOCLock;
     Vector<TOCEntry> mTableOfContents;
+    bool mTOCReady;
+    bool mTOCAbort;
+    bool mTOCThreadStarted;
+    pthread_t mTOCThread;
 
     ssize_t readPage(off64_t offset, Page *page);
     status_t findNextPage(off64_t startOffset, off64_t *pageOffset);
 
+    static ssize_t ParsePage(const uint8_t *data, size_t size, Page *page);
+
+    status_t findPageInRange(
+            uint8_t *buffer, off64_t offset,
+            off64_t *pageOffset, uint64_t *granulePos);
+
+    status_t findPageForGranule(
+            uint64_t granulePos, off64_t left, off64_t right,
+            off64_t *pageOffset);
+
     status_t verifyHeader(
             MediaBuffer *buffer, uint8_t type);
 
@@ -125,6 +152,7 @@ private:
 
     status_t findPrevGranulePosition(off64_t pageOffset, uint64_t *granulePos);
 
+    static void *TOCThreadWrapper(void *me);
     void buildTableOfContents();
 
     MyVorbisExtractor(const MyVorbisExtractor &);
@@ -212,7 +240,11 @@ MyVorbisExtractor::MyVorbisExtractor(const sp<DataSource> &source)
       mFirstPacketInPage(true),
       mCurrentPageSamples(0),
       mNextLaceIndex(0),
-      mFirstDataOffset(-1) {
+      mFirstDataOffset(-1),
+      mFileSize(-1),
+      mTOCReady(false),
+      mTOCAbort(false),
+      mTOCThreadStarted(false) {
     mCurrentPage.mNumSegments = 0;
 
     vorbis_info_init(&mVi);
@@ -220,6 +252,16 @@ MyVorbisExtractor::MyVorbisExtractor(const sp<DataSource> &source)
 }
 
 MyVorbisExtractor::~MyVorbisExtractor() {
+    if (mTOCThreadStarted) {
+        {
+            Mutex::Autolock autoLock(mTOCLock);
+            mTOCAbort = true;
+        }
+
+        void *dummy;
+        pthread_join(mTOCThread, &dummy);
+    }
+
     vorbis_comment_clear(&mVc);
     vorbis_info_clear(&mVi);
 }
@@ -310,38 +352,210 @@ status_t MyVorbisExtractor::findPrevGranulePosition(
 }
 
 status_t MyVorbisExtractor::seekToTime(int64_t timeUs) {
-    if (mTableOfContents.isEmpty()) {
-        // Perform approximate seeking based on avg. bitrate.
+    // Where bisection looks for the page, narrowed down by the table of
+    // contents if it is ready.
+    off64_t leftOffset = mFirstDataOffset;
+    off64_t rightOffset = mFileSize;
+
+    {
+        Mutex::Autolock autoLock(mTOCLock);
+
+        if (mTOCReady && !mTableOfContents.isEmpty()) {
+            size_t left = 0;
+            size_t right = mTableOfContents.size();
+            while (left < right) {
+                size_t center = left / 2 + right / 2 + (left & right & 1);
+
+                const TOCEntry &entry = mTableOfContents.itemAt(center);
+
+                if (timeUs < entry.mTimeUs) {
+                    right = center;
+                } else if (timeUs > entry.mTimeUs) {
+                    left = center + 1;
+                } else {
+                    left = right = center;
+                    break;
+                }
+            }
 
-        off64_t pos = timeUs * approxBitrate() / 8000000ll;
+            // The entries only cover every so many pages, the page we're
+            // after lies between the last entry before "timeUs" and the
+            // first one at or after it.
+            if (left > 0) {
+                leftOffset = mTableOfContents.itemAt(left - 1).mPageOffset;
+            }
+            if (left < mTableOfContents.size()) {
+                rightOffset = mTableOfContents.itemAt(left).mPageOffset;
+            }
 
-        ALOGV("seeking to offset %lld", pos);
-        return seekToOffset(pos);
+            ALOGV("seeking between entries %d and %d / %d",
+                 left - 1, left, mTableOfContents.size());
+        }
     }
 
-    size_t left = 0;
-    size_t right = mTableOfContents.size();
-    while (left < right) {
-        size_t center = left / 2 + right / 2 + (left & right & 1);
+    if (mFileSize >= 0) {
+        off64_t pageOffset;
+        if (findPageForGranule(
+                    (timeUs < 0 ? 0 : timeUs) * mVi.rate / 1000000ll,
+                    leftOffset, rightOffset, &pageOffset) == OK) {
+            ALOGV("bisected to offset %lld", pageOffset);
 
-        const TOCEntry &entry = mTableOfContents.itemAt(center);
+            return seekToOffset(pageOffset);
+        }
+    }
 
-        if (timeUs < entry.mTimeUs) {
-            right = center;
-        } else if (timeUs > entry.mTimeUs) {
-            left = center + 1;
-        } else {
-            left = right = center;
+    // Perform approximate seeking based on avg. bitrate.
+
+    off64_t pos = timeUs * approxBitrate() / 8000000ll;
+
+    ALOGV("seeking to offset %lld", pos);
+    return seekToOffset(pos);
+}
+
+// Bisection reads this much at a time, from offsets aligned to
+// kBisectAlignment.
+static const size_t kBisectReadSize = 64 * 1024;
+static const off64_t kBisectAlignment = 4096;
+
+static const uint64_t kNoGranulePosition = 0xffffffffffffffffull;
+
+// Parses the page starting at "data" without touching the data source.
+// Returns the size of the page, 0 if "size" bytes are not enough to tell
+// or a negative error if this isn't a page.
+// static
+ssize_t MyVorbisExtractor::ParsePage(
+        const uint8_t *data, size_t size, Page *page) {
+    if (size < 27) {
+        return 0;
+    }
+
+    if (memcmp(data, "OggS", 4) || data[4] != 0 || (data[5] & ~7)) {
+        return ERROR_MALFORMED;
+    }
+
+    page->mFlags = data[5];
+    page->mGranulePosition = U64LE_AT(&data[6]);
+    page->mSerialNo = U32LE_AT(&data[14]);
+    page->mPageNo = U32LE_AT(&data[18]);
+    page->mNumSegments = data[26];
+
+    if (size < 27u + page->mNumSegments) {
+        return 0;
+    }
+
+    memcpy(page->mLace, &data[27], page->mNumSegments);
+
+    size_t totalSize = 0;
+    for (size_t i = 0; i < page->mNumSegments; ++i) {
+        totalSize += page->mLace[i];
+    }
+
+    return 27 + page->mNumSegments + totalSize;
+}
+
+// Finds the first page at or after "offset" that is followed by another
+// page (if that one is within reach) and has a granule position, using a
+// single read of kBisectReadSize bytes.
+status_t MyVorbisExtractor::findPageInRange(
+        uint8_t *buffer, off64_t offset,
+        off64_t *pageOffset, uint64_t *granulePos) {
+    ssize_t n = mSource->readAt(offset, buffer, kBisectReadSize);
+    if (n < 27) {
+        return ERROR_END_OF_STREAM;
+    }
+
+    size_t size = n;
+    size_t i = 0;
+    while (i + 4 <= size) {
+        if (memcmp(&buffer[i], "OggS", 4)) {
+            ++i;
+            continue;
+        }
+
+        Page page;
+        ssize_t pageSize = ParsePage(&buffer[i], size - i, &page);
+
+        if (pageSize == 0) {
             break;
+        } else if (pageSize < 0) {
+            ++i;
+            continue;
+        }
+
+        // "OggS" can occur in the payload, a real page is followed by
+        // another one.
+        Page nextPage;
+        if (i + pageSize < size
+                && ParsePage(&buffer[i + pageSize],
+                             size - i - pageSize, &nextPage) < 0) {
+            ++i;
+            continue;
         }
+
+        if (page.mGranulePosition == kNoGranulePosition) {
+            // No packet ends on this page.
+            i += pageSize;
+            continue;
+        }
+
+        *pageOffset = offset + i;
+        *granulePos = page.mGranulePosition;
+
+        return OK;
     }
 
-    const TOCEntry &entry = mTableOfContents.itemAt(left);
+    return ERROR_END_OF_STREAM;
+}
+
+// Returns the offset of the page containing the sample at "granulePos",
+// i.e. the first page whose granule position is not below it. That page
+// must start at or after "left" and at or before "right".
+status_t MyVorbisExtractor::findPageForGranule(
+        uint64_t granulePos, off64_t left, off64_t right,
+        off64_t *pageOffset) {
+    uint8_t *buffer = new uint8_t[kBisectReadSize];
+
+    while (right - left > (off64_t)kBisectReadSize) {
+        off64_t mid = (left + (right - left) / 2) & ~(kBisectAlignment - 1);
+        if (mid <= left) {
+            break;
+        }
 
-    ALOGV("seeking to entry %d / %d at offset %lld",
-         left, mTableOfContents.size(), entry.mPageOffset);
+        off64_t offset;
+        uint64_t midGranulePos;
+        if (findPageInRange(buffer, mid, &offset, &midGranulePos) != OK
+                || offset >= right) {
+            right = mid;
+        } else if (midGranulePos < granulePos) {
+            left = offset;
+        } else {
+            right = offset;
+        }
+    }
 
-    return seekToOffset(entry.mPageOffset);
+    delete[] buffer;
+    buffer = NULL;
+
+    // Walk the remaining pages.
+    off64_t offset = left;
+    for (;;) {
+        Page page;
+        ssize_t n = readPage(offset, &page);
+
+        if (n <= 0) {
+            // Past the last page, the caller will find the end of stream.
+            *pageOffset = offset;
+            return OK;
+        }
+
+        if (page.mGranulePosition != kNoGranulePosition
+                && page.mGranulePosition >= granulePos) {
+            *pageOffset = offset;
+            return OK;
+        }
+
+        offset += n;
+    }
 }
 
 status_t MyVorbisExtractor::seekToOffset(off64_t offset) {
@@ -637,27 +851,38 @@ status_t MyVorbisExtractor::init() {
 
         mMeta->setInt64(kKeyDuration, durationUs);
 
-        buildTableOfContents();
+        mFileSize = size;
     }
 
     return OK;
 }
 
-void MyVorbisExtractor::buildTableOfContents() {
-    off64_t offset = mFirstDataOffset;
-    Page page;
-    ssize_t pageSize;
-    while ((pageSize = readPage(offset, &page)) > 0) {
-        mTableOfContents.push();
+void MyVorbisExtractor::startTableOfContents() {
+    if (mFileSize < 0 || mTOCThreadStarted) {
+        return;
+    }
 
-        TOCEntry &entry =
-            mTableOfContents.editItemAt(mTableOfContents.size() - 1);
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_JOINABLE);
 
-        entry.mPageOffset = offset;
-        entry.mTimeUs = page.mGranulePosition * 1000000ll / mVi.rate;
+    mTOCThreadStarted =
+        pthread_create(&mTOCThread, &attr, TOCThreadWrapper, this) == 0;
 
-        offset += (size_t)pageSize;
-    }
+    pthread_attr_destroy(&attr);
+}
+
+// static
+void *MyVorbisExtractor::TOCThreadWrapper(void *me) {
+    androidSetThreadPriority(0, ANDROID_PRIORITY_BACKGROUND);
+
+    static_cast<MyVorbisExtractor *>(me)->buildTableOfContents();
+
+    return NULL;
+}
+
+void MyVorbisExtractor::buildTableOfContents() {
+    prctl(PR_SET_NAME, (unsigned long)"OggTOC", 0, 0, 0);
 
     // Limit the maximum amount of RAM we spend on the table of contents,
     // if necessary thin out the table evenly to trim it down to maximum
@@ -666,20 +891,98 @@ void MyVorbisExtractor::buildTableOfContents() {
     static const size_t kMaxTOCSize = 8192;
     static const size_t kMaxNumTOCEntries = kMaxTOCSize / sizeof(TOCEntry);
 
-    size_t numerator = mTableOfContents.size();
+    // Enough for any page, header plus 255 segments of 255 bytes each.
+    static const size_t kReadSize = 128 * 1024;
+
+    Vector<TOCEntry> toc;
+    size_t numPages = 0;
+    size_t stride = 1;
+
+    uint8_t *buffer = new uint8_t[kReadSize];
+    off64_t bufferOffset = mFirstDataOffset;
+    size_t bufferSize = 0;
+    bool reachedEOS = false;
+
+    off64_t offset = mFirstDataOffset;
+    for (;;) {
+        Page page;
+        ssize_t pageSize =
+            ParsePage(&buffer[offset - bufferOffset],
+                      bufferOffset + bufferSize - offset, &page);
+
+        if (pageSize == 0) {
+            if (reachedEOS) {
+                break;
+            }
+
+            {
+                Mutex::Autolock autoLock(mTOCLock);
+                if (mTOCAbort) {
+                    break;
+                }
+            }
+
+            ssize_t n = mSource->readAt(offset, buffer, kReadSize);
+            if (n <= 0) {
+                break;
+            }
+
+            bufferOffset = offset;
+            bufferSize = n;
+            reachedEOS = (size_t)n < kReadSize;
+            continue;
+        } else if (pageSize < 0) {
+            break;
+        }
+
+        if (page.mGranulePosition != kNoGranulePosition) {
+            if ((numPages % stride) == 0) {
+                TOCEntry entry;
+                entry.mPageOffset = offset;
+                entry.mTimeUs = page.mGranulePosition * 1000000ll / mVi.rate;
+
+                if (toc.size() == kMaxNumTOCEntries) {
+                    // Keep every other entry and from now on only every
+                    // other page.
+                    for (size_t i = 1; i < toc.size() / 2; ++i) {
+                        toc.editItemAt(i) = toc.itemAt(2 * i);
+                    }
+                    toc.removeItemsAt(toc.size() / 2, toc.size() - toc.size() / 2);
 
-    if (numerator > kMaxNumTOCEntries) {
-        size_t denom = numerator - kMaxNumTOCEntries;
+                    stride *= 2;
+                }
 
-        size_t accum = 0;
-        for (ssize_t i = mTableOfContents.size() - 1; i >= 0; --i) {
-            accum += denom;
-            if (accum >= numerator) {
-                mTableOfContents.removeAt(i);
-                accum -= numerator;
+                if ((numPages % stride) == 0) {
+                    toc.push(entry);
+                }
             }
+
+            ++numPages;
         }
+
+        offset += pageSize;
+
+        if (offset > bufferOffset + (off64_t)bufferSize) {
+            // The last page is truncated.
+            bufferOffset = offset;
+            bufferSize = 0;
+        }
+    }
+
+    delete[] buffer;
+    buffer = NULL;
+
+    Mutex::Autolock autoLock(mTOCLock);
+
+    if (mTOCAbort) {
+        return;
     }
+
+    ALOGV("table of contents has %d entries for %d pages",
+         toc.size(), numPages);
+
+    mTableOfContents = toc;
+    mTOCReady = true;
 }
 
 status_t MyVorbisExtractor::verifyHeader(
@@ -994,6 +1297,8 @@ sp<MediaSource> OggExtractor::getTrack(size_t index) {
         return NULL;
     }
 
+    mImpl->startTableOfContents();
+
     return new OggSource(this);
 }
 
@@ -98,6 +98,7 @@ status_t SampleIterator::seekTo(uint32_t sampleIndex) {
         }
 
         mCurrentChunkSampleSizes.clear();
+        mCurrentChunkEndOffset = mCurrentChunkOffset;
 
         uint32_t firstChunkSampleIndex =
             mFirstChunkSampleIndex
@@ -112,6 +113,7 @@ status_t SampleIterator::seekTo(uint32_t sampleIndex) {
             }
 
             mCurrentChunkSampleSizes.push(sampleSize);
+            mCurrentChunkEndOffset += sampleSize;
         }
     }
 
@@ -233,22 +233,32 @@ status_t SampleTable::setSampleToChunkParams(
     mSampleToChunkEntries =
         new SampleToChunkEntry[mNumSampleToChunkOffsets];
 
+    // Read all entries at once rather than with a read each.
+    size_t size = mNumSampleToChunkOffsets * 12;
+    uint8_t *buffer = new uint8_t[size];
+
+    if (mDataSource->readAt(mSampleToChunkOffset + 8, buffer, size)
+            != (ssize_t)size) {
+        delete[] buffer;
+        buffer = NULL;
+
+        return ERROR_IO;
+    }
+
     for (uint32_t i = 0; i < mNumSampleToChunkOffsets; ++i) {
-        uint8_t buffer[12];
-        if (mDataSource->readAt(
-                    mSampleToChunkOffset + 8 + i * 12, buffer, sizeof(buffer))
-                != (ssize_t)sizeof(buffer)) {
-            return ERROR_IO;
-        }
+        const uint8_t *entry = &buffer[i * 12];
 
-        CHECK(U32_AT(buffer) >= 1);  // chunk index is 1 based in the spec.
+        CHECK(U32_AT(entry) >= 1);  // chunk index is 1 based in the spec.
 
         // We want the chunk index to be 0-based.
-        mSampleToChunkEntries[i].startChunk = U32_AT(buffer) - 1;
-        mSampleToChunkEntries[i].samplesPerChunk = U32_AT(&buffer[4]);
-        mSampleToChunkEntries[i].chunkDesc = U32_AT(&buffer[8]);
+        mSampleToChunkEntries[i].startChunk = U32_AT(entry) - 1;
+        mSampleToChunkEntries[i].samplesPerChunk = U32_AT(&entry[4]);
+        mSampleToChunkEntries[i].chunkDesc = U32_AT(&entry[8]);
     }
 
+    delete[] buffer;
+    buffer = NULL;
+
     return OK;
 }
 
@@ -444,19 +454,72 @@ status_t SampleTable::getMaxSampleSize(size_t *max_size) {
 
     *max_size = 0;
 
-    for (uint32_t i = 0; i < mNumSampleSizes; ++i) {
-        size_t sample_size;
-        status_t err = getSampleSize_l(i, &sample_size);
+    if (mNumSampleSizes == 0) {
+        return OK;
+    }
 
-        if (err != OK) {
-            return err;
+    if (mDefaultSampleSize > 0) {
+        *max_size = mDefaultSampleSize;
+        return OK;
+    }
+
+    // The table is scanned in pieces of this size instead of with a read
+    // per sample, it holds an even number of 4 bit entries.
+    static const size_t kBufferSize = 16384;
+
+    uint8_t *buffer = new uint8_t[kBufferSize];
+
+    const size_t samplesPerBuffer = kBufferSize * 8 / mSampleSizeFieldSize;
+
+    off64_t offset = mSampleSizeOffset + 12;
+    uint32_t sampleIndex = 0;
+    while (sampleIndex < mNumSampleSizes) {
+        size_t numSamples = mNumSampleSizes - sampleIndex;
+        if (numSamples > samplesPerBuffer) {
+            numSamples = samplesPerBuffer;
+        }
+
+        size_t numBytes = (numSamples * mSampleSizeFieldSize + 7) / 8;
+
+        if (mDataSource->readAt(offset, buffer, numBytes)
+                < (ssize_t)numBytes) {
+            delete[] buffer;
+            buffer = NULL;
+
+            return ERROR_IO;
         }
 
-        if (sample_size > *max_size) {
-            *max_size = sample_size;
+        for (size_t i = 0; i < numSamples; ++i) {
+            size_t sample_size;
+            switch (mSampleSizeFieldSize) {
+                case 32:
+                    sample_size = U32_AT(&buffer[4 * i]);
+                    break;
+                case 16:
+                    sample_size = U16_AT(&buffer[2 * i]);
+                    break;
+                case 8:
+                    sample_size = buffer[i];
+                    break;
+                default:
+                    CHECK_EQ(mSampleSizeFieldSize, 4u);
+                    sample_size =
+                        (i & 1) ? buffer[i / 2] & 0x0f : buffer[i / 2] >> 4;
+                    break;
+            }
+
+            if (sample_size > *max_size) {
+                *max_size = sample_size;
+            }
         }
+
+        offset += numBytes;
+        sampleIndex += numSamples;
     }
 
+    delete[] buffer;
+    buffer = NULL;
+
     return OK;
 }
 
@@ -778,7 +841,8 @@ status_t SampleTable::getMetaDataForSample(
         off64_t *offset,
         size_t *size,
         uint32_t *compositionTime,
-        bool *isSyncSample) {
+        bool *isSyncSample,
+        off64_t *chunkEndOffset) {
     Mutex::Autolock autoLock(mLock);
 
     status_t err;
@@ -798,6 +862,10 @@ status_t SampleTable::getMetaDataForSample(
         *compositionTime = mSampleIterator->getSampleTime();
     }
 
+    if (chunkEndOffset) {
+        *chunkEndOffset = mSampleIterator->getChunkEndOffset();
+    }
+
     if (isSyncSample) {
         *isSyncSample = false;
         if (mSyncSampleOffset < 0) {
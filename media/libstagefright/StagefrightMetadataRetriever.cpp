@@ -101,6 +101,9 @@ status_t StagefrightMetadataRetriever::setDataSource(
 #endif
     }
 
+    // What only decoding needs is parsed once a frame is requested.
+    mExtractor->setLazyParsing(true);
+
     return OK;
 }
 
@@ -158,6 +161,9 @@ status_t StagefrightMetadataRetriever::setDataSource(
 #endif
     }
 
+    // What only decoding needs is parsed once a frame is requested.
+    mExtractor->setLazyParsing(true);
+
     return OK;
 }
 
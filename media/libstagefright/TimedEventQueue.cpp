@@ -35,7 +35,8 @@
 namespace android {
 
 TimedEventQueue::TimedEventQueue()
-    : mNextEventID(1),
+    : mNextSequence(0),
+      mNextEventID(1),
       mRunning(false),
       mStopped(false) {
 }
@@ -76,6 +77,9 @@ void TimedEventQueue::stop(bool flush) {
     void *dummy;
     pthread_join(mThread, &dummy);
 
+    for (size_t i = 0; i < mQueue.size(); ++i) {
+        mQueue.editItemAt(i).event->mQueueIndex = -1;
+    }
     mQueue.clear();
 
     mRunning = false;
@@ -102,40 +106,128 @@ TimedEventQueue::event_id TimedEventQueue::postTimedEvent(
         const sp<Event> &event, int64_t realtime_us) {
     Mutex::Autolock autoLock(mLock);
 
-    event->setEventID(mNextEventID++);
+    ssize_t index = event->mQueueIndex;
+
+    if (index >= 0) {
+        // Still pending, an event can only be pending on one queue.
+        CHECK(mQueue.itemAt(index).event == event);
 
-    List<QueueItem>::iterator it = mQueue.begin();
-    while (it != mQueue.end() && realtime_us >= (*it).realtime_us) {
-        ++it;
+        if (realtime_us < mQueue.itemAt(index).realtime_us) {
+            mQueue.editItemAt(index).realtime_us = realtime_us;
+            siftUp_l(index);
+
+            if (event->mQueueIndex == 0) {
+                mQueueHeadChangedCondition.signal();
+            }
+        }
+
+        return event->eventID();
     }
 
+    event->setEventID(mNextEventID++);
+
     QueueItem item;
     item.event = event;
     item.realtime_us = realtime_us;
+    item.sequence = mNextSequence++;
 
-    if (it == mQueue.begin()) {
+    mQueue.push(item);
+    event->mQueueIndex = mQueue.size() - 1;
+    siftUp_l(mQueue.size() - 1);
+
+    if (event->mQueueIndex == 0) {
         mQueueHeadChangedCondition.signal();
     }
 
-    mQueue.insert(it, item);
-
     mQueueNotEmptyCondition.signal();
 
     return event->eventID();
 }
 
-static bool MatchesEventID(
-        void *cookie, const sp<TimedEventQueue::Event> &event) {
-    TimedEventQueue::event_id *id =
-        static_cast<TimedEventQueue::event_id *>(cookie);
+// static
+bool TimedEventQueue::IsEarlier(const QueueItem &a, const QueueItem &b) {
+    if (a.realtime_us != b.realtime_us) {
+        return a.realtime_us < b.realtime_us;
+    }
 
-    if (event->eventID() != *id) {
-        return false;
+    return a.sequence < b.sequence;
+}
+
+void TimedEventQueue::setItem_l(size_t index, const QueueItem &item) {
+    mQueue.editItemAt(index) = item;
+    item.event->mQueueIndex = index;
+}
+
+void TimedEventQueue::siftUp_l(size_t index) {
+    QueueItem item = mQueue.itemAt(index);
+
+    while (index > 0) {
+        size_t parent = (index - 1) / 2;
+
+        if (!IsEarlier(item, mQueue.itemAt(parent))) {
+            break;
+        }
+
+        setItem_l(index, mQueue.itemAt(parent));
+        index = parent;
     }
 
-    *id = 0;
+    setItem_l(index, item);
+}
 
-    return true;
+void TimedEventQueue::siftDown_l(size_t index) {
+    QueueItem item = mQueue.itemAt(index);
+    size_t size = mQueue.size();
+
+    for (;;) {
+        size_t child = 2 * index + 1;
+        if (child >= size) {
+            break;
+        }
+
+        if (child + 1 < size
+                && IsEarlier(mQueue.itemAt(child + 1), mQueue.itemAt(child))) {
+            ++child;
+        }
+
+        if (!IsEarlier(mQueue.itemAt(child), item)) {
+            break;
+        }
+
+        setItem_l(index, mQueue.itemAt(child));
+        index = child;
+    }
+
+    setItem_l(index, item);
+}
+
+void TimedEventQueue::removeAt_l(size_t index) {
+    sp<Event> event = mQueue.itemAt(index).event;
+
+    ALOGV("removing event %d", event->eventID());
+
+    event->mQueueIndex = -1;
+
+    size_t last = mQueue.size() - 1;
+    if (index < last) {
+        QueueItem item = mQueue.itemAt(last);
+        mQueue.removeAt(last);
+
+        setItem_l(index, item);
+
+        if (index > 0
+                && IsEarlier(item, mQueue.itemAt((index - 1) / 2))) {
+            siftUp_l(index);
+        } else {
+            siftDown_l(index);
+        }
+    } else {
+        mQueue.removeAt(last);
+    }
+
+    if (index == 0) {
+        mQueueHeadChangedCondition.signal();
+    }
 }
 
 bool TimedEventQueue::cancelEvent(event_id id) {
@@ -143,12 +235,38 @@ bool TimedEventQueue::cancelEvent(event_id id) {
         return false;
     }
 
-    cancelEvents(&MatchesEventID, &id, true /* stopAfterFirstMatch */);
+    Mutex::Autolock autoLock(mLock);
+
+    for (size_t i = 0; i < mQueue.size(); ++i) {
+        if (mQueue.itemAt(i).event->eventID() == id) {
+            ALOGV("cancelling event %d", id);
+
+            mQueue.editItemAt(i).event->setEventID(0);
+            removeAt_l(i);
+
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool TimedEventQueue::cancelEvent(const sp<Event> &event) {
+    Mutex::Autolock autoLock(mLock);
+
+    ssize_t index = event->mQueueIndex;
+
+    if (index < 0 || (size_t)index >= mQueue.size()
+            || mQueue.itemAt(index).event != event) {
+        return false;
+    }
+
+    ALOGV("cancelling event %d", event->eventID());
 
-    // if MatchesEventID found a match, it will have set id to 0
-    // (which is not a valid event_id).
+    event->setEventID(0);
+    removeAt_l(index);
 
-    return id == 0;
+    return true;
 }
 
 void TimedEventQueue::cancelEvents(
@@ -157,25 +275,55 @@ void TimedEventQueue::cancelEvents(
         bool stopAfterFirstMatch) {
     Mutex::Autolock autoLock(mLock);
 
-    List<QueueItem>::iterator it = mQueue.begin();
-    while (it != mQueue.end()) {
-        if (!(*predicate)(cookie, (*it).event)) {
-            ++it;
+    if (mQueue.empty()) {
+        return;
+    }
+
+    sp<Event> head = mQueue.itemAt(0).event;
+
+    // Events are matched in heap order, the survivors are compacted in
+    // place and the heap is rebuilt once at the end.
+    size_t size = mQueue.size();
+    size_t kept = 0;
+    bool matching = true;
+
+    for (size_t i = 0; i < size; ++i) {
+        const QueueItem &item = mQueue.itemAt(i);
+
+        if (matching && (*predicate)(cookie, item.event)) {
+            ALOGV("cancelling event %d", item.event->eventID());
+
+            item.event->setEventID(0);
+            item.event->mQueueIndex = -1;
+
+            if (stopAfterFirstMatch) {
+                matching = false;
+            }
             continue;
         }
 
-        if (it == mQueue.begin()) {
-            mQueueHeadChangedCondition.signal();
+        if (kept != i) {
+            mQueue.editItemAt(kept) = mQueue.itemAt(i);
         }
+        ++kept;
+    }
 
-        ALOGV("cancelling event %d", (*it).event->eventID());
+    if (kept == size) {
+        return;
+    }
 
-        (*it).event->setEventID(0);
-        it = mQueue.erase(it);
+    mQueue.removeItemsAt(kept, size - kept);
 
-        if (stopAfterFirstMatch) {
-            return;
-        }
+    for (size_t i = 0; i < mQueue.size(); ++i) {
+        mQueue.editItemAt(i).event->mQueueIndex = i;
+    }
+
+    for (size_t i = mQueue.size() / 2; i-- > 0;) {
+        siftDown_l(i);
+    }
+
+    if (mQueue.empty() || mQueue.itemAt(0).event != head) {
+        mQueueHeadChangedCondition.signal();
     }
 }
 
@@ -215,11 +363,11 @@ void TimedEventQueue::threadEntry() {
                     break;
                 }
 
-                List<QueueItem>::iterator it = mQueue.begin();
-                eventID = (*it).event->eventID();
+                const QueueItem &head = mQueue.itemAt(0);
+                eventID = head.event->eventID();
 
                 now_us = ALooper::GetNowUs();
-                int64_t when_us = (*it).realtime_us;
+                int64_t when_us = head.realtime_us;
 
                 int64_t delay_us;
                 if (when_us < 0 || when_us == INT64_MAX) {
@@ -273,13 +421,13 @@ void TimedEventQueue::threadEntry() {
 
 sp<TimedEventQueue::Event> TimedEventQueue::removeEventFromQueue_l(
         event_id id) {
-    for (List<QueueItem>::iterator it = mQueue.begin();
-         it != mQueue.end(); ++it) {
-        if ((*it).event->eventID() == id) {
-            sp<Event> event = (*it).event;
+    // The event may have moved while we were waiting, look it up.
+    for (size_t i = 0; i < mQueue.size(); ++i) {
+        if (mQueue.itemAt(i).event->eventID() == id) {
+            sp<Event> event = mQueue.itemAt(i).event;
             event->setEventID(0);
 
-            mQueue.erase(it);
+            removeAt_l(i);
 
             return event;
         }
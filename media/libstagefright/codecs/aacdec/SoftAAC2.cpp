@@ -62,6 +62,11 @@ SoftAAC2::SoftAAC2(
       mOutputPortSettingsChange(NONE) {
     initPorts();
     CHECK_EQ(initDecoder(), (status_t)OK);
+
+    // A frame decodes to 1024 samples per channel, about 21ms at 48kHz, in
+    // much less time than a buffer round trip through the client takes.
+    // Hand buffers back in batches.
+    setBatchBufferDone(true);
 }
 
 SoftAAC2::~SoftAAC2() {
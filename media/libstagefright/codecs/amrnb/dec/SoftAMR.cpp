@@ -59,6 +59,12 @@ SoftAMR::SoftAMR(
 
     initPorts();
     CHECK_EQ(initDecoder(), (status_t)OK);
+
+    // Every output buffer carries a single 20ms frame, 160 or 320 samples,
+    // and an input buffer only one or a few of them, so per buffer
+    // callbacks would cost more than the decoding. Hand buffers back in
+    // batches.
+    setBatchBufferDone(true);
 }
 
 SoftAMR::~SoftAMR() {
@@ -30,6 +30,10 @@ LOCAL_C_INCLUDES := \
 LOCAL_CFLAGS := \
     -DOSCL_IMPORT_REF= -DOSCL_UNUSED_ARG= -DOSCL_EXPORT_REF=
 
+ifeq ($(TARGET_ARCH),x86)
+LOCAL_CFLAGS += -DPV_AVCENC_SSE2
+endif
+
 include $(BUILD_STATIC_LIBRARY)
 
 ################################################################################
@@ -62,6 +66,7 @@ LOCAL_SHARED_LIBRARIES := \
         libstagefright_foundation \
         libstagefright_omx \
         libutils \
+        libcutils \
         libui
 
 
@@ -31,11 +31,17 @@
 #include <media/stagefright/Utils.h>
 #include <ui/Rect.h>
 #include <ui/GraphicBufferMapper.h>
+#include <cutils/properties.h>
+
+#include <stdlib.h>
+#include <unistd.h>
 
 #include "SoftAVCEncoder.h"
 
 namespace android {
 
+static const long kMaxNumThreads = 4;
+
 template<class T>
 static void InitOMXParams(T *params) {
     params->nSize = sizeof(T);
@@ -325,6 +331,25 @@ OMX_ERRORTYPE SoftAVCEncoder::initEncoder() {
         return OMX_ErrorUndefined;
     }
 
+    // Motion estimation is spread over the available cores, the bitstream
+    // does not depend on the number of threads. The default can be
+    // overridden with the media.stagefright.avcenc-threads property.
+    long numThreads = sysconf(_SC_NPROCESSORS_ONLN);
+    if (numThreads > kMaxNumThreads) {
+        numThreads = kMaxNumThreads;
+    }
+    char value[PROPERTY_VALUE_MAX];
+    if (property_get("media.stagefright.avcenc-threads", value, NULL)) {
+        numThreads = strtol(value, NULL, 10);
+    }
+    if (numThreads > 1) {
+        err = PVAVCEncSetNumThreads(mHandle, numThreads);
+        if (err != AVCENC_SUCCESS) {
+            ALOGW("Failed to start %ld motion estimation threads: %d",
+                    numThreads, err);
+        }
+    }
+
     mNumInputFrames = -2;  // 1st two buffers contain SPS and PPS
     mSpsPpsHeaderReceived = false;
     mReadyForNextFrame = true;
@@ -82,6 +82,8 @@ OSCL_EXPORT_REF AVCEnc_Status PVAVCEncInitialize(AVCHandle *avcHandle, AVCEncPar
 
     encvid->avcHandle = avcHandle;
 
+    encvid->meThreads = NULL;
+
     encvid->common = (AVCCommonObj*) avcHandle->CBAVC_Malloc(userData, sizeof(AVCCommonObj), DEFAULT_ATTR);
     if (encvid->common == NULL)
     {
@@ -721,6 +723,23 @@ OSCL_EXPORT_REF AVCEnc_Status PVAVCEncUpdateIMBRefresh(AVCHandle *avcHandle, int
     return AVCENC_FAIL;
 }
 
+/* ======================================================================== */
+/*  Function : PVAVCEncSetNumThreads()                                      */
+/*  Purpose  : Set the number of threads used for motion estimation         */
+/*  In/out   :                                                              */
+/*  Return   : AVCENC_SUCCESS for success.                                  */
+/*  Modified :                                                              */
+/* ======================================================================== */
+OSCL_EXPORT_REF AVCEnc_Status PVAVCEncSetNumThreads(AVCHandle *avcHandle, int numThreads)
+{
+    if (avcHandle->AVCObject == NULL)
+    {
+        return AVCENC_UNINITIALIZED;
+    }
+
+    return InitMEThreads(avcHandle, numThreads);
+}
+
 void PVAVCEncGetFrameStats(AVCHandle *avcHandle, AVCEncFrameStats *avcStats)
 {
     AVCEncObject *encvid = (AVCEncObject*) avcHandle->AVCObject;
@@ -315,6 +315,18 @@ extern "C"
     OSCL_IMPORT_REF AVCEnc_Status PVAVCEncIDRRequest(AVCHandle *avcHandle);
     OSCL_IMPORT_REF AVCEnc_Status PVAVCEncUpdateIMBRefresh(AVCHandle *avcHandle, int numMB);
 
+    /**
+    This function sets the number of threads used for motion estimation, including the
+    thread calling PVAVCEncodeNAL. The bitstream does not depend on the number of threads.
+    It must be called after PVAVCEncInitialize and not while a frame is being encoded.
+    \param "avcHandle"  "Handle to the AVC encoder library object."
+    \param "numThreads" "Number of threads, 0 or 1 for single-threaded operation."
+    \return "AVCENC_SUCCESS for success, AVCENC_UNINITIALIZED if the encoder is not
+              initialized, AVCENC_MEMORY_FAIL or AVCENC_FAIL if the threads could not be
+              created."
+    */
+    OSCL_IMPORT_REF AVCEnc_Status PVAVCEncSetNumThreads(AVCHandle *avcHandle, int numThreads);
+
 
 #ifdef __cplusplus
 }
@@ -362,6 +362,10 @@ typedef struct tagHTFM_Stat
 #endif
 
 
+/**
+Threads sharing the motion estimation of a frame, defined in motion_est.cpp. */
+typedef struct tagMEThreads AVCMEThreads;
+
 /**
 This structure is the main object for AVC encoder library providing access to all
 global variables. It is allocated at PVAVCInitEncoder and freed at PVAVCCleanUpEncoder.
@@ -440,6 +444,7 @@ typedef struct tagEncObject
 
     /* encoding complexity control */
     uint fullsearch_enable; /* flag to enable full-pel full-search */
+    AVCMEThreads *meThreads; /* motion estimation threads, NULL if single-threaded */
 
     /* misc.*/
     bool outOfBandParamSet; /* flag to enable out-of-band param set */
@@ -494,6 +494,21 @@ extern "C"
     */
     void CleanMotionSearchModule(AVCHandle *avcHandle);
 
+    /**
+    Start the threads sharing the motion estimation with the encoding thread.
+    \param "avcHandle" "Handle to the AVC encoder library object."
+    \param "numThreads" "Total number of threads, including the encoding thread."
+    \return "AVCENC_SUCCESS, AVCENC_MEMORY_FAIL or AVCENC_FAIL."
+    */
+    AVCEnc_Status InitMEThreads(AVCHandle *avcHandle, int numThreads);
+
+    /**
+    Stop the motion estimation threads started by InitMEThreads.
+    \param "avcHandle" "Handle to the AVC encoder library object."
+    \return "void."
+    */
+    void CleanMEThreads(AVCHandle *avcHandle);
+
 
     /**
     This function performs motion estimation of all macroblocks in a frame during the InitFrame.
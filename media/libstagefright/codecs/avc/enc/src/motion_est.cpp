@@ -17,6 +17,8 @@
  */
 #include "avcenc_lib.h"
 
+#include <pthread.h>
+
 #define MIN_GOP     1   /* minimum size of GOP, 1/23/01, need to be tested */
 
 #define DEFAULT_REF_IDX     0  /* always from the first frame in the reflist */
@@ -64,47 +66,68 @@ uint32 num_cand = 0;
 #define FIXED_SUBMB_MODE    AVC_4x4
 /*************************************************************************/
 
-/* Initialize arrays necessary for motion search */
-AVCEnc_Status InitMotionSearchModule(AVCHandle *avcHandle)
+/* Motion estimation of a macroblock uses the motion vectors of the left, top
+   and top-right macroblocks of the current frame, and those of the right and
+   bottom macroblocks of the previous frame. Rows of macroblocks can then be
+   searched in parallel as long as each row stays two macroblocks behind the
+   row above it. The result is identical to the raster scan order. */
+
+#define MAX_ME_THREADS      8
+#define ME_SYNC_INTERVAL    2   /* publish the progress of a row every 2 MBs */
+
+typedef struct tagMEWorker
 {
-    AVCEncObject *encvid = (AVCEncObject*) avcHandle->AVCObject;
-    AVCRateControl *rateCtrl = encvid->rateCtrl;
-    int search_range = rateCtrl->mvRange;
-    int number_of_subpel_positions = 4 * (2 * search_range + 3);
-    int max_mv_bits, max_mvd;
-    int temp_bits = 0;
-    uint8 *mvbits;
-    int bits, imax, imin, i;
-    uint8* subpel_pred = (uint8*) encvid->subpel_pred; // all 16 sub-pel positions
+    AVCMEThreads *owner;
+    pthread_t thread;
 
+    /* private copies, so that the scratch buffers of the search are not shared */
+    AVCEncObject encvid;
+    AVCCommonObj common;
 
-    while (number_of_subpel_positions > 0)
-    {
-        temp_bits++;
-        number_of_subpel_positions >>= 1;
-    }
+    /* statistics of the rows searched in the current pass */
+    int totalSAD;
+    int numIntraSearch;
+} AVCMEWorker;
 
-    max_mv_bits = 3 + 2 * temp_bits;
-    max_mvd  = (1 << (max_mv_bits >> 1)) - 1;
+struct tagMEThreads
+{
+    pthread_mutex_t lock;
+    pthread_cond_t startCond;
+    pthread_cond_t progressCond;
 
-    encvid->mvbits_array = (uint8*) avcHandle->CBAVC_Malloc(encvid->avcHandle->userData,
-                           sizeof(uint8) * (2 * max_mvd + 1), DEFAULT_ATTR);
+    AVCMEWorker *worker[MAX_ME_THREADS - 1];
+    int numWorkers;
+    int quit;
 
-    if (encvid->mvbits_array == NULL)
-    {
-        return AVCENC_MEMORY_FAIL;
-    }
+    /* incremented for every pass handed to the workers */
+    uint32 generation;
 
-    mvbits = encvid->mvbits  = encvid->mvbits_array + max_mvd;
+    /* current pass */
+    int start_i;
+    int incr_i;
+    int type_pred;
+    int mbheight;
+    int nextRow;
+    int rowsDone;
 
-    mvbits[0] = 1;
-    for (bits = 3; bits <= max_mv_bits; bits += 2)
-    {
-        imax = 1    << (bits >> 1);
-        imin = imax >> 1;
+    /* number of columns done in each row */
+    int *rowProgress;
+    int rowProgressSize;
+};
 
-        for (i = imin; i < imax; i++)   mvbits[-i] = mvbits[i] = bits;
-    }
+static void InitSubpelCandidates(AVCEncObject *encvid);
+static void AVCMotionEstimateRow(AVCEncObject *encvid, AVCMEThreads *threads, int j,
+                                 int start_i, int incr_i, int type_pred,
+                                 int *totalSAD, int *NumIntraSearch);
+static void AVCMotionEstimatePass(AVCEncObject *encvid, AVCMEThreads *threads,
+                                  int start_i, int incr_i, int type_pred,
+                                  int *totalSAD, int *NumIntraSearch);
+static void *MEWorkerThread(void *arg);
+
+/* Point the half-pel and quarter-pel candidates into encvid->subpel_pred */
+static void InitSubpelCandidates(AVCEncObject *encvid)
+{
+    uint8* subpel_pred = (uint8*) encvid->subpel_pred; // all 16 sub-pel positions
 
     /* initialize half-pel search */
     encvid->hpel_cand[0] = subpel_pred + REF_CENTER;
@@ -165,6 +188,51 @@ AVCEnc_Status InitMotionSearchModule(AVCHandle *avcHandle)
     encvid->bilin_base[8][2] = subpel_pred + V2Q_H0Q * SUBPEL_PRED_BLK_SIZE;
     encvid->bilin_base[8][3] = subpel_pred + V2Q_H2Q * SUBPEL_PRED_BLK_SIZE;
 
+    return ;
+}
+
+/* Initialize arrays necessary for motion search */
+AVCEnc_Status InitMotionSearchModule(AVCHandle *avcHandle)
+{
+    AVCEncObject *encvid = (AVCEncObject*) avcHandle->AVCObject;
+    AVCRateControl *rateCtrl = encvid->rateCtrl;
+    int search_range = rateCtrl->mvRange;
+    int number_of_subpel_positions = 4 * (2 * search_range + 3);
+    int max_mv_bits, max_mvd;
+    int temp_bits = 0;
+    uint8 *mvbits;
+    int bits, imax, imin, i;
+
+
+    while (number_of_subpel_positions > 0)
+    {
+        temp_bits++;
+        number_of_subpel_positions >>= 1;
+    }
+
+    max_mv_bits = 3 + 2 * temp_bits;
+    max_mvd  = (1 << (max_mv_bits >> 1)) - 1;
+
+    encvid->mvbits_array = (uint8*) avcHandle->CBAVC_Malloc(encvid->avcHandle->userData,
+                           sizeof(uint8) * (2 * max_mvd + 1), DEFAULT_ATTR);
+
+    if (encvid->mvbits_array == NULL)
+    {
+        return AVCENC_MEMORY_FAIL;
+    }
+
+    mvbits = encvid->mvbits  = encvid->mvbits_array + max_mvd;
+
+    mvbits[0] = 1;
+    for (bits = 3; bits <= max_mv_bits; bits += 2)
+    {
+        imax = 1    << (bits >> 1);
+        imin = imax >> 1;
+
+        for (i = imin; i < imax; i++)   mvbits[-i] = mvbits[i] = bits;
+    }
+
+    InitSubpelCandidates(encvid);
 
     return AVCENC_SUCCESS;
 }
@@ -180,6 +248,116 @@ void CleanMotionSearchModule(AVCHandle *avcHandle)
         encvid->mvbits = NULL;
     }
 
+    CleanMEThreads(avcHandle);
+
+    return ;
+}
+
+/* Start the threads sharing the motion estimation with the encoding thread,
+   numThreads is the total including the encoding thread. */
+AVCEnc_Status InitMEThreads(AVCHandle *avcHandle, int numThreads)
+{
+    AVCEncObject *encvid = (AVCEncObject*) avcHandle->AVCObject;
+    AVCMEThreads *threads;
+    AVCMEWorker *worker;
+    int i;
+
+    CleanMEThreads(avcHandle);
+
+#ifdef HTFM
+    /* the hypothesis testing statistics are collected over the whole frame */
+    numThreads = 1;
+#endif
+
+    if (numThreads > MAX_ME_THREADS)
+    {
+        numThreads = MAX_ME_THREADS;
+    }
+
+    if (numThreads <= 1)
+    {
+        return AVCENC_SUCCESS;
+    }
+
+    threads = (AVCMEThreads*) avcHandle->CBAVC_Malloc(avcHandle->userData,
+              sizeof(AVCMEThreads), DEFAULT_ATTR);
+    if (threads == NULL)
+    {
+        return AVCENC_MEMORY_FAIL;
+    }
+
+    memset(threads, 0, sizeof(AVCMEThreads));
+
+    pthread_mutex_init(&threads->lock, NULL);
+    pthread_cond_init(&threads->startCond, NULL);
+    pthread_cond_init(&threads->progressCond, NULL);
+
+    encvid->meThreads = threads;
+
+    for (i = 0; i < numThreads - 1; i++)
+    {
+        worker = (AVCMEWorker*) avcHandle->CBAVC_Malloc(avcHandle->userData,
+                 sizeof(AVCMEWorker), DEFAULT_ATTR);
+        if (worker == NULL)
+        {
+            break;
+        }
+
+        worker->owner = threads;
+
+        if (pthread_create(&worker->thread, NULL, MEWorkerThread, worker) != 0)
+        {
+            avcHandle->CBAVC_Free(avcHandle->userData, worker);
+            break;
+        }
+
+        threads->worker[threads->numWorkers++] = worker;
+    }
+
+    if (threads->numWorkers == 0)
+    {
+        CleanMEThreads(avcHandle);
+        return AVCENC_FAIL;
+    }
+
+    return AVCENC_SUCCESS;
+}
+
+/* Stop the motion estimation threads */
+void CleanMEThreads(AVCHandle *avcHandle)
+{
+    AVCEncObject *encvid = (AVCEncObject*) avcHandle->AVCObject;
+    AVCMEThreads *threads = encvid->meThreads;
+    int i;
+
+    if (threads == NULL)
+    {
+        return ;
+    }
+
+    pthread_mutex_lock(&threads->lock);
+    threads->quit = 1;
+    pthread_cond_broadcast(&threads->startCond);
+    pthread_mutex_unlock(&threads->lock);
+
+    for (i = 0; i < threads->numWorkers; i++)
+    {
+        pthread_join(threads->worker[i]->thread, NULL);
+        avcHandle->CBAVC_Free(avcHandle->userData, threads->worker[i]);
+    }
+
+    pthread_cond_destroy(&threads->progressCond);
+    pthread_cond_destroy(&threads->startCond);
+    pthread_mutex_destroy(&threads->lock);
+
+    if (threads->rowProgress)
+    {
+        avcHandle->CBAVC_Free(avcHandle->userData, threads->rowProgress);
+    }
+
+    avcHandle->CBAVC_Free(avcHandle->userData, threads);
+    encvid->meThreads = NULL;
+
     return ;
 }
 
@@ -238,39 +416,25 @@ void AVCMotionEstimation(AVCEncObject *encvid)
 {
     AVCCommonObj *video = encvid->common;
     int slice_type = video->slice_type;
-    AVCFrameIO *currInput = encvid->currInput;
     AVCPictureData *refPic = video->RefPicList0[0];
-    int i, j, k;
-    int mbwidth = video->PicWidthInMbs;
-    int mbheight = video->PicHeightInMbs;
+    int i;
     int totalMB = video->PicSizeInMbs;
-    int pitch = currInput->pitch;
-    AVCMacroblock *currMB, *mblock = video->mblock;
-    AVCMV *mot_mb_16x16, *mot16x16 = encvid->mot16x16;
-    // AVCMV *mot_mb_16x8, *mot_mb_8x16, *mot_mb_8x8, etc;
+    AVCMacroblock *mblock = video->mblock;
     AVCRateControl *rateCtrl = encvid->rateCtrl;
     uint8 *intraSearch = encvid->intraSearch;
-    uint FS_en = encvid->fullsearch_enable;
+    AVCMEThreads *threads = encvid->meThreads;
 
     int NumIntraSearch, start_i, numLoop, incr_i;
-    int mbnum, offset;
-    uint8 *cur, *best_cand[5];
     int totalSAD = 0;   /* average SAD for rate control */
     int type_pred;
-    int abe_cost;
 
 #ifdef HTFM
     /***** HYPOTHESIS TESTING ********/  /* 2/28/01 */
     int collect = 0;
-    HTFM_Stat htfm_stat;
     double newvar[16];
     double exp_lamda[15];
     /*********************************/
 #endif
-    int hp_guess = 0;
-    uint32 mv_uint32;
-
-    offset = 0;
 
     if (slice_type == AVC_I_SLICE)
     {
@@ -309,7 +473,7 @@ void AVCMotionEstimation(AVCEncObject *encvid)
     encvid->sad_extra_info = NULL;
 #ifdef HTFM
     /***** HYPOTHESIS TESTING ********/
-    InitHTFM(video, &htfm_stat, newvar, &collect);
+    InitHTFM(video, &encvid->htfm_stat, newvar, &collect);
     /*********************************/
 #endif
 
@@ -330,100 +494,47 @@ void AVCMotionEstimation(AVCEncObject *encvid)
         type_pred = 2;
     }
 
+    if (threads != NULL && video->PicHeightInMbs > 1)
+    {
+        /* the workers search with copies of the encoder state of this frame */
+        for (i = 0; i < threads->numWorkers; i++)
+        {
+            AVCMEWorker *worker = threads->worker[i];
+
+            memcpy(&worker->encvid, encvid, sizeof(AVCEncObject));
+            memcpy(&worker->common, video, sizeof(AVCCommonObj));
+            worker->encvid.common = &worker->common;
+            InitSubpelCandidates(&worker->encvid);
+        }
+    }
+    else
+    {
+        threads = NULL;
+    }
+
     /* First pass, loop thru half the macroblock */
     /* determine scene change */
     /* Second pass, for the rest of macroblocks */
     NumIntraSearch = 0; // to be intra searched in the encoding loop.
     while (numLoop--)
     {
-        for (j = 0; j < mbheight; j++)
-        {
-            if (incr_i > 1)
-                start_i = (start_i == 0 ? 1 : 0) ; /* toggle 0 and 1 */
-
-            offset = pitch * (j << 4) + (start_i << 4);
+        /* the first macroblock of each row alternates between 0 and 1 */
+        if (incr_i > 1)
+            start_i = (start_i == 0 ? 1 : 0) ; /* toggle 0 and 1 */
 
-            mbnum = j * mbwidth + start_i;
-
-            for (i = start_i; i < mbwidth; i += incr_i)
+        if (threads != NULL)
+        {
+            AVCMotionEstimatePass(encvid, threads, start_i, incr_i, type_pred,
+                                  &totalSAD, &NumIntraSearch);
+        }
+        else
+        {
+            for (i = 0; i < video->PicHeightInMbs; i++)
             {
-                video->mbNum = mbnum;
-                video->currMB = currMB = mblock + mbnum;
-                mot_mb_16x16 = mot16x16 + mbnum;
-
-                cur = currInput->YCbCr[0] + offset;
-
-                if (currMB->mb_intra == 0) /* for INTER mode */
-                {
-#if defined(HTFM)
-                    HTFMPrepareCurMB_AVC(encvid, &htfm_stat, cur, pitch);
-#else
-                    AVCPrepareCurMB(encvid, cur, pitch);
-#endif
-                    /************************************************************/
-                    /******** full-pel 1MV search **********************/
-
-                    AVCMBMotionSearch(encvid, cur, best_cand, i << 4, j << 4, type_pred,
-                                      FS_en, &hp_guess);
-
-                    abe_cost = encvid->min_cost[mbnum] = mot_mb_16x16->sad;
-
-                    /* set mbMode and MVs */
-                    currMB->mbMode = AVC_P16;
-                    currMB->MBPartPredMode[0][0] = AVC_Pred_L0;
-                    mv_uint32 = ((mot_mb_16x16->y) << 16) | ((mot_mb_16x16->x) & 0xffff);
-                    for (k = 0; k < 32; k += 2)
-                    {
-                        currMB->mvL0[k>>1] = mv_uint32;
-                    }
-
-                    /* make a decision whether it should be tested for intra or not */
-                    if (i != mbwidth - 1 && j != mbheight - 1 && i != 0 && j != 0)
-                    {
-                        if (false == IntraDecisionABE(&abe_cost, cur, pitch, true))
-                        {
-                            intraSearch[mbnum] = 0;
-                        }
-                        else
-                        {
-                            NumIntraSearch++;
-                            rateCtrl->MADofMB[mbnum] = abe_cost;
-                        }
-                    }
-                    else // boundary MBs, always do intra search
-                    {
-                        NumIntraSearch++;
-                    }
-
-                    totalSAD += (int) rateCtrl->MADofMB[mbnum];//mot_mb_16x16->sad;
-                }
-                else    /* INTRA update, use for prediction */
-                {
-                    mot_mb_16x16[0].x = mot_mb_16x16[0].y = 0;
-
-                    /* reset all other MVs to zero */
-                    /* mot_mb_16x8, mot_mb_8x16, mot_mb_8x8, etc. */
-                    abe_cost = encvid->min_cost[mbnum] = 0x7FFFFFFF;  /* max value for int */
-
-                    if (i != mbwidth - 1 && j != mbheight - 1 && i != 0 && j != 0)
-                    {
-                        IntraDecisionABE(&abe_cost, cur, pitch, false);
-
-                        rateCtrl->MADofMB[mbnum] = abe_cost;
-                        totalSAD += abe_cost;
-                    }
-
-                    NumIntraSearch++ ;
-                    /* cannot do I16 prediction here because it needs full decoding. */
-                    // intraSearch[mbnum] = 1;
-
-                }
-
-                mbnum += incr_i;
-                offset += (incr_i << 4);
-
-            } /* for i */
-        } /* for j */
+                AVCMotionEstimateRow(encvid, NULL, i, start_i, incr_i, type_pred,
+                                     &totalSAD, &NumIntraSearch);
+            }
+        }
 
         /* since we cannot do intra/inter decision here, the SCD has to be
         based on other criteria such as motion vectors coherency or the SAD */
@@ -464,7 +575,7 @@ void AVCMotionEstimation(AVCEncObject *encvid)
     if (collect)
     {
         collect = 0;
-        UpdateHTFM(encvid, newvar, exp_lamda, &htfm_stat);
+        UpdateHTFM(encvid, newvar, exp_lamda, &encvid->htfm_stat);
     }
     /*********************************/
 #endif
@@ -472,6 +583,275 @@ void AVCMotionEstimation(AVCEncObject *encvid)
     return ;
 }
 
+/* Motion search for the macroblocks of row j, starting at column start_i.
+   With threads, the row follows the progress of the row above. */
+static void AVCMotionEstimateRow(AVCEncObject *encvid, AVCMEThreads *threads, int j,
+                                 int start_i, int incr_i, int type_pred,
+                                 int *totalSAD, int *NumIntraSearch)
+{
+    AVCCommonObj *video = encvid->common;
+    AVCFrameIO *currInput = encvid->currInput;
+    int i, k;
+    int mbwidth = video->PicWidthInMbs;
+    int mbheight = video->PicHeightInMbs;
+    int pitch = currInput->pitch;
+    AVCMacroblock *currMB, *mblock = video->mblock;
+    AVCMV *mot_mb_16x16, *mot16x16 = encvid->mot16x16;
+    // AVCMV *mot_mb_16x8, *mot_mb_8x16, *mot_mb_8x8, etc;
+    AVCRateControl *rateCtrl = encvid->rateCtrl;
+    uint8 *intraSearch = encvid->intraSearch;
+    uint FS_en = encvid->fullsearch_enable;
+
+    int mbnum, offset;
+    uint8 *cur, *best_cand[5];
+    int abe_cost;
+    int hp_guess = 0;
+    uint32 mv_uint32;
+    int required, available;
+
+    /* with the scene change detection, every other macroblock is searched */
+    if (incr_i > 1 && (j & 1))
+    {
+        start_i = (start_i == 0 ? 1 : 0) ; /* toggle 0 and 1 */
+    }
+
+    offset = pitch * (j << 4) + (start_i << 4);
+
+    mbnum = j * mbwidth + start_i;
+
+    available = (threads == NULL || j == 0) ? mbwidth : 0;
+
+    for (i = start_i; i < mbwidth; i += incr_i)
+    {
+        required = AVC_MIN(i + 2, mbwidth);
+        if (available < required)
+        {
+            pthread_mutex_lock(&threads->lock);
+            while (threads->rowProgress[j - 1] < required)
+            {
+                pthread_cond_wait(&threads->progressCond, &threads->lock);
+            }
+            available = threads->rowProgress[j - 1];
+            pthread_mutex_unlock(&threads->lock);
+        }
+
+        video->mbNum = mbnum;
+        video->currMB = currMB = mblock + mbnum;
+        mot_mb_16x16 = mot16x16 + mbnum;
+
+        cur = currInput->YCbCr[0] + offset;
+
+        if (currMB->mb_intra == 0) /* for INTER mode */
+        {
+#if defined(HTFM)
+            HTFMPrepareCurMB_AVC(encvid, &encvid->htfm_stat, cur, pitch);
+#else
+            AVCPrepareCurMB(encvid, cur, pitch);
+#endif
+            /************************************************************/
+            /******** full-pel 1MV search **********************/
+
+            AVCMBMotionSearch(encvid, cur, best_cand, i << 4, j << 4, type_pred,
+                              FS_en, &hp_guess);
+
+            abe_cost = encvid->min_cost[mbnum] = mot_mb_16x16->sad;
+
+            /* set mbMode and MVs */
+            currMB->mbMode = AVC_P16;
+            currMB->MBPartPredMode[0][0] = AVC_Pred_L0;
+            mv_uint32 = ((mot_mb_16x16->y) << 16) | ((mot_mb_16x16->x) & 0xffff);
+            for (k = 0; k < 32; k += 2)
+            {
+                currMB->mvL0[k>>1] = mv_uint32;
+            }
+
+            /* make a decision whether it should be tested for intra or not */
+            if (i != mbwidth - 1 && j != mbheight - 1 && i != 0 && j != 0)
+            {
+                if (false == IntraDecisionABE(&abe_cost, cur, pitch, true))
+                {
+                    intraSearch[mbnum] = 0;
+                }
+                else
+                {
+                    (*NumIntraSearch)++;
+                    rateCtrl->MADofMB[mbnum] = abe_cost;
+                }
+            }
+            else // boundary MBs, always do intra search
+            {
+                (*NumIntraSearch)++;
+            }
+
+            *totalSAD += (int) rateCtrl->MADofMB[mbnum];//mot_mb_16x16->sad;
+        }
+        else    /* INTRA update, use for prediction */
+        {
+            mot_mb_16x16[0].x = mot_mb_16x16[0].y = 0;
+
+            /* reset all other MVs to zero */
+            /* mot_mb_16x8, mot_mb_8x16, mot_mb_8x8, etc. */
+            abe_cost = encvid->min_cost[mbnum] = 0x7FFFFFFF;  /* max value for int */
+
+            if (i != mbwidth - 1 && j != mbheight - 1 && i != 0 && j != 0)
+            {
+                IntraDecisionABE(&abe_cost, cur, pitch, false);
+
+                rateCtrl->MADofMB[mbnum] = abe_cost;
+                *totalSAD += abe_cost;
+            }
+
+            (*NumIntraSearch)++ ;
+            /* cannot do I16 prediction here because it needs full decoding. */
+            // intraSearch[mbnum] = 1;
+
+        }
+
+        if (threads != NULL && i + incr_i < mbwidth
+                && ((i / incr_i) % ME_SYNC_INTERVAL) == ME_SYNC_INTERVAL - 1)
+        {
+            pthread_mutex_lock(&threads->lock);
+            threads->rowProgress[j] = i + 1;
+            pthread_cond_broadcast(&threads->progressCond);
+            pthread_mutex_unlock(&threads->lock);
+        }
+
+        mbnum += incr_i;
+        offset += (incr_i << 4);
+
+    } /* for i */
+
+    return ;
+}
+
+/* Motion search for all rows with the encoding thread and the workers,
+   the rows are handed out in order. */
+static void AVCMotionEstimatePass(AVCEncObject *encvid, AVCMEThreads *threads,
+                                  int start_i, int incr_i, int type_pred,
+                                  int *totalSAD, int *NumIntraSearch)
+{
+    AVCHandle *avcHandle = encvid->avcHandle;
+    int mbheight = encvid->common->PicHeightInMbs;
+    int j, i;
+
+    if (threads->rowProgressSize < mbheight)
+    {
+        if (threads->rowProgress)
+        {
+            avcHandle->CBAVC_Free(avcHandle->userData, threads->rowProgress);
+        }
+
+        threads->rowProgress = (int*) avcHandle->CBAVC_Malloc(avcHandle->userData,
+                               sizeof(int) * mbheight, DEFAULT_ATTR);
+        if (threads->rowProgress == NULL)
+        {
+            threads->rowProgressSize = 0;
+
+            for (j = 0; j < mbheight; j++)
+            {
+                AVCMotionEstimateRow(encvid, NULL, j, start_i, incr_i, type_pred,
+                                     totalSAD, NumIntraSearch);
+            }
+            return ;
+        }
+        threads->rowProgressSize = mbheight;
+    }
+
+    memset(threads->rowProgress, 0, sizeof(int) * mbheight);
+
+    for (i = 0; i < threads->numWorkers; i++)
+    {
+        threads->worker[i]->totalSAD = 0;
+        threads->worker[i]->numIntraSearch = 0;
+    }
+
+    pthread_mutex_lock(&threads->lock);
+    threads->start_i = start_i;
+    threads->incr_i = incr_i;
+    threads->type_pred = type_pred;
+    threads->mbheight = mbheight;
+    threads->nextRow = 0;
+    threads->rowsDone = 0;
+    threads->generation++;
+    pthread_cond_broadcast(&threads->startCond);
+
+    while (threads->nextRow < mbheight)
+    {
+        j = threads->nextRow++;
+        pthread_mutex_unlock(&threads->lock);
+
+        AVCMotionEstimateRow(encvid, threads, j, start_i, incr_i, type_pred,
+                             totalSAD, NumIntraSearch);
+
+        pthread_mutex_lock(&threads->lock);
+        threads->rowProgress[j] = encvid->common->PicWidthInMbs;
+        threads->rowsDone++;
+        pthread_cond_broadcast(&threads->progressCond);
+    }
+
+    while (threads->rowsDone < mbheight)
+    {
+        pthread_cond_wait(&threads->progressCond, &threads->lock);
+    }
+
+    pthread_mutex_unlock(&threads->lock);
+
+    /* integer sums, the result does not depend on the order */
+    for (i = 0; i < threads->numWorkers; i++)
+    {
+        *totalSAD += threads->worker[i]->totalSAD;
+        *NumIntraSearch += threads->worker[i]->numIntraSearch;
+    }
+
+    return ;
+}
+
+/* Worker thread main loop, searches rows of each pass until all rows have
+   been handed out. */
+static void *MEWorkerThread(void *arg)
+{
+    AVCMEWorker *worker = (AVCMEWorker*) arg;
+    AVCMEThreads *threads = worker->owner;
+    uint32 generation = 0;
+    int j;
+
+    pthread_mutex_lock(&threads->lock);
+
+    for (;;)
+    {
+        while (!threads->quit && threads->generation == generation)
+        {
+            pthread_cond_wait(&threads->startCond, &threads->lock);
+        }
+
+        if (threads->quit)
+        {
+            break;
+        }
+
+        generation = threads->generation;
+
+        while (threads->nextRow < threads->mbheight)
+        {
+            j = threads->nextRow++;
+            pthread_mutex_unlock(&threads->lock);
+
+            AVCMotionEstimateRow(&worker->encvid, threads, j, threads->start_i,
+                                 threads->incr_i, threads->type_pred,
+                                 &worker->totalSAD, &worker->numIntraSearch);
+
+            pthread_mutex_lock(&threads->lock);
+            threads->rowProgress[j] = worker->common.PicWidthInMbs;
+            threads->rowsDone++;
+            pthread_cond_broadcast(&threads->progressCond);
+        }
+    }
+
+    pthread_mutex_unlock(&threads->lock);
+
+    return NULL;
+}
+
 /*=====================================================================
     Function:   PaddingEdge
     Date:       09/16/2000
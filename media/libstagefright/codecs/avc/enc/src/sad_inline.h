@@ -18,6 +18,10 @@
 #ifndef _SAD_INLINE_H_
 #define _SAD_INLINE_H_
 
+#if defined(PV_AVCENC_SSE2)
+#include <emmintrin.h>
+#endif
+
 #ifdef __cplusplus
 extern "C"
 {
@@ -76,6 +80,37 @@ extern "C"
 #include "sad_mb_offset.h"
 
 
+#if defined(PV_AVCENC_SSE2)
+
+    /* One row of 16 pixels per step, with the same early termination
+     * against dmin after every row as the C version below. */
+    __inline int32 simd_sad_mb(uint8 *ref, uint8 *blk, int dmin, int lx)
+    {
+        __m128i x0, x1;
+        int32 sad = 0;
+        int i;
+
+        for (i = 0; i < 16; i++)
+        {
+            x0 = _mm_loadu_si128((const __m128i*)ref);
+            x1 = _mm_loadu_si128((const __m128i*)blk);
+            x0 = _mm_sad_epu8(x0, x1);
+            sad += _mm_cvtsi128_si32(x0) + _mm_extract_epi16(x0, 4);
+
+            if (sad > dmin)
+            {
+                break;
+            }
+
+            ref += lx;
+            blk += 16;
+        }
+
+        return sad;
+    }
+
+#else
+
     __inline int32 simd_sad_mb(uint8 *ref, uint8 *blk, int dmin, int lx)
     {
         int32 x4, x5, x6, x8, x9, x10, x11, x12, x14;
@@ -169,6 +204,8 @@ SadMBOffset1:
 
     }
 
+#endif /* PV_AVCENC_SSE2 */
+
 #elif defined(__CC_ARM)  /* only work with arm v5 */
 
     __inline int32 SUB_SAD(int32 sad, int32 tmp, int32 tmp2)
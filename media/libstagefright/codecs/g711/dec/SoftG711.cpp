@@ -50,6 +50,10 @@ SoftG711::SoftG711(
     }
 
     initPorts();
+
+    // Decoding is one table lookup per sample, the buffer done callbacks
+    // cost more than that. Hand buffers back in batches.
+    setBatchBufferDone(true);
 }
 
 SoftG711::~SoftG711() {
@@ -50,6 +50,10 @@ LOCAL_C_INCLUDES := \
 LOCAL_CFLAGS := \
         -DOSCL_UNUSED_ARG=
 
+ifeq ($(TARGET_ARCH),x86)
+LOCAL_CFLAGS += -DPV_MP3DEC_SSE2
+endif
+
 LOCAL_MODULE := libstagefright_mp3dec
 
 LOCAL_ARM_MODE := arm
@@ -79,3 +83,59 @@ LOCAL_MODULE := libstagefright_soft_mp3dec
 LOCAL_MODULE_TAGS := optional
 
 include $(BUILD_SHARED_LIBRARY)
+
+################################################################################
+# test utility: decoding speed
+################################################################################
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := \
+        test/mp3dec_bench.cpp
+
+LOCAL_C_INCLUDES := \
+        frameworks/av/media/libstagefright/include \
+        $(LOCAL_PATH)/src \
+        $(LOCAL_PATH)/include
+
+LOCAL_SHARED_LIBRARIES := \
+        libstagefright libstagefright_foundation libutils
+
+LOCAL_STATIC_LIBRARIES := \
+        libstagefright_mp3dec
+
+LOCAL_MODULE_TAGS := debug
+
+LOCAL_MODULE := mp3dec_bench
+
+include $(BUILD_EXECUTABLE)
+
+ifeq ($(TARGET_ARCH),x86)
+
+################################################################################
+# test utility: SSE2 kernels against the C code
+################################################################################
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := \
+        test/mp3dec_kernel_test.cpp
+
+LOCAL_C_INCLUDES := \
+        $(LOCAL_PATH)/src \
+        $(LOCAL_PATH)/include
+
+LOCAL_CFLAGS := \
+        -DOSCL_UNUSED_ARG= \
+        -DPV_MP3DEC_SSE2
+
+LOCAL_STATIC_LIBRARIES := \
+        libstagefright_mp3dec
+
+LOCAL_MODULE_TAGS := debug
+
+LOCAL_MODULE := mp3dec_kernel_test
+
+include $(BUILD_EXECUTABLE)
+
+endif
@@ -0,0 +1,106 @@
+/* ------------------------------------------------------------------
+ * Copyright (C) 1998-2009 PacketVideo
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ * -------------------------------------------------------------------
+ */
+/*
+------------------------------------------------------------------------------
+   PacketVideo Corp.
+   MP3 Decoder Library
+
+   Pathname: ./cpp/include/pv_mp3dec_fxd_op_sse2.h
+
+------------------------------------------------------------------------------
+ INCLUDE DESCRIPTION
+
+ Four-lane versions of the fixed point operations in
+ pv_mp3dec_fxd_op_c_equivalent.h, built on SSE2.
+
+ Each product is truncated exactly like the scalar fxp_mul32_Qn, and
+ accumulation wraps around in 32 bits, so sums of these products match
+ the C code bit for bit regardless of the order they are added in.
+
+------------------------------------------------------------------------------
+*/
+
+#ifndef PV_MP3DEC_FXD_OP_SSE2_H
+#define PV_MP3DEC_FXD_OP_SSE2_H
+
+#include <emmintrin.h>
+
+#include "pvmp3_audio_type_defs.h"
+
+/*----------------------------------------------------------------------------
+; FUNCTION CODE
+----------------------------------------------------------------------------*/
+
+/*
+ *  Signed 64-bit products of lanes 0 and 2. SSE2 only has the unsigned
+ *  32x32->64 multiply, its high word is corrected for negative operands.
+ */
+static inline __m128i pv_mul64_even_sse2(__m128i a, __m128i b)
+{
+    __m128i p    = _mm_mul_epu32(a, b);
+    __m128i corr = _mm_add_epi32(_mm_and_si128(_mm_srai_epi32(a, 31), b),
+                                 _mm_and_si128(_mm_srai_epi32(b, 31), a));
+
+    return _mm_sub_epi64(p, _mm_slli_epi64(corr, 32));
+}
+
+/*
+ *  (int32)(((int64)a * b) >> n) on four lanes, 0 < n <= 32
+ */
+static inline __m128i fxp_mul32_Qn_sse2(__m128i a, __m128i b, const int32 n)
+{
+    __m128i even = pv_mul64_even_sse2(a, b);
+    __m128i odd  = pv_mul64_even_sse2(_mm_srli_epi64(a, 32),
+                                      _mm_srli_epi64(b, 32));
+
+    even = _mm_and_si128(_mm_srli_epi64(even, n),
+                         _mm_set_epi32(0, -1, 0, -1));
+    odd  = _mm_slli_epi64(_mm_srli_epi64(odd, n), 32);
+
+    return _mm_or_si128(even, odd);
+}
+
+static inline __m128i fxp_mul32_Q32_sse2(__m128i a, __m128i b)
+{
+    __m128i even = pv_mul64_even_sse2(a, b);
+    __m128i odd  = pv_mul64_even_sse2(_mm_srli_epi64(a, 32),
+                                      _mm_srli_epi64(b, 32));
+
+    return _mm_or_si128(_mm_srli_epi64(even, 32),
+                        _mm_and_si128(odd, _mm_set_epi32(-1, 0, -1, 0)));
+}
+
+/*
+ *  Lane order reversal, for the mirrored accesses of the transforms
+ */
+static inline __m128i pv_reverse_sse2(__m128i a)
+{
+    return _mm_shuffle_epi32(a, _MM_SHUFFLE(0, 1, 2, 3));
+}
+
+static inline __m128i pv_load_sse2(const int32 *p)
+{
+    return _mm_loadu_si128((const __m128i *)p);
+}
+
+static inline void pv_store_sse2(int32 *p, __m128i a)
+{
+    _mm_storeu_si128((__m128i *)p, a);
+}
+
+#endif  /* PV_MP3DEC_FXD_OP_SSE2_H */
@@ -98,6 +98,10 @@ Input
 #include "pvmp3_dct_16.h"
 #include "pv_mp3dec_fxd_op.h"
 
+#if defined(PV_MP3DEC_SSE2)
+#include "pv_mp3dec_fxd_op_sse2.h"
+#endif
+
 /*----------------------------------------------------------------------------
 ; MACROS
 ; Define module specific macros here
@@ -366,7 +370,11 @@ void pvmp3_merge_in_place_N32(int32 vec[])
 
 
 
+#if defined(PV_MP3DEC_SSE2)
+void pvmp3_split_c(int32 *vect)
+#else
 void pvmp3_split(int32 *vect)
+#endif
 {
 
     int32 i;
@@ -407,4 +415,49 @@ void pvmp3_split(int32 *vect)
 
 }
 
+#if defined(PV_MP3DEC_SSE2)
+
+/*
+ *  Four butterflies at a time, vect[i] against vect[-1-i]. The first six
+ *  use Q27 products and the remaining ten Q31, as in the C code.
+ */
+void pvmp3_split(int32 *vect)
+{
+    /* lanes 0, 1 of the second group are Q27, lanes 2, 3 Q31 */
+    const __m128i q31Mask = _mm_set_epi32(-1, -1, 0, 0);
+
+    for (int32 i = 0; i < 16; i += 4)
+    {
+        __m128i tmp2 = pv_load_sse2(&vect[i]);
+        __m128i tmp1 = pv_reverse_sse2(pv_load_sse2(&vect[-4 - i]));
+        __m128i cosx = pv_reverse_sse2(pv_load_sse2(&CosTable_dct32[12 - i]));
+        __m128i diff = _mm_sub_epi32(tmp1, tmp2);
+        __m128i res;
+
+        pv_store_sse2(&vect[-4 - i],
+                      pv_reverse_sse2(_mm_add_epi32(tmp1, tmp2)));
+
+        if (i == 0)
+        {
+            res = fxp_mul32_Qn_sse2(diff, cosx, 27);
+        }
+        else if (i == 4)
+        {
+            __m128i q27 = fxp_mul32_Qn_sse2(diff, cosx, 27);
+            __m128i q31 = fxp_mul32_Q32_sse2(_mm_slli_epi32(diff, 1), cosx);
+
+            res = _mm_or_si128(_mm_andnot_si128(q31Mask, q27),
+                               _mm_and_si128(q31Mask, q31));
+        }
+        else
+        {
+            res = fxp_mul32_Q32_sse2(_mm_slli_epi32(diff, 1), cosx);
+        }
+
+        pv_store_sse2(&vect[i], res);
+    }
+}
+
+#endif
+
 #endif
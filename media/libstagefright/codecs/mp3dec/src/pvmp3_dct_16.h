@@ -84,6 +84,10 @@ extern "C"
 
     void pvmp3_split(int32 *vect);
 
+#if defined(PV_MP3DEC_SSE2)
+    void pvmp3_split_c(int32 *vect);
+#endif
+
 
 #ifdef __cplusplus
 }
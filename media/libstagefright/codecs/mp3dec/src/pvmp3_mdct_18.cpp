@@ -71,6 +71,10 @@ Returns
 #include "pv_mp3dec_fxd_op.h"
 #include "pvmp3_mdct_18.h"
 
+#if defined(PV_MP3DEC_SSE2)
+#include "pv_mp3dec_fxd_op_sse2.h"
+#endif
+
 
 /*----------------------------------------------------------------------------
 ; MACROS
@@ -89,6 +93,10 @@ Returns
 ; Function Prototype declaration
 ----------------------------------------------------------------------------*/
 
+static void pvmp3_mdct_18_dct_overlap(int32 vec[],
+                                      int32 *history,
+                                      const int32 *window);
+
 /*----------------------------------------------------------------------------
 ; LOCAL STORE/BUFFER/POINTER DEFINITIONS
 ; Variable declaration - defined here and used outside this module
@@ -129,14 +137,15 @@ const int32 cosTerms_1_ov_cos_phi[18] =
 
 
 
+#if defined(PV_MP3DEC_SSE2)
+void pvmp3_mdct_18_c(int32 vec[], int32 *history, const int32 *window)
+#else
 void pvmp3_mdct_18(int32 vec[], int32 *history, const int32 *window)
+#endif
 {
     int32 i;
     int32 tmp;
     int32 tmp1;
-    int32 tmp2;
-    int32 tmp3;
-    int32 tmp4;
 
 
 
@@ -157,6 +166,63 @@ void pvmp3_mdct_18(int32 vec[], int32 *history, const int32 *window)
         *(pt_vec_o--) = fxp_mul32_Q28((tmp - tmp1), *(pt_cos_split++));
     }
 
+    pvmp3_mdct_18_dct_overlap(vec, history, window);
+}
+
+
+#if defined(PV_MP3DEC_SSE2)
+
+/*
+ *  The input rotation pairs vec[i] with vec[17-i], i = 0..7 are done four
+ *  at a time, the middle pair and the rest of the transform as in C.
+ */
+void pvmp3_mdct_18(int32 vec[], int32 *history, const int32 *window)
+{
+    int32 tmp;
+    int32 tmp1;
+
+    for (int32 i = 0; i < 8; i += 4)
+    {
+        __m128i vIn  = pv_load_sse2(&vec[i]);
+        __m128i vInO = pv_reverse_sse2(pv_load_sse2(&vec[14 - i]));
+        __m128i cosx = pv_load_sse2(&cosTerms_1_ov_cos_phi[i]);
+        __m128i cosO = pv_reverse_sse2(
+                           pv_load_sse2(&cosTerms_1_ov_cos_phi[14 - i]));
+        __m128i cosS = pv_load_sse2(&cosTerms_dct18[i]);
+
+        __m128i vTmp  = fxp_mul32_Q32_sse2(_mm_slli_epi32(vIn, 1), cosx);
+        __m128i vTmp1 = fxp_mul32_Qn_sse2(vInO, cosO, 27);
+
+        pv_store_sse2(&vec[i], _mm_add_epi32(vTmp, vTmp1));
+        pv_store_sse2(&vec[14 - i],
+                      pv_reverse_sse2(fxp_mul32_Qn_sse2(
+                                          _mm_sub_epi32(vTmp, vTmp1), cosS, 28)));
+    }
+
+    tmp  = fxp_mul32_Q32(vec[8] << 1, cosTerms_1_ov_cos_phi[8]);
+    tmp1 = fxp_mul32_Q27(vec[9], cosTerms_1_ov_cos_phi[9]);
+    vec[8] = tmp + tmp1;
+    vec[9] = fxp_mul32_Q28((tmp - tmp1), cosTerms_dct18[8]);
+
+    pvmp3_mdct_18_dct_overlap(vec, history, window);
+}
+
+#endif
+
+
+/*
+ *  Second half of the mdct, shared by all implementations of the rotation
+ */
+static void pvmp3_mdct_18_dct_overlap(int32 vec[],
+                                      int32 *history,
+                                      const int32 *window)
+{
+    int32 i;
+    int32 tmp;
+    int32 tmp1;
+    int32 tmp2;
+    int32 tmp3;
+    int32 tmp4;
 
     pvmp3_dct_9(vec);         // Even terms
     pvmp3_dct_9(&vec[9]);     // Odd  terms
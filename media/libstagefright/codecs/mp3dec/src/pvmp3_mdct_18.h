@@ -91,6 +91,10 @@ extern "C"
 
     void pvmp3_mdct_18(int32 vec[], int32 *history, const int32 *window);
 
+#if defined(PV_MP3DEC_SSE2)
+    void pvmp3_mdct_18_c(int32 vec[], int32 *history, const int32 *window);
+#endif
+
     void pvmp3_dct_9(int32 vec[]);
 
     void pvmp3_mdct_6(int32 vec[], int32 *overlap);
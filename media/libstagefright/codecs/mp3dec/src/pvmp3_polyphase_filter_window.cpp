@@ -76,6 +76,10 @@ Input
 #include "pvmp3_dec_defs.h"
 #include "pvmp3_tables.h"
 
+#if defined(PV_MP3DEC_SSE2)
+#include "pv_mp3dec_fxd_op_sse2.h"
+#endif
+
 /*----------------------------------------------------------------------------
 ; MACROS
 ; Define module1 specific macros here
@@ -112,9 +116,18 @@ Input
 ; FUNCTION CODE
 ----------------------------------------------------------------------------*/
 
+#if defined(PV_MP3DEC_SSE2)
+/*
+ *  The C implementation stays available as the reference for the SSE2 one
+ */
+void pvmp3_polyphase_filter_window_c(int32 *synth_buffer,
+                                     int16 *outPcm,
+                                     int32 numChannels)
+#else
 void pvmp3_polyphase_filter_window(int32 *synth_buffer,
                                    int16 *outPcm,
                                    int32 numChannels)
+#endif
 {
     int32 sum1;
     int32 sum2;
@@ -235,5 +248,105 @@ void pvmp3_polyphase_filter_window(int32 *synth_buffer,
 
 }
 
+
+#if defined(PV_MP3DEC_SSE2)
+
+/*
+ *  Same computation as the C code, with the outputs j = 1..15 computed
+ *  four at a time. Lane l of a group handles j + l, so the samples below
+ *  i (pt_2) are loaded in reverse order. The coefficients come from
+ *  pqmfSynthWinSse2, regrouped accordingly.
+ */
+void pvmp3_polyphase_filter_window(int32 *synth_buffer,
+                                   int16 *outPcm,
+                                   int32 numChannels)
+{
+    const int32 *winPtr = pqmfSynthWinSse2;
+    int16 pcm[8];
+    int32 sum1;
+    int32 sum2;
+    int32 i;
+
+    for (int32 j = 1; j < SUBBANDS_NUMBER / 2; j += 4)
+    {
+        const int32 *pt_1 = &synth_buffer[(SUBBANDS_NUMBER >> 1) + j];
+        const int32 *pt_2 = &synth_buffer[(SUBBANDS_NUMBER >> 1) - j - 3];
+        __m128i vsum1 = _mm_set1_epi32(0x00000020);
+        __m128i vsum2 = _mm_set1_epi32(0x00000020);
+
+        for (i = 0; i < 8; i += 2)
+        {
+            __m128i temp1 = pv_load_sse2(&pt_1[SUBBANDS_NUMBER * i]);
+            __m128i temp3 = pv_reverse_sse2(
+                                pv_load_sse2(&pt_2[SUBBANDS_NUMBER * (15 - i)]));
+            __m128i temp2 = pv_reverse_sse2(
+                                pv_load_sse2(&pt_2[SUBBANDS_NUMBER * (i + 1)]));
+            __m128i temp4 = pv_load_sse2(&pt_1[SUBBANDS_NUMBER * (14 - i)]);
+
+            __m128i win0 = pv_load_sse2(&winPtr[ 0]);
+            __m128i win1 = pv_load_sse2(&winPtr[ 4]);
+            __m128i win2 = pv_load_sse2(&winPtr[ 8]);
+            __m128i win3 = pv_load_sse2(&winPtr[12]);
+
+            vsum1 = _mm_add_epi32(vsum1, fxp_mul32_Q32_sse2(temp1, win0));
+            vsum2 = _mm_add_epi32(vsum2, fxp_mul32_Q32_sse2(temp3, win0));
+            vsum2 = _mm_add_epi32(vsum2, fxp_mul32_Q32_sse2(temp1, win1));
+            vsum1 = _mm_sub_epi32(vsum1, fxp_mul32_Q32_sse2(temp3, win1));
+            vsum1 = _mm_add_epi32(vsum1, fxp_mul32_Q32_sse2(temp2, win2));
+            vsum2 = _mm_sub_epi32(vsum2, fxp_mul32_Q32_sse2(temp4, win2));
+            vsum2 = _mm_add_epi32(vsum2, fxp_mul32_Q32_sse2(temp2, win3));
+            vsum1 = _mm_add_epi32(vsum1, fxp_mul32_Q32_sse2(temp4, win3));
+
+            winPtr += 16;
+        }
+
+        /* saturating pack is equivalent to saturate16() */
+        _mm_storeu_si128((__m128i *)pcm,
+                         _mm_packs_epi32(_mm_srai_epi32(vsum1, 6),
+                                         _mm_srai_epi32(vsum2, 6)));
+
+        for (i = 0; i < 4 && j + i < SUBBANDS_NUMBER / 2; i++)
+        {
+            int32 k = (j + i) << (numChannels - 1);
+            outPcm[k] = pcm[i];
+            outPcm[(numChannels<<5) - k] = pcm[4 + i];
+        }
+    }
+
+    winPtr = &pqmfSynthWin[(SUBBANDS_NUMBER / 2 - 1) << 4];
+
+    sum1 = 0x00000020;
+    sum2 = 0x00000020;
+
+
+    for (i = 16; i < HAN_SIZE + 16; i += (SUBBANDS_NUMBER << 2))
+    {
+        int32 *pt_synth = &synth_buffer[i];
+        int32 temp1 = pt_synth[ 0                ];
+        int32 temp2 = pt_synth[ SUBBANDS_NUMBER  ];
+        int32 temp3 = pt_synth[ SUBBANDS_NUMBER/2];
+
+        sum1 = fxp_mac32_Q32(sum1, temp1, winPtr[0]) ;
+        sum1 = fxp_mac32_Q32(sum1, temp2, winPtr[1]) ;
+        sum2 = fxp_mac32_Q32(sum2, temp3, winPtr[2]) ;
+
+        temp1 = pt_synth[ SUBBANDS_NUMBER<<1 ];
+        temp2 = pt_synth[ 3*SUBBANDS_NUMBER  ];
+        temp3 = pt_synth[ SUBBANDS_NUMBER*5/2];
+
+        sum1 = fxp_mac32_Q32(sum1, temp1, winPtr[3]) ;
+        sum1 = fxp_mac32_Q32(sum1, temp2, winPtr[4]) ;
+        sum2 = fxp_mac32_Q32(sum2, temp3, winPtr[5]) ;
+
+        winPtr += 6;
+    }
+
+
+    outPcm[0] = saturate16(sum1 >> 6);
+    outPcm[(SUBBANDS_NUMBER/2)<<(numChannels-1)] = saturate16(sum2 >> 6);
+}
+
+#endif
+
 #endif // If not assembly
 
@@ -122,6 +122,12 @@ extern "C"
                                        int16 *outPcm,
                                        int32 numChannels);
 
+#if defined(PV_MP3DEC_SSE2)
+    void pvmp3_polyphase_filter_window_c(int32 *synth_buffer,
+                                         int16 *outPcm,
+                                         int32 numChannels);
+#endif
+
 
 #ifdef __cplusplus
 }
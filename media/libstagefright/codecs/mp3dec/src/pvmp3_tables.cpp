@@ -249,6 +249,88 @@ const int32 pqmfSynthWin[(HAN_SIZE/2) + 8] =
     Q30_fmt(0.002227783F), Q30_fmt(0.003250122F), Q30_fmt(-0.000442500F), Q30_fmt(-0.000076294F),
 };
 
+#if defined(PV_MP3DEC_SSE2)
+/*
+ *  pqmfSynthWin coefficients of the outputs j = 1..15, regrouped for
+ *  pvmp3_polyphase_filter_window to process four values of j at once:
+ *  entry [g][m][lane] holds pqmfSynthWin[(4g + lane) * 16 + m]
+ */
+const int32 pqmfSynthWinSse2[4*16*4] =
+{
+    /* j = 1..4 */
+    Q30_fmt(-0.000015259F), Q30_fmt(-0.000015259F), Q30_fmt(-0.000015259F), Q30_fmt(-0.000015259F),
+    Q30_fmt(0.000396729F), Q30_fmt(0.000366211F), Q30_fmt(0.000320435F), Q30_fmt(0.000289917F),
+    Q30_fmt(0.000473022F), Q30_fmt(0.000534058F), Q30_fmt(0.000579834F), Q30_fmt(0.000625610F),
+    Q30_fmt(0.003173828F), Q30_fmt(0.003082275F), Q30_fmt(0.002990723F), Q30_fmt(0.002899170F),
+    Q30_fmt(0.003326416F), Q30_fmt(0.003387451F), Q30_fmt(0.003433228F), Q30_fmt(0.003463745F),
+    Q30_fmt(0.006118770F), Q30_fmt(0.005294800F), Q30_fmt(0.004486080F), Q30_fmt(0.003723140F),
+    Q30_fmt(0.007919310F), Q30_fmt(0.008865360F), Q30_fmt(0.009841920F), Q30_fmt(0.010849000F),
+    Q30_fmt(0.031478880F), Q30_fmt(0.031738280F), Q30_fmt(0.031845090F), Q30_fmt(0.031814580F),
+    Q30_fmt(0.030517578F), Q30_fmt(0.029785160F), Q30_fmt(0.028884890F), Q30_fmt(0.027801510F),
+    Q30_fmt(0.073059080F), Q30_fmt(0.067520140F), Q30_fmt(0.061996460F), Q30_fmt(0.056533810F),
+    Q30_fmt(0.084182740F), Q30_fmt(0.089706420F), Q30_fmt(0.095169070F), Q30_fmt(0.100540160F),
+    Q30_fmt(0.108856200F), Q30_fmt(0.116577150F), Q30_fmt(0.123474120F), Q30_fmt(0.129577640F),
+    Q30_fmt(0.090927124F), Q30_fmt(0.080688480F), Q30_fmt(0.069595340F), Q30_fmt(0.057617190F),
+    Q30_fmt(0.543823240F), Q30_fmt(0.515609740F), Q30_fmt(0.487472530F), Q30_fmt(0.459472660F),
+    Q30_fmt(0.600219727F), Q30_fmt(0.628295900F), Q30_fmt(0.656219480F), Q30_fmt(0.683914180F),
+    Q30_fmt(1.144287109F), Q30_fmt(1.142211914F), Q30_fmt(1.138763428F), Q30_fmt(1.133926392F),
+
+    /* j = 5..8 */
+    Q30_fmt(-0.000015259F), Q30_fmt(-0.000015259F), Q30_fmt(-0.000030518F), Q30_fmt(-0.000030518F),
+    Q30_fmt(0.000259399F), Q30_fmt(0.000244141F), Q30_fmt(0.000213623F), Q30_fmt(0.000198364F),
+    Q30_fmt(0.000686646F), Q30_fmt(0.000747681F), Q30_fmt(0.000808716F), Q30_fmt(0.000885010F),
+    Q30_fmt(0.002792358F), Q30_fmt(0.002685547F), Q30_fmt(0.002578735F), Q30_fmt(0.002456665F),
+    Q30_fmt(0.003479004F), Q30_fmt(0.003479004F), Q30_fmt(0.003463745F), Q30_fmt(0.003417969F),
+    Q30_fmt(0.003005981F), Q30_fmt(0.002334595F), Q30_fmt(0.001693726F), Q30_fmt(0.001098633F),
+    Q30_fmt(0.011886600F), Q30_fmt(0.012939450F), Q30_fmt(0.014022830F), Q30_fmt(0.015121460F),
+    Q30_fmt(0.031661990F), Q30_fmt(0.031387330F), Q30_fmt(0.031005860F), Q30_fmt(0.030532840F),
+    Q30_fmt(0.026535030F), Q30_fmt(0.025085450F), Q30_fmt(0.023422240F), Q30_fmt(0.021575930F),
+    Q30_fmt(0.051132200F), Q30_fmt(0.045837400F), Q30_fmt(0.040634160F), Q30_fmt(0.035552980F),
+    Q30_fmt(0.105819700F), Q30_fmt(0.110946660F), Q30_fmt(0.115921020F), Q30_fmt(0.120697020F),
+    Q30_fmt(0.134887700F), Q30_fmt(0.139450070F), Q30_fmt(0.143264770F), Q30_fmt(0.146362300F),
+    Q30_fmt(0.044784550F), Q30_fmt(0.031082153F), Q30_fmt(0.016510010F), Q30_fmt(0.001068120F),
+    Q30_fmt(0.431655880F), Q30_fmt(0.404083250F), Q30_fmt(0.376800540F), Q30_fmt(0.349868770F),
+    Q30_fmt(0.711318970F), Q30_fmt(0.738372800F), Q30_fmt(0.765029907F), Q30_fmt(0.791213990F),
+    Q30_fmt(1.127746582F), Q30_fmt(1.120223999F), Q30_fmt(1.111373901F), Q30_fmt(1.101211548F),
+
+    /* j = 9..12 */
+    Q30_fmt(-0.000030518F), Q30_fmt(-0.000030518F), Q30_fmt(-0.000045776F), Q30_fmt(-0.000045776F),
+    Q30_fmt(0.000167847F), Q30_fmt(0.000152588F), Q30_fmt(0.000137329F), Q30_fmt(0.000122070F),
+    Q30_fmt(0.000961304F), Q30_fmt(0.001037598F), Q30_fmt(0.001113892F), Q30_fmt(0.001205444F),
+    Q30_fmt(0.002349854F), Q30_fmt(0.002243042F), Q30_fmt(0.002120972F), Q30_fmt(0.002014160F),
+    Q30_fmt(0.003372192F), Q30_fmt(0.003280640F), Q30_fmt(0.003173828F), Q30_fmt(0.003051758F),
+    Q30_fmt(0.000549316F), Q30_fmt(0.000030518F), Q30_fmt(-0.000442505F), Q30_fmt(-0.000869751F),
+    Q30_fmt(0.016235350F), Q30_fmt(0.017349240F), Q30_fmt(0.018463130F), Q30_fmt(0.019577030F),
+    Q30_fmt(0.029937740F), Q30_fmt(0.029281620F), Q30_fmt(0.028533940F), Q30_fmt(0.027725220F),
+    Q30_fmt(0.019531250F), Q30_fmt(0.017257690F), Q30_fmt(0.014801030F), Q30_fmt(0.012115480F),
+    Q30_fmt(0.030609130F), Q30_fmt(0.025817870F), Q30_fmt(0.021179200F), Q30_fmt(0.016708370F),
+    Q30_fmt(0.125259400F), Q30_fmt(0.129562380F), Q30_fmt(0.133590700F), Q30_fmt(0.137298580F),
+    Q30_fmt(0.148773190F), Q30_fmt(0.150497440F), Q30_fmt(0.151596070F), Q30_fmt(0.152069090F),
+    Q30_fmt(-0.015228270F), Q30_fmt(-0.032379150F), Q30_fmt(-0.050354000F), Q30_fmt(-0.069168090F),
+    Q30_fmt(0.323318480F), Q30_fmt(0.297210693F), Q30_fmt(0.271591190F), Q30_fmt(0.246505740F),
+    Q30_fmt(0.816864010F), Q30_fmt(0.841949463F), Q30_fmt(0.866363530F), Q30_fmt(0.890090940F),
+    Q30_fmt(1.089782715F), Q30_fmt(1.077117920F), Q30_fmt(1.063217163F), Q30_fmt(1.048156738F),
+
+    /* j = 13..15, last lane unused */
+    Q30_fmt(-0.000061035F), Q30_fmt(-0.000061035F), Q30_fmt(-0.000076294F), 0,
+    Q30_fmt(0.000106812F), Q30_fmt(0.000106812F), Q30_fmt(0.000091553F), 0,
+    Q30_fmt(0.001296997F), Q30_fmt(0.001388550F), Q30_fmt(0.001480103F), 0,
+    Q30_fmt(0.001907349F), Q30_fmt(0.001785278F), Q30_fmt(0.001693726F), 0,
+    Q30_fmt(0.002883911F), Q30_fmt(0.002700806F), Q30_fmt(0.002487183F), 0,
+    Q30_fmt(-0.001266479F), Q30_fmt(-0.001617432F), Q30_fmt(-0.001937866F), 0,
+    Q30_fmt(0.020690920F), Q30_fmt(0.021789550F), Q30_fmt(0.022857670F), 0,
+    Q30_fmt(0.026840210F), Q30_fmt(0.025909420F), Q30_fmt(0.024932860F), 0,
+    Q30_fmt(0.009231570F), Q30_fmt(0.006134030F), Q30_fmt(0.002822880F), 0,
+    Q30_fmt(0.012420650F), Q30_fmt(0.008316040F), Q30_fmt(0.004394530F), 0,
+    Q30_fmt(0.140670780F), Q30_fmt(0.143676760F), Q30_fmt(0.146255490F), 0,
+    Q30_fmt(0.151962280F), Q30_fmt(0.151306150F), Q30_fmt(0.150115970F), 0,
+    Q30_fmt(-0.088775630F), Q30_fmt(-0.109161380F), Q30_fmt(-0.130310060F), 0,
+    Q30_fmt(0.221984860F), Q30_fmt(0.198059080F), Q30_fmt(0.174789430F), 0,
+    Q30_fmt(0.913055420F), Q30_fmt(0.935195920F), Q30_fmt(0.956481930F), 0,
+    Q30_fmt(1.031936646F), Q30_fmt(1.014617920F), Q30_fmt(0.996246338F), 0
+};
+#endif
+
 
 
 
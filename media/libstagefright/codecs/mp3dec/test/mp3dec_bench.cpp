@@ -0,0 +1,230 @@
+/*
+ * Copyright (C) 2012 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Decodes mp3 files with the software decoder alone and reports how many
+// times faster than realtime it runs. The compressed frames are read into
+// memory up front so that only the decoder itself is timed.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <media/stagefright/foundation/ABuffer.h>
+#include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/foundation/ALooper.h>
+#include <media/stagefright/DataSource.h>
+#include <media/stagefright/FileSource.h>
+#include <media/stagefright/MediaBuffer.h>
+#include <media/stagefright/MediaDefs.h>
+#include <media/stagefright/MediaExtractor.h>
+#include <media/stagefright/MediaSource.h>
+#include <media/stagefright/MetaData.h>
+#include <utils/Vector.h>
+
+#include "pvmp3decoder_api.h"
+
+using namespace android;
+
+static const size_t kOutputBufferSize = 4608 * 2;
+
+static void usage(const char *me) {
+    fprintf(stderr, "usage: %s [-n repetitions] file.mp3 ...\n", me);
+}
+
+static status_t readFrames(const char *path, Vector<sp<ABuffer> > *frames) {
+    sp<DataSource> dataSource = new FileSource(path);
+    if (dataSource->initCheck() != OK) {
+        fprintf(stderr, "unable to open '%s'\n", path);
+        return UNKNOWN_ERROR;
+    }
+
+    sp<MediaExtractor> extractor =
+        MediaExtractor::Create(dataSource, MEDIA_MIMETYPE_AUDIO_MPEG);
+
+    if (extractor == NULL) {
+        fprintf(stderr, "'%s' is not an mp3 file\n", path);
+        return UNKNOWN_ERROR;
+    }
+
+    sp<MediaSource> source;
+    for (size_t i = 0; i < extractor->countTracks(); ++i) {
+        const char *mime;
+        CHECK(extractor->getTrackMetaData(i)->findCString(
+                    kKeyMIMEType, &mime));
+
+        if (!strcasecmp(mime, MEDIA_MIMETYPE_AUDIO_MPEG)) {
+            source = extractor->getTrack(i);
+            break;
+        }
+    }
+
+    if (source == NULL || source->start() != OK) {
+        fprintf(stderr, "no mp3 track in '%s'\n", path);
+        return UNKNOWN_ERROR;
+    }
+
+    MediaBuffer *buffer;
+    while (source->read(&buffer) == OK) {
+        sp<ABuffer> frame = new ABuffer(buffer->range_length());
+        memcpy(frame->data(),
+               (const uint8_t *)buffer->data() + buffer->range_offset(),
+               buffer->range_length());
+
+        frames->push(frame);
+
+        buffer->release();
+        buffer = NULL;
+    }
+
+    source->stop();
+
+    return OK;
+}
+
+// Decodes all frames once, returns the decoding time and accumulates the
+// duration of the decoded audio.
+static int64_t decodeFrames(
+        const Vector<sp<ABuffer> > &frames, void *decoderBuf,
+        int16_t *outBuf, double *audioDurationSecs) {
+    tPVMP3DecoderExternal config;
+    memset(&config, 0, sizeof(config));
+    config.equalizerType = flat;
+    config.crcEnabled = false;
+
+    pvmp3_InitDecoder(&config, decoderBuf);
+
+    int64_t totalTimeUs = 0;
+    int64_t numSamples = 0;
+    int32_t samplingRate = 0;
+
+    for (size_t i = 0; i < frames.size(); ++i) {
+        const sp<ABuffer> &frame = frames.itemAt(i);
+
+        config.pInputBuffer = frame->data();
+        config.inputBufferCurrentLength = frame->size();
+        config.inputBufferMaxLength = 0;
+        config.inputBufferUsedLength = 0;
+        config.outputFrameSize = kOutputBufferSize / sizeof(int16_t);
+        config.pOutputBuffer = outBuf;
+
+        int64_t startUs = ALooper::GetNowUs();
+        ERROR_CODE err = pvmp3_framedecoder(&config, decoderBuf);
+        totalTimeUs += ALooper::GetNowUs() - startUs;
+
+        if (err != NO_DECODING_ERROR) {
+            if (err != NO_ENOUGH_MAIN_DATA_ERROR && err != SIDE_INFO_ERROR) {
+                fprintf(stderr, "decoder returned error %d\n", err);
+                break;
+            }
+            continue;
+        }
+
+        if (config.samplingRate != samplingRate) {
+            if (samplingRate > 0) {
+                *audioDurationSecs += (double)numSamples / samplingRate;
+            }
+            samplingRate = config.samplingRate;
+            numSamples = 0;
+        }
+
+        numSamples += config.outputFrameSize / config.num_channels;
+    }
+
+    if (samplingRate > 0) {
+        *audioDurationSecs += (double)numSamples / samplingRate;
+    }
+
+    return totalTimeUs;
+}
+
+int main(int argc, char **argv) {
+    const char *me = argv[0];
+    int numRepetitions = 1;
+
+    int res;
+    while ((res = getopt(argc, argv, "hn:")) >= 0) {
+        switch (res) {
+            case 'n':
+                numRepetitions = atoi(optarg);
+                if (numRepetitions < 1) {
+                    numRepetitions = 1;
+                }
+                break;
+
+            case '?':
+            case 'h':
+            default:
+                usage(me);
+                return 1;
+        }
+    }
+
+    argc -= optind;
+    argv += optind;
+
+    if (argc < 1) {
+        usage(me);
+        return 1;
+    }
+
+    DataSource::RegisterDefaultSniffers();
+
+    void *decoderBuf = malloc(pvmp3_decoderMemRequirements());
+    int16_t *outBuf = (int16_t *)malloc(kOutputBufferSize);
+
+    double totalAudioSecs = 0.0;
+    double totalDecodeSecs = 0.0;
+
+    for (int k = 0; k < argc; ++k) {
+        Vector<sp<ABuffer> > frames;
+        if (readFrames(argv[k], &frames) != OK) {
+            continue;
+        }
+
+        double audioSecs = 0.0;
+        int64_t decodeTimeUs = 0;
+        for (int i = 0; i < numRepetitions; ++i) {
+            decodeTimeUs +=
+                decodeFrames(frames, decoderBuf, outBuf, &audioSecs);
+        }
+
+        double decodeSecs = decodeTimeUs / 1E6;
+
+        printf("%s: %d frames, %.2f secs of audio decoded in %.3f secs, "
+               "%.1fx realtime\n",
+               argv[k], (int)frames.size(), audioSecs, decodeSecs,
+               decodeSecs > 0 ? audioSecs / decodeSecs : 0.0);
+
+        totalAudioSecs += audioSecs;
+        totalDecodeSecs += decodeSecs;
+    }
+
+    if (argc > 1 && totalDecodeSecs > 0) {
+        printf("total: %.2f secs of audio decoded in %.3f secs, "
+               "%.1fx realtime\n",
+               totalAudioSecs, totalDecodeSecs,
+               totalAudioSecs / totalDecodeSecs);
+    }
+
+    free(outBuf);
+    outBuf = NULL;
+
+    free(decoderBuf);
+    decoderBuf = NULL;
+
+    return 0;
+}
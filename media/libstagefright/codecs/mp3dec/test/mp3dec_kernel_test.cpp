@@ -0,0 +1,122 @@
+/*
+ * Copyright (C) 2012 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Checks that the vectorized synthesis kernels of the mp3 decoder produce
+// exactly the same output as their C counterparts.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pvmp3_audio_type_defs.h"
+#include "pvmp3_dct_16.h"
+#include "pvmp3_mdct_18.h"
+#include "pvmp3_polyphase_filter_window.h"
+
+#if !defined(PV_MP3DEC_SSE2)
+#error "this test requires the SSE2 kernels"
+#endif
+
+static const int kNumIterations = 100000;
+
+// Large enough for all reads of pvmp3_polyphase_filter_window.
+static const int kSynthBufferSize = 512 + 64;
+
+// Random values of magnitude up to 2^(bits - 1), so both the typical
+// range of the filterbank and full scale overflow behaviour are covered.
+static int32 randomValue(int bits) {
+    int32 r = (int32)(((uint32)rand() << 16) ^ (uint32)rand());
+    return bits >= 32 ? r : (r >> (32 - bits));
+}
+
+static void fill(int32 *a, int32 *b, int n, int bits) {
+    for (int i = 0; i < n; ++i) {
+        a[i] = b[i] = randomValue(bits);
+    }
+}
+
+static bool testPolyphaseFilterWindow(int iter) {
+    int32 synth1[kSynthBufferSize];
+    int32 synth2[kSynthBufferSize];
+    int16 pcm1[64];
+    int16 pcm2[64];
+
+    fill(synth1, synth2, kSynthBufferSize, 8 + iter % 25);
+    memset(pcm1, 0, sizeof(pcm1));
+    memset(pcm2, 0, sizeof(pcm2));
+
+    int32 numChannels = 1 + (iter & 1);
+    pvmp3_polyphase_filter_window_c(synth1, pcm1, numChannels);
+    pvmp3_polyphase_filter_window(synth2, pcm2, numChannels);
+
+    return !memcmp(pcm1, pcm2, sizeof(pcm1));
+}
+
+static bool testSplit(int iter) {
+    int32 vec1[32];
+    int32 vec2[32];
+
+    fill(vec1, vec2, 32, 8 + iter % 25);
+
+    pvmp3_split_c(&vec1[16]);
+    pvmp3_split(&vec2[16]);
+
+    return !memcmp(vec1, vec2, sizeof(vec1));
+}
+
+static bool testMdct18(int iter) {
+    int32 vec1[18], vec2[18];
+    int32 history1[18], history2[18];
+    int32 window[36];
+
+    int bits = 8 + iter % 25;
+    fill(vec1, vec2, 18, bits);
+    fill(history1, history2, 18, bits);
+    for (int i = 0; i < 36; ++i) {
+        window[i] = randomValue(31);
+    }
+
+    pvmp3_mdct_18_c(vec1, history1, window);
+    pvmp3_mdct_18(vec2, history2, window);
+
+    return !memcmp(vec1, vec2, sizeof(vec1))
+        && !memcmp(history1, history2, sizeof(history1));
+}
+
+int main(int argc, char **argv) {
+    int numFailures = 0;
+
+    srand(argc > 1 ? atoi(argv[1]) : 1);
+
+    for (int i = 0; i < kNumIterations; ++i) {
+        if (!testPolyphaseFilterWindow(i)) {
+            fprintf(stderr, "pvmp3_polyphase_filter_window mismatch (%d)\n", i);
+            ++numFailures;
+        }
+        if (!testSplit(i)) {
+            fprintf(stderr, "pvmp3_split mismatch (%d)\n", i);
+            ++numFailures;
+        }
+        if (!testMdct18(i)) {
+            fprintf(stderr, "pvmp3_mdct_18 mismatch (%d)\n", i);
+            ++numFailures;
+        }
+    }
+
+    printf("%d iterations, %d mismatches\n", kNumIterations, numFailures);
+
+    return numFailures == 0 ? 0 : 1;
+}
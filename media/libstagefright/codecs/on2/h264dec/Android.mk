@@ -85,10 +85,12 @@ MY_OMXDL_ASM_SRC := \
 	./omxdl/arm_neon/vc/m4p10/src_gcc/omxVCM4P10_TransformDequantChromaDCFromPair_s.S \
 
 
+LOCAL_CFLAGS := -DH264DEC_THREADS
+
 ifeq ($(ARCH_ARM_HAVE_NEON),true)
     LOCAL_ARM_NEON   := true
 #    LOCAL_CFLAGS     := -std=c99 -D._NEON -D._OMXDL
-    LOCAL_CFLAGS     := -DH264DEC_NEON -DH264DEC_OMXDL
+    LOCAL_CFLAGS     += -DH264DEC_NEON -DH264DEC_OMXDL
     LOCAL_SRC_FILES  += $(MY_ASM) $(MY_OMXDL_C_SRC) $(MY_OMXDL_ASM_SRC)
     LOCAL_C_INCLUDES += $(LOCAL_PATH)/./source/arm_neon_asm_gcc
     LOCAL_C_INCLUDES += $(LOCAL_PATH)/./omxdl/arm_neon/api \
@@ -96,6 +98,10 @@ ifeq ($(ARCH_ARM_HAVE_NEON),true)
                         $(LOCAL_PATH)/./omxdl/arm_neon/vc/m4p10/api
 endif
 
+ifeq ($(TARGET_ARCH),x86)
+    LOCAL_CFLAGS     += -DH264DEC_SSE2
+endif
+
 LOCAL_SHARED_LIBRARIES := \
 	libstagefright libstagefright_omx libstagefright_foundation libutils \
 
@@ -125,3 +131,22 @@ LOCAL_MODULE := decoder
 
 include $(BUILD_EXECUTABLE)
 
+
+#####################################################################
+# test utility: SSE2 kernels against the C code
+#####################################################################
+ifeq ($(TARGET_ARCH),x86)
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := ./source/Sse2TestBench.c
+
+LOCAL_C_INCLUDES := $(LOCAL_PATH)/inc $(LOCAL_PATH)/source
+
+LOCAL_SHARED_LIBRARIES := libstagefright_soft_h264dec
+
+LOCAL_MODULE_TAGS := debug
+
+LOCAL_MODULE := h264dec_sse2_test
+
+include $(BUILD_EXECUTABLE)
+endif
@@ -25,9 +25,13 @@
 #include <media/stagefright/MediaErrors.h>
 #include <media/IOMX.h>
 
+#include <unistd.h>
+
 
 namespace android {
 
+static const long kMaxNumThreads = 4;
+
 static const CodecProfileLevel kProfileLevels[] = {
     { OMX_VIDEO_AVCProfileBaseline, OMX_VIDEO_AVCLevel1  },
     { OMX_VIDEO_AVCProfileBaseline, OMX_VIDEO_AVCLevel1b },
@@ -161,10 +165,21 @@ void SoftAVC::initPorts() {
 
 status_t SoftAVC::initDecoder() {
     // Force decoder to output buffers in display order.
-    if (H264SwDecInit(&mHandle, 0) == H264SWDEC_OK) {
-        return OK;
+    if (H264SwDecInit(&mHandle, 0) != H264SWDEC_OK) {
+        return UNKNOWN_ERROR;
+    }
+
+    // Deblocking is spread over the available cores, the output does not
+    // depend on the number of threads.
+    long numCpus = sysconf(_SC_NPROCESSORS_ONLN);
+    if (numCpus > 1) {
+        u32 numThreads = (u32)(numCpus < kMaxNumThreads ? numCpus : kMaxNumThreads);
+        if (H264SwDecSetNumThreads(mHandle, numThreads) != H264SWDEC_OK) {
+            ALOGW("Failed to start %u deblocking threads", numThreads);
+        }
     }
-    return UNKNOWN_ERROR;
+
+    return OK;
 }
 
 OMX_ERRORTYPE SoftAVC::internalGetParameter(
@@ -155,6 +155,9 @@ extern "C"
 
     void  H264SwDecRelease(H264SwDecInst decInst);
 
+    H264SwDecRet H264SwDecSetNumThreads(H264SwDecInst decInst,
+                                        u32 numThreads);
+
     H264SwDecApiVersion H264SwDecGetAPIVersion(void);
 
     /* function prototype for API trace */
@@ -18,6 +18,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/time.h>
 
 /*------------------------------------------------------------------------------
     Module defines
@@ -40,6 +41,7 @@ void WriteOutput(char *filename, u8 *data, u32 picSize);
 u32 NextPacket(u8 **pStrm);
 u32 CropPicture(u8 *pOutImage, u8 *pInImage,
     u32 picWidth, u32 picHeight, CropParams *pCropParams);
+static double NowSeconds(void);
 
 /* Global variables for stream handling */
 u8 *streamStop = NULL;
@@ -102,6 +104,9 @@ int main(int argc, char **argv)
     u32 numErrors = 0;
     u32 cropDisplay = 0;
     u32 disableOutputReordering = 0;
+    u32 numThreads = 0;
+    double startTime;
+    double decodeTime = 0.0;
 
     FILE *finput;
 
@@ -123,7 +128,7 @@ int main(int argc, char **argv)
     if (argc < 2)
     {
         DEBUG((
-            "Usage: %s [-Nn] [-Ooutfile] [-P] [-U] [-C] [-R] [-T] file.h264\n",
+            "Usage: %s [-Nn] [-Ooutfile] [-P] [-U] [-C] [-R] [-Jn] [-T] file.h264\n",
             argv[0]));
         DEBUG(("\t-Nn forces decoding to stop after n pictures\n"));
 #if defined(_NO_OUT)
@@ -136,6 +141,7 @@ int main(int argc, char **argv)
         DEBUG(("\t-U NAL unit stream mode\n"));
         DEBUG(("\t-C display cropped image (default decoded image)\n"));
         DEBUG(("\t-R disable DPB output reordering\n"));
+        DEBUG(("\t-Jn use n threads for deblocking\n"));
         DEBUG(("\t-T to print tag name and exit\n"));
         return 0;
     }
@@ -167,6 +173,10 @@ int main(int argc, char **argv)
         {
             disableOutputReordering = 1;
         }
+        else if ( strncmp(argv[i], "-J", 2) == 0 )
+        {
+            numThreads = (u32)atoi(argv[i]+2);
+        }
     }
 
     /* open input file for reading, file name given by user. If file open
@@ -204,6 +214,18 @@ int main(int argc, char **argv)
         return -1;
     }
 
+    if (numThreads > 1)
+    {
+        ret = H264SwDecSetNumThreads(decInst, numThreads);
+        if (ret != H264SWDEC_OK)
+        {
+            DEBUG(("UNABLE TO START %d THREADS\n", numThreads));
+            H264SwDecRelease(decInst);
+            free(byteStrmStart);
+            return -1;
+        }
+    }
+
     /* initialize H264SwDecDecode() input structure */
     streamStop = byteStrmStart + strmLen;
     decInput.pStream = byteStrmStart;
@@ -222,8 +244,11 @@ int main(int argc, char **argv)
         /* Picture ID is the picture number in decoding order */
         decInput.picId = picDecodeNumber;
 
-        /* call API function to perform decoding */
+        /* call API function to perform decoding, only the time spent in
+         * the decoder is accounted for in the reported frame rate */
+        startTime = NowSeconds();
         ret = H264SwDecDecode(decInst, &decInput, &decOutput);
+        decodeTime += NowSeconds() - startTime;
 
         switch(ret)
         {
@@ -408,6 +433,13 @@ int main(int argc, char **argv)
         }
     }
 
+    if (decodeTime > 0.0)
+    {
+        DEBUG(("Decoded %d pictures in %.3f s, %.2f fps\n",
+            picDecodeNumber - 1, decodeTime,
+            (picDecodeNumber - 1) / decodeTime));
+    }
+
     /* release decoder instance */
     H264SwDecRelease(decInst);
 
@@ -665,6 +697,24 @@ u32 CropPicture(u8 *pOutImage, u8 *pInImage,
     return (0);
 }
 
+/*------------------------------------------------------------------------------
+
+    Function name: NowSeconds
+
+    Purpose:
+        Return wall clock time in seconds, used for measuring decoding
+        speed.
+
+------------------------------------------------------------------------------*/
+static double NowSeconds(void)
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+
+    return (double)tv.tv_sec + (double)tv.tv_usec / 1000000.0;
+}
+
 /*------------------------------------------------------------------------------
 
     Function name:  H264SwDecTrace
@@ -29,6 +29,7 @@
           H264SwDecDecode
           H264SwDecGetAPIVersion
           H264SwDecNextPicture
+          H264SwDecSetNumThreads
 
 ------------------------------------------------------------------------------*/
 
@@ -564,4 +565,60 @@ H264SwDecRet H264SwDecNextPicture(H264SwDecInst decInst,
 
 }
 
+/*------------------------------------------------------------------------------
+
+    Function: H264SwDecSetNumThreads
+
+        Functional description:
+            Set the number of threads used for deblocking filtering. The
+            calling thread takes part in the filtering, so numThreads-1
+            worker threads are started. Output of the decoder does not
+            depend on the number of threads.
+
+        Inputs:
+            decInst     decoder instance
+            numThreads  number of threads, 0 or 1 disables threading
+
+        Outputs:
+            none
+
+        Returns:
+            H264SWDEC_OK            success
+            H264SWDEC_PARAM_ERR     invalid parameters
+            H264SWDEC_MEMFAIL       failed to start the threads
+
+------------------------------------------------------------------------------*/
+
+H264SwDecRet H264SwDecSetNumThreads(H264SwDecInst decInst, u32 numThreads)
+{
+
+    decContainer_t *pDecCont;
+
+    DEC_API_TRC("H264SwDecSetNumThreads#");
+
+    if (decInst == NULL)
+    {
+        DEC_API_TRC("H264SwDecSetNumThreads# ERROR: decInst == NULL");
+        return(H264SWDEC_PARAM_ERR);
+    }
+
+    pDecCont = (decContainer_t*)decInst;
+
+#ifdef H264DEC_TRACE
+    sprintf(pDecCont->str, "H264SwDecSetNumThreads# decInst %p numThreads %d",
+            decInst, numThreads);
+    DEC_API_TRC(pDecCont->str);
+#endif
+
+    if (h264bsdSetNumThreads(&pDecCont->storage, numThreads) != HANTRO_OK)
+    {
+        DEC_API_TRC("H264SwDecSetNumThreads# ERROR: thread creation failed");
+        return(H264SWDEC_MEMFAIL);
+    }
+
+    DEC_API_TRC("H264SwDecSetNumThreads# OK");
+
+    return(H264SWDEC_OK);
+
+}
 
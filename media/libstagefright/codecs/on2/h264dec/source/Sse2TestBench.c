@@ -0,0 +1,209 @@
+/*
+ * Copyright (C) 2012 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Checks the H264DEC_SSE2 kernels bit exact against the C code on random
+ * input. The decoder under test is built with H264DEC_SSE2, this file
+ * builds the C inverse transform itself (renamed) and computes the half-pel
+ * interpolation straight from the 6-tap filter definition, including the
+ * edge extension done when the block reaches outside the reference frame.
+ * Returns non-zero if any output differs. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "h264bsd_reconstruct.h"
+
+/* C reference of h264bsdProcessBlock */
+#undef H264DEC_SSE2
+#define h264bsdProcessBlock RefProcessBlock
+#define h264bsdProcessLumaDc RefProcessLumaDc
+#define h264bsdProcessChromaDc RefProcessChromaDc
+#include "h264bsd_transform.c"
+#undef h264bsdProcessBlock
+#undef h264bsdProcessLumaDc
+#undef h264bsdProcessChromaDc
+
+u32 h264bsdProcessBlock(i32 *data, u32 qp, u32 skip, u32 coeffMap);
+
+/*------------------------------------------------------------------------------
+    Module defines
+------------------------------------------------------------------------------*/
+
+#define NUM_ITERATIONS 100000
+
+#define REF_WIDTH 48
+#define REF_HEIGHT 48
+
+static u32 Rand(u32 range)
+{
+    return (u32)rand() % range;
+}
+
+static u8 Clip(i32 x)
+{
+    return (u8)(x < 0 ? 0 : (x > 255 ? 255 : x));
+}
+
+/* reference sample with the edge extension of h264bsdFillBlock */
+static i32 Sample(const u8 *ref, i32 x, i32 y)
+{
+    x = x < 0 ? 0 : (x >= REF_WIDTH ? REF_WIDTH - 1 : x);
+    y = y < 0 ? 0 : (y >= REF_HEIGHT ? REF_HEIGHT - 1 : y);
+    return ref[y * REF_WIDTH + x];
+}
+
+static u8 Filter6Tap(i32 a, i32 b, i32 c, i32 d, i32 e, i32 f)
+{
+    return Clip((a - 5*b + 20*c + 20*d - 5*e + f + 16) >> 5);
+}
+
+/*------------------------------------------------------------------------------
+
+    Function name:  TestProcessBlock
+
+    Purpose:
+        Compare h264bsdProcessBlock against the C transform. Returns the
+        number of mismatching blocks.
+
+------------------------------------------------------------------------------*/
+static u32 TestProcessBlock(void)
+{
+    i32 data[16], refData[16];
+    u32 i, j, qp, skip, range, ret, refRet;
+    u32 mismatches = 0;
+
+    for (i = 0; i < NUM_ITERATIONS; i++)
+    {
+        /* mostly in range, some large enough to trip the range check */
+        range = (i & 0xF) ? 64 : 4096;
+        for (j = 0; j < 16; j++)
+            data[j] = (i32)Rand(2 * range) - (i32)range;
+        memcpy(refData, data, sizeof(data));
+
+        qp = Rand(52);
+        skip = Rand(2);
+
+        ret = h264bsdProcessBlock(data, qp, skip, 0xFFFF);
+        refRet = RefProcessBlock(refData, qp, skip, 0xFFFF);
+
+        if (ret != refRet ||
+            (ret == HANTRO_OK && memcmp(data, refData, sizeof(data))))
+        {
+            if (!mismatches)
+                printf("ProcessBlock mismatch, qp %u skip %u\n", qp, skip);
+            mismatches++;
+        }
+    }
+
+    return mismatches;
+}
+
+/*------------------------------------------------------------------------------
+
+    Function name:  TestInterpolateHalf
+
+    Purpose:
+        Compare h264bsdInterpolateVerHalf ('h') and h264bsdInterpolateHorHalf
+        ('b') against the 6-tap filter, for the partition sizes with SSE2
+        versions, inside and across the frame edges. Returns the number of
+        mismatching partitions.
+
+------------------------------------------------------------------------------*/
+static u32 TestInterpolateHalf(u32 vertical)
+{
+    static const u32 kPartSizes[4][2] = { {16,16}, {16,8}, {8,16}, {8,8} };
+    u8 ref[REF_WIDTH * REF_HEIGHT];
+    u8 mb[16*16], refMb[16*16];
+    u32 i, j, x, y, w, h;
+    i32 x0, y0, sx, sy;
+    u32 mismatches = 0;
+
+    for (i = 0; i < NUM_ITERATIONS / 10; i++)
+    {
+        for (j = 0; j < sizeof(ref); j++)
+            ref[j] = (u8)Rand(256);
+
+        w = kPartSizes[i & 3][0];
+        h = kPartSizes[i & 3][1];
+        /* position of the top left sample of the filter window */
+        x0 = (i32)Rand(REF_WIDTH + 16) - 8 - (vertical ? 0 : 2);
+        y0 = (i32)Rand(REF_HEIGHT + 16) - 8 - (vertical ? 2 : 0);
+
+        memset(mb, 0, sizeof(mb));
+        memset(refMb, 0, sizeof(refMb));
+
+        if (vertical)
+            h264bsdInterpolateVerHalf(ref, mb, x0, y0, REF_WIDTH, REF_HEIGHT,
+                w, h);
+        else
+            h264bsdInterpolateHorHalf(ref, mb, x0, y0, REF_WIDTH, REF_HEIGHT,
+                w, h);
+
+        for (y = 0; y < h; y++)
+        {
+            for (x = 0; x < w; x++)
+            {
+                sx = x0 + (i32)x;
+                sy = y0 + (i32)y;
+                if (vertical)
+                    refMb[y*16 + x] = Filter6Tap(Sample(ref, sx, sy),
+                        Sample(ref, sx, sy + 1), Sample(ref, sx, sy + 2),
+                        Sample(ref, sx, sy + 3), Sample(ref, sx, sy + 4),
+                        Sample(ref, sx, sy + 5));
+                else
+                    refMb[y*16 + x] = Filter6Tap(Sample(ref, sx, sy),
+                        Sample(ref, sx + 1, sy), Sample(ref, sx + 2, sy),
+                        Sample(ref, sx + 3, sy), Sample(ref, sx + 4, sy),
+                        Sample(ref, sx + 5, sy));
+            }
+        }
+
+        if (memcmp(mb, refMb, sizeof(mb)))
+        {
+            if (!mismatches)
+                printf("Interpolate%sHalf mismatch, %ux%u at (%d, %d)\n",
+                    vertical ? "Ver" : "Hor", w, h, x0, y0);
+            mismatches++;
+        }
+    }
+
+    return mismatches;
+}
+
+int main(int argc, char **argv)
+{
+    u32 mismatches, total = 0;
+
+    (void)argc;
+    (void)argv;
+
+    srand(1);
+
+    mismatches = TestProcessBlock();
+    printf("ProcessBlock: %u mismatches\n", mismatches);
+    total += mismatches;
+
+    mismatches = TestInterpolateHalf(1);
+    printf("InterpolateVerHalf: %u mismatches\n", mismatches);
+    total += mismatches;
+
+    mismatches = TestInterpolateHalf(0);
+    printf("InterpolateHorHalf: %u mismatches\n", mismatches);
+    total += mismatches;
+
+    return total ? 1 : 0;
+}
@@ -23,7 +23,7 @@
      3. Module defines
      4. Local function prototypes
      5. Functions
-          h264bsdFilterPicture
+          FilterMacroblock
           FilterVerLumaEdge
           FilterHorLumaEdge
           FilterHorLuma
@@ -40,6 +40,12 @@
           GetChromaEdgeThresholds
           FilterLuma
           FilterChroma
+          h264bsdFilterPicture
+          h264bsdInitDeblockThreads
+          h264bsdFreeDeblockThreads
+          h264bsdFilterPictureMt
+          FilterRow
+          DeblockThread
 
 ------------------------------------------------------------------------------*/
 
@@ -59,6 +65,10 @@
 #include "armVC.h"
 #endif /* H264DEC_OMXDL */
 
+#ifdef H264DEC_THREADS
+#include <pthread.h>
+#endif /* H264DEC_THREADS */
+
 /*------------------------------------------------------------------------------
     2. External compiler flags
 --------------------------------------------------------------------------------
@@ -166,6 +176,15 @@ static u32 IsSliceBoundaryOnTop(mbStorage_t *mb);
 
 static u32 GetMbFilteringFlags(mbStorage_t *mb);
 
+static void FilterMacroblock(image_t *image, mbStorage_t *pMb, u32 mbRow,
+    u32 mbCol);
+
+#ifdef H264DEC_THREADS
+static void FilterRow(deblockThreads_t *threads, u32 mbRow);
+
+static void *DeblockThread(void *arg);
+#endif /* H264DEC_THREADS */
+
 #ifndef H264DEC_OMXDL
 
 static u32 GetBoundaryStrengths(mbStorage_t *mb, bS_t *bs, u32 flags);
@@ -548,20 +567,19 @@ u32 EdgeBoundaryStrengthLeft(mbStorage_t *mb1, mbStorage_t *mb2)
 #endif /* H264DEC_OMXDL */
 /*------------------------------------------------------------------------------
 
-    Function: h264bsdFilterPicture
+    Function: FilterMacroblock
 
         Functional description:
-          Perform deblocking filtering for a picture. Filter does not copy
-          the original picture anywhere but filtering is performed directly
-          on the original image. Parameters controlling the filtering process
-          are computed based on information in macroblock structures of the
-          filtered macroblock, macroblock above and macroblock on the left of
-          the filtered one.
+          Perform deblocking filtering for one macroblock. The left and top
+          edges of the macroblock are filtered as well, i.e. up to three
+          pixels of the macroblocks on the left and above are modified.
 
         Inputs:
           image         pointer to image to be filtered
-          mb            pointer to macroblock data structure of the top-left
-                        macroblock of the picture
+          pMb           pointer to macroblock data structure of the filtered
+                        macroblock
+          mbRow         vertical position of the macroblock
+          mbCol         horizontal position of the macroblock
 
         Outputs:
           image         filtered image stored here
@@ -571,68 +589,50 @@ u32 EdgeBoundaryStrengthLeft(mbStorage_t *mb1, mbStorage_t *mb2)
 
 ------------------------------------------------------------------------------*/
 #ifndef H264DEC_OMXDL
-void h264bsdFilterPicture(
+void FilterMacroblock(
   image_t *image,
-  mbStorage_t *mb)
+  mbStorage_t *pMb,
+  u32 mbRow,
+  u32 mbCol)
 {
 
 /* Variables */
 
     u32 flags;
-    u32 picSizeInMbs, mbRow, mbCol;
+    u32 picSizeInMbs;
     u32 picWidthInMbs;
     u8 *data;
-    mbStorage_t *pMb;
     bS_t bS[16];
     edgeThreshold_t thresholds[3];
 
 /* Code */
 
-    ASSERT(image);
-    ASSERT(mb);
-    ASSERT(image->data);
-    ASSERT(image->width);
-    ASSERT(image->height);
-
     picWidthInMbs = image->width;
-    data = image->data;
     picSizeInMbs = picWidthInMbs * image->height;
 
-    pMb = mb;
+    flags = GetMbFilteringFlags(pMb);
 
-    for (mbRow = 0, mbCol = 0; mbRow < image->height; pMb++)
+    if (flags)
     {
-        flags = GetMbFilteringFlags(pMb);
-
-        if (flags)
+        /* GetBoundaryStrengths function returns non-zero value if any of
+         * the bS values for the macroblock being processed was non-zero */
+        if (GetBoundaryStrengths(pMb, bS, flags))
         {
-            /* GetBoundaryStrengths function returns non-zero value if any of
-             * the bS values for the macroblock being processed was non-zero */
-            if (GetBoundaryStrengths(pMb, bS, flags))
-            {
-                /* luma */
-                GetLumaEdgeThresholds(thresholds, pMb, flags);
-                data = image->data + mbRow * picWidthInMbs * 256 + mbCol * 16;
+            /* luma */
+            GetLumaEdgeThresholds(thresholds, pMb, flags);
+            data = image->data + mbRow * picWidthInMbs * 256 + mbCol * 16;
 
-                FilterLuma((u8*)data, bS, thresholds, picWidthInMbs*16);
+            FilterLuma((u8*)data, bS, thresholds, picWidthInMbs*16);
 
-                /* chroma */
-                GetChromaEdgeThresholds(thresholds, pMb, flags,
-                    pMb->chromaQpIndexOffset);
-                data = image->data + picSizeInMbs * 256 +
-                    mbRow * picWidthInMbs * 64 + mbCol * 8;
+            /* chroma */
+            GetChromaEdgeThresholds(thresholds, pMb, flags,
+                pMb->chromaQpIndexOffset);
+            data = image->data + picSizeInMbs * 256 +
+                mbRow * picWidthInMbs * 64 + mbCol * 8;
 
-                FilterChroma((u8*)data, data + 64*picSizeInMbs, bS,
-                        thresholds, picWidthInMbs*8);
+            FilterChroma((u8*)data, data + 64*picSizeInMbs, bS,
+                    thresholds, picWidthInMbs*8);
 
-            }
-        }
-
-        mbCol++;
-        if (mbCol == picWidthInMbs)
-        {
-            mbCol = 0;
-            mbRow++;
         }
     }
 
@@ -1739,20 +1739,19 @@ void FilterChroma(
 
 /*------------------------------------------------------------------------------
 
-    Function: h264bsdFilterPicture
+    Function: FilterMacroblock
 
         Functional description:
-          Perform deblocking filtering for a picture. Filter does not copy
-          the original picture anywhere but filtering is performed directly
-          on the original image. Parameters controlling the filtering process
-          are computed based on information in macroblock structures of the
-          filtered macroblock, macroblock above and macroblock on the left of
-          the filtered one.
+          Perform deblocking filtering for one macroblock. The left and top
+          edges of the macroblock are filtered as well, i.e. up to three
+          pixels of the macroblocks on the left and above are modified.
 
         Inputs:
           image         pointer to image to be filtered
-          mb            pointer to macroblock data structure of the top-left
-                        macroblock of the picture
+          pMb           pointer to macroblock data structure of the filtered
+                        macroblock
+          mbRow         vertical position of the macroblock
+          mbCol         horizontal position of the macroblock
 
         Outputs:
           image         filtered image stored here
@@ -1761,20 +1760,20 @@ void FilterChroma(
           none
 
 ------------------------------------------------------------------------------*/
-
 /*lint --e{550} Symbol not accessed */
-void h264bsdFilterPicture(
+void FilterMacroblock(
   image_t *image,
-  mbStorage_t *mb)
+  mbStorage_t *pMb,
+  u32 mbRow,
+  u32 mbCol)
 {
 
 /* Variables */
 
     u32 flags;
-    u32 picSizeInMbs, mbRow, mbCol;
+    u32 picSizeInMbs;
     u32 picWidthInMbs;
     u8 *data;
-    mbStorage_t *pMb;
     u8 bS[2][16];
     u8 thresholdLuma[2][16];
     u8 thresholdChroma[2][8];
@@ -1784,86 +1783,67 @@ void h264bsdFilterPicture(
 
 /* Code */
 
-    ASSERT(image);
-    ASSERT(mb);
-    ASSERT(image->data);
-    ASSERT(image->width);
-    ASSERT(image->height);
-
     picWidthInMbs = image->width;
-    data = image->data;
     picSizeInMbs = picWidthInMbs * image->height;
 
-    pMb = mb;
+    flags = GetMbFilteringFlags(pMb);
 
-    for (mbRow = 0, mbCol = 0; mbRow < image->height; pMb++)
+    if (flags)
     {
-        flags = GetMbFilteringFlags(pMb);
-
-        if (flags)
+        /* GetBoundaryStrengths function returns non-zero value if any of
+         * the bS values for the macroblock being processed was non-zero */
+        if (GetBoundaryStrengths(pMb, bS, flags))
         {
-            /* GetBoundaryStrengths function returns non-zero value if any of
-             * the bS values for the macroblock being processed was non-zero */
-            if (GetBoundaryStrengths(pMb, bS, flags))
-            {
 
-                /* Luma */
-                GetLumaEdgeThresholds(pMb,alpha,beta,thresholdLuma,bS,flags);
-                data = image->data + mbRow * picWidthInMbs * 256 + mbCol * 16;
-
-                res = omxVCM4P10_FilterDeblockingLuma_VerEdge_I( data,
-                                                (OMX_S32)(picWidthInMbs*16),
-                                                (const OMX_U8*)alpha,
-                                                (const OMX_U8*)beta,
-                                                (const OMX_U8*)thresholdLuma,
-                                                (const OMX_U8*)bS );
-
-                res = omxVCM4P10_FilterDeblockingLuma_HorEdge_I( data,
-                                                (OMX_S32)(picWidthInMbs*16),
-                                                (const OMX_U8*)alpha+2,
-                                                (const OMX_U8*)beta+2,
-                                                (const OMX_U8*)thresholdLuma+16,
-                                                (const OMX_U8*)bS+16 );
-                /* Cb */
-                GetChromaEdgeThresholds(pMb, alpha, beta, thresholdChroma,
-                                        bS, flags, pMb->chromaQpIndexOffset);
-                data = image->data + picSizeInMbs * 256 +
-                    mbRow * picWidthInMbs * 64 + mbCol * 8;
-
-                res = omxVCM4P10_FilterDeblockingChroma_VerEdge_I( data,
-                                              (OMX_S32)(picWidthInMbs*8),
-                                              (const OMX_U8*)alpha,
-                                              (const OMX_U8*)beta,
-                                              (const OMX_U8*)thresholdChroma,
-                                              (const OMX_U8*)bS );
-                res = omxVCM4P10_FilterDeblockingChroma_HorEdge_I( data,
-                                              (OMX_S32)(picWidthInMbs*8),
-                                              (const OMX_U8*)alpha+2,
-                                              (const OMX_U8*)beta+2,
-                                              (const OMX_U8*)thresholdChroma+8,
-                                              (const OMX_U8*)bS+16 );
-                /* Cr */
-                data += (picSizeInMbs * 64);
-                res = omxVCM4P10_FilterDeblockingChroma_VerEdge_I( data,
-                                              (OMX_S32)(picWidthInMbs*8),
-                                              (const OMX_U8*)alpha,
-                                              (const OMX_U8*)beta,
-                                              (const OMX_U8*)thresholdChroma,
-                                              (const OMX_U8*)bS );
-                res = omxVCM4P10_FilterDeblockingChroma_HorEdge_I( data,
-                                              (OMX_S32)(picWidthInMbs*8),
-                                              (const OMX_U8*)alpha+2,
-                                              (const OMX_U8*)beta+2,
-                                              (const OMX_U8*)thresholdChroma+8,
-                                              (const OMX_U8*)bS+16 );
-            }
-        }
-
-        mbCol++;
-        if (mbCol == picWidthInMbs)
-        {
-            mbCol = 0;
-            mbRow++;
+            /* Luma */
+            GetLumaEdgeThresholds(pMb,alpha,beta,thresholdLuma,bS,flags);
+            data = image->data + mbRow * picWidthInMbs * 256 + mbCol * 16;
+
+            res = omxVCM4P10_FilterDeblockingLuma_VerEdge_I( data,
+                                            (OMX_S32)(picWidthInMbs*16),
+                                            (const OMX_U8*)alpha,
+                                            (const OMX_U8*)beta,
+                                            (const OMX_U8*)thresholdLuma,
+                                            (const OMX_U8*)bS );
+
+            res = omxVCM4P10_FilterDeblockingLuma_HorEdge_I( data,
+                                            (OMX_S32)(picWidthInMbs*16),
+                                            (const OMX_U8*)alpha+2,
+                                            (const OMX_U8*)beta+2,
+                                            (const OMX_U8*)thresholdLuma+16,
+                                            (const OMX_U8*)bS+16 );
+            /* Cb */
+            GetChromaEdgeThresholds(pMb, alpha, beta, thresholdChroma,
+                                    bS, flags, pMb->chromaQpIndexOffset);
+            data = image->data + picSizeInMbs * 256 +
+                mbRow * picWidthInMbs * 64 + mbCol * 8;
+
+            res = omxVCM4P10_FilterDeblockingChroma_VerEdge_I( data,
+                                          (OMX_S32)(picWidthInMbs*8),
+                                          (const OMX_U8*)alpha,
+                                          (const OMX_U8*)beta,
+                                          (const OMX_U8*)thresholdChroma,
+                                          (const OMX_U8*)bS );
+            res = omxVCM4P10_FilterDeblockingChroma_HorEdge_I( data,
+                                          (OMX_S32)(picWidthInMbs*8),
+                                          (const OMX_U8*)alpha+2,
+                                          (const OMX_U8*)beta+2,
+                                          (const OMX_U8*)thresholdChroma+8,
+                                          (const OMX_U8*)bS+16 );
+            /* Cr */
+            data += (picSizeInMbs * 64);
+            res = omxVCM4P10_FilterDeblockingChroma_VerEdge_I( data,
+                                          (OMX_S32)(picWidthInMbs*8),
+                                          (const OMX_U8*)alpha,
+                                          (const OMX_U8*)beta,
+                                          (const OMX_U8*)thresholdChroma,
+                                          (const OMX_U8*)bS );
+            res = omxVCM4P10_FilterDeblockingChroma_HorEdge_I( data,
+                                          (OMX_S32)(picWidthInMbs*8),
+                                          (const OMX_U8*)alpha+2,
+                                          (const OMX_U8*)beta+2,
+                                          (const OMX_U8*)thresholdChroma+8,
+                                          (const OMX_U8*)bS+16 );
         }
     }
 
@@ -2413,5 +2393,430 @@ void GetChromaEdgeThresholds(
 
 #endif /* H264DEC_OMXDL */
 
+/*------------------------------------------------------------------------------
+
+    Function: h264bsdFilterPicture
+
+        Functional description:
+          Perform deblocking filtering for a picture. Filter does not copy
+          the original picture anywhere but filtering is performed directly
+          on the original image. Parameters controlling the filtering process
+          are computed based on information in macroblock structures of the
+          filtered macroblock, macroblock above and macroblock on the left of
+          the filtered one.
+
+        Inputs:
+          image         pointer to image to be filtered
+          mb            pointer to macroblock data structure of the top-left
+                        macroblock of the picture
+
+        Outputs:
+          image         filtered image stored here
+
+        Returns:
+          none
+
+------------------------------------------------------------------------------*/
+
+void h264bsdFilterPicture(
+  image_t *image,
+  mbStorage_t *mb)
+{
+
+/* Variables */
+
+    u32 mbRow, mbCol;
+    mbStorage_t *pMb;
+
+/* Code */
+
+    ASSERT(image);
+    ASSERT(mb);
+    ASSERT(image->data);
+    ASSERT(image->width);
+    ASSERT(image->height);
+
+    pMb = mb;
+
+    for (mbRow = 0; mbRow < image->height; mbRow++)
+    {
+        for (mbCol = 0; mbCol < image->width; mbCol++)
+        {
+            FilterMacroblock(image, pMb++, mbRow, mbCol);
+        }
+    }
+
+}
+
+#ifdef H264DEC_THREADS
+
+/* Deblocking of a macroblock modifies pixels of the macroblocks on the left
+ * and above it. The right edge of the macroblock above is in turn modified
+ * by the macroblock above-right, so macroblock (row, col) can be filtered
+ * once row-1 has been filtered up to and including column col+1. Rows are
+ * handed out to the threads in order and each thread follows the row above
+ * it in a wavefront. */
+
+/* progress of a row is published after every DEBLOCK_SYNC_INTERVAL
+ * macroblocks to keep the locking overhead low */
+#define DEBLOCK_SYNC_INTERVAL 4
+
+struct deblockThreads
+{
+    pthread_mutex_t lock;
+    pthread_cond_t startCond;
+    pthread_cond_t progressCond;
+
+    pthread_t thread[MAX_DEBLOCK_THREADS];
+    u32 numWorkers;
+    u32 quit;
+
+    /* incremented for every picture handed to the workers */
+    u32 generation;
+
+    image_t *image;
+    mbStorage_t *mb;
+
+    /* next row to be claimed and number of rows completely filtered */
+    u32 nextRow;
+    u32 rowsDone;
+
+    /* number of filtered macroblocks in each row */
+    u32 *rowProgress;
+    u32 rowProgressSize;
+};
+
+/*------------------------------------------------------------------------------
+
+    Function: h264bsdInitDeblockThreads
+
+        Functional description:
+          Start worker threads for deblocking. The calling thread takes part
+          in the filtering as well, so numThreads-1 threads are created. No
+          threads are created if numThreads is 0 or 1.
+
+        Inputs:
+          numThreads    total number of threads filtering a picture
+
+        Outputs:
+          threads       pointer to the created thread context is stored
+                        here, NULL if no threads were created
+
+        Returns:
+          HANTRO_OK     success
+          HANTRO_NOK    failed to allocate memory or to create threads
+
+------------------------------------------------------------------------------*/
+
+u32 h264bsdInitDeblockThreads(deblockThreads_t **threads, u32 numThreads)
+{
+
+/* Variables */
+
+    deblockThreads_t *p;
+    u32 i;
+
+/* Code */
+
+    ASSERT(threads);
+
+    *threads = NULL;
+
+    if (numThreads > MAX_DEBLOCK_THREADS)
+        numThreads = MAX_DEBLOCK_THREADS;
+
+    if (numThreads <= 1)
+        return(HANTRO_OK);
+
+    ALLOCATE(p, 1, deblockThreads_t);
+    if (p == NULL)
+        return(HANTRO_NOK);
+
+    H264SwDecMemset(p, 0, sizeof(deblockThreads_t));
+
+    pthread_mutex_init(&p->lock, NULL);
+    pthread_cond_init(&p->startCond, NULL);
+    pthread_cond_init(&p->progressCond, NULL);
+
+    for (i = 0; i < numThreads - 1; i++)
+    {
+        if (pthread_create(&p->thread[i], NULL, DeblockThread, p) != 0)
+            break;
+        p->numWorkers++;
+    }
+
+    if (p->numWorkers == 0)
+    {
+        h264bsdFreeDeblockThreads(p);
+        return(HANTRO_NOK);
+    }
+
+    *threads = p;
+
+    return(HANTRO_OK);
+
+}
+
+/*------------------------------------------------------------------------------
+
+    Function: h264bsdFreeDeblockThreads
+
+        Functional description:
+          Stop the deblocking worker threads and free the thread context.
+
+------------------------------------------------------------------------------*/
+
+void h264bsdFreeDeblockThreads(deblockThreads_t *threads)
+{
+
+/* Variables */
+
+    u32 i;
+
+/* Code */
+
+    if (threads == NULL)
+        return;
+
+    pthread_mutex_lock(&threads->lock);
+    threads->quit = HANTRO_TRUE;
+    pthread_cond_broadcast(&threads->startCond);
+    pthread_mutex_unlock(&threads->lock);
+
+    for (i = 0; i < threads->numWorkers; i++)
+        pthread_join(threads->thread[i], NULL);
+
+    pthread_cond_destroy(&threads->progressCond);
+    pthread_cond_destroy(&threads->startCond);
+    pthread_mutex_destroy(&threads->lock);
+
+    FREE(threads->rowProgress);
+    FREE(threads);
+
+}
+
+/*------------------------------------------------------------------------------
+
+    Function: h264bsdFilterPictureMt
+
+        Functional description:
+          Perform deblocking filtering for a picture using the calling
+          thread and the worker threads of the thread context. Output is
+          identical to h264bsdFilterPicture. Falls back to single threaded
+          filtering if threads is NULL.
+
+        Inputs:
+          threads       thread context
+          image         pointer to image to be filtered
+          mb            pointer to macroblock data structure of the top-left
+                        macroblock of the picture
+
+        Outputs:
+          image         filtered image stored here
+
+        Returns:
+          none
+
+------------------------------------------------------------------------------*/
+
+void h264bsdFilterPictureMt(
+  deblockThreads_t *threads,
+  image_t *image,
+  mbStorage_t *mb)
+{
+
+/* Variables */
+
+    u32 mbRow;
+
+/* Code */
+
+    ASSERT(image);
+    ASSERT(mb);
+
+    if (threads == NULL || image->height < 2)
+    {
+        h264bsdFilterPicture(image, mb);
+        return;
+    }
+
+    if (threads->rowProgressSize < image->height)
+    {
+        FREE(threads->rowProgress);
+        ALLOCATE(threads->rowProgress, image->height, u32);
+        if (threads->rowProgress == NULL)
+        {
+            threads->rowProgressSize = 0;
+            h264bsdFilterPicture(image, mb);
+            return;
+        }
+        threads->rowProgressSize = image->height;
+    }
+
+    H264SwDecMemset(threads->rowProgress, 0, image->height * sizeof(u32));
+
+    pthread_mutex_lock(&threads->lock);
+    threads->image = image;
+    threads->mb = mb;
+    threads->nextRow = 0;
+    threads->rowsDone = 0;
+    threads->generation++;
+    pthread_cond_broadcast(&threads->startCond);
+
+    for (;;)
+    {
+        mbRow = threads->nextRow;
+        if (mbRow >= image->height)
+            break;
+        threads->nextRow++;
+        pthread_mutex_unlock(&threads->lock);
+
+        FilterRow(threads, mbRow);
+
+        pthread_mutex_lock(&threads->lock);
+    }
+
+    while (threads->rowsDone < image->height)
+        pthread_cond_wait(&threads->progressCond, &threads->lock);
+
+    threads->image = NULL;
+    threads->mb = NULL;
+    pthread_mutex_unlock(&threads->lock);
+
+}
+
+/*------------------------------------------------------------------------------
+
+    Function: FilterRow
+
+        Functional description:
+          Filter one row of macroblocks, staying behind the row above as
+          described at the top of this section.
+
+------------------------------------------------------------------------------*/
+
+void FilterRow(deblockThreads_t *threads, u32 mbRow)
+{
+
+/* Variables */
+
+    u32 mbCol, required, available;
+    u32 picWidthInMbs;
+    image_t *image;
+    mbStorage_t *pMb;
+
+/* Code */
+
+    image = threads->image;
+    picWidthInMbs = image->width;
+    pMb = threads->mb + mbRow * picWidthInMbs;
+
+    available = (mbRow == 0) ? picWidthInMbs : 0;
+
+    for (mbCol = 0; mbCol < picWidthInMbs; mbCol++, pMb++)
+    {
+        required = MIN(mbCol + 2, picWidthInMbs);
+        if (available < required)
+        {
+            pthread_mutex_lock(&threads->lock);
+            while (threads->rowProgress[mbRow - 1] < required)
+                pthread_cond_wait(&threads->progressCond, &threads->lock);
+            available = threads->rowProgress[mbRow - 1];
+            pthread_mutex_unlock(&threads->lock);
+        }
+
+        FilterMacroblock(image, pMb, mbRow, mbCol);
+
+        if (mbCol + 1 == picWidthInMbs ||
+            ((mbCol + 1) % DEBLOCK_SYNC_INTERVAL) == 0)
+        {
+            pthread_mutex_lock(&threads->lock);
+            threads->rowProgress[mbRow] = mbCol + 1;
+            if (mbCol + 1 == picWidthInMbs)
+                threads->rowsDone++;
+            pthread_cond_broadcast(&threads->progressCond);
+            pthread_mutex_unlock(&threads->lock);
+        }
+    }
+
+}
+
+/*------------------------------------------------------------------------------
+
+    Function: DeblockThread
+
+        Functional description:
+          Worker thread main loop, claims rows of each new picture until
+          all rows have been handed out.
+
+------------------------------------------------------------------------------*/
+
+void *DeblockThread(void *arg)
+{
+
+/* Variables */
+
+    deblockThreads_t *threads = (deblockThreads_t *)arg;
+    u32 generation = 0;
+    u32 mbRow;
+
+/* Code */
+
+    pthread_mutex_lock(&threads->lock);
+
+    for (;;)
+    {
+        while (!threads->quit && threads->generation == generation)
+            pthread_cond_wait(&threads->startCond, &threads->lock);
+
+        if (threads->quit)
+            break;
+
+        generation = threads->generation;
+
+        while (threads->image && threads->nextRow < threads->image->height)
+        {
+            mbRow = threads->nextRow++;
+            pthread_mutex_unlock(&threads->lock);
+
+            FilterRow(threads, mbRow);
+
+            pthread_mutex_lock(&threads->lock);
+        }
+    }
+
+    pthread_mutex_unlock(&threads->lock);
+
+    return NULL;
+
+}
+
+#else /* H264DEC_THREADS */
+
+u32 h264bsdInitDeblockThreads(deblockThreads_t **threads, u32 numThreads)
+{
+    ASSERT(threads);
+
+    /* built without thread support, always filter in the calling thread */
+    *threads = NULL;
+
+    return(HANTRO_OK);
+}
+
+void h264bsdFreeDeblockThreads(deblockThreads_t *threads)
+{
+    ASSERT(threads == NULL);
+}
+
+void h264bsdFilterPictureMt(
+  deblockThreads_t *threads,
+  image_t *image,
+  mbStorage_t *mb)
+{
+    h264bsdFilterPicture(image, mb);
+}
+
+#endif /* H264DEC_THREADS */
+
 /*lint +e701 +e702 */
 
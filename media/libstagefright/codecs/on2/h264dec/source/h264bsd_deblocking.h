@@ -40,10 +40,16 @@
     2. Module defines
 ------------------------------------------------------------------------------*/
 
+/* maximum number of threads taking part in deblocking of a picture */
+#define MAX_DEBLOCK_THREADS 8
+
 /*------------------------------------------------------------------------------
     3. Data types
 ------------------------------------------------------------------------------*/
 
+/* worker threads for deblocking, opaque outside h264bsd_deblocking.c */
+typedef struct deblockThreads deblockThreads_t;
+
 /*------------------------------------------------------------------------------
     4. Function prototypes
 ------------------------------------------------------------------------------*/
@@ -52,5 +58,14 @@ void h264bsdFilterPicture(
   image_t *image,
   mbStorage_t *mb);
 
+u32 h264bsdInitDeblockThreads(deblockThreads_t **threads, u32 numThreads);
+
+void h264bsdFreeDeblockThreads(deblockThreads_t *threads);
+
+void h264bsdFilterPictureMt(
+  deblockThreads_t *threads,
+  image_t *image,
+  mbStorage_t *mb);
+
 #endif /* #ifdef H264SWDEC_DEBLOCKING_H */
 
@@ -35,6 +35,7 @@
           h264bsdVideoRange
           h264bsdMatrixCoefficients
           h264bsdCroppingParams
+          h264bsdSetNumThreads
 
 ------------------------------------------------------------------------------*/
 
@@ -471,7 +472,8 @@ u32 h264bsdDecode(storage_t *pStorage, u8 *byteStrm, u32 len, u32 picId,
 
     if (picReady)
     {
-        h264bsdFilterPicture(pStorage->currImage, pStorage->mb);
+        h264bsdFilterPictureMt(pStorage->deblockThreads,
+            pStorage->currImage, pStorage->mb);
 
         h264bsdResetStorage(pStorage);
 
@@ -569,6 +571,9 @@ void h264bsdShutdown(storage_t *pStorage)
 
     h264bsdFreeDpb(pStorage->dpb);
 
+    h264bsdFreeDeblockThreads(pStorage->deblockThreads);
+    pStorage->deblockThreads = NULL;
+
 }
 
 /*------------------------------------------------------------------------------
@@ -959,3 +964,29 @@ u32 h264bsdProfile(storage_t *pStorage)
         return 0;
 }
 
+/*------------------------------------------------------------------------------
+
+    Function: h264bsdSetNumThreads
+
+        Functional description:
+            Set the number of threads used for deblocking filtering of the
+            decoded pictures. Worker threads of a previous call are stopped.
+
+        Inputs:
+            pStorage    pointer to storage structure
+            numThreads  number of threads, 0 or 1 to filter in the decoding
+                        thread only
+
+        Returns:
+            HANTRO_OK   success
+            HANTRO_NOK  failed to start the threads
+
+------------------------------------------------------------------------------*/
+u32 h264bsdSetNumThreads(storage_t *pStorage, u32 numThreads)
+{
+    h264bsdFreeDeblockThreads(pStorage->deblockThreads);
+    pStorage->deblockThreads = NULL;
+
+    return h264bsdInitDeblockThreads(&pStorage->deblockThreads, numThreads);
+}
+
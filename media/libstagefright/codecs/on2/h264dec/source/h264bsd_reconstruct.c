@@ -42,6 +42,10 @@
 #include "armVC.h"
 #endif /* H264DEC_OMXDL */
 
+#ifdef H264DEC_SSE2
+#include <emmintrin.h>
+#endif /* H264DEC_SSE2 */
+
 /*------------------------------------------------------------------------------
     2. External compiler flags
 --------------------------------------------------------------------------------
@@ -76,6 +80,83 @@ static const u32 lumaFracPos[4][4] = {
 /* clipping table, defined in h264bsd_intra_prediction.c */
 extern const u8 h264bsdClip[];
 
+#if defined(H264DEC_SSE2) && !defined(H264DEC_OMXDL)
+
+/* Apply the 6-tap luma filter (1, -5, 20, 20, -5, 1) to eight pixel
+ * positions at once. a-f hold eight 8-bit samples each in their low half,
+ * the result is rounded, shifted and clipped exactly as in the C code. The
+ * intermediate sum fits in 16 bits: its range is [-2550, 10726]. */
+static __inline __m128i Filter6TapSse2(__m128i a, __m128i b, __m128i c,
+    __m128i d, __m128i e, __m128i f)
+{
+    const __m128i zero = _mm_setzero_si128();
+    __m128i sum, tmp;
+
+    sum = _mm_add_epi16(_mm_unpacklo_epi8(a, zero),
+                        _mm_unpacklo_epi8(f, zero));
+    tmp = _mm_add_epi16(_mm_unpacklo_epi8(c, zero),
+                        _mm_unpacklo_epi8(d, zero));
+    sum = _mm_add_epi16(sum, _mm_mullo_epi16(tmp, _mm_set1_epi16(20)));
+    tmp = _mm_add_epi16(_mm_unpacklo_epi8(b, zero),
+                        _mm_unpacklo_epi8(e, zero));
+    sum = _mm_sub_epi16(sum, _mm_mullo_epi16(tmp, _mm_set1_epi16(5)));
+    sum = _mm_srai_epi16(_mm_add_epi16(sum, _mm_set1_epi16(16)), 5);
+
+    return _mm_packus_epi16(sum, sum);
+}
+
+#define LOAD8(p) _mm_loadl_epi64((const __m128i *)(p))
+
+/* Vertical half-pel interpolation ('h') for partitions whose width is a
+ * multiple of 8. ref points to the sample two rows above the partition. */
+static void InterpolateVerHalfSse2(const u8 *ref, u8 *mb, u32 width,
+    u32 partWidth, u32 partHeight)
+{
+    u32 x, y;
+    const u8 *p;
+
+    for (y = partHeight; y; y--)
+    {
+        for (x = 0; x < partWidth; x += 8)
+        {
+            p = ref + x;
+            _mm_storel_epi64((__m128i *)(mb + x),
+                Filter6TapSse2(LOAD8(p), LOAD8(p + width),
+                    LOAD8(p + 2*width), LOAD8(p + 3*width),
+                    LOAD8(p + 4*width), LOAD8(p + 5*width)));
+        }
+        ref += width;
+        mb += 16;
+    }
+}
+
+/* Horizontal half-pel interpolation ('b') for partitions whose width is a
+ * multiple of 8. ref points to the sample two columns left of the
+ * partition. */
+static void InterpolateHorHalfSse2(const u8 *ref, u8 *mb, u32 width,
+    u32 partWidth, u32 partHeight)
+{
+    u32 x, y;
+    const u8 *p;
+
+    for (y = partHeight; y; y--)
+    {
+        for (x = 0; x < partWidth; x += 8)
+        {
+            p = ref + x;
+            _mm_storel_epi64((__m128i *)(mb + x),
+                Filter6TapSse2(LOAD8(p), LOAD8(p + 1), LOAD8(p + 2),
+                    LOAD8(p + 3), LOAD8(p + 4), LOAD8(p + 5)));
+        }
+        ref += width;
+        mb += 16;
+    }
+}
+
+#undef LOAD8
+
+#endif /* H264DEC_SSE2 && !H264DEC_OMXDL */
+
 /*------------------------------------------------------------------------------
     4. Local function prototypes
 ------------------------------------------------------------------------------*/
@@ -521,6 +602,14 @@ void h264bsdInterpolateVerHalf(
 
     ref += (u32)y0 * width + (u32)x0;
 
+#ifdef H264DEC_SSE2
+    if ((partWidth & 0x7) == 0)
+    {
+        InterpolateVerHalfSse2(ref, mb, width, partWidth, partHeight);
+        return;
+    }
+#endif /* H264DEC_SSE2 */
+
     ptrC = ref + width;
     ptrV = ptrC + 5*width;
 
@@ -775,6 +864,14 @@ void h264bsdInterpolateHorHalf(
 
     ref += (u32)y0 * width + (u32)x0;
 
+#ifdef H264DEC_SSE2
+    if ((partWidth & 0x7) == 0)
+    {
+        InterpolateHorHalfSse2(ref, mb, width, partWidth, partHeight);
+        return;
+    }
+#endif /* H264DEC_SSE2 */
+
     ptrJ = ref + 5;
 
     for (y = partHeight; y; y--)
@@ -37,6 +37,10 @@
 #include "h264bsd_transform.h"
 #include "h264bsd_util.h"
 
+#ifdef H264DEC_SSE2
+#include <emmintrin.h>
+#endif /* H264DEC_SSE2 */
+
 /*------------------------------------------------------------------------------
     2. External compiler flags
 --------------------------------------------------------------------------------
@@ -67,6 +71,10 @@ static const u8 qpDiv6[52] = {0,0,0,0,0,0,1,1,1,1,1,1,2,2,2,2,2,2,3,3,3,3,3,3,
     4. Local function prototypes
 ------------------------------------------------------------------------------*/
 
+#ifdef H264DEC_SSE2
+static u32 InverseTransformSse2(i32 *data);
+#endif /* H264DEC_SSE2 */
+
 /*------------------------------------------------------------------------------
 
     Function: h264bsdProcessBlock
@@ -98,9 +106,11 @@ u32 h264bsdProcessBlock(i32 *data, u32 qp, u32 skip, u32 coeffMap)
 
     i32 tmp0, tmp1, tmp2, tmp3;
     i32 d1, d2, d3;
+#ifndef H264DEC_SSE2
     u32 row,col;
-    u32 qpDiv;
     i32 *ptr;
+#endif /* H264DEC_SSE2 */
+    u32 qpDiv;
 
 /* Code */
 
@@ -152,6 +162,10 @@ u32 h264bsdProcessBlock(i32 *data, u32 qp, u32 skip, u32 coeffMap)
         data[10] = (d2 * tmp1);
         data[11] = (d3 * tmp2);
 
+#ifdef H264DEC_SSE2
+        if (InverseTransformSse2(data) != HANTRO_OK)
+            return(HANTRO_NOK);
+#else
         /* horizontal transform */
         for (row = 4, ptr = data; row--; ptr += 4)
         {
@@ -184,6 +198,7 @@ u32 h264bsdProcessBlock(i32 *data, u32 qp, u32 skip, u32 coeffMap)
                 ((u32)(data[12] + 512) > 1023) )
                 return(HANTRO_NOK);
         }
+#endif /* H264DEC_SSE2 */
     }
     else /* rows 1, 2 and 3 are zero */
     {
@@ -230,6 +245,106 @@ u32 h264bsdProcessBlock(i32 *data, u32 qp, u32 skip, u32 coeffMap)
 
 }
 
+#ifdef H264DEC_SSE2
+/*------------------------------------------------------------------------------
+
+    Function: InverseTransformSse2
+
+        Functional description:
+            Inverse transform of a 4x4 block, four rows or columns at a
+            time. Bit exact with the C code in h264bsdProcessBlock.
+
+        Inputs:
+            data            dequantized coefficients in raster order
+
+        Outputs:
+            data            residual, (x + 32) >> 6 applied
+
+        Returns:
+            HANTRO_OK       success
+            HANTRO_NOK      processed data not in valid range [-512, 511]
+
+------------------------------------------------------------------------------*/
+#define TRANSPOSE4(r0, r1, r2, r3) \
+{ \
+    __m128i t0 = _mm_unpacklo_epi32(r0, r1); \
+    __m128i t1 = _mm_unpacklo_epi32(r2, r3); \
+    __m128i t2 = _mm_unpackhi_epi32(r0, r1); \
+    __m128i t3 = _mm_unpackhi_epi32(r2, r3); \
+    r0 = _mm_unpacklo_epi64(t0, t1); \
+    r1 = _mm_unpackhi_epi64(t0, t1); \
+    r2 = _mm_unpacklo_epi64(t2, t3); \
+    r3 = _mm_unpackhi_epi64(t2, t3); \
+}
+
+#define BUTTERFLY4(r0, r1, r2, r3) \
+{ \
+    __m128i t0 = _mm_add_epi32(r0, r2); \
+    __m128i t1 = _mm_sub_epi32(r0, r2); \
+    __m128i t2 = _mm_sub_epi32(_mm_srai_epi32(r1, 1), r3); \
+    __m128i t3 = _mm_add_epi32(r1, _mm_srai_epi32(r3, 1)); \
+    r0 = _mm_add_epi32(t0, t3); \
+    r1 = _mm_add_epi32(t1, t2); \
+    r2 = _mm_sub_epi32(t1, t2); \
+    r3 = _mm_sub_epi32(t0, t3); \
+}
+
+u32 InverseTransformSse2(i32 *data)
+{
+
+/* Variables */
+
+    __m128i r0, r1, r2, r3;
+    __m128i round, max, min, outOfRange;
+
+/* Code */
+
+    r0 = _mm_loadu_si128((__m128i *)(data + 0));
+    r1 = _mm_loadu_si128((__m128i *)(data + 4));
+    r2 = _mm_loadu_si128((__m128i *)(data + 8));
+    r3 = _mm_loadu_si128((__m128i *)(data + 12));
+
+    /* horizontal transform, done on columns of the transposed block */
+    TRANSPOSE4(r0, r1, r2, r3);
+    BUTTERFLY4(r0, r1, r2, r3);
+
+    /* then vertical transform */
+    TRANSPOSE4(r0, r1, r2, r3);
+    BUTTERFLY4(r0, r1, r2, r3);
+
+    round = _mm_set1_epi32(32);
+    r0 = _mm_srai_epi32(_mm_add_epi32(r0, round), 6);
+    r1 = _mm_srai_epi32(_mm_add_epi32(r1, round), 6);
+    r2 = _mm_srai_epi32(_mm_add_epi32(r2, round), 6);
+    r3 = _mm_srai_epi32(_mm_add_epi32(r3, round), 6);
+
+    _mm_storeu_si128((__m128i *)(data + 0), r0);
+    _mm_storeu_si128((__m128i *)(data + 4), r1);
+    _mm_storeu_si128((__m128i *)(data + 8), r2);
+    _mm_storeu_si128((__m128i *)(data + 12), r3);
+
+    /* check that each value is in the range [-512,511] */
+    max = _mm_set1_epi32(511);
+    min = _mm_set1_epi32(-512);
+    outOfRange = _mm_or_si128(
+        _mm_or_si128(_mm_cmpgt_epi32(r0, max), _mm_cmplt_epi32(r0, min)),
+        _mm_or_si128(_mm_cmpgt_epi32(r1, max), _mm_cmplt_epi32(r1, min)));
+    outOfRange = _mm_or_si128(outOfRange,
+        _mm_or_si128(_mm_cmpgt_epi32(r2, max), _mm_cmplt_epi32(r2, min)));
+    outOfRange = _mm_or_si128(outOfRange,
+        _mm_or_si128(_mm_cmpgt_epi32(r3, max), _mm_cmplt_epi32(r3, min)));
+
+    if (_mm_movemask_epi8(outOfRange))
+        return(HANTRO_NOK);
+
+    return(HANTRO_OK);
+
+}
+
+#undef TRANSPOSE4
+#undef BUTTERFLY4
+#endif /* H264DEC_SSE2 */
+
 /*------------------------------------------------------------------------------
 
     Function: h264bsdProcessLumaDc
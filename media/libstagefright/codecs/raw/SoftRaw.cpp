@@ -45,6 +45,10 @@ SoftRaw::SoftRaw(
       mSampleRate(44100) {
     initPorts();
     CHECK_EQ(initDecoder(), (status_t)OK);
+
+    // Nothing is decoded, the input is copied to the output as is, so the
+    // buffer done callbacks are most of the work. Hand them back in batches.
+    setBatchBufferDone(true);
 }
 
 SoftRaw::~SoftRaw() {
@@ -21,6 +21,7 @@
 #include <media/stagefright/foundation/ABase.h>
 #include <media/stagefright/MediaExtractor.h>
 #include <media/stagefright/MediaSource.h>
+#include <utils/threads.h>
 #include <utils/Vector.h>
 
 namespace android {
@@ -46,12 +47,25 @@ private:
 
     struct SampleInfo {
         uint32_t mOffset;
+        uint32_t mSize;
         bool mIsKey;
     };
 
+    // The index of each track is kept as a byte stream of variable length
+    // deltas, see appendSample(). Every kSamplesPerBlock samples a block
+    // starts that can be decoded without the ones before it.
+    enum {
+        kSamplesPerBlock = 64,
+    };
+
+    struct IndexBlock {
+        uint32_t mPackedOffset;
+        uint32_t mFirstOffset;
+        uint32_t mFirstSize;
+    };
+
     struct Track {
         sp<MetaData> mMeta;
-        Vector<SampleInfo> mSamples;
         uint32_t mRate;
         uint32_t mScale;
 
@@ -67,6 +81,20 @@ private:
 
         } mKind;
 
+        size_t mNumSamples;
+        Vector<uint8_t> mPackedIndex;
+        Vector<IndexBlock> mIndexBlocks;
+        uint32_t mLastOffset;
+        uint32_t mLastSize;
+
+        // Indices of the sync samples in ascending order, left empty as
+        // long as all samples are sync samples.
+        Vector<uint32_t> mSyncSamples;
+
+        // The block last decoded by getSampleInfo(), -1 if none.
+        ssize_t mDecodedBlock;
+        SampleInfo mDecodedSamples[kSamplesPerBlock];
+
         size_t mNumSyncSamples;
         size_t mThumbnailSampleSize;
         ssize_t mThumbnailSampleIndex;
@@ -79,6 +107,10 @@ private:
 
     sp<DataSource> mDataSource;
     status_t mInitCheck;
+
+    // Protects the decoded index blocks, the tracks' sources read
+    // concurrently.
+    Mutex mLock;
     Vector<Track> mTracks;
 
     off64_t mMovieOffset;
@@ -92,6 +124,13 @@ private:
 
     status_t parseHeaders();
 
+    static void appendSample(
+            Track *track, uint32_t offset, uint32_t size, bool isKey);
+
+    static void decodeBlock(Track *track, size_t blockIndex);
+
+    status_t checkSampleChunk(size_t trackIndex, size_t sampleIndex);
+
     status_t getSampleInfo(
             size_t trackIndex, size_t sampleIndex,
             off64_t *offset, size_t *size, bool *isKey,
@@ -83,6 +83,10 @@ struct AwesomePlayer {
     status_t play();
     status_t pause();
 
+    // Gets audio-only playback ready to start without a gap, called on
+    // the player that is to follow the current one.
+    status_t prerollAudio();
+
     bool isPlaying() const;
 
     status_t setSurfaceTexture(const sp<ISurfaceTexture> &surfaceTexture);
@@ -294,6 +298,7 @@ private:
     void finishSeekIfNecessary(int64_t videoTimeUs);
     void ensureCacheIsFetching_l();
 
+    void createAudioPlayer_l();
     status_t startAudioPlayer_l(bool sendErrorNotification = true);
 
     void shutdownVideoDecoder_l();
@@ -0,0 +1,91 @@
+/*
+ * Copyright (C) 2012 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FRAME_INDEX_SEEKER_H_
+
+#define FRAME_INDEX_SEEKER_H_
+
+#include "include/MP3Seeker.h"
+
+#include <pthread.h>
+#include <utils/threads.h>
+#include <utils/Vector.h>
+
+namespace android {
+
+struct DataSource;
+
+// Seek table for streams that carry neither a XING nor a VBRI header.
+// On the first seek a background thread starts walking the frame headers
+// in large sequential reads and records the offset of every
+// kFramesPerEntry'th frame, streams that are never seeked in are never
+// indexed. Seeks to a time the index already covers land exactly on a
+// frame boundary, until then getOffsetForTime() fails and the caller
+// falls back to its bitrate estimate.
+struct FrameIndexSeeker : public MP3Seeker {
+    // Returns NULL if the source is not local or its size is unknown,
+    // indexing would then just compete with playback for the network.
+    static sp<FrameIndexSeeker> CreateFromSource(
+            const sp<DataSource> &source,
+            off64_t first_frame_pos, uint32_t fixed_header);
+
+    virtual bool getDuration(int64_t *durationUs);
+    virtual bool getOffsetForTime(int64_t *timeUs, off64_t *pos);
+
+protected:
+    virtual ~FrameIndexSeeker();
+
+private:
+    enum {
+        kFramesPerEntry = 16,
+    };
+
+    sp<DataSource> mSource;
+    off64_t mFirstFramePos;
+    uint32_t mFixedHeader;
+    int32_t mSampleRate;
+    int32_t mSamplesPerFrame;
+
+    Mutex mLock;
+
+    // Frame offsets relative to mFirstFramePos, one per kFramesPerEntry
+    // frames.
+    Vector<uint32_t> mOffsets;
+    int64_t mNumFrames;
+    bool mComplete;
+    bool mAbort;
+
+    pthread_t mThread;
+    bool mThreadStarted;
+
+    FrameIndexSeeker(
+            const sp<DataSource> &source, off64_t first_frame_pos,
+            uint32_t fixed_header,
+            int32_t sample_rate, int32_t samples_per_frame);
+
+    void startIndexing_l();
+
+    int64_t getTimeUsForFrame(int64_t frame) const;
+
+    static void *ThreadWrapper(void *me);
+    void buildIndex();
+
+    DISALLOW_EVIL_CONSTRUCTORS(FrameIndexSeeker);
+};
+
+}  // namespace android
+
+#endif  // FRAME_INDEX_SEEKER_H_
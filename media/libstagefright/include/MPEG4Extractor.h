@@ -40,6 +40,8 @@ public:
 
     virtual sp<MetaData> getMetaData();
 
+    virtual void setLazyParsing(bool lazy);
+
     // for DRM
     virtual char* getDrmTrackInfo(size_t trackID, int *len);
 
@@ -47,6 +49,12 @@ protected:
     virtual ~MPEG4Extractor();
 
 private:
+    struct SampleTableBox {
+        uint32_t type;
+        off64_t data_offset;
+        off64_t data_size;
+    };
+
     struct Track {
         Track *next;
         sp<MetaData> meta;
@@ -54,11 +62,18 @@ private:
         sp<SampleTable> sampleTable;
         bool includes_expensive_metadata;
         bool skipTrack;
+
+        // With lazy parsing the boxes of the sample table are recorded
+        // here and only parsed once "sampleTable" is needed.
+        off64_t stblOffset;
+        off64_t stblSize;
+        Vector<SampleTableBox> sampleTableBoxes;
     };
 
     sp<DataSource> mDataSource;
     status_t mInitCheck;
     bool mHasVideo;
+    bool mLazyParsing;
 
     Track *mFirstTrack, *mLastTrack;
 
@@ -73,6 +88,12 @@ private:
     status_t parseChunk(off64_t *offset, int depth);
     status_t parseMetaData(off64_t offset, size_t size);
 
+    status_t parseSampleTableBox(
+            Track *track, uint32_t type,
+            off64_t data_offset, off64_t data_size);
+
+    status_t loadSampleTables(Track *track);
+
     status_t updateAudioTrackInfoFromESDS_MPEG4Audio(
             const void *esds_data, size_t esds_size);
 
@@ -20,6 +20,7 @@
 
 #include "OMX.h"
 
+#include <utils/List.h>
 #include <utils/RefBase.h>
 #include <utils/threads.h>
 
@@ -86,6 +87,7 @@ struct OMXNodeInstance {
             const char *parameterName, OMX_INDEXTYPE *index);
 
     void onMessage(const omx_message &msg);
+    void onMessages(const List<omx_message> &messages);
     void onObserverDied(OMXMaster *master);
     void onGetHandleFailed();
 
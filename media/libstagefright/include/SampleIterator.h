@@ -29,6 +29,7 @@ struct SampleIterator {
     uint32_t getDescIndex() const { return mChunkDesc; }
     off64_t getSampleOffset() const { return mCurrentSampleOffset; }
     size_t getSampleSize() const { return mCurrentSampleSize; }
+    off64_t getChunkEndOffset() const { return mCurrentChunkEndOffset; }
     uint32_t getSampleTime() const { return mCurrentSampleTime; }
 
     status_t getSampleSizeDirect(
@@ -49,6 +50,7 @@ private:
 
     uint32_t mCurrentChunkIndex;
     off64_t mCurrentChunkOffset;
+    off64_t mCurrentChunkEndOffset;
     Vector<size_t> mCurrentChunkSampleSizes;
 
     uint32_t mTimeToSampleIndex;
@@ -74,15 +74,35 @@ protected:
 
     PortInfo *editPortInfo(OMX_U32 portIndex);
 
+    // Holds back the buffer-done callbacks while a batch of queued buffers
+    // is processed and delivers them together at the end, meant for
+    // components whose buffers are small and cheap to process.
+    void setBatchBufferDone(bool batch);
+
 private:
     enum {
         kWhatSendCommand,
-        kWhatEmptyThisBuffer,
-        kWhatFillThisBuffer,
+        kWhatQueueBuffers,
+    };
+
+    // A buffer handed to us by emptyThisBuffer/fillThisBuffer that the
+    // looper hasn't picked up yet. Buffers queued between two commands
+    // share a generation and are processed by a single message.
+    struct PendingBuffer {
+        OMX_BUFFERHEADERTYPE *mHeader;
+        bool mIsInput;
+        int32_t mGeneration;
     };
 
     Mutex mLock;
 
+    Mutex mPendingLock;
+    List<PendingBuffer> mPendingBuffers;
+    int32_t mPendingGeneration;
+    bool mQueueBuffersPosted;
+
+    bool mBatchBufferDone;
+
     sp<ALooper> mLooper;
     sp<AHandlerReflector<SimpleSoftOMXComponent> > mHandler;
 
@@ -128,6 +148,10 @@ private:
 
     virtual OMX_ERRORTYPE getState(OMX_STATETYPE *state);
 
+    void queueBuffer(OMX_BUFFERHEADERTYPE *header, bool isInput);
+    void onQueueBuffers(int32_t generation);
+    void onQueueBuffer(OMX_BUFFERHEADERTYPE *header, bool isInput);
+
     void onSendCommand(OMX_COMMANDTYPE cmd, OMX_U32 param);
     void onChangeState(OMX_STATETYPE state);
     void onPortEnable(OMX_U32 portIndex, bool enable);
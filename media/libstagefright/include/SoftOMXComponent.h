@@ -21,6 +21,7 @@
 #include <media/stagefright/foundation/ABase.h>
 #include <media/stagefright/foundation/AString.h>
 #include <utils/RefBase.h>
+#include <utils/Vector.h>
 
 #include <OMX_Component.h>
 
@@ -52,6 +53,12 @@ protected:
     void notifyEmptyBufferDone(OMX_BUFFERHEADERTYPE *header);
     void notifyFillBufferDone(OMX_BUFFERHEADERTYPE *header);
 
+    // While deferred, buffer-done notifications are collected and then
+    // delivered back to back by flushBufferDone(), or before the next
+    // event so that their order relative to events is preserved.
+    void deferBufferDone();
+    void flushBufferDone();
+
     virtual OMX_ERRORTYPE sendCommand(
             OMX_COMMANDTYPE cmd, OMX_U32 param, OMX_PTR data);
 
@@ -96,12 +103,20 @@ protected:
     virtual OMX_ERRORTYPE getState(OMX_STATETYPE *state);
 
 private:
+    struct BufferDone {
+        OMX_BUFFERHEADERTYPE *mHeader;
+        bool mIsFill;
+    };
+
     AString mName;
     const OMX_CALLBACKTYPE *mCallbacks;
     OMX_COMPONENTTYPE *mComponent;
 
     void *mLibHandle;
 
+    bool mDeferBufferDone;
+    Vector<BufferDone> mDeferredBufferDone;
+
     static OMX_ERRORTYPE SendCommandWrapper(
             OMX_HANDLETYPE component,
             OMX_COMMANDTYPE cmd,
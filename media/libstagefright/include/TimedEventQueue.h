@@ -20,9 +20,9 @@
 
 #include <pthread.h>
 
-#include <utils/List.h>
 #include <utils/RefBase.h>
 #include <utils/threads.h>
+#include <utils/Vector.h>
 
 namespace android {
 
@@ -32,7 +32,8 @@ struct TimedEventQueue {
 
     struct Event : public RefBase {
         Event()
-            : mEventID(0) {
+            : mEventID(0),
+              mQueueIndex(-1) {
         }
 
         virtual ~Event() {}
@@ -49,6 +50,10 @@ struct TimedEventQueue {
 
         event_id mEventID;
 
+        // Position in the queue's heap while the event is pending, -1
+        // otherwise.
+        ssize_t mQueueIndex;
+
         void setEventID(event_id id) {
             mEventID = id;
         }
@@ -79,6 +84,8 @@ struct TimedEventQueue {
 
     // If the event is to be posted at a time that has already passed,
     // it will fire as soon as possible.
+    // Posting an event that is still pending coalesces the two, the event
+    // keeps its id and fires once, at the earlier of the two times.
     event_id postTimedEvent(const sp<Event> &event, int64_t realtime_us);
 
     // Returns true iff event is currently in the queue and has been
@@ -86,6 +93,9 @@ struct TimedEventQueue {
     // removed from the queue and won't fire.
     bool cancelEvent(event_id id);
 
+    // Same as above, but doesn't need to search the queue for the event.
+    bool cancelEvent(const sp<Event> &event);
+
     // Cancel any pending event that satisfies the predicate.
     // If stopAfterFirstMatch is true, only cancels the first event
     // satisfying the predicate (if any).
@@ -100,6 +110,9 @@ private:
     struct QueueItem {
         sp<Event> event;
         int64_t realtime_us;
+
+        // Orders events posted for the same time by when they were posted.
+        uint64_t sequence;
     };
 
     struct StopEvent : public TimedEventQueue::Event {
@@ -109,7 +122,11 @@ private:
     };
 
     pthread_t mThread;
-    List<QueueItem> mQueue;
+
+    // Binary min-heap on (realtime_us, sequence).
+    Vector<QueueItem> mQueue;
+    uint64_t mNextSequence;
+
     Mutex mLock;
     Condition mQueueNotEmptyCondition;
     Condition mQueueHeadChangedCondition;
@@ -123,6 +140,12 @@ private:
 
     sp<Event> removeEventFromQueue_l(event_id id);
 
+    static bool IsEarlier(const QueueItem &a, const QueueItem &b);
+    void setItem_l(size_t index, const QueueItem &item);
+    void siftUp_l(size_t index);
+    void siftDown_l(size_t index);
+    void removeAt_l(size_t index);
+
     TimedEventQueue(const TimedEventQueue &);
     TimedEventQueue &operator=(const TimedEventQueue &);
 };
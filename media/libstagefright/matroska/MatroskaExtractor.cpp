@@ -33,11 +33,36 @@
 #include <media/stagefright/Utils.h>
 #include <utils/String8.h>
 
+#include <pthread.h>
+#include <sys/prctl.h>
+
 namespace android {
 
+// Reads go through a few buffered windows of the file. A read that misses
+// them pulls in kReadAheadSize bytes, whole clusters are brought in with
+// a single prefetch() so that all tracks read their blocks from memory.
 struct DataSourceReader : public mkvparser::IMkvReader {
     DataSourceReader(const sp<DataSource> &source)
-        : mSource(source) {
+        : mSource(source),
+          mReadAheadEnabled(true),
+          mPrefetchEnabled(true),
+          mHasUncachedThread(false),
+          mAge(0) {
+        for (size_t i = 0; i < kNumWindows; ++i) {
+            Window *window = &mWindows[i];
+            window->mData = NULL;
+            window->mCapacity = 0;
+            window->mPos = 0;
+            window->mSize = 0;
+            window->mLastUsed = 0;
+        }
+    }
+
+    virtual ~DataSourceReader() {
+        for (size_t i = 0; i < kNumWindows; ++i) {
+            delete[] mWindows[i].mData;
+            mWindows[i].mData = NULL;
+        }
     }
 
     virtual int Read(long long position, long length, unsigned char* buffer) {
@@ -48,6 +73,31 @@ struct DataSourceReader : public mkvparser::IMkvReader {
             return 0;
         }
 
+        if (isUncachedThread()) {
+            ssize_t n = mSource->readAt(position, buffer, length);
+            return (n <= 0) ? -1 : 0;
+        }
+
+        Mutex::Autolock autoLock(mLock);
+
+        Window *window = findWindow_l(position, length);
+
+        if (window == NULL
+                && mReadAheadEnabled && (size_t)length < kReadAheadSize) {
+            window = fillWindow_l(position, kReadAheadSize);
+
+            if (window != NULL
+                    && position + length > window->mPos + (off64_t)window->mSize) {
+                // Short read at the end of the file.
+                window = NULL;
+            }
+        }
+
+        if (window != NULL) {
+            memcpy(buffer, window->mData + (position - window->mPos), length);
+            return 0;
+        }
+
         ssize_t n = mSource->readAt(position, buffer, length);
 
         if (n <= 0) {
@@ -77,8 +127,171 @@ struct DataSourceReader : public mkvparser::IMkvReader {
         return 0;
     }
 
+    // Brings [position, position + size) into memory with a single read,
+    // unless it is already there.
+    void prefetch(long long position, long long size) {
+        if (size <= 0) {
+            return;
+        }
+
+        if (size > (long long)kMaxPrefetchSize) {
+            size = kMaxPrefetchSize;
+        }
+
+        Mutex::Autolock autoLock(mLock);
+
+        if (!mReadAheadEnabled || !mPrefetchEnabled
+                || findWindow_l(position, size) != NULL) {
+            return;
+        }
+
+        fillWindow_l(position, size);
+    }
+
+    // Live streams only have so much data available, reading ahead would
+    // block until there's more.
+    void disableReadAhead() {
+        Mutex::Autolock autoLock(mLock);
+        mReadAheadEnabled = false;
+    }
+
+    // A caching source downloads in the background, a whole cluster read
+    // in one go would stall the tracks until all of it has arrived.
+    void disablePrefetch() {
+        Mutex::Autolock autoLock(mLock);
+        mPrefetchEnabled = false;
+    }
+
+    // Reads from the calling thread go straight to the source, so that
+    // scattered reads (the Cues) don't evict the tracks' windows.
+    void setUncachedThread() {
+        Mutex::Autolock autoLock(mLock);
+        mUncachedThread = pthread_self();
+        mHasUncachedThread = true;
+    }
+
+    void clearUncachedThread() {
+        Mutex::Autolock autoLock(mLock);
+        mHasUncachedThread = false;
+    }
+
 private:
+    enum {
+        // Enough for the clusters of the tracks being played, which can be
+        // some distance apart, plus whatever else is parsed meanwhile.
+        kNumWindows = 3,
+    };
+
+    static const size_t kReadAheadSize = 64 * 1024;
+    static const size_t kMaxPrefetchSize = 8 * 1024 * 1024;
+
+    // Bound on the memory held by all windows together, room for one
+    // maximum size prefetch and a few smaller ones.
+    static const size_t kMaxBufferedSize = 12 * 1024 * 1024;
+
+    struct Window {
+        uint8_t *mData;
+        size_t mCapacity;
+        off64_t mPos;
+        size_t mSize;
+        uint32_t mLastUsed;
+    };
+
+    Mutex mLock;
     sp<DataSource> mSource;
+    bool mReadAheadEnabled;
+    bool mPrefetchEnabled;
+    bool mHasUncachedThread;
+    pthread_t mUncachedThread;
+    Window mWindows[kNumWindows];
+    uint32_t mAge;
+
+    bool isUncachedThread() {
+        Mutex::Autolock autoLock(mLock);
+        return mHasUncachedThread
+            && pthread_equal(pthread_self(), mUncachedThread);
+    }
+
+    Window *findWindow_l(long long position, long long size) {
+        for (size_t i = 0; i < kNumWindows; ++i) {
+            Window *window = &mWindows[i];
+
+            if (position >= window->mPos
+                    && position + size <= window->mPos + (off64_t)window->mSize) {
+                window->mLastUsed = ++mAge;
+                return window;
+            }
+        }
+
+        return NULL;
+    }
+
+    Window *fillWindow_l(long long position, size_t size) {
+        Window *window = &mWindows[0];
+        for (size_t i = 1; i < kNumWindows; ++i) {
+            if (mWindows[i].mLastUsed < window->mLastUsed) {
+                window = &mWindows[i];
+            }
+        }
+
+        // Don't keep a large prefetch buffer around for small reads.
+        if (window->mCapacity < size || window->mCapacity > 2 * size) {
+            releaseWindow_l(window);
+        }
+
+        // Make room by dropping the other windows, least recently used
+        // first, if this one would take the total over the bound.
+        size_t buffered = size;
+        for (size_t i = 0; i < kNumWindows; ++i) {
+            if (&mWindows[i] != window) {
+                buffered += mWindows[i].mCapacity;
+            }
+        }
+
+        while (buffered > kMaxBufferedSize) {
+            Window *oldest = NULL;
+            for (size_t i = 0; i < kNumWindows; ++i) {
+                Window *other = &mWindows[i];
+                if (other != window && other->mCapacity > 0
+                        && (oldest == NULL
+                            || other->mLastUsed < oldest->mLastUsed)) {
+                    oldest = other;
+                }
+            }
+
+            if (oldest == NULL) {
+                break;
+            }
+
+            buffered -= oldest->mCapacity;
+            releaseWindow_l(oldest);
+        }
+
+        if (window->mData == NULL) {
+            window->mData = new uint8_t[size];
+            window->mCapacity = size;
+        }
+
+        ssize_t n = mSource->readAt(position, window->mData, size);
+
+        if (n <= 0) {
+            window->mSize = 0;
+            return NULL;
+        }
+
+        window->mPos = position;
+        window->mSize = n;
+        window->mLastUsed = ++mAge;
+
+        return window;
+    }
+
+    void releaseWindow_l(Window *window) {
+        delete[] window->mData;
+        window->mData = NULL;
+        window->mCapacity = 0;
+        window->mSize = 0;
+    }
 
     DataSourceReader(const DataSourceReader &);
     DataSourceReader &operator=(const DataSourceReader &);
@@ -110,6 +323,7 @@ private:
     long mBlockEntryIndex;
 
     void advance_l();
+    void prefetchCluster_l();
 
     BlockIterator(const BlockIterator &);
     BlockIterator &operator=(const BlockIterator &);
@@ -275,6 +489,7 @@ void BlockIterator::advance_l() {
             CHECK(!nextCluster->EOS());
 
             mCluster = nextCluster;
+            prefetchCluster_l();
 
             res = mCluster->Parse(pos, len);
             ALOGV("Parse (2) returned %ld", res);
@@ -294,12 +509,24 @@ void BlockIterator::advance_l() {
     }
 }
 
+void BlockIterator::prefetchCluster_l() {
+    if (mCluster == NULL || mCluster->EOS()) {
+        return;
+    }
+
+    // The size is unknown (negative) for clusters that haven't been
+    // parsed yet and don't specify it.
+    mExtractor->mReader->prefetch(
+            mCluster->m_element_start, mCluster->GetElementSize());
+}
+
 void BlockIterator::reset() {
     Mutex::Autolock autoLock(mExtractor->mLock);
 
     mCluster = mExtractor->mSegment->GetFirst();
     mBlockEntry = NULL;
     mBlockEntryIndex = 0;
+    prefetchCluster_l();
 
     do {
         advance_l();
@@ -323,6 +550,7 @@ void BlockIterator::seek(
         ALOGV("Seek to beginning: %lld", seekTimeUs);
         mCluster = pSegment->GetFirst();
         mBlockEntryIndex = 0;
+        prefetchCluster_l();
         do {
             advance_l();
         } while (!eos() && block()->GetTrackNumber() != mTrackNum);
@@ -331,33 +559,10 @@ void BlockIterator::seek(
 
     ALOGV("Seeking to: %lld", seekTimeUs);
 
-    // If the Cues have not been located then find them.
-    const mkvparser::Cues* pCues = pSegment->GetCues();
-    const mkvparser::SeekHead* pSH = pSegment->GetSeekHead();
-    if (!pCues && pSH) {
-        const size_t count = pSH->GetCount();
-        const mkvparser::SeekHead::Entry* pEntry;
-        ALOGV("No Cues yet");
-
-        for (size_t index = 0; index < count; index++) {
-            pEntry = pSH->GetEntry(index);
-
-            if (pEntry->id == 0x0C53BB6B) { // Cues ID
-                long len; long long pos;
-                pSegment->ParseCues(pEntry->pos, pos, len);
-                pCues = pSegment->GetCues();
-                ALOGV("Cues found");
-                break;
-            }
-        }
-
-        if (!pCues) {
-            ALOGE("No Cues in file");
-            return;
-        }
-    }
-    else if (!pSH) {
-        ALOGE("No SeekHead");
+    // The Cues are usually loaded in the background by now, if not
+    // load as many as we need.
+    const mkvparser::Cues* pCues = mExtractor->findCues_l();
+    if (!pCues) {
         return;
     }
 
@@ -397,6 +602,8 @@ void BlockIterator::seek(
     CHECK(mCluster);
     CHECK(!mCluster->EOS());
 
+    prefetchCluster_l();
+
     // mBlockEntryIndex starts at 0 but m_block starts at 1
     CHECK_GT(pTP->m_block, 0);
     mBlockEntryIndex = pTP->m_block - 1;
@@ -628,7 +835,9 @@ MatroskaExtractor::MatroskaExtractor(const sp<DataSource> &source)
       mReader(new DataSourceReader(mDataSource)),
       mSegment(NULL),
       mExtractedThumbnails(false),
-      mIsWebm(false) {
+      mIsWebm(false),
+      mCuesThreadStarted(false),
+      mAbortCues(false) {
     off64_t size;
     mIsLiveStreaming =
         (mDataSource->flags()
@@ -636,6 +845,12 @@ MatroskaExtractor::MatroskaExtractor(const sp<DataSource> &source)
                 | DataSource::kIsCachingDataSource))
         && mDataSource->getSize(&size) != OK;
 
+    if (mIsLiveStreaming) {
+        mReader->disableReadAhead();
+    } else if (mDataSource->flags() & DataSource::kIsCachingDataSource) {
+        mReader->disablePrefetch();
+    }
+
     mkvparser::EBMLHeader ebmlHeader;
     long long pos;
     if (ebmlHeader.Parse(mReader, pos) < 0) {
@@ -678,6 +893,16 @@ MatroskaExtractor::MatroskaExtractor(const sp<DataSource> &source)
 }
 
 MatroskaExtractor::~MatroskaExtractor() {
+    if (mCuesThreadStarted) {
+        {
+            Mutex::Autolock autoLock(mLock);
+            mAbortCues = true;
+        }
+
+        void *dummy;
+        pthread_join(mCuesThread, &dummy);
+    }
+
     delete mSegment;
     mSegment = NULL;
 
@@ -694,9 +919,106 @@ sp<MediaSource> MatroskaExtractor::getTrack(size_t index) {
         return NULL;
     }
 
+    startLoadingCues();
+
     return new MatroskaSource(this, index);
 }
 
+const mkvparser::Cues *MatroskaExtractor::findCues_l() {
+    // If the Cues have not been located then find them.
+    const mkvparser::Cues* pCues = mSegment->GetCues();
+    const mkvparser::SeekHead* pSH = mSegment->GetSeekHead();
+    if (!pCues && pSH) {
+        const size_t count = pSH->GetCount();
+        const mkvparser::SeekHead::Entry* pEntry;
+        ALOGV("No Cues yet");
+
+        for (size_t index = 0; index < count; index++) {
+            pEntry = pSH->GetEntry(index);
+
+            if (pEntry->id == 0x0C53BB6B) { // Cues ID
+                long len; long long pos;
+                mSegment->ParseCues(pEntry->pos, pos, len);
+                pCues = mSegment->GetCues();
+                ALOGV("Cues found");
+                break;
+            }
+        }
+
+        if (!pCues) {
+            ALOGE("No Cues in file");
+        }
+    }
+    else if (!pSH) {
+        ALOGE("No SeekHead");
+        return NULL;
+    }
+
+    return pCues;
+}
+
+void MatroskaExtractor::startLoadingCues() {
+    Mutex::Autolock autoLock(mLock);
+
+    // Over a caching source, reading the Cues from wherever they are in
+    // the file would move the cache away from the playback position,
+    // leave it to the first seek.
+    if (mCuesThreadStarted || mSegment == NULL || isLiveStreaming()
+            || (mDataSource->flags() & DataSource::kIsCachingDataSource)) {
+        return;
+    }
+
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_JOINABLE);
+
+    mCuesThreadStarted =
+        pthread_create(&mCuesThread, &attr, CuesThreadWrapper, this) == 0;
+
+    pthread_attr_destroy(&attr);
+}
+
+// static
+void *MatroskaExtractor::CuesThreadWrapper(void *me) {
+    androidSetThreadPriority(0, ANDROID_PRIORITY_BACKGROUND);
+
+    static_cast<MatroskaExtractor *>(me)->loadCues();
+
+    return NULL;
+}
+
+void MatroskaExtractor::loadCues() {
+    prctl(PR_SET_NAME, (unsigned long)"MatroskaCues", 0, 0, 0);
+
+    const mkvparser::Cues *cues;
+    {
+        Mutex::Autolock autoLock(mLock);
+        cues = findCues_l();
+    }
+
+    if (cues == NULL) {
+        return;
+    }
+
+    mReader->setUncachedThread();
+
+    // One cue point at a time, the sources take the same lock to read
+    // and seek.
+    for (;;) {
+        Mutex::Autolock autoLock(mLock);
+
+        if (mAbortCues || cues->DoneParsing()) {
+            break;
+        }
+
+        cues->LoadCuePoint();
+    }
+
+    mReader->clearUncachedThread();
+
+    ALOGV("Cues loaded");
+}
+
 sp<MetaData> MatroskaExtractor::getTrackMetaData(
         size_t index, uint32_t flags) {
     if (index >= mTracks.size()) {
@@ -22,7 +22,10 @@
 #include <utils/Vector.h>
 #include <utils/threads.h>
 
+#include <pthread.h>
+
 namespace mkvparser {
+struct Cues;
 struct Segment;
 };
 
@@ -70,9 +73,21 @@ private:
     bool mIsLiveStreaming;
     bool mIsWebm;
 
+    // Cues are loaded in the background once a track is requested, so
+    // that the first seek doesn't have to.
+    pthread_t mCuesThread;
+    bool mCuesThreadStarted;
+    bool mAbortCues;
+
     void addTracks();
     void findThumbnails();
 
+    const mkvparser::Cues *findCues_l();
+
+    void startLoadingCues();
+    static void *CuesThreadWrapper(void *me);
+    void loadCues();
+
     bool isLiveStreaming() const;
 
     MatroskaExtractor(const MatroskaExtractor &);
@@ -75,7 +75,7 @@ private:
 
     sp<CallbackDispatcherThread> mThread;
 
-    void dispatch(const omx_message &msg);
+    void dispatch(const List<omx_message> &messages);
 
     CallbackDispatcher(const CallbackDispatcher &);
     CallbackDispatcher &operator=(const CallbackDispatcher &);
@@ -113,17 +113,17 @@ void OMX::CallbackDispatcher::post(const omx_message &msg) {
     mQueueChanged.signal();
 }
 
-void OMX::CallbackDispatcher::dispatch(const omx_message &msg) {
+void OMX::CallbackDispatcher::dispatch(const List<omx_message> &messages) {
     if (mOwner == NULL) {
         ALOGV("Would have dispatched a message to a node that's already gone.");
         return;
     }
-    mOwner->onMessage(msg);
+    mOwner->onMessages(messages);
 }
 
 bool OMX::CallbackDispatcher::loop() {
     for (;;) {
-        omx_message msg;
+        List<omx_message> messages;
 
         {
             Mutex::Autolock autoLock(mLock);
@@ -135,11 +135,17 @@ bool OMX::CallbackDispatcher::loop() {
                 break;
             }
 
-            msg = *mQueue.begin();
-            mQueue.erase(mQueue.begin());
+            // Hand everything that accumulated to the observer at once,
+            // so a burst of buffer callbacks costs a single transaction.
+            // Only this direction is batched: emptyBuffer/fillBuffer are
+            // still one transaction per buffer, and buffers allocated
+            // with a backup are still copied by BufferMeta, there is no
+            // shared ring or zero-copy mapping of the client's heap.
+            messages = mQueue;
+            mQueue.clear();
         }
 
-        dispatch(msg);
+        dispatch(messages);
     }
 
     return false;
@@ -656,7 +656,7 @@ status_t OMXNodeInstance::getExtensionIndex(
     return StatusFromOMXError(err);
 }
 
-void OMXNodeInstance::onMessage(const omx_message &msg) {
+static void copyFromOMXIfFilled(const omx_message &msg) {
     if (msg.type == omx_message::FILL_BUFFER_DONE) {
         OMX_BUFFERHEADERTYPE *buffer =
             static_cast<OMX_BUFFERHEADERTYPE *>(
@@ -667,10 +667,27 @@ void OMXNodeInstance::onMessage(const omx_message &msg) {
 
         buffer_meta->CopyFromOMX(buffer);
     }
+}
+
+void OMXNodeInstance::onMessage(const omx_message &msg) {
+    copyFromOMXIfFilled(msg);
 
     mObserver->onMessage(msg);
 }
 
+void OMXNodeInstance::onMessages(const List<omx_message> &messages) {
+    for (List<omx_message>::const_iterator it = messages.begin();
+         it != messages.end(); ++it) {
+        copyFromOMXIfFilled(*it);
+    }
+
+    if (messages.size() == 1) {
+        mObserver->onMessage(*messages.begin());
+    } else {
+        mObserver->onMessages(messages);
+    }
+}
+
 void OMXNodeInstance::onObserverDied(OMXMaster *master) {
     ALOGE("!!! Observer died. Quickly, do something, ... anything...");
 
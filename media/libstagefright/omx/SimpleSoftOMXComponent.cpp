@@ -32,6 +32,9 @@ SimpleSoftOMXComponent::SimpleSoftOMXComponent(
         OMX_PTR appData,
         OMX_COMPONENTTYPE **component)
     : SoftOMXComponent(name, callbacks, appData, component),
+      mPendingGeneration(0),
+      mQueueBuffersPosted(false),
+      mBatchBufferDone(false),
       mLooper(new ALooper),
       mHandler(new AHandlerReflector<SimpleSoftOMXComponent>(this)),
       mState(OMX_StateLoaded),
@@ -58,6 +61,12 @@ OMX_ERRORTYPE SimpleSoftOMXComponent::sendCommand(
         OMX_COMMANDTYPE cmd, OMX_U32 param, OMX_PTR data) {
     CHECK(data == NULL);
 
+    // Buffers queued after this command must not be picked up before
+    // it is processed, start a new batch for them.
+    Mutex::Autolock autoLock(mPendingLock);
+    ++mPendingGeneration;
+    mQueueBuffersPosted = false;
+
     sp<AMessage> msg = new AMessage(kWhatSendCommand, mHandler->id());
     msg->setInt32("cmd", cmd);
     msg->setInt32("param", param);
@@ -307,22 +316,39 @@ OMX_ERRORTYPE SimpleSoftOMXComponent::freeBuffer(
 
 OMX_ERRORTYPE SimpleSoftOMXComponent::emptyThisBuffer(
         OMX_BUFFERHEADERTYPE *buffer) {
-    sp<AMessage> msg = new AMessage(kWhatEmptyThisBuffer, mHandler->id());
-    msg->setPointer("header", buffer);
-    msg->post();
+    queueBuffer(buffer, true /* isInput */);
 
     return OMX_ErrorNone;
 }
 
 OMX_ERRORTYPE SimpleSoftOMXComponent::fillThisBuffer(
         OMX_BUFFERHEADERTYPE *buffer) {
-    sp<AMessage> msg = new AMessage(kWhatFillThisBuffer, mHandler->id());
-    msg->setPointer("header", buffer);
-    msg->post();
+    queueBuffer(buffer, false /* isInput */);
 
     return OMX_ErrorNone;
 }
 
+void SimpleSoftOMXComponent::queueBuffer(
+        OMX_BUFFERHEADERTYPE *header, bool isInput) {
+    Mutex::Autolock autoLock(mPendingLock);
+
+    PendingBuffer pending;
+    pending.mHeader = header;
+    pending.mIsInput = isInput;
+    pending.mGeneration = mPendingGeneration;
+    mPendingBuffers.push_back(pending);
+
+    // Buffers arriving while the looper is busy ride along with the
+    // message already posted instead of posting one each.
+    if (!mQueueBuffersPosted) {
+        sp<AMessage> msg = new AMessage(kWhatQueueBuffers, mHandler->id());
+        msg->setInt32("generation", mPendingGeneration);
+        msg->post();
+
+        mQueueBuffersPosted = true;
+    }
+}
+
 OMX_ERRORTYPE SimpleSoftOMXComponent::getState(OMX_STATETYPE *state) {
     Mutex::Autolock autoLock(mLock);
 
@@ -346,47 +372,83 @@ void SimpleSoftOMXComponent::onMessageReceived(const sp<AMessage> &msg) {
             break;
         }
 
-        case kWhatEmptyThisBuffer:
-        case kWhatFillThisBuffer:
+        case kWhatQueueBuffers:
         {
-            OMX_BUFFERHEADERTYPE *header;
-            CHECK(msg->findPointer("header", (void **)&header));
+            int32_t generation;
+            CHECK(msg->findInt32("generation", &generation));
 
-            CHECK(mState == OMX_StateExecuting && mTargetState == mState);
+            onQueueBuffers(generation);
+            break;
+        }
 
-            bool found = false;
-            size_t portIndex = (kWhatEmptyThisBuffer == msgType)?
-                    header->nInputPortIndex: header->nOutputPortIndex;
-            PortInfo *port = &mPorts.editItemAt(portIndex);
+        default:
+            TRESPASS();
+            break;
+    }
+}
 
-            for (size_t j = 0; j < port->mBuffers.size(); ++j) {
-                BufferInfo *buffer = &port->mBuffers.editItemAt(j);
+void SimpleSoftOMXComponent::onQueueBuffers(int32_t generation) {
+    List<PendingBuffer> buffers;
 
-                if (buffer->mHeader == header) {
-                    CHECK(!buffer->mOwnedByUs);
+    {
+        Mutex::Autolock autoLock(mPendingLock);
 
-                    buffer->mOwnedByUs = true;
+        while (!mPendingBuffers.empty()
+                && (*mPendingBuffers.begin()).mGeneration <= generation) {
+            buffers.push_back(*mPendingBuffers.begin());
+            mPendingBuffers.erase(mPendingBuffers.begin());
+        }
 
-                    CHECK((msgType == kWhatEmptyThisBuffer
-                            && port->mDef.eDir == OMX_DirInput)
-                            || (port->mDef.eDir == OMX_DirOutput));
+        if (generation == mPendingGeneration) {
+            mQueueBuffersPosted = false;
+        }
+    }
 
-                    port->mQueue.push_back(buffer);
-                    onQueueFilled(portIndex);
+    if (mBatchBufferDone) {
+        deferBufferDone();
+    }
 
-                    found = true;
-                    break;
-                }
-            }
+    // The buffers are handed to the component in the order they were
+    // queued, exactly as if each had arrived in a message of its own.
+    for (List<PendingBuffer>::iterator it = buffers.begin();
+         it != buffers.end(); ++it) {
+        onQueueBuffer((*it).mHeader, (*it).mIsInput);
+    }
 
-            CHECK(found);
-            break;
-        }
+    if (mBatchBufferDone) {
+        flushBufferDone();
+    }
+}
 
-        default:
-            TRESPASS();
+void SimpleSoftOMXComponent::onQueueBuffer(
+        OMX_BUFFERHEADERTYPE *header, bool isInput) {
+    CHECK(mState == OMX_StateExecuting && mTargetState == mState);
+
+    bool found = false;
+    size_t portIndex = isInput ?
+            header->nInputPortIndex: header->nOutputPortIndex;
+    PortInfo *port = &mPorts.editItemAt(portIndex);
+
+    for (size_t j = 0; j < port->mBuffers.size(); ++j) {
+        BufferInfo *buffer = &port->mBuffers.editItemAt(j);
+
+        if (buffer->mHeader == header) {
+            CHECK(!buffer->mOwnedByUs);
+
+            buffer->mOwnedByUs = true;
+
+            CHECK((isInput && port->mDef.eDir == OMX_DirInput)
+                    || (port->mDef.eDir == OMX_DirOutput));
+
+            port->mQueue.push_back(buffer);
+            onQueueFilled(portIndex);
+
+            found = true;
             break;
+        }
     }
+
+    CHECK(found);
 }
 
 void SimpleSoftOMXComponent::onSendCommand(
@@ -623,6 +685,10 @@ void SimpleSoftOMXComponent::addPort(const OMX_PARAM_PORTDEFINITIONTYPE &def) {
 void SimpleSoftOMXComponent::onQueueFilled(OMX_U32 portIndex) {
 }
 
+void SimpleSoftOMXComponent::setBatchBufferDone(bool batch) {
+    mBatchBufferDone = batch;
+}
+
 void SimpleSoftOMXComponent::onPortFlushCompleted(OMX_U32 portIndex) {
 }
 
@@ -32,7 +32,8 @@ SoftOMXComponent::SoftOMXComponent(
     : mName(name),
       mCallbacks(callbacks),
       mComponent(new OMX_COMPONENTTYPE),
-      mLibHandle(NULL) {
+      mLibHandle(NULL),
+      mDeferBufferDone(false) {
     mComponent->nSize = sizeof(*mComponent);
     mComponent->nVersion.s.nVersionMajor = 1;
     mComponent->nVersion.s.nVersionMinor = 0;
@@ -88,6 +89,11 @@ const char *SoftOMXComponent::name() const {
 void SoftOMXComponent::notify(
         OMX_EVENTTYPE event,
         OMX_U32 data1, OMX_U32 data2, OMX_PTR data) {
+    if (!mDeferredBufferDone.empty()) {
+        flushBufferDone();
+        mDeferBufferDone = true;
+    }
+
     (*mCallbacks->EventHandler)(
             mComponent,
             mComponent->pApplicationPrivate,
@@ -98,15 +104,51 @@ void SoftOMXComponent::notify(
 }
 
 void SoftOMXComponent::notifyEmptyBufferDone(OMX_BUFFERHEADERTYPE *header) {
+    if (mDeferBufferDone) {
+        BufferDone done;
+        done.mHeader = header;
+        done.mIsFill = false;
+        mDeferredBufferDone.push(done);
+        return;
+    }
+
     (*mCallbacks->EmptyBufferDone)(
             mComponent, mComponent->pApplicationPrivate, header);
 }
 
 void SoftOMXComponent::notifyFillBufferDone(OMX_BUFFERHEADERTYPE *header) {
+    if (mDeferBufferDone) {
+        BufferDone done;
+        done.mHeader = header;
+        done.mIsFill = true;
+        mDeferredBufferDone.push(done);
+        return;
+    }
+
     (*mCallbacks->FillBufferDone)(
             mComponent, mComponent->pApplicationPrivate, header);
 }
 
+void SoftOMXComponent::deferBufferDone() {
+    mDeferBufferDone = true;
+}
+
+void SoftOMXComponent::flushBufferDone() {
+    mDeferBufferDone = false;
+
+    for (size_t i = 0; i < mDeferredBufferDone.size(); ++i) {
+        const BufferDone &done = mDeferredBufferDone.itemAt(i);
+
+        if (done.mIsFill) {
+            notifyFillBufferDone(done.mHeader);
+        } else {
+            notifyEmptyBufferDone(done.mHeader);
+        }
+    }
+
+    mDeferredBufferDone.clear();
+}
+
 // static
 OMX_ERRORTYPE SoftOMXComponent::SendCommandWrapper(
         OMX_HANDLETYPE component,
@@ -42,7 +42,8 @@
 namespace android {
 
 Harness::Harness()
-    : mInitCheck(NO_INIT) {
+    : mInitCheck(NO_INIT),
+      mMeasureThroughput(false) {
     mInitCheck = initOMX();
 }
 
@@ -735,11 +736,106 @@ status_t Harness::testSeek(
     return OK;
 }
 
+status_t Harness::testThroughput(
+        const char *componentName, const char *componentRole) {
+    bool isEncoder =
+        !strncmp(componentRole, "audio_encoder.", 14)
+        || !strncmp(componentRole, "video_encoder.", 14);
+
+    if (isEncoder) {
+        printf("  * Not measuring throughput of encoders.\n");
+        return OK;
+    }
+
+    const char *mime = GetMimeFromComponentRole(componentRole);
+
+    if (!mime) {
+        printf("  * Cannot measure throughput with this componentRole (%s)\n",
+               componentRole);
+
+        return OK;
+    }
+
+    sp<MediaSource> source = CreateSourceForMime(mime);
+
+    if (source == NULL) {
+        printf("  * Unable to open test content for type '%s', "
+               "skipping test of componentRole %s\n",
+               mime, componentRole);
+
+        return OK;
+    }
+
+    sp<MediaSource> codec = OMXCodec::Create(
+            mOMX, source->getFormat(), false /* createEncoder */,
+            source, componentName);
+
+    CHECK(codec != NULL);
+
+    CHECK_EQ(codec->start(), (status_t)OK);
+
+    // The clock runs from the first buffer on, so that component setup
+    // is not counted.
+    int64_t startUs = -1;
+    int64_t numBuffers = 0;
+    int64_t numBytes = 0;
+
+    status_t err;
+    for (;;) {
+        MediaBuffer *buffer;
+        err = codec->read(&buffer);
+
+        if (err == INFO_FORMAT_CHANGED) {
+            CHECK(buffer == NULL);
+            continue;
+        }
+
+        if (err != OK) {
+            CHECK(buffer == NULL);
+            break;
+        }
+
+        if (startUs < 0) {
+            startUs = ALooper::GetNowUs();
+        } else {
+            ++numBuffers;
+            numBytes += buffer->range_length();
+        }
+
+        buffer->release();
+        buffer = NULL;
+    }
+
+    int64_t elapsedUs = ALooper::GetNowUs() - startUs;
+
+    CHECK_EQ(codec->stop(), (status_t)OK);
+
+    EXPECT(err == ERROR_END_OF_STREAM,
+           "Expected ERROR_END_OF_STREAM at the end of the content.");
+
+    if (numBuffers > 0) {
+        printf("\n  * %lld buffers (%lld bytes) in %lld us, "
+               "%.1f us per buffer\n",
+               numBuffers, numBytes, elapsedUs,
+               (double)elapsedUs / numBuffers);
+    }
+
+    return OK;
+}
+
+void Harness::setMeasureThroughput(bool measure) {
+    mMeasureThroughput = measure;
+}
+
 status_t Harness::test(
         const char *componentName, const char *componentRole) {
     printf("testing %s [%s] ... ", componentName, componentRole);
     ALOGI("testing %s [%s].", componentName, componentRole);
 
+    if (mMeasureThroughput) {
+        return testThroughput(componentName, componentRole);
+    }
+
     status_t err1 = testStateTransitions(componentName, componentRole);
     status_t err2 = testSeek(componentName, componentRole);
 
@@ -785,6 +881,8 @@ static void usage(const char *me) {
     fprintf(stderr, "usage: %s\n"
                     "  -h(elp)  Show this information\n"
                     "  -s(eed)  Set the random seed\n"
+                    "  -t(hroughput)  Measure the decoding cost per buffer "
+                    "instead of testing conformance\n"
                     "    [ component role ]\n\n"
                     "When launched without specifying a specific component "
                     "and role, tool will test all available OMX components "
@@ -805,9 +903,10 @@ int main(int argc, char **argv) {
     const char *me = argv[0];
 
     unsigned long seed = 0xdeadbeef;
+    bool measureThroughput = false;
 
     int res;
-    while ((res = getopt(argc, argv, "hs:")) >= 0) {
+    while ((res = getopt(argc, argv, "hs:t")) >= 0) {
         switch (res) {
             case 's':
             {
@@ -823,6 +922,12 @@ int main(int argc, char **argv) {
                 break;
             }
 
+            case 't':
+            {
+                measureThroughput = true;
+                break;
+            }
+
             case '?':
                 fprintf(stderr, "\n");
                 // fall through
@@ -848,6 +953,8 @@ int main(int argc, char **argv) {
     sp<Harness> h = new Harness;
     CHECK_EQ(h->initCheck(), (status_t)OK);
 
+    h->setMeasureThroughput(measureThroughput);
+
     if (argc == 0) {
         h->testAll();
     } else if (argc == 2) {
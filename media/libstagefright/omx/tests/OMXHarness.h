@@ -69,11 +69,18 @@ struct Harness : public BnOMXObserver {
     status_t testSeek(
             const char *componentName, const char *componentRole);
 
+    status_t testThroughput(
+            const char *componentName, const char *componentRole);
+
     status_t test(
             const char *componentName, const char *componentRole);
 
     status_t testAll();
 
+    // When set, test() measures the decoding cost per buffer instead of
+    // running the conformance tests.
+    void setMeasureThroughput(bool measure);
+
     virtual void onMessage(const omx_message &msg);
 
 protected:
@@ -85,6 +92,7 @@ private:
     Mutex mLock;
 
     status_t mInitCheck;
+    bool mMeasureThroughput;
     sp<IOMX> mOMX;
     List<omx_message> mMessageQueue;
     Condition mMessageAddedCondition;
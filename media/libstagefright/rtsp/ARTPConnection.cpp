@@ -31,12 +31,46 @@
 #include <media/stagefright/foundation/hexdump.h>
 
 #include <arpa/inet.h>
+#include <sys/epoll.h>
 #include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
 
 namespace android {
 
 static const size_t kMaxUDPSize = 1500;
 
+// Datagrams larger than the MTU are rare, the buffer size is only raised
+// to this once we've actually seen one truncated.
+static const size_t kMaxDatagramSize = 65536;
+
+// Number of datagrams received per recvmmsg call.
+static const size_t kMaxPacketBatch = 16;
+
+static const size_t kMaxBufferPoolSize = 64;
+
+static const size_t kMaxEpollEvents = 16;
+
+// Layout-compatible with the kernel's struct mmsghdr, which is not declared
+// by every C library we build against.
+struct MMsgHdr {
+    struct msghdr msg_hdr;
+    unsigned int msg_len;
+};
+
+static ssize_t receivePackets(int s, MMsgHdr *msgs, size_t count) {
+#if defined(__NR_recvmmsg)
+    return syscall(__NR_recvmmsg, s, msgs, count, MSG_DONTWAIT, NULL);
+#else
+    ssize_t n = recvmsg(s, &msgs[0].msg_hdr, MSG_DONTWAIT);
+    if (n < 0) {
+        return n;
+    }
+    msgs[0].msg_len = n;
+    return 1;
+#endif
+}
+
 static uint16_t u16at(const uint8_t *data) {
     return data[0] << 8 | data[1];
 }
@@ -69,11 +103,17 @@ struct ARTPConnection::StreamInfo {
 
 ARTPConnection::ARTPConnection(uint32_t flags)
     : mFlags(flags),
+      mEpollFd(-1),
+      mBufferSize(kMaxUDPSize),
       mPollEventPending(false),
       mLastReceiverReportTimeUs(-1) {
 }
 
 ARTPConnection::~ARTPConnection() {
+    if (mEpollFd >= 0) {
+        close(mEpollFd);
+        mEpollFd = -1;
+    }
 }
 
 void ARTPConnection::addStream(
@@ -205,6 +245,21 @@ void ARTPConnection::onAddStream(const sp<AMessage> &msg) {
     memset(&info->mRemoteRTCPAddr, 0, sizeof(info->mRemoteRTCPAddr));
 
     if (!injected) {
+        if (mEpollFd < 0) {
+            mEpollFd = epoll_create(kMaxEpollEvents);
+            CHECK_GE(mEpollFd, 0);
+        }
+
+        struct epoll_event ev;
+        memset(&ev, 0, sizeof(ev));
+        ev.events = EPOLLIN;
+
+        ev.data.fd = info->mRTPSocket;
+        CHECK_EQ(epoll_ctl(mEpollFd, EPOLL_CTL_ADD, info->mRTPSocket, &ev), 0);
+
+        ev.data.fd = info->mRTCPSocket;
+        CHECK_EQ(epoll_ctl(mEpollFd, EPOLL_CTL_ADD, info->mRTCPSocket, &ev), 0);
+
         postPollEvent();
     }
 }
@@ -224,7 +279,17 @@ void ARTPConnection::onRemoveStream(const sp<AMessage> &msg) {
         return;
     }
 
-    mStreams.erase(it);
+    eraseStream(it);
+}
+
+List<ARTPConnection::StreamInfo>::iterator ARTPConnection::eraseStream(
+        List<StreamInfo>::iterator it) {
+    if (!it->mIsInjected) {
+        epoll_ctl(mEpollFd, EPOLL_CTL_DEL, it->mRTPSocket, NULL);
+        epoll_ctl(mEpollFd, EPOLL_CTL_DEL, it->mRTCPSocket, NULL);
+    }
+
+    return mStreams.erase(it);
 }
 
 void ARTPConnection::postPollEvent() {
@@ -245,62 +310,44 @@ void ARTPConnection::onPollStreams() {
         return;
     }
 
-    struct timeval tv;
-    tv.tv_sec = 0;
-    tv.tv_usec = kSelectTimeoutUs;
-
-    fd_set rs;
-    FD_ZERO(&rs);
-
-    int maxSocket = -1;
+    bool hasSockets = false;
     for (List<StreamInfo>::iterator it = mStreams.begin();
          it != mStreams.end(); ++it) {
-        if ((*it).mIsInjected) {
-            continue;
-        }
-
-        FD_SET(it->mRTPSocket, &rs);
-        FD_SET(it->mRTCPSocket, &rs);
-
-        if (it->mRTPSocket > maxSocket) {
-            maxSocket = it->mRTPSocket;
-        }
-        if (it->mRTCPSocket > maxSocket) {
-            maxSocket = it->mRTCPSocket;
+        if (!(*it).mIsInjected) {
+            hasSockets = true;
+            break;
         }
     }
 
-    if (maxSocket == -1) {
+    if (!hasSockets) {
         return;
     }
 
-    int res = select(maxSocket + 1, &rs, NULL, NULL, &tv);
+    struct epoll_event events[kMaxEpollEvents];
+    int res = epoll_wait(
+            mEpollFd, events, kMaxEpollEvents, kSelectTimeoutUs / 1000ll);
+
+    for (int i = 0; i < res; ++i) {
+        int fd = events[i].data.fd;
 
-    if (res > 0) {
         List<StreamInfo>::iterator it = mStreams.begin();
-        while (it != mStreams.end()) {
-            if ((*it).mIsInjected) {
-                ++it;
-                continue;
-            }
+        while (it != mStreams.end()
+                && (it->mIsInjected
+                    || (it->mRTPSocket != fd && it->mRTCPSocket != fd))) {
+            ++it;
+        }
 
-            status_t err = OK;
-            if (FD_ISSET(it->mRTPSocket, &rs)) {
-                err = receive(&*it, true);
-            }
-            if (err == OK && FD_ISSET(it->mRTCPSocket, &rs)) {
-                err = receive(&*it, false);
-            }
+        if (it == mStreams.end()) {
+            continue;
+        }
 
-            if (err == -ECONNRESET) {
-                // socket failure, this stream is dead, Jim.
+        status_t err = receive(&*it, fd == it->mRTPSocket);
 
-                ALOGW("failed to receive RTP/RTCP datagram.");
-                it = mStreams.erase(it);
-                continue;
-            }
+        if (err == -ECONNRESET) {
+            // socket failure, this stream is dead, Jim.
 
-            ++it;
+            ALOGW("failed to receive RTP/RTCP datagram.");
+            eraseStream(it);
         }
     }
 
@@ -351,7 +398,7 @@ void ARTPConnection::onPollStreams() {
                     ALOGW("failed to send RTCP receiver report (%s).",
                          n == 0 ? "connection gone" : strerror(errno));
 
-                    it = mStreams.erase(it);
+                    it = eraseStream(it);
                     continue;
                 }
 
@@ -369,41 +416,125 @@ void ARTPConnection::onPollStreams() {
     }
 }
 
+sp<ABuffer> ARTPConnection::acquireBuffer(bool mayAllocate) {
+    for (size_t i = 0; i < mBufferPool.size(); ++i) {
+        const sp<ABuffer> &buffer = mBufferPool.itemAt(i);
+
+        // Only the pool still references this buffer.
+        if (buffer->getStrongCount() == 1
+                && buffer->capacity() >= mBufferSize) {
+            buffer->setRange(0, buffer->capacity());
+            buffer->meta()->clear();
+            return buffer;
+        }
+    }
+
+    if (mBufferPool.size() >= kMaxBufferPoolSize && !mayAllocate) {
+        return NULL;
+    }
+
+    sp<ABuffer> buffer = new ABuffer(mBufferSize);
+
+    if (mBufferPool.size() < kMaxBufferPoolSize) {
+        mBufferPool.push(buffer);
+    }
+
+    return buffer;
+}
+
 status_t ARTPConnection::receive(StreamInfo *s, bool receiveRTP) {
     ALOGV("receiving %s", receiveRTP ? "RTP" : "RTCP");
 
     CHECK(!s->mIsInjected);
 
-    sp<ABuffer> buffer = new ABuffer(65536);
+    MMsgHdr msgs[kMaxPacketBatch];
+    struct iovec iov[kMaxPacketBatch];
+    sp<ABuffer> buffers[kMaxPacketBatch];
 
-    socklen_t remoteAddrLen =
-        (!receiveRTP && s->mNumRTCPPacketsReceived == 0)
-            ? sizeof(s->mRemoteRTCPAddr) : 0;
+    // Only the very first RTCP packet tells us where to send receiver
+    // reports to.
+    bool wantsRemoteAddr = !receiveRTP && s->mNumRTCPPacketsReceived == 0;
 
-    ssize_t nbytes;
+    // The batch only extends over buffers the pool can spare, a buffer
+    // that can't be pooled is allocated for the first datagram alone.
+    size_t numBuffers = 0;
+    while (numBuffers < kMaxPacketBatch) {
+        size_t i = numBuffers;
+
+        buffers[i] = acquireBuffer(i == 0 /* mayAllocate */);
+        if (buffers[i] == NULL) {
+            break;
+        }
+        ++numBuffers;
+
+        iov[i].iov_base = buffers[i]->data();
+        iov[i].iov_len = buffers[i]->capacity();
+
+        memset(&msgs[i], 0, sizeof(msgs[i]));
+        msgs[i].msg_hdr.msg_iov = &iov[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+
+        if (i == 0 && wantsRemoteAddr) {
+            msgs[i].msg_hdr.msg_name = &s->mRemoteRTCPAddr;
+            msgs[i].msg_hdr.msg_namelen = sizeof(s->mRemoteRTCPAddr);
+        }
+    }
+
+    ssize_t count;
     do {
-        nbytes = recvfrom(
-            receiveRTP ? s->mRTPSocket : s->mRTCPSocket,
-            buffer->data(),
-            buffer->capacity(),
-            0,
-            remoteAddrLen > 0 ? (struct sockaddr *)&s->mRemoteRTCPAddr : NULL,
-            remoteAddrLen > 0 ? &remoteAddrLen : NULL);
-    } while (nbytes < 0 && errno == EINTR);
-
-    if (nbytes <= 0) {
+        count = receivePackets(
+                receiveRTP ? s->mRTPSocket : s->mRTCPSocket,
+                msgs, numBuffers);
+    } while (count < 0 && errno == EINTR);
+
+    if (count < 0 && errno == EAGAIN) {
+        return OK;
+    }
+
+    if (count <= 0) {
         return -ECONNRESET;
     }
 
-    buffer->setRange(0, nbytes);
+    status_t err = OK;
+    for (ssize_t i = 0; i < count; ++i) {
+        if (msgs[i].msg_hdr.msg_flags & MSG_TRUNC) {
+            ALOGW("dropping %s datagram larger than %zu bytes.",
+                  receiveRTP ? "RTP" : "RTCP", mBufferSize);
+
+            if (mBufferSize < kMaxDatagramSize) {
+                mBufferSize = kMaxDatagramSize;
+
+                // The pool would hold on to buffers it can't hand out
+                // anymore, and allocate outside of it from then on.
+                for (size_t j = mBufferPool.size(); j-- > 0;) {
+                    if (mBufferPool.itemAt(j)->capacity() < mBufferSize) {
+                        mBufferPool.removeAt(j);
+                    }
+                }
+            }
+            continue;
+        }
+
+        if (msgs[i].msg_len == 0) {
+            // Empty datagrams carry nothing to parse.
+            continue;
+        }
 
-    // ALOGI("received %d bytes.", buffer->size());
+        buffers[i]->setRange(0, msgs[i].msg_len);
+
+        // ALOGI("received %d bytes.", buffers[i]->size());
+
+        if (receiveRTP) {
+            err = parseRTP(s, buffers[i]);
+        } else {
+            err = parseRTCP(s, buffers[i]);
+        }
+    }
 
-    status_t err;
     if (receiveRTP) {
-        err = parseRTP(s, buffer);
-    } else {
-        err = parseRTCP(s, buffer);
+        for (size_t i = 0; i < s->mSources.size(); ++i) {
+            s->mSources.valueAt(i)->assembleQueuedPackets();
+        }
     }
 
     return err;
@@ -490,7 +621,7 @@ status_t ARTPConnection::parseRTP(StreamInfo *s, const sp<ABuffer> &buffer) {
     buffer->setInt32Data(u16at(&data[2]));
     buffer->setRange(payloadOffset, size - payloadOffset);
 
-    source->processRTPPacket(buffer);
+    source->queueRTPPacket(buffer);
 
     return OK;
 }
@@ -666,6 +797,10 @@ void ARTPConnection::onInjectPacket(const sp<AMessage> &msg) {
     status_t err;
     if (it->mRTPSocket == index) {
         err = parseRTP(s, buffer);
+
+        for (size_t i = 0; i < s->mSources.size(); ++i) {
+            s->mSources.valueAt(i)->assembleQueuedPackets();
+        }
     } else {
         err = parseRTCP(s, buffer);
     }
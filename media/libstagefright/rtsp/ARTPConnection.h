@@ -20,6 +20,7 @@
 
 #include <media/stagefright/foundation/AHandler.h>
 #include <utils/List.h>
+#include <utils/Vector.h>
 
 namespace android {
 
@@ -69,6 +70,15 @@ private:
     struct StreamInfo;
     List<StreamInfo> mStreams;
 
+    // All non-injected RTP/RTCP sockets are registered here once, instead of
+    // rebuilding an fd_set on every poll.
+    int mEpollFd;
+
+    // Receive buffers are recycled once the assemblers and their clients
+    // have released them.
+    Vector<sp<ABuffer> > mBufferPool;
+    size_t mBufferSize;
+
     bool mPollEventPending;
     int64_t mLastReceiverReportTimeUs;
 
@@ -79,6 +89,11 @@ private:
     void onSendReceiverReports();
 
     status_t receive(StreamInfo *info, bool receiveRTP);
+    // Returns NULL if the pool has no free buffer and is full, unless
+    // "mayAllocate" is set.
+    sp<ABuffer> acquireBuffer(bool mayAllocate);
+
+    List<StreamInfo>::iterator eraseStream(List<StreamInfo>::iterator it);
 
     status_t parseRTP(StreamInfo *info, const sp<ABuffer> &buffer);
     status_t parseRTCP(StreamInfo *info, const sp<ABuffer> &buffer);
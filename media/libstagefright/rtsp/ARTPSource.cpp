@@ -44,6 +44,7 @@ ARTPSource::ARTPSource(
     : mID(id),
       mHighestSeqNumber(0),
       mNumBuffersReceived(0),
+      mAssemblyPending(false),
       mLastNTPTime(0),
       mLastNTPTimeUpdateUs(0),
       mIssueFIRRequests(false),
@@ -91,6 +92,24 @@ void ARTPSource::processRTPPacket(const sp<ABuffer> &buffer) {
     }
 }
 
+void ARTPSource::queueRTPPacket(const sp<ABuffer> &buffer) {
+    if (queuePacket(buffer)) {
+        mAssemblyPending = true;
+    }
+}
+
+void ARTPSource::assembleQueuedPackets() {
+    if (!mAssemblyPending) {
+        return;
+    }
+
+    mAssemblyPending = false;
+
+    if (mAssembler != NULL) {
+        mAssembler->onPacketReceived(this);
+    }
+}
+
 void ARTPSource::timeUpdate(uint32_t rtpTime, uint64_t ntpTime) {
     mLastNTPTime = ntpTime;
     mLastNTPTimeUpdateUs = ALooper::GetNowUs();
@@ -144,9 +163,18 @@ bool ARTPSource::queuePacket(const sp<ABuffer> &buffer) {
 
     buffer->setInt32Data(seqNum);
 
-    List<sp<ABuffer> >::iterator it = mQueue.begin();
-    while (it != mQueue.end() && (uint32_t)(*it)->int32Data() < seqNum) {
-        ++it;
+    // Packets mostly arrive in order, so search for the insertion point
+    // starting from the tail of the queue.
+    List<sp<ABuffer> >::iterator it = mQueue.end();
+    while (it != mQueue.begin()) {
+        List<sp<ABuffer> >::iterator prev = it;
+        --prev;
+
+        if ((uint32_t)(*prev)->int32Data() < seqNum) {
+            break;
+        }
+
+        it = prev;
     }
 
     if (it != mQueue.end() && (uint32_t)(*it)->int32Data() == seqNum) {
@@ -38,6 +38,12 @@ struct ARTPSource : public RefBase {
             const sp<AMessage> &notify);
 
     void processRTPPacket(const sp<ABuffer> &buffer);
+
+    // Like processRTPPacket, but defers running the assembler until
+    // assembleQueuedPackets is called, so that a whole batch of received
+    // packets is assembled in one go.
+    void queueRTPPacket(const sp<ABuffer> &buffer);
+    void assembleQueuedPackets();
     void timeUpdate(uint32_t rtpTime, uint64_t ntpTime);
     void byeReceived();
 
@@ -50,6 +56,7 @@ private:
     uint32_t mID;
     uint32_t mHighestSeqNumber;
     int32_t mNumBuffersReceived;
+    bool mAssemblyPending;
 
     List<sp<ABuffer> > mQueue;
     sp<ARTPAssembler> mAssembler;
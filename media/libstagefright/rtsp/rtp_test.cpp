@@ -20,20 +20,181 @@
 
 #include <binder/ProcessState.h>
 
+#include <media/stagefright/foundation/ABuffer.h>
 #include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/foundation/AHandler.h>
 #include <media/stagefright/foundation/ALooper.h>
+#include <media/stagefright/foundation/AMessage.h>
 #include <media/stagefright/DataSource.h>
 #include <media/stagefright/MetaData.h>
 #include <media/stagefright/OMXClient.h>
 #include <media/stagefright/OMXCodec.h>
 #include <media/stagefright/foundation/base64.h>
 
+#include "ARTPConnection.h"
 #include "ARTPSession.h"
 #include "ASessionDescription.h"
 #include "UDPPusher.h"
 
+#include <arpa/inet.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+
 using namespace android;
 
+struct LoopbackReceiver : public AHandler {
+    LoopbackReceiver()
+        : mNumAccessUnits(0) {
+    }
+
+    size_t numAccessUnits() {
+        Mutex::Autolock autoLock(mLock);
+        return mNumAccessUnits;
+    }
+
+protected:
+    virtual void onMessageReceived(const sp<AMessage> &msg) {
+        sp<ABuffer> accessUnit;
+        if (msg->findBuffer("access-unit", &accessUnit)) {
+            Mutex::Autolock autoLock(mLock);
+            ++mNumAccessUnits;
+        }
+    }
+
+private:
+    Mutex mLock;
+    size_t mNumAccessUnits;
+
+    DISALLOW_EVIL_CONSTRUCTORS(LoopbackReceiver);
+};
+
+static int64_t getCPUTimeUs() {
+    struct rusage usage;
+    CHECK_EQ(getrusage(RUSAGE_SELF, &usage), 0);
+
+    return (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000ll
+        + usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+}
+
+// Pushes MP2T-over-RTP packets through an ARTPConnection over the loopback
+// interface and reports the receive throughput and CPU cost per packet.
+static int runLoopbackBenchmark(size_t numPackets) {
+    static const char *raw =
+        "v=0\r\n"
+        "o=- 64 233572944 IN IP4 127.0.0.0\r\n"
+        "s=Loopback\r\n"
+        "t=0 0\r\n"
+        "m=video 0 RTP/AVP 33\r\n"
+        "c=IN IP4 127.0.0.1\r\n"
+        "a=rtpmap:33 MP2T/90000\r\n";
+
+    sp<ASessionDescription> desc = new ASessionDescription;
+    CHECK(desc->setTo(raw, strlen(raw)));
+
+    sp<ALooper> looper = new ALooper;
+
+    sp<ARTPConnection> connection = new ARTPConnection;
+    looper->registerHandler(connection);
+
+    sp<LoopbackReceiver> receiver = new LoopbackReceiver;
+    looper->registerHandler(receiver);
+
+    looper->start();
+
+    int rtpSocket, rtcpSocket;
+    unsigned rtpPort;
+    ARTPConnection::MakePortPair(&rtpSocket, &rtcpSocket, &rtpPort);
+
+    connection->addStream(
+            rtpSocket, rtcpSocket, desc, 1 /* index */,
+            new AMessage(0, receiver->id()), false /* injected */);
+
+    int s = socket(AF_INET, SOCK_DGRAM, 0);
+    CHECK_GE(s, 0);
+
+    struct sockaddr_in addr;
+    memset(addr.sin_zero, 0, sizeof(addr.sin_zero));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(rtpPort);
+
+    CHECK_EQ(connect(s, (const struct sockaddr *)&addr, sizeof(addr)), 0);
+
+    // 7 transport stream packets per RTP packet, like most senders do.
+    uint8_t packet[12 + 7 * 188];
+    memset(packet, 0, sizeof(packet));
+    packet[0] = 0x80;
+    packet[1] = 33;
+    packet[8] = 0xde;
+    packet[9] = 0xad;
+    packet[10] = 0xbe;
+    packet[11] = 0xef;
+    for (size_t i = 0; i < 7; ++i) {
+        packet[12 + i * 188] = 0x47;
+    }
+
+    int64_t startUs = ALooper::GetNowUs();
+    int64_t startCPUTimeUs = getCPUTimeUs();
+
+    for (size_t i = 0; i < numPackets; ++i) {
+        uint16_t seqNo = i & 0xffff;
+        packet[2] = seqNo >> 8;
+        packet[3] = seqNo & 0xff;
+
+        uint32_t rtpTime = i * 90;
+        packet[4] = rtpTime >> 24;
+        packet[5] = (rtpTime >> 16) & 0xff;
+        packet[6] = (rtpTime >> 8) & 0xff;
+        packet[7] = rtpTime & 0xff;
+
+        CHECK_EQ(send(s, packet, sizeof(packet), 0), (ssize_t)sizeof(packet));
+
+        if ((i % 32) == 31) {
+            // Don't overrun the receive buffer.
+            usleep(1000);
+        }
+    }
+
+    size_t received = 0;
+    int64_t lastProgressUs = ALooper::GetNowUs();
+    while (received < numPackets) {
+        usleep(10000);
+
+        size_t n = receiver->numAccessUnits();
+        int64_t nowUs = ALooper::GetNowUs();
+
+        if (n > received) {
+            received = n;
+            lastProgressUs = nowUs;
+        } else if (nowUs - lastProgressUs > 1000000ll) {
+            break;
+        }
+    }
+
+    int64_t elapsedUs = ALooper::GetNowUs() - startUs;
+    int64_t cpuTimeUs = getCPUTimeUs() - startCPUTimeUs;
+
+    printf("received %zu/%zu packets in %.2f secs (%.1f packets/sec), "
+           "%.2f us CPU per packet\n",
+           received,
+           numPackets,
+           elapsedUs / 1E6,
+           received * 1E6 / elapsedUs,
+           received > 0 ? (double)cpuTimeUs / received : 0.0);
+
+    close(s);
+    s = -1;
+
+    connection->removeStream(rtpSocket, rtcpSocket);
+
+    looper->stop();
+
+    close(rtpSocket);
+    close(rtcpSocket);
+
+    return received == numPackets ? 0 : 1;
+}
+
 int main(int argc, char **argv) {
     android::ProcessState::self()->startThreadPool();
 
@@ -42,11 +203,23 @@ int main(int argc, char **argv) {
     const char *rtpFilename = NULL;
     const char *rtcpFilename = NULL;
 
+    if (argc >= 2 && !strcmp(argv[1], "-b")) {
+        int numPackets = (argc >= 3) ? atoi(argv[2]) : 100000;
+        if (numPackets <= 0) {
+            fprintf(stderr, "Illegal number of packets specified.\n");
+            return 1;
+        }
+        return runLoopbackBenchmark(numPackets);
+    }
+
     if (argc == 3) {
         rtpFilename = argv[1];
         rtcpFilename = argv[2];
     } else if (argc != 1) {
-        fprintf(stderr, "usage: %s [ rtpFilename rtcpFilename ]\n", argv[0]);
+        fprintf(stderr,
+                "usage: %s [ rtpFilename rtcpFilename ]\n"
+                "       %s -b [ numPackets ]\tloopback throughput benchmark\n",
+                argv[0], argv[0]);
         return 1;
     }
 
@@ -0,0 +1,234 @@
+/*
+ * Copyright (C) 2012 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "TimedEventQueue_test"
+
+#include <gtest/gtest.h>
+#include <stdlib.h>
+#include <utils/KeyedVector.h>
+#include <utils/threads.h>
+#include <utils/Vector.h>
+
+#include <media/stagefright/foundation/ALooper.h>
+
+#include "TimedEventQueue.h"
+
+namespace android {
+
+struct Recorder {
+    Mutex mLock;
+    Condition mCondition;
+    Vector<int> mFired;
+
+    void add(int tag) {
+        Mutex::Autolock autoLock(mLock);
+        mFired.push(tag);
+        mCondition.signal();
+    }
+
+    // Waits until "count" events have fired, or a second passed.
+    bool waitFor(size_t count) {
+        Mutex::Autolock autoLock(mLock);
+        while (mFired.size() < count) {
+            if (mCondition.waitRelative(mLock, 1000000000ll) != OK) {
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+struct TestEvent : public TimedEventQueue::Event {
+    TestEvent(Recorder *recorder, int tag)
+        : mRecorder(recorder),
+          mTag(tag) {
+    }
+
+protected:
+    virtual void fire(TimedEventQueue *queue, int64_t now_us) {
+        mRecorder->add(mTag);
+    }
+
+private:
+    Recorder *mRecorder;
+    int mTag;
+};
+
+class TimedEventQueueTest : public ::testing::Test {
+protected:
+    TimedEventQueue mQueue;
+    Recorder mRecorder;
+
+    sp<TestEvent> makeEvent(int tag) {
+        return new TestEvent(&mRecorder, tag);
+    }
+};
+
+TEST_F(TimedEventQueueTest, FiresInTimeOrder) {
+    static const int kDelaysMs[] = { 50, 10, 40, 20, 30 };
+    static const size_t kNumEvents = sizeof(kDelaysMs) / sizeof(kDelaysMs[0]);
+
+    for (size_t i = 0; i < kNumEvents; ++i) {
+        mQueue.postEventWithDelay(
+                makeEvent(kDelaysMs[i]), kDelaysMs[i] * 1000ll);
+    }
+
+    mQueue.start();
+    ASSERT_TRUE(mRecorder.waitFor(kNumEvents));
+    mQueue.stop();
+
+    for (size_t i = 0; i < kNumEvents; ++i) {
+        EXPECT_EQ((int)(i + 1) * 10, mRecorder.mFired[i]);
+    }
+}
+
+TEST_F(TimedEventQueueTest, SameTimeFiresInPostingOrder) {
+    int64_t whenUs = ALooper::GetNowUs() + 20000ll;
+
+    for (int i = 0; i < 100; ++i) {
+        mQueue.postTimedEvent(makeEvent(i), whenUs);
+    }
+
+    mQueue.start();
+    ASSERT_TRUE(mRecorder.waitFor(100));
+    mQueue.stop();
+
+    for (int i = 0; i < 100; ++i) {
+        EXPECT_EQ(i, mRecorder.mFired[i]);
+    }
+}
+
+TEST_F(TimedEventQueueTest, CancelledEventsDontFire) {
+    sp<TestEvent> byID = makeEvent(1);
+    sp<TestEvent> byHandle = makeEvent(2);
+    sp<TestEvent> kept = makeEvent(3);
+
+    TimedEventQueue::event_id id = mQueue.postEventWithDelay(byID, 10000ll);
+    mQueue.postEventWithDelay(byHandle, 20000ll);
+    mQueue.postEventWithDelay(kept, 30000ll);
+
+    EXPECT_TRUE(mQueue.cancelEvent(id));
+    EXPECT_FALSE(mQueue.cancelEvent(id));
+    EXPECT_TRUE(mQueue.cancelEvent(byHandle));
+    EXPECT_FALSE(mQueue.cancelEvent(byHandle));
+
+    mQueue.start();
+    ASSERT_TRUE(mRecorder.waitFor(1));
+    mQueue.stop();
+
+    ASSERT_EQ(1u, mRecorder.mFired.size());
+    EXPECT_EQ(3, mRecorder.mFired[0]);
+
+    // A cancelled event can be posted again.
+    mQueue.postEvent(byHandle);
+    mQueue.start();
+    ASSERT_TRUE(mRecorder.waitFor(2));
+    mQueue.stop();
+
+    EXPECT_EQ(2, mRecorder.mFired[1]);
+}
+
+TEST_F(TimedEventQueueTest, RepostedEventCoalesces) {
+    sp<TestEvent> event = makeEvent(1);
+    sp<TestEvent> marker = makeEvent(2);
+
+    TimedEventQueue::event_id id = mQueue.postEventWithDelay(event, 40000ll);
+    EXPECT_EQ(id, mQueue.postEventWithDelay(event, 10000ll));
+    EXPECT_EQ(id, mQueue.postEventWithDelay(event, 80000ll));
+    mQueue.postEventWithDelay(marker, 20000ll);
+
+    mQueue.start();
+    ASSERT_TRUE(mRecorder.waitFor(2));
+    usleep(100000);
+    mQueue.stop();
+
+    // Fired once, at the earliest of the requested times.
+    ASSERT_EQ(2u, mRecorder.mFired.size());
+    EXPECT_EQ(1, mRecorder.mFired[0]);
+    EXPECT_EQ(2, mRecorder.mFired[1]);
+}
+
+static bool IsEven(void *cookie, const sp<TimedEventQueue::Event> &event) {
+    KeyedVector<TimedEventQueue::event_id, int> *tags =
+        static_cast<KeyedVector<TimedEventQueue::event_id, int> *>(cookie);
+
+    return (tags->valueFor(event->eventID()) % 2) == 0;
+}
+
+TEST_F(TimedEventQueueTest, CancelEventsKeepsOrder) {
+    KeyedVector<TimedEventQueue::event_id, int> tags;
+
+    for (int i = 0; i < 64; ++i) {
+        int tag = (i * 37) % 64;
+        tags.add(mQueue.postEventWithDelay(
+                    makeEvent(tag), 10000ll + tag * 500ll), tag);
+    }
+
+    mQueue.cancelEvents(&IsEven, &tags);
+
+    mQueue.start();
+    ASSERT_TRUE(mRecorder.waitFor(32));
+    mQueue.stop();
+
+    ASSERT_EQ(32u, mRecorder.mFired.size());
+    for (int i = 0; i < 32; ++i) {
+        EXPECT_EQ(2 * i + 1, mRecorder.mFired[i]);
+    }
+}
+
+// Not a correctness test, reports what posting and cancelling costs with
+// many events pending, the way a busy media server would see it.
+TEST_F(TimedEventQueueTest, PostCancelBenchmark) {
+    static const size_t kNumEvents = 10000;
+
+    Vector<sp<TestEvent> > events;
+    Vector<TimedEventQueue::event_id> ids;
+    for (size_t i = 0; i < kNumEvents; ++i) {
+        events.push(makeEvent(i));
+    }
+
+    srand(1);
+    int64_t baseUs = ALooper::GetNowUs() + 3600000000ll;
+
+    int64_t startUs = ALooper::GetNowUs();
+    for (size_t i = 0; i < kNumEvents; ++i) {
+        ids.push(mQueue.postTimedEvent(
+                    events[i], baseUs + (rand() % 1000000)));
+    }
+    int64_t postUs = ALooper::GetNowUs() - startUs;
+
+    startUs = ALooper::GetNowUs();
+    for (size_t i = 0; i < kNumEvents; i += 2) {
+        EXPECT_TRUE(mQueue.cancelEvent(events[i]));
+    }
+    int64_t cancelByHandleUs = ALooper::GetNowUs() - startUs;
+
+    startUs = ALooper::GetNowUs();
+    for (size_t i = 1; i < kNumEvents; i += 2) {
+        EXPECT_TRUE(mQueue.cancelEvent(ids[i]));
+    }
+    int64_t cancelByIDUs = ALooper::GetNowUs() - startUs;
+
+    printf("%d events: post %.3f us, cancel by handle %.3f us, "
+           "cancel by id %.3f us (per event)\n",
+           (int)kNumEvents,
+           (double)postUs / kNumEvents,
+           (double)cancelByHandleUs / (kNumEvents / 2),
+           (double)cancelByIDUs / (kNumEvents / 2));
+}
+
+}  // namespace android
@@ -26,7 +26,10 @@
 #include <net/if.h>
 #include <netdb.h>
 #include <netinet/in.h>
+#include <sys/epoll.h>
 #include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
 
 #include <media/stagefright/foundation/ABuffer.h>
 #include <media/stagefright/foundation/ADebug.h>
@@ -38,6 +41,77 @@ namespace android {
 
 static const size_t kMaxUDPSize = 1500;
 
+// Number of datagrams moved per recvmmsg/sendmmsg call.
+static const size_t kMaxDatagramBatch = 16;
+
+static const size_t kMaxEpollEvents = 32;
+
+// Session IDs start at 1, the interrupt pipe is registered under this one.
+static const int32_t kInterruptID = 0;
+
+// Layout-compatible with the kernel's struct mmsghdr, which is not declared
+// by every C library we build against.
+struct MMsgHdr {
+    struct msghdr msg_hdr;
+    unsigned int msg_len;
+};
+
+// Kernels older than the C library headers reject the batched syscalls with
+// ENOSYS, from then on the batch is moved one datagram per syscall. Only ever
+// cleared, a stale read just costs one more failing syscall.
+static volatile bool gHaveRecvMMsg = true;
+static volatile bool gHaveSendMMsg = true;
+
+static ssize_t ReceiveDatagrams(int s, MMsgHdr *msgs, size_t count) {
+#if defined(__NR_recvmmsg)
+    if (gHaveRecvMMsg) {
+        ssize_t n = syscall(__NR_recvmmsg, s, msgs, count, 0, NULL);
+        if (n >= 0 || errno != ENOSYS) {
+            return n;
+        }
+        gHaveRecvMMsg = false;
+    }
+#endif
+    // Sockets are non-blocking, stop at the first failure and report it
+    // only if nothing was received, like recvmmsg does.
+    size_t i = 0;
+    while (i < count) {
+        ssize_t n = recvmsg(s, &msgs[i].msg_hdr, 0);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        msgs[i++].msg_len = n;
+    }
+    return i > 0 ? (ssize_t)i : -1;
+}
+
+static ssize_t SendDatagrams(int s, MMsgHdr *msgs, size_t count) {
+#if defined(__NR_sendmmsg)
+    if (gHaveSendMMsg) {
+        ssize_t n = syscall(__NR_sendmmsg, s, msgs, count, 0);
+        if (n >= 0 || errno != ENOSYS) {
+            return n;
+        }
+        gHaveSendMMsg = false;
+    }
+#endif
+    size_t i = 0;
+    while (i < count) {
+        ssize_t n = sendmsg(s, &msgs[i].msg_hdr, 0);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        msgs[i++].msg_len = n;
+    }
+    return i > 0 ? (ssize_t)i : -1;
+}
+
 struct ANetworkSession::NetworkThread : public Thread {
     NetworkThread(ANetworkSession *session);
 
@@ -81,8 +155,16 @@ struct ANetworkSession::Session : public RefBase {
 
     status_t sendRequest(const void *data, ssize_t size);
 
+    // Number of bytes queued for sending but not yet accepted by the kernel.
+    size_t outgoingQueueSize() const;
+
     void setIsRTSPConnection(bool yesno);
 
+    // The epoll events this session is currently registered for, or -1
+    // if its socket is not part of the epoll set.
+    int32_t epollEvents() const;
+    void setEpollEvents(int32_t events);
+
 protected:
     virtual ~Session();
 
@@ -93,12 +175,18 @@ private:
     int mSocket;
     sp<AMessage> mNotify;
     bool mSawReceiveFailure, mSawSendFailure;
+    int32_t mEpollEvents;
 
     // for TCP / stream data
     AString mOutBuffer;
 
     // for UDP / datagrams
     List<sp<ABuffer> > mOutDatagrams;
+    size_t mOutDatagramsSize;
+
+    // Receive buffers for the next recvmmsg call, slots that were not
+    // filled by the previous call are reused.
+    sp<ABuffer> mInDatagrams[kMaxDatagramBatch];
 
     AString mInBuffer;
 
@@ -135,7 +223,9 @@ ANetworkSession::Session::Session(
       mSocket(s),
       mNotify(notify),
       mSawReceiveFailure(false),
-      mSawSendFailure(false) {
+      mSawSendFailure(false),
+      mEpollEvents(-1),
+      mOutDatagramsSize(0) {
     if (mState == CONNECTED) {
         struct sockaddr_in localAddr;
         socklen_t localAddrLen = sizeof(localAddr);
@@ -197,6 +287,18 @@ void ANetworkSession::Session::setIsRTSPConnection(bool yesno) {
     mIsRTSPConnection = yesno;
 }
 
+int32_t ANetworkSession::Session::epollEvents() const {
+    return mEpollEvents;
+}
+
+void ANetworkSession::Session::setEpollEvents(int32_t events) {
+    mEpollEvents = events;
+}
+
+size_t ANetworkSession::Session::outgoingQueueSize() const {
+    return (mState == DATAGRAM) ? mOutDatagramsSize : mOutBuffer.size();
+}
+
 sp<AMessage> ANetworkSession::Session::getNotificationMessage() const {
     return mNotify;
 }
@@ -222,36 +324,57 @@ bool ANetworkSession::Session::wantsToWrite() {
 
 status_t ANetworkSession::Session::readMore() {
     if (mState == DATAGRAM) {
-        status_t err;
-        do {
-            sp<ABuffer> buf = new ABuffer(kMaxUDPSize);
+        MMsgHdr msgs[kMaxDatagramBatch];
+        struct iovec iov[kMaxDatagramBatch];
+        struct sockaddr_in remoteAddrs[kMaxDatagramBatch];
 
-            struct sockaddr_in remoteAddr;
-            socklen_t remoteAddrLen = sizeof(remoteAddr);
+        status_t err = OK;
+        for (;;) {
+            for (size_t i = 0; i < kMaxDatagramBatch; ++i) {
+                if (mInDatagrams[i] == NULL) {
+                    mInDatagrams[i] = new ABuffer(kMaxUDPSize);
+                }
 
-            ssize_t n;
+                iov[i].iov_base = mInDatagrams[i]->base();
+                iov[i].iov_len = mInDatagrams[i]->capacity();
+
+                memset(&msgs[i], 0, sizeof(msgs[i]));
+                msgs[i].msg_hdr.msg_name = &remoteAddrs[i];
+                msgs[i].msg_hdr.msg_namelen = sizeof(remoteAddrs[i]);
+                msgs[i].msg_hdr.msg_iov = &iov[i];
+                msgs[i].msg_hdr.msg_iovlen = 1;
+            }
+
+            ssize_t count;
             do {
-                n = recvfrom(
-                        mSocket, buf->data(), buf->capacity(), 0,
-                        (struct sockaddr *)&remoteAddr, &remoteAddrLen);
-            } while (n < 0 && errno == EINTR);
+                count = ReceiveDatagrams(mSocket, msgs, kMaxDatagramBatch);
+            } while (count < 0 && errno == EINTR);
 
-            err = OK;
-            if (n < 0) {
+            if (count < 0) {
                 err = -errno;
-            } else if (n == 0) {
-                err = -ECONNRESET;
-            } else {
-                buf->setRange(0, n);
+                break;
+            }
 
-                int64_t nowUs = ALooper::GetNowUs();
+            int64_t nowUs = ALooper::GetNowUs();
+
+            for (ssize_t i = 0; i < count; ++i) {
+                if (msgs[i].msg_len == 0) {
+                    // An empty datagram is valid UDP and carries nothing,
+                    // keep its buffer for the next batch.
+                    continue;
+                }
+
+                sp<ABuffer> buf = mInDatagrams[i];
+                mInDatagrams[i].clear();
+
+                buf->setRange(0, msgs[i].msg_len);
                 buf->meta()->setInt64("arrivalTimeUs", nowUs);
 
                 sp<AMessage> notify = mNotify->dup();
                 notify->setInt32("sessionID", mSessionID);
                 notify->setInt32("reason", kWhatDatagram);
 
-                uint32_t ip = ntohl(remoteAddr.sin_addr.s_addr);
+                uint32_t ip = ntohl(remoteAddrs[i].sin_addr.s_addr);
                 notify->setString(
                         "fromAddr",
                         StringPrintf(
@@ -261,12 +384,18 @@ status_t ANetworkSession::Session::readMore() {
                             (ip >> 8) & 0xff,
                             ip & 0xff).c_str());
 
-                notify->setInt32("fromPort", ntohs(remoteAddr.sin_port));
+                notify->setInt32("fromPort", ntohs(remoteAddrs[i].sin_port));
 
                 notify->setBuffer("data", buf);
                 notify->post();
             }
-        } while (err == OK);
+
+            if ((size_t)count < kMaxDatagramBatch) {
+                // A short batch means the socket has been drained, we'll
+                // hear from epoll again once more data arrives.
+                break;
+            }
+        }
 
         if (err == -EAGAIN) {
             err = OK;
@@ -403,19 +532,35 @@ status_t ANetworkSession::Session::writeMore() {
     if (mState == DATAGRAM) {
         CHECK(!mOutDatagrams.empty());
 
-        status_t err;
+        MMsgHdr msgs[kMaxDatagramBatch];
+        struct iovec iov[kMaxDatagramBatch];
+
+        status_t err = OK;
         do {
-            const sp<ABuffer> &datagram = *mOutDatagrams.begin();
+            size_t count = 0;
+            for (List<sp<ABuffer> >::iterator it = mOutDatagrams.begin();
+                    it != mOutDatagrams.end() && count < kMaxDatagramBatch;
+                    ++it, ++count) {
+                const sp<ABuffer> &datagram = *it;
+
+                iov[count].iov_base = datagram->data();
+                iov[count].iov_len = datagram->size();
+
+                memset(&msgs[count], 0, sizeof(msgs[count]));
+                msgs[count].msg_hdr.msg_iov = &iov[count];
+                msgs[count].msg_hdr.msg_iovlen = 1;
+            }
 
-            int n;
+            ssize_t n;
             do {
-                n = send(mSocket, datagram->data(), datagram->size(), 0);
+                n = SendDatagrams(mSocket, msgs, count);
             } while (n < 0 && errno == EINTR);
 
-            err = OK;
-
             if (n > 0) {
-                mOutDatagrams.erase(mOutDatagrams.begin());
+                while (n-- > 0) {
+                    mOutDatagramsSize -= (*mOutDatagrams.begin())->size();
+                    mOutDatagrams.erase(mOutDatagrams.begin());
+                }
             } else if (n < 0) {
                 err = -errno;
             } else if (n == 0) {
@@ -495,6 +640,7 @@ status_t ANetworkSession::Session::sendRequest(const void *data, ssize_t size) {
         memcpy(datagram->data(), data, size);
 
         mOutDatagrams.push_back(datagram);
+        mOutDatagramsSize += size;
         return OK;
     }
 
@@ -536,7 +682,8 @@ void ANetworkSession::Session::notify(NotificationReason reason) {
 ////////////////////////////////////////////////////////////////////////////////
 
 ANetworkSession::ANetworkSession()
-    : mNextSessionID(1) {
+    : mNextSessionID(1),
+      mEpollFd(-1) {
     mPipeFd[0] = mPipeFd[1] = -1;
 }
 
@@ -555,6 +702,31 @@ status_t ANetworkSession::start() {
         return -errno;
     }
 
+    {
+        Mutex::Autolock autoLock(mLock);
+
+        mEpollFd = epoll_create(kMaxEpollEvents);
+        if (mEpollFd < 0) {
+            status_t err = -errno;
+
+            close(mPipeFd[0]);
+            close(mPipeFd[1]);
+            mPipeFd[0] = mPipeFd[1] = -1;
+
+            return err;
+        }
+
+        struct epoll_event ev;
+        memset(&ev, 0, sizeof(ev));
+        ev.events = EPOLLIN;
+        ev.data.u32 = kInterruptID;
+        CHECK_EQ(epoll_ctl(mEpollFd, EPOLL_CTL_ADD, mPipeFd[0], &ev), 0);
+
+        for (size_t i = 0; i < mSessions.size(); ++i) {
+            updateSessionEvents_l(mSessions.valueAt(i));
+        }
+    }
+
     mThread = new NetworkThread(this);
 
     status_t err = mThread->run("ANetworkSession", ANDROID_PRIORITY_AUDIO);
@@ -562,6 +734,14 @@ status_t ANetworkSession::start() {
     if (err != OK) {
         mThread.clear();
 
+        Mutex::Autolock autoLock(mLock);
+        for (size_t i = 0; i < mSessions.size(); ++i) {
+            mSessions.valueAt(i)->setEpollEvents(-1);
+        }
+
+        close(mEpollFd);
+        mEpollFd = -1;
+
         close(mPipeFd[0]);
         close(mPipeFd[1]);
         mPipeFd[0] = mPipeFd[1] = -1;
@@ -583,6 +763,16 @@ status_t ANetworkSession::stop() {
 
     mThread.clear();
 
+    {
+        Mutex::Autolock autoLock(mLock);
+        for (size_t i = 0; i < mSessions.size(); ++i) {
+            mSessions.valueAt(i)->setEpollEvents(-1);
+        }
+
+        close(mEpollFd);
+        mEpollFd = -1;
+    }
+
     close(mPipeFd[0]);
     close(mPipeFd[1]);
     mPipeFd[0] = mPipeFd[1] = -1;
@@ -675,9 +865,14 @@ status_t ANetworkSession::destroySession(int32_t sessionID) {
         return -ENOENT;
     }
 
-    mSessions.removeItemsAt(index);
+    const sp<Session> session = mSessions.valueAt(index);
 
-    interrupt();
+    if (session->epollEvents() >= 0) {
+        epoll_ctl(mEpollFd, EPOLL_CTL_DEL, session->socket(), NULL);
+        session->setEpollEvents(-1);
+    }
+
+    mSessions.removeItemsAt(index);
 
     return OK;
 }
@@ -872,7 +1067,7 @@ status_t ANetworkSession::createClientOrServer(
 
     mSessions.add(session->sessionID(), session);
 
-    interrupt();
+    updateSessionEvents_l(session);
 
     *sessionID = session->sessionID();
 
@@ -938,11 +1133,26 @@ status_t ANetworkSession::sendRequest(
 
     status_t err = session->sendRequest(data, size);
 
-    interrupt();
+    updateSessionEvents_l(session);
 
     return err;
 }
 
+status_t ANetworkSession::getOutgoingQueueSize(
+        int32_t sessionID, size_t *numBytes) {
+    Mutex::Autolock autoLock(mLock);
+
+    ssize_t index = mSessions.indexOfKey(sessionID);
+
+    if (index < 0) {
+        return -ENOENT;
+    }
+
+    *numBytes = mSessions.valueAt(index)->outgoingQueueSize();
+
+    return OK;
+}
+
 void ANetworkSession::interrupt() {
     static const char dummy = 0;
 
@@ -956,43 +1166,63 @@ void ANetworkSession::interrupt() {
     }
 }
 
-void ANetworkSession::threadLoop() {
-    fd_set rs, ws;
-    FD_ZERO(&rs);
-    FD_ZERO(&ws);
+void ANetworkSession::updateSessionEvents_l(const sp<Session> &session) {
+    if (mEpollFd < 0) {
+        // Not started yet, start() registers all existing sessions.
+        return;
+    }
 
-    FD_SET(mPipeFd[0], &rs);
-    int maxFd = mPipeFd[0];
+    int s = session->socket();
 
-    {
-        Mutex::Autolock autoLock(mLock);
+    if (s < 0) {
+        return;
+    }
 
-        for (size_t i = 0; i < mSessions.size(); ++i) {
-            const sp<Session> &session = mSessions.valueAt(i);
+    int32_t events = 0;
+    if (session->wantsToRead()) {
+        events |= EPOLLIN;
+    }
+    if (session->wantsToWrite()) {
+        events |= EPOLLOUT;
+    }
 
-            int s = session->socket();
+    int32_t oldEvents = session->epollEvents();
 
-            if (s < 0) {
-                continue;
-            }
+    if (events == oldEvents) {
+        return;
+    }
 
-            if (session->wantsToRead()) {
-                FD_SET(s, &rs);
-                if (s > maxFd) {
-                    maxFd = s;
-                }
-            }
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = events;
+    ev.data.u32 = session->sessionID();
+
+    int res;
+    if (events == 0) {
+        // Error and hangup conditions are reported even for an empty
+        // event mask, drop the socket from the set altogether so that
+        // a failed session cannot keep waking us up.
+        res = epoll_ctl(mEpollFd, EPOLL_CTL_DEL, s, NULL);
+        events = -1;
+    } else if (oldEvents < 0) {
+        res = epoll_ctl(mEpollFd, EPOLL_CTL_ADD, s, &ev);
+    } else {
+        res = epoll_ctl(mEpollFd, EPOLL_CTL_MOD, s, &ev);
+    }
 
-            if (session->wantsToWrite()) {
-                FD_SET(s, &ws);
-                if (s > maxFd) {
-                    maxFd = s;
-                }
-            }
-        }
+    if (res < 0) {
+        ALOGE("epoll_ctl on socket %d failed w/ error %d (%s)",
+              s, errno, strerror(errno));
+        return;
     }
 
-    int res = select(maxFd + 1, &rs, &ws, NULL, NULL /* tv */);
+    session->setEpollEvents(events);
+}
+
+void ANetworkSession::threadLoop() {
+    struct epoll_event events[kMaxEpollEvents];
+
+    int res = epoll_wait(mEpollFd, events, kMaxEpollEvents, -1 /* timeout */);
 
     if (res == 0) {
         return;
@@ -1003,115 +1233,125 @@ void ANetworkSession::threadLoop() {
             return;
         }
 
-        ALOGE("select failed w/ error %d (%s)", errno, strerror(errno));
+        ALOGE("epoll_wait failed w/ error %d (%s)", errno, strerror(errno));
         return;
     }
 
-    if (FD_ISSET(mPipeFd[0], &rs)) {
-        char c;
-        ssize_t n;
-        do {
-            n = read(mPipeFd[0], &c, 1);
-        } while (n < 0 && errno == EINTR);
+    Mutex::Autolock autoLock(mLock);
 
-        if (n < 0) {
-            ALOGW("Error reading from pipe (%s)", strerror(errno));
+    List<sp<Session> > sessionsToAdd;
+
+    for (int i = 0; i < res; ++i) {
+        int32_t sessionID = events[i].data.u32;
+
+        if (sessionID == kInterruptID) {
+            char c;
+            ssize_t n;
+            do {
+                n = read(mPipeFd[0], &c, 1);
+            } while (n < 0 && errno == EINTR);
+
+            if (n < 0) {
+                ALOGW("Error reading from pipe (%s)", strerror(errno));
+            }
+
+            continue;
         }
 
-        --res;
-    }
+        ssize_t index = mSessions.indexOfKey(sessionID);
 
-    {
-        Mutex::Autolock autoLock(mLock);
+        if (index < 0) {
+            // Destroyed after epoll_wait returned.
+            continue;
+        }
 
-        List<sp<Session> > sessionsToAdd;
+        sp<Session> session = mSessions.valueAt(index);
 
-        for (size_t i = mSessions.size(); res > 0 && i-- > 0;) {
-            const sp<Session> &session = mSessions.valueAt(i);
+        int s = session->socket();
 
-            int s = session->socket();
+        if (s < 0) {
+            continue;
+        }
 
-            if (s < 0) {
-                continue;
-            }
+        uint32_t revents = events[i].events;
 
-            if (FD_ISSET(s, &rs) || FD_ISSET(s, &ws)) {
-                --res;
-            }
+        if ((revents & (EPOLLIN | EPOLLERR | EPOLLHUP))
+                && session->wantsToRead()) {
+            if (session->isRTSPServer() || session->isTCPDatagramServer()) {
+                struct sockaddr_in remoteAddr;
+                socklen_t remoteAddrLen = sizeof(remoteAddr);
 
-            if (FD_ISSET(s, &rs)) {
-                if (session->isRTSPServer() || session->isTCPDatagramServer()) {
-                    struct sockaddr_in remoteAddr;
-                    socklen_t remoteAddrLen = sizeof(remoteAddr);
-
-                    int clientSocket = accept(
-                            s, (struct sockaddr *)&remoteAddr, &remoteAddrLen);
-
-                    if (clientSocket >= 0) {
-                        status_t err = MakeSocketNonBlocking(clientSocket);
-
-                        if (err != OK) {
-                            ALOGE("Unable to make client socket non blocking, "
-                                  "failed w/ error %d (%s)",
-                                  err, strerror(-err));
-
-                            close(clientSocket);
-                            clientSocket = -1;
-                        } else {
-                            in_addr_t addr = ntohl(remoteAddr.sin_addr.s_addr);
-
-                            ALOGI("incoming connection from %d.%d.%d.%d:%d "
-                                  "(socket %d)",
-                                  (addr >> 24),
-                                  (addr >> 16) & 0xff,
-                                  (addr >> 8) & 0xff,
-                                  addr & 0xff,
-                                  ntohs(remoteAddr.sin_port),
-                                  clientSocket);
-
-                            sp<Session> clientSession =
-                                // using socket sd as sessionID
-                                new Session(
-                                        mNextSessionID++,
-                                        Session::CONNECTED,
-                                        clientSocket,
-                                        session->getNotificationMessage());
-
-                            clientSession->setIsRTSPConnection(
-                                    session->isRTSPServer());
-
-                            sessionsToAdd.push_back(clientSession);
-                        }
+                int clientSocket = accept(
+                        s, (struct sockaddr *)&remoteAddr, &remoteAddrLen);
+
+                if (clientSocket >= 0) {
+                    status_t err = MakeSocketNonBlocking(clientSocket);
+
+                    if (err != OK) {
+                        ALOGE("Unable to make client socket non blocking, "
+                              "failed w/ error %d (%s)",
+                              err, strerror(-err));
+
+                        close(clientSocket);
+                        clientSocket = -1;
                     } else {
-                        ALOGE("accept returned error %d (%s)",
-                              errno, strerror(errno));
+                        in_addr_t addr = ntohl(remoteAddr.sin_addr.s_addr);
+
+                        ALOGI("incoming connection from %d.%d.%d.%d:%d "
+                              "(socket %d)",
+                              (addr >> 24),
+                              (addr >> 16) & 0xff,
+                              (addr >> 8) & 0xff,
+                              addr & 0xff,
+                              ntohs(remoteAddr.sin_port),
+                              clientSocket);
+
+                        sp<Session> clientSession =
+                            // using socket sd as sessionID
+                            new Session(
+                                    mNextSessionID++,
+                                    Session::CONNECTED,
+                                    clientSocket,
+                                    session->getNotificationMessage());
+
+                        clientSession->setIsRTSPConnection(
+                                session->isRTSPServer());
+
+                        sessionsToAdd.push_back(clientSession);
                     }
                 } else {
-                    status_t err = session->readMore();
-                    if (err != OK) {
-                        ALOGE("readMore on socket %d failed w/ error %d (%s)",
-                              s, err, strerror(-err));
-                    }
+                    ALOGE("accept returned error %d (%s)",
+                          errno, strerror(errno));
                 }
-            }
-
-            if (FD_ISSET(s, &ws)) {
-                status_t err = session->writeMore();
+            } else {
+                status_t err = session->readMore();
                 if (err != OK) {
-                    ALOGE("writeMore on socket %d failed w/ error %d (%s)",
+                    ALOGE("readMore on socket %d failed w/ error %d (%s)",
                           s, err, strerror(-err));
                 }
             }
         }
 
-        while (!sessionsToAdd.empty()) {
-            sp<Session> session = *sessionsToAdd.begin();
-            sessionsToAdd.erase(sessionsToAdd.begin());
+        if ((revents & (EPOLLOUT | EPOLLERR | EPOLLHUP))
+                && session->wantsToWrite()) {
+            status_t err = session->writeMore();
+            if (err != OK) {
+                ALOGE("writeMore on socket %d failed w/ error %d (%s)",
+                      s, err, strerror(-err));
+            }
+        }
 
-            mSessions.add(session->sessionID(), session);
+        updateSessionEvents_l(session);
+    }
 
-            ALOGI("added clientSession %d", session->sessionID());
-        }
+    while (!sessionsToAdd.empty()) {
+        sp<Session> session = *sessionsToAdd.begin();
+        sessionsToAdd.erase(sessionsToAdd.begin());
+
+        mSessions.add(session->sessionID(), session);
+        updateSessionEvents_l(session);
+
+        ALOGI("added clientSession %d", session->sessionID());
     }
 }
 
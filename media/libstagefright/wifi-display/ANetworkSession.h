@@ -76,6 +76,10 @@ struct ANetworkSession : public RefBase {
     status_t sendRequest(
             int32_t sessionID, const void *data, ssize_t size = -1);
 
+    // Number of bytes queued on the session that the kernel has not yet
+    // accepted, a measure of how far the link is falling behind.
+    status_t getOutgoingQueueSize(int32_t sessionID, size_t *numBytes);
+
     enum NotificationReason {
         kWhatError,
         kWhatConnected,
@@ -98,6 +102,7 @@ private:
     int32_t mNextSessionID;
 
     int mPipeFd[2];
+    int mEpollFd;
 
     KeyedVector<int32_t, sp<Session> > mSessions;
 
@@ -120,6 +125,10 @@ private:
     void threadLoop();
     void interrupt();
 
+    // Brings the session's registration in the epoll set in line with
+    // what it currently wants to read or write.
+    void updateSessionEvents_l(const sp<Session> &session);
+
     static status_t MakeSocketNonBlocking(int s);
 
     DISALLOW_EVIL_CONSTRUCTORS(ANetworkSession);
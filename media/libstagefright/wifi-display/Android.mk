@@ -7,7 +7,7 @@ LOCAL_SRC_FILES:= \
         ANetworkSession.cpp             \
         Parameters.cpp                  \
         ParsedMessage.cpp               \
-        sink/LinearRegression.cpp       \
+        sink/JitterBuffer.cpp           \
         sink/RTPSink.cpp                \
         sink/TunnelRenderer.cpp         \
         sink/WifiDisplaySink.cpp        \
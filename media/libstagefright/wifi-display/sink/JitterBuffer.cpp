@@ -0,0 +1,384 @@
+/*
+ * Copyright 2012, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "JitterBuffer"
+#include <utils/Log.h>
+
+#include "JitterBuffer.h"
+
+#include <media/stagefright/foundation/ABuffer.h>
+#include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/foundation/AMessage.h>
+
+#include <string.h>
+
+namespace android {
+
+// The sender's and our clock shouldn't disagree by more than this.
+static const double kMaxClockDrift = 1E-3;
+
+// A sequence number this far behind the last one played out means the
+// source restarted rather than that a packet is very late.
+static const int32_t kMaxMisorder = 3000;
+
+JitterBuffer::JitterBuffer()
+    : mBytesQueued(0ll),
+      mLastDequeuedExtSeqNo(-1),
+      mHaveClockBase(false),
+      mArrivalTimeBaseUs(0ll),
+      mLastRTPTime(0),
+      mExtRTPTime(0ll),
+      mNumWindowPackets(0),
+      mWindowMinTransitUs(0ll),
+      mWindowMinSenderTimeUs(0ll),
+      mNumClockSamples(0),
+      mClockSampleIndex(0),
+      mClockRate(1.0),
+      mOffsetUs(0.0),
+      mDelayHistoryCount(0),
+      mDelayHistoryIndex(0),
+      mNumPacketsSinceTargetUpdate(0),
+      mTargetDelayUs(kMaxTargetDelayUs / 4),
+      mMaxDelayUs(0ll),
+      mNumPacketsReceived(0ll),
+      mNumPacketsLost(0ll),
+      mNumPacketsLate(0ll),
+      mNumConcealments(0ll) {
+    memset(mDelayBins, 0, sizeof(mDelayBins));
+}
+
+JitterBuffer::~JitterBuffer() {
+}
+
+int64_t JitterBuffer::bytesQueued() const {
+    return mBytesQueued;
+}
+
+void JitterBuffer::queueBuffer(const sp<ABuffer> &buffer) {
+    uint32_t rtpTime;
+    CHECK(buffer->meta()->findInt32("rtp-time", (int32_t *)&rtpTime));
+
+    int64_t arrivalTimeUs;
+    CHECK(buffer->meta()->findInt64("arrivalTimeUs", &arrivalTimeUs));
+
+    ++mNumPacketsReceived;
+
+    if (!mHaveClockBase) {
+        mHaveClockBase = true;
+        mArrivalTimeBaseUs = arrivalTimeUs;
+        mLastRTPTime = rtpTime;
+        mExtRTPTime = 0ll;
+    }
+
+    // Unwrap the 32-bit RTP time, reordered packets may be slightly older
+    // than the newest one seen so far.
+    int64_t extRTPTime = mExtRTPTime + (int32_t)(rtpTime - mLastRTPTime);
+    if (extRTPTime > mExtRTPTime) {
+        mExtRTPTime = extRTPTime;
+        mLastRTPTime = rtpTime;
+    }
+
+    // 90kHz time scale
+    int64_t senderTimeUs = (extRTPTime * 100ll) / 9ll;
+
+    arrivalTimeUs -= mArrivalTimeBaseUs;
+
+    updateClockModel(senderTimeUs, arrivalTimeUs);
+
+    int64_t expectedUs = expectedArrivalTimeUs(senderTimeUs);
+    int64_t delayUs = arrivalTimeUs - expectedUs;
+
+    addDelaySample(delayUs);
+
+    int32_t newExtendedSeqNo = buffer->int32Data();
+
+    if (mLastDequeuedExtSeqNo >= 0
+            && newExtendedSeqNo <= mLastDequeuedExtSeqNo) {
+        if (newExtendedSeqNo + kMaxMisorder >= mLastDequeuedExtSeqNo) {
+            // Its slot was already played out or skipped over.
+            ALOGV("packet %d arrived %.2f ms late",
+                  newExtendedSeqNo, delayUs / 1E3);
+
+            ++mNumPacketsLate;
+            return;
+        }
+
+        ALOGI("sequence numbers restarted at %d", newExtendedSeqNo);
+        mLastDequeuedExtSeqNo = -1;
+    }
+
+    buffer->meta()->setInt64(
+            "expectedArrivalTimeUs",
+            expectedUs + mArrivalTimeBaseUs);
+
+    if (mPackets.empty()) {
+        mPackets.push_back(buffer);
+        mBytesQueued += buffer->size();
+        return;
+    }
+
+    List<sp<ABuffer> >::iterator firstIt = mPackets.begin();
+    List<sp<ABuffer> >::iterator it = --mPackets.end();
+    for (;;) {
+        int32_t extendedSeqNo = (*it)->int32Data();
+
+        if (extendedSeqNo == newExtendedSeqNo) {
+            // Duplicate packet.
+            return;
+        }
+
+        if (extendedSeqNo < newExtendedSeqNo) {
+            // Insert new packet after the one at "it".
+            mPackets.insert(++it, buffer);
+            break;
+        }
+
+        if (it == firstIt) {
+            // Insert new packet before the first existing one.
+            mPackets.insert(it, buffer);
+            break;
+        }
+
+        --it;
+    }
+
+    mBytesQueued += buffer->size();
+}
+
+sp<ABuffer> JitterBuffer::dequeueBuffer(
+        int64_t nowUs, int32_t *missingExtSeqNo, int64_t *retryTimeUs) {
+    *missingExtSeqNo = -1;
+    *retryTimeUs = -1ll;
+
+    if (mPackets.empty()) {
+        return NULL;
+    }
+
+    sp<ABuffer> buffer = *mPackets.begin();
+    int32_t extSeqNo = buffer->int32Data();
+
+    if (mLastDequeuedExtSeqNo >= 0 && extSeqNo != mLastDequeuedExtSeqNo + 1) {
+        // The next packet in sequence is missing, the packets following it
+        // are only held back until the missing one would be later than
+        // the jitter we've been seeing recently.
+
+        int64_t expectedArrivalTimeUs;
+        CHECK(buffer->meta()->findInt64(
+                    "expectedArrivalTimeUs", &expectedArrivalTimeUs));
+
+        int64_t deadlineUs = expectedArrivalTimeUs + mTargetDelayUs;
+
+        if (nowUs < deadlineUs) {
+            *missingExtSeqNo = mLastDequeuedExtSeqNo + 1;
+            *retryTimeUs = deadlineUs;
+            return NULL;
+        }
+
+        ALOGV("skipping over %d missing packet(s) at %d",
+              extSeqNo - mLastDequeuedExtSeqNo - 1,
+              mLastDequeuedExtSeqNo + 1);
+
+        mNumPacketsLost += extSeqNo - mLastDequeuedExtSeqNo - 1;
+        ++mNumConcealments;
+    }
+
+    mLastDequeuedExtSeqNo = extSeqNo;
+
+    mPackets.erase(mPackets.begin());
+    mBytesQueued -= buffer->size();
+
+    return buffer;
+}
+
+void JitterBuffer::updateClockModel(int64_t senderTimeUs, int64_t arrivalTimeUs) {
+    // The packets that made it across the fastest carry the least queueing
+    // delay, they define the lower envelope that the model follows.
+    int64_t transitUs = arrivalTimeUs - senderTimeUs;
+
+    if (mNumWindowPackets == 0 || transitUs < mWindowMinTransitUs) {
+        mWindowMinTransitUs = transitUs;
+        mWindowMinSenderTimeUs = senderTimeUs;
+    }
+
+    if (mNumClockSamples < 2) {
+        // Until there's enough data to estimate drift, assume none.
+        if (mNumPacketsReceived == 1 || transitUs < mOffsetUs) {
+            mOffsetUs = transitUs;
+        }
+    }
+
+    if (++mNumWindowPackets < kClockWindowSize) {
+        return;
+    }
+
+    mNumWindowPackets = 0;
+
+    mClockSamplesX[mClockSampleIndex] = mWindowMinSenderTimeUs;
+    mClockSamplesY[mClockSampleIndex] =
+        mWindowMinSenderTimeUs + mWindowMinTransitUs;
+
+    mClockSampleIndex = (mClockSampleIndex + 1) % kNumClockSamples;
+    if (mNumClockSamples < kNumClockSamples) {
+        ++mNumClockSamples;
+    }
+
+    if (mNumClockSamples < 2) {
+        return;
+    }
+
+    double meanX = 0.0;
+    double meanY = 0.0;
+    for (size_t i = 0; i < mNumClockSamples; ++i) {
+        meanX += mClockSamplesX[i];
+        meanY += mClockSamplesY[i];
+    }
+    meanX /= mNumClockSamples;
+    meanY /= mNumClockSamples;
+
+    double sumXX = 0.0;
+    double sumXY = 0.0;
+    for (size_t i = 0; i < mNumClockSamples; ++i) {
+        double x = mClockSamplesX[i] - meanX;
+        double y = mClockSamplesY[i] - meanY;
+
+        sumXX += x * x;
+        sumXY += x * y;
+    }
+
+    if (sumXX <= 0.0) {
+        return;
+    }
+
+    double rate = sumXY / sumXX;
+    if (rate < 1.0 - kMaxClockDrift) {
+        rate = 1.0 - kMaxClockDrift;
+    } else if (rate > 1.0 + kMaxClockDrift) {
+        rate = 1.0 + kMaxClockDrift;
+    }
+
+    // Shift the fitted line down so that it touches the lowest sample.
+    double offsetUs = mClockSamplesY[0] - rate * mClockSamplesX[0];
+    for (size_t i = 1; i < mNumClockSamples; ++i) {
+        double y = mClockSamplesY[i] - rate * mClockSamplesX[i];
+        if (y < offsetUs) {
+            offsetUs = y;
+        }
+    }
+
+    mClockRate = rate;
+    mOffsetUs = offsetUs;
+
+    ALOGV("clock drift %.1f ppm, offset %.2f ms",
+          (mClockRate - 1.0) * 1E6, mOffsetUs / 1E3);
+}
+
+int64_t JitterBuffer::expectedArrivalTimeUs(int64_t senderTimeUs) const {
+    return (int64_t)(mClockRate * senderTimeUs + mOffsetUs);
+}
+
+void JitterBuffer::addDelaySample(int64_t delayUs) {
+    if (delayUs > mMaxDelayUs) {
+        mMaxDelayUs = delayUs;
+    }
+
+    int64_t bin = delayUs / 1000ll;
+    if (bin < 0) {
+        bin = 0;
+    } else if (bin >= kNumDelayBins) {
+        bin = kNumDelayBins - 1;
+    }
+
+    if (mDelayHistoryCount == kDelayHistorySize) {
+        --mDelayBins[mDelayHistory[mDelayHistoryIndex]];
+    } else {
+        ++mDelayHistoryCount;
+    }
+
+    mDelayHistory[mDelayHistoryIndex] = bin;
+    ++mDelayBins[bin];
+
+    mDelayHistoryIndex = (mDelayHistoryIndex + 1) % kDelayHistorySize;
+
+    if (++mNumPacketsSinceTargetUpdate < kTargetUpdateInterval) {
+        return;
+    }
+
+    mNumPacketsSinceTargetUpdate = 0;
+
+    int64_t targetDelayUs = delayPercentileUs(kTargetPercentile);
+
+    if (targetDelayUs < kMinTargetDelayUs) {
+        targetDelayUs = kMinTargetDelayUs;
+    } else if (targetDelayUs > kMaxTargetDelayUs) {
+        targetDelayUs = kMaxTargetDelayUs;
+    }
+
+    if (targetDelayUs != mTargetDelayUs) {
+        ALOGV("target delay now %.2f ms", targetDelayUs / 1E3);
+        mTargetDelayUs = targetDelayUs;
+    }
+}
+
+int64_t JitterBuffer::delayPercentileUs(int32_t percentile) const {
+    if (mDelayHistoryCount == 0) {
+        return 0ll;
+    }
+
+    size_t threshold = (mDelayHistoryCount * percentile + 99) / 100;
+
+    size_t count = 0;
+    for (size_t bin = 0; bin < kNumDelayBins; ++bin) {
+        count += mDelayBins[bin];
+
+        if (count >= threshold) {
+            // Upper edge of the bin.
+            return (bin + 1) * 1000ll;
+        }
+    }
+
+    return kNumDelayBins * 1000ll;
+}
+
+void JitterBuffer::dump(AString *out) const {
+    out->append(StringPrintf(
+                "  target delay %.1f ms, jitter p50 %.1f ms, p95 %.1f ms, "
+                "max %.1f ms\n",
+                mTargetDelayUs / 1E3,
+                delayPercentileUs(50) / 1E3,
+                delayPercentileUs(95) / 1E3,
+                mMaxDelayUs / 1E3));
+
+    out->append(StringPrintf(
+                "  clock drift %.1f ppm, offset %.2f ms\n",
+                (mClockRate - 1.0) * 1E6,
+                mOffsetUs / 1E3));
+
+    out->append(StringPrintf(
+                "  packets received %lld, lost %lld (%lld concealments), "
+                "late %lld\n",
+                mNumPacketsReceived,
+                mNumPacketsLost,
+                mNumConcealments,
+                mNumPacketsLate));
+
+    out->append(StringPrintf(
+                "  queued %d packets, %lld bytes\n",
+                mPackets.size(),
+                mBytesQueued));
+}
+
+}  // namespace android
@@ -0,0 +1,128 @@
+/*
+ * Copyright 2012, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef JITTER_BUFFER_H_
+
+#define JITTER_BUFFER_H_
+
+#include <media/stagefright/foundation/ABase.h>
+#include <media/stagefright/foundation/AString.h>
+#include <utils/List.h>
+#include <utils/RefBase.h>
+
+namespace android {
+
+struct ABuffer;
+
+// Puts incoming RTP packets back into sequence number order and decides
+// how long to wait for a missing packet before giving up on it.
+//
+// A clock model maps the sender's RTP clock onto the local clock,
+// following the lower envelope of the observed transit times and
+// compensating for drift between the two clocks. The delay of a packet
+// beyond the modelled arrival time is its jitter, the wait for a missing
+// packet tracks a high percentile of the recent jitter.
+//
+// Not thread-safe, callers are expected to provide their own locking.
+struct JitterBuffer {
+    JitterBuffer();
+    ~JitterBuffer();
+
+    // The packet's extended sequence number is expected in "int32Data",
+    // its meta data must contain "rtp-time" and "arrivalTimeUs".
+    void queueBuffer(const sp<ABuffer> &buffer);
+
+    // Returns the next packet in sequence or NULL if there is none yet.
+    // If the next packet is missing, "*missingExtSeqNo" is set to its
+    // extended sequence number and "*retryTimeUs" to the time at which
+    // it will be skipped over, otherwise both are set to -1.
+    sp<ABuffer> dequeueBuffer(
+            int64_t nowUs, int32_t *missingExtSeqNo, int64_t *retryTimeUs);
+
+    int64_t bytesQueued() const;
+
+    void dump(AString *out) const;
+
+private:
+    enum {
+        // Number of packets over which the fastest (least delayed) one
+        // is taken as a sample of the clock offset.
+        kClockWindowSize = 128,
+
+        // Number of such samples the drift estimate is based on.
+        kNumClockSamples = 16,
+
+        // Jitter history in packets, bucketed into 1ms bins.
+        kDelayHistorySize = 512,
+        kNumDelayBins = 256,
+
+        // Recompute the target delay every so many packets.
+        kTargetUpdateInterval = 16,
+    };
+
+    static const int32_t kTargetPercentile = 95;
+    static const int64_t kMinTargetDelayUs = 2000ll;
+    static const int64_t kMaxTargetDelayUs = 200000ll;
+
+    List<sp<ABuffer> > mPackets;
+    int64_t mBytesQueued;
+    int32_t mLastDequeuedExtSeqNo;
+
+    // Clock model, relative to the first packet received.
+    bool mHaveClockBase;
+    int64_t mArrivalTimeBaseUs;
+    uint32_t mLastRTPTime;
+    int64_t mExtRTPTime;
+
+    size_t mNumWindowPackets;
+    int64_t mWindowMinTransitUs;
+    int64_t mWindowMinSenderTimeUs;
+
+    double mClockSamplesX[kNumClockSamples];
+    double mClockSamplesY[kNumClockSamples];
+    size_t mNumClockSamples;
+    size_t mClockSampleIndex;
+
+    // Local clock microseconds elapsing per sender clock microsecond.
+    double mClockRate;
+    double mOffsetUs;
+
+    // Jitter statistics.
+    uint8_t mDelayHistory[kDelayHistorySize];
+    size_t mDelayHistoryCount;
+    size_t mDelayHistoryIndex;
+    uint32_t mDelayBins[kNumDelayBins];
+    size_t mNumPacketsSinceTargetUpdate;
+    int64_t mTargetDelayUs;
+    int64_t mMaxDelayUs;
+
+    int64_t mNumPacketsReceived;
+    int64_t mNumPacketsLost;
+    int64_t mNumPacketsLate;
+    int64_t mNumConcealments;
+
+    void updateClockModel(int64_t senderTimeUs, int64_t arrivalTimeUs);
+    int64_t expectedArrivalTimeUs(int64_t senderTimeUs) const;
+
+    void addDelaySample(int64_t delayUs);
+    int64_t delayPercentileUs(int32_t percentile) const;
+
+    DISALLOW_EVIL_CONSTRUCTORS(JitterBuffer);
+};
+
+}  // namespace android
+
+#endif  // JITTER_BUFFER_H_
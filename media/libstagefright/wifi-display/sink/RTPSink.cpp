@@ -38,8 +38,14 @@ struct RTPSink::Source : public RefBase {
 
     bool updateSeq(uint16_t seq, const sp<ABuffer> &buffer);
 
+    // Updates the interarrival jitter estimate (RFC 3550, A.8), both
+    // times are in units of the 90kHz RTP clock.
+    void updateJitter(uint32_t rtpTime, int64_t arrivalTimeMedia);
+
     void addReportBlock(uint32_t ssrc, const sp<ABuffer> &buf);
 
+    void dump(uint32_t ssrc, AString *out) const;
+
 protected:
     virtual ~Source();
 
@@ -60,6 +66,10 @@ private:
     uint32_t mExpectedPrior;
     uint32_t mReceivedPrior;
 
+    bool mHaveTransit;
+    int32_t mTransit;
+    uint32_t mJitter;  // scaled by 16
+
     void initSeq(uint16_t seq);
     void queuePacket(const sp<ABuffer> &buffer);
 
@@ -72,7 +82,10 @@ RTPSink::Source::Source(
         uint16_t seq, const sp<ABuffer> &buffer,
         const sp<AMessage> queueBufferMsg)
     : mQueueBufferMsg(queueBufferMsg),
-      mProbation(kMinSequential) {
+      mProbation(kMinSequential),
+      mHaveTransit(false),
+      mTransit(0),
+      mJitter(0) {
     initSeq(seq);
     mMaxSeq = seq - 1;
 
@@ -165,6 +178,36 @@ bool RTPSink::Source::updateSeq(uint16_t seq, const sp<ABuffer> &buffer) {
     return true;
 }
 
+void RTPSink::Source::updateJitter(uint32_t rtpTime, int64_t arrivalTimeMedia) {
+    int32_t transit = (int32_t)((uint32_t)arrivalTimeMedia - rtpTime);
+
+    if (!mHaveTransit) {
+        mHaveTransit = true;
+        mTransit = transit;
+        return;
+    }
+
+    int32_t d = transit - mTransit;
+    mTransit = transit;
+
+    if (d < 0) {
+        d = -d;
+    }
+
+    mJitter += d - ((mJitter + 8) >> 4);
+}
+
+void RTPSink::Source::dump(uint32_t ssrc, AString *out) const {
+    uint32_t extMaxSeq = mMaxSeq | mCycles;
+    uint32_t expected = extMaxSeq - mBaseSeq + 1;
+
+    // jitter is kept in 1/16ths of the 90kHz RTP clock.
+    out->append(StringPrintf(
+                "  source 0x%08x: %u packets received, %u expected, "
+                "interarrival jitter %.2f ms\n",
+                ssrc, mReceived, expected, mJitter / (16 * 90.0)));
+}
+
 void RTPSink::Source::queuePacket(const sp<ABuffer> &buffer) {
     sp<AMessage> msg = mQueueBufferMsg->dup();
     msg->setBuffer("buffer", buffer);
@@ -216,12 +259,13 @@ void RTPSink::Source::addReportBlock(
     ptr[10] = (extMaxSeq >> 8) & 0xff;
     ptr[11] = extMaxSeq & 0xff;
 
-    // XXX TODO:
+    uint32_t jitter = mJitter >> 4;
+    ptr[12] = jitter >> 24;  // interarrival jitter
+    ptr[13] = (jitter >> 16) & 0xff;
+    ptr[14] = (jitter >> 8) & 0xff;
+    ptr[15] = jitter & 0xff;
 
-    ptr[12] = 0x00;  // interarrival jitter
-    ptr[13] = 0x00;
-    ptr[14] = 0x00;
-    ptr[15] = 0x00;
+    // XXX TODO:
 
     ptr[16] = 0x00;  // last SR
     ptr[17] = 0x00;
@@ -245,9 +289,7 @@ RTPSink::RTPSink(
       mRTPSessionID(0),
       mRTCPSessionID(0),
       mFirstArrivalTimeUs(-1ll),
-      mNumPacketsReceived(0ll),
-      mRegression(1000),
-      mMaxDelayMs(-1ll) {
+      mNumPacketsReceived(0ll) {
 }
 
 RTPSink::~RTPSink() {
@@ -398,6 +440,19 @@ void RTPSink::onMessageReceived(const sp<AMessage> &msg) {
     }
 }
 
+void RTPSink::dump(AString *out) const {
+    out->append(StringPrintf(
+                "RTPSink: %lld packets received\n", mNumPacketsReceived));
+
+    for (size_t i = 0; i < mSources.size(); ++i) {
+        mSources.valueAt(i)->dump(mSources.keyAt(i), out);
+    }
+
+    if (mRenderer != NULL) {
+        mRenderer->dump(out);
+    }
+}
+
 status_t RTPSink::injectPacket(bool isRTP, const sp<ABuffer> &buffer) {
     sp<AMessage> msg = new AMessage(kWhatInject, id());
     msg->setInt32("isRTP", isRTP);
@@ -483,24 +538,8 @@ status_t RTPSink::parseRTP(const sp<ABuffer> &buffer) {
     ALOGV("seqNo: %d, SSRC 0x%08x, diff %lld",
             seqNo, srcId, rtpTime - arrivalTimeMedia);
 
-    mRegression.addPoint((float)rtpTime, (float)arrivalTimeMedia);
-
     ++mNumPacketsReceived;
 
-    float n1, n2, b;
-    if (mRegression.approxLine(&n1, &n2, &b)) {
-        ALOGV("Line %lld: %.2f %.2f %.2f, slope %.2f",
-              mNumPacketsReceived, n1, n2, b, -n1 / n2);
-
-        float expectedArrivalTimeMedia = (b - n1 * (float)rtpTime) / n2;
-        float latenessMs = (arrivalTimeMedia - expectedArrivalTimeMedia) / 90.0;
-
-        if (mMaxDelayMs < 0ll || latenessMs > mMaxDelayMs) {
-            mMaxDelayMs = latenessMs;
-            ALOGI("packet was %.2f ms late", latenessMs);
-        }
-    }
-
     sp<AMessage> meta = buffer->meta();
     meta->setInt32("ssrc", srcId);
     meta->setInt32("rtp-time", rtpTime);
@@ -525,7 +564,9 @@ status_t RTPSink::parseRTP(const sp<ABuffer> &buffer) {
         sp<Source> source = new Source(seqNo, buffer, queueBufferMsg);
         mSources.add(srcId, source);
     } else {
-        mSources.valueAt(index)->updateSeq(seqNo, buffer);
+        const sp<Source> &source = mSources.valueAt(index);
+        source->updateJitter(rtpTime, arrivalTimeMedia);
+        source->updateSeq(seqNo, buffer);
     }
 
     return OK;
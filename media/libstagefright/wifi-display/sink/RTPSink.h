@@ -20,8 +20,6 @@
 
 #include <media/stagefright/foundation/AHandler.h>
 
-#include "LinearRegression.h"
-
 #include <gui/Surface.h>
 
 namespace android {
@@ -49,6 +47,10 @@ struct RTPSink : public AHandler {
 
     status_t injectPacket(bool isRTP, const sp<ABuffer> &buffer);
 
+    // Appends reception and jitter buffer statistics, must be called on
+    // the looper thread.
+    void dump(AString *out) const;
+
 protected:
     virtual void onMessageReceived(const sp<AMessage> &msg);
     virtual ~RTPSink();
@@ -75,8 +77,6 @@ private:
 
     int64_t mFirstArrivalTimeUs;
     int64_t mNumPacketsReceived;
-    LinearRegression mRegression;
-    int64_t mMaxDelayMs;
 
     sp<TunnelRenderer> mRenderer;
 
@@ -162,10 +162,11 @@ TunnelRenderer::TunnelRenderer(
         const sp<ISurfaceTexture> &surfaceTex)
     : mNotifyLost(notifyLost),
       mSurfaceTex(surfaceTex),
-      mTotalBytesQueued(0ll),
-      mLastDequeuedExtSeqNo(-1),
-      mFirstFailedAttemptUs(-1ll),
-      mRequestedRetransmission(false) {
+      mDrainQueuePending(false),
+      mDrainQueueTimeUs(0ll),
+      mDrainQueueGeneration(0),
+      mRetransmissionExtSeqNo(-1),
+      mNumRetransmissionRequests(0ll) {
 }
 
 TunnelRenderer::~TunnelRenderer() {
@@ -175,131 +176,76 @@ TunnelRenderer::~TunnelRenderer() {
 void TunnelRenderer::queueBuffer(const sp<ABuffer> &buffer) {
     Mutex::Autolock autoLock(mLock);
 
-    mTotalBytesQueued += buffer->size();
-
-    if (mPackets.empty()) {
-        mPackets.push_back(buffer);
-        return;
-    }
-
-    int32_t newExtendedSeqNo = buffer->int32Data();
-
-    List<sp<ABuffer> >::iterator firstIt = mPackets.begin();
-    List<sp<ABuffer> >::iterator it = --mPackets.end();
-    for (;;) {
-        int32_t extendedSeqNo = (*it)->int32Data();
-
-        if (extendedSeqNo == newExtendedSeqNo) {
-            // Duplicate packet.
-            return;
-        }
-
-        if (extendedSeqNo < newExtendedSeqNo) {
-            // Insert new packet after the one at "it".
-            mPackets.insert(++it, buffer);
-            return;
-        }
-
-        if (it == firstIt) {
-            // Insert new packet before the first existing one.
-            mPackets.insert(it, buffer);
-            return;
-        }
-
-        --it;
-    }
+    mJitterBuffer.queueBuffer(buffer);
 }
 
 sp<ABuffer> TunnelRenderer::dequeueBuffer() {
     Mutex::Autolock autoLock(mLock);
 
-    sp<ABuffer> buffer;
-    int32_t extSeqNo;
-    while (!mPackets.empty()) {
-        buffer = *mPackets.begin();
-        extSeqNo = buffer->int32Data();
+    int32_t missingExtSeqNo;
+    int64_t retryTimeUs;
+    sp<ABuffer> buffer = mJitterBuffer.dequeueBuffer(
+            ALooper::GetNowUs(), &missingExtSeqNo, &retryTimeUs);
 
-        if (mLastDequeuedExtSeqNo < 0 || extSeqNo > mLastDequeuedExtSeqNo) {
-            break;
-        }
-
-        // This is a retransmission of a packet we've already returned.
-
-        mTotalBytesQueued -= buffer->size();
-        buffer.clear();
-        extSeqNo = -1;
-
-        mPackets.erase(mPackets.begin());
-    }
-
-    if (mPackets.empty()) {
-        if (mFirstFailedAttemptUs < 0ll) {
-            mFirstFailedAttemptUs = ALooper::GetNowUs();
-            mRequestedRetransmission = false;
-        } else {
-            ALOGV("no packets available for %.2f secs",
-                    (ALooper::GetNowUs() - mFirstFailedAttemptUs) / 1E6);
-        }
-
-        return NULL;
-    }
+    if (buffer != NULL) {
+        if (mRetransmissionExtSeqNo >= 0) {
+            if (buffer->int32Data() == mRetransmissionExtSeqNo) {
+                ALOGI("Recovered after requesting retransmission of %d",
+                      mRetransmissionExtSeqNo);
+            }
 
-    if (mLastDequeuedExtSeqNo < 0 || extSeqNo == mLastDequeuedExtSeqNo + 1) {
-        if (mRequestedRetransmission) {
-            ALOGI("Recovered after requesting retransmission of %d",
-                  extSeqNo);
+            mRetransmissionExtSeqNo = -1;
         }
 
-        mLastDequeuedExtSeqNo = extSeqNo;
-        mFirstFailedAttemptUs = -1ll;
-        mRequestedRetransmission = false;
-
-        mPackets.erase(mPackets.begin());
-
-        mTotalBytesQueued -= buffer->size();
-
         return buffer;
     }
 
-    if (mFirstFailedAttemptUs < 0ll) {
-        mFirstFailedAttemptUs = ALooper::GetNowUs();
-
-        ALOGI("failed to get the correct packet the first time.");
+    if (missingExtSeqNo < 0) {
         return NULL;
     }
 
-    if (mFirstFailedAttemptUs + 50000ll > ALooper::GetNowUs()) {
-        // We're willing to wait a little while to get the right packet.
+    if (missingExtSeqNo != mRetransmissionExtSeqNo) {
+        ALOGV("requesting retransmission of seqNo %d",
+              missingExtSeqNo & 0xffff);
 
-        if (!mRequestedRetransmission) {
-            ALOGI("requesting retransmission of seqNo %d",
-                  (mLastDequeuedExtSeqNo + 1) & 0xffff);
+        sp<AMessage> notify = mNotifyLost->dup();
+        notify->setInt32("seqNo", missingExtSeqNo & 0xffff);
+        notify->post();
 
-            sp<AMessage> notify = mNotifyLost->dup();
-            notify->setInt32("seqNo", (mLastDequeuedExtSeqNo + 1) & 0xffff);
-            notify->post();
+        mRetransmissionExtSeqNo = missingExtSeqNo;
+        ++mNumRetransmissionRequests;
+    }
 
-            mRequestedRetransmission = true;
-        } else {
-            ALOGI("still waiting for the correct packet to arrive.");
-        }
+    scheduleDrainQueue_l(retryTimeUs);
 
-        return NULL;
+    return NULL;
+}
+
+void TunnelRenderer::scheduleDrainQueue_l(int64_t whenUs) {
+    if (mDrainQueuePending && whenUs >= mDrainQueueTimeUs) {
+        return;
     }
 
-    ALOGI("dropping packet. extSeqNo %d didn't arrive in time",
-            mLastDequeuedExtSeqNo + 1);
+    // An earlier deadline supersedes the pending drain, which is then
+    // ignored when it fires.
+    mDrainQueuePending = true;
+    mDrainQueueTimeUs = whenUs;
 
-    // Permanent failure, we never received the packet.
-    mLastDequeuedExtSeqNo = extSeqNo;
-    mFirstFailedAttemptUs = -1ll;
-    mRequestedRetransmission = false;
+    sp<AMessage> msg = new AMessage(kWhatDrainQueue, id());
+    msg->setInt32("generation", ++mDrainQueueGeneration);
 
-    mTotalBytesQueued -= buffer->size();
+    int64_t delayUs = whenUs - ALooper::GetNowUs();
+    msg->post(delayUs > 0ll ? delayUs : 0ll);
+}
+
+void TunnelRenderer::dump(AString *out) const {
+    Mutex::Autolock autoLock(mLock);
 
-    mPackets.erase(mPackets.begin());
+    mJitterBuffer.dump(out);
 
-    return buffer;
+    out->append(StringPrintf(
+                "  retransmission requests %lld\n",
+                mNumRetransmissionRequests));
 }
 
 void TunnelRenderer::onMessageReceived(const sp<AMessage> &msg) {
@@ -312,10 +258,16 @@ void TunnelRenderer::onMessageReceived(const sp<AMessage> &msg) {
             queueBuffer(buffer);
 
             if (mStreamSource == NULL) {
-                if (mTotalBytesQueued > 0ll) {
+                int64_t bytesQueued;
+                {
+                    Mutex::Autolock autoLock(mLock);
+                    bytesQueued = mJitterBuffer.bytesQueued();
+                }
+
+                if (bytesQueued > 0ll) {
                     initPlayer();
                 } else {
-                    ALOGI("Have %lld bytes queued...", mTotalBytesQueued);
+                    ALOGI("Have %lld bytes queued...", bytesQueued);
                 }
             } else {
                 mStreamSource->doSomeWork();
@@ -323,6 +275,25 @@ void TunnelRenderer::onMessageReceived(const sp<AMessage> &msg) {
             break;
         }
 
+        case kWhatDrainQueue:
+        {
+            int32_t generation;
+            CHECK(msg->findInt32("generation", &generation));
+
+            {
+                Mutex::Autolock autoLock(mLock);
+                if (generation != mDrainQueueGeneration) {
+                    break;
+                }
+                mDrainQueuePending = false;
+            }
+
+            if (mStreamSource != NULL) {
+                mStreamSource->doSomeWork();
+            }
+            break;
+        }
+
         default:
             TRESPASS();
     }
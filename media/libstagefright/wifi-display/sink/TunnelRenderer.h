@@ -18,6 +18,8 @@
 
 #define TUNNEL_RENDERER_H_
 
+#include "JitterBuffer.h"
+
 #include <gui/Surface.h>
 #include <media/stagefright/foundation/AHandler.h>
 
@@ -40,8 +42,11 @@ struct TunnelRenderer : public AHandler {
 
     sp<ABuffer> dequeueBuffer();
 
+    void dump(AString *out) const;
+
     enum {
         kWhatQueueBuffer,
+        kWhatDrainQueue,
     };
 
 protected:
@@ -57,8 +62,10 @@ private:
     sp<AMessage> mNotifyLost;
     sp<ISurfaceTexture> mSurfaceTex;
 
-    List<sp<ABuffer> > mPackets;
-    int64_t mTotalBytesQueued;
+    JitterBuffer mJitterBuffer;
+    bool mDrainQueuePending;
+    int64_t mDrainQueueTimeUs;
+    int32_t mDrainQueueGeneration;
 
     sp<SurfaceComposerClient> mComposerClient;
     sp<SurfaceControl> mSurfaceControl;
@@ -67,15 +74,18 @@ private:
     sp<IMediaPlayer> mPlayer;
     sp<StreamSource> mStreamSource;
 
-    int32_t mLastDequeuedExtSeqNo;
-    int64_t mFirstFailedAttemptUs;
-    bool mRequestedRetransmission;
+    int32_t mRetransmissionExtSeqNo;
+    int64_t mNumRetransmissionRequests;
 
     void initPlayer();
     void destroyPlayer();
 
     void queueBuffer(const sp<ABuffer> &buffer);
 
+    // Makes sure the player gets another chance to pull data once the
+    // jitter buffer stops waiting for a missing packet.
+    void scheduleDrainQueue_l(int64_t whenUs);
+
     DISALLOW_EVIL_CONSTRUCTORS(TunnelRenderer);
 };
 
@@ -27,6 +27,8 @@
 #include <media/stagefright/foundation/AMessage.h>
 #include <media/stagefright/MediaErrors.h>
 
+#include <unistd.h>
+
 namespace android {
 
 WifiDisplaySink::WifiDisplaySink(
@@ -55,6 +57,24 @@ void WifiDisplaySink::start(const char *uri) {
     msg->post();
 }
 
+status_t WifiDisplaySink::dump(int fd, const Vector<String16> &args) {
+    sp<AMessage> msg = new AMessage(kWhatDump, id());
+
+    sp<AMessage> response;
+    status_t err = msg->postAndAwaitResponse(&response);
+
+    if (err != OK) {
+        return err;
+    }
+
+    AString out;
+    CHECK(response->findString("dump", &out));
+
+    write(fd, out.c_str(), out.size());
+
+    return OK;
+}
+
 // static
 bool WifiDisplaySink::ParseURL(
         const char *url, AString *host, int32_t *port, AString *path,
@@ -227,6 +247,22 @@ void WifiDisplaySink::onMessageReceived(const sp<AMessage> &msg) {
             break;
         }
 
+        case kWhatDump:
+        {
+            uint32_t replyID;
+            CHECK(msg->senderAwaitsResponse(&replyID));
+
+            AString out = "WifiDisplaySink\n";
+            if (mRTPSink != NULL) {
+                mRTPSink->dump(&out);
+            }
+
+            sp<AMessage> response = new AMessage;
+            response->setString("dump", out.c_str());
+            response->postReply(replyID);
+            break;
+        }
+
         default:
             TRESPASS();
     }
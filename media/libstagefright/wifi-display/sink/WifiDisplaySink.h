@@ -22,6 +22,8 @@
 
 #include <gui/Surface.h>
 #include <media/stagefright/foundation/AHandler.h>
+#include <utils/String16.h>
+#include <utils/Vector.h>
 
 namespace android {
 
@@ -39,6 +41,8 @@ struct WifiDisplaySink : public AHandler {
     void start(const char *sourceHost, int32_t sourcePort);
     void start(const char *uri);
 
+    status_t dump(int fd, const Vector<String16> &args);
+
 protected:
     virtual ~WifiDisplaySink();
     virtual void onMessageReceived(const sp<AMessage> &msg);
@@ -56,6 +60,7 @@ private:
         kWhatStart,
         kWhatRTSPNotify,
         kWhatStop,
+        kWhatDump,
     };
 
     struct ResponseID {
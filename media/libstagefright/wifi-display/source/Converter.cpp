@@ -48,6 +48,7 @@ Converter::Converter(
       mInputFormat(format),
       mIsVideo(false),
       mIsPCMAudio(usePCMAudio),
+      mVideoBitrate(0),
       mDoMoreWorkPending(false)
 #if ENABLE_SILENCE_DETECTION
       ,mFirstSilentFrameUs(-1ll)
@@ -94,6 +95,10 @@ sp<AMessage> Converter::getOutputFormat() const {
     return mOutputFormat;
 }
 
+int32_t Converter::getVideoBitrate() const {
+    return mVideoBitrate;
+}
+
 static int32_t getBitrate(const char *propName, int32_t defaultValue) {
     char val[PROPERTY_VALUE_MAX];
     if (property_get(propName, val, NULL)) {
@@ -153,6 +158,7 @@ status_t Converter::initEncoder() {
     if (isAudio) {
         mOutputFormat->setInt32("bitrate", audioBitrate);
     } else {
+        mVideoBitrate = videoBitrate;
         mOutputFormat->setInt32("bitrate", videoBitrate);
         mOutputFormat->setInt32("bitrate-mode", OMX_Video_ControlRateConstant);
         mOutputFormat->setInt32("frame-rate", 30);
@@ -332,6 +338,24 @@ void Converter::onMessageReceived(const sp<AMessage> &msg) {
             break;
         }
 
+        case kWhatSetVideoBitrate:
+        {
+            if (mEncoder == NULL || !mIsVideo) {
+                break;
+            }
+
+            int32_t bitrate;
+            CHECK(msg->findInt32("bitrate", &bitrate));
+
+            ALOGI("changing video bitrate to %d bps", bitrate);
+
+            sp<AMessage> params = new AMessage;
+            params->setInt32("videoBitrate", bitrate);
+
+            mEncoder->setParameters(params);
+            break;
+        }
+
         case kWhatShutdown:
         {
             ALOGI("shutting down encoder");
@@ -603,4 +627,10 @@ void Converter::requestIDRFrame() {
     (new AMessage(kWhatRequestIDRFrame, id()))->post();
 }
 
+void Converter::setVideoBitrate(int32_t bitrate) {
+    sp<AMessage> msg = new AMessage(kWhatSetVideoBitrate, id());
+    msg->setInt32("bitrate", bitrate);
+    msg->post();
+}
+
 }  // namespace android
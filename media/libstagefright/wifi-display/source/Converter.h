@@ -50,6 +50,12 @@ struct Converter : public AHandler {
 
     void requestIDRFrame();
 
+    // Retunes the video encoder's target bitrate mid-session.
+    void setVideoBitrate(int32_t bitrate);
+
+    // The bitrate the video encoder was initially configured with.
+    int32_t getVideoBitrate() const;
+
     enum {
         kWhatAccessUnit,
         kWhatEOS,
@@ -59,6 +65,7 @@ struct Converter : public AHandler {
     enum {
         kWhatDoMoreWork,
         kWhatRequestIDRFrame,
+        kWhatSetVideoBitrate,
         kWhatShutdown,
         kWhatMediaPullerNotify,
         kWhatEncoderActivity,
@@ -78,6 +85,7 @@ private:
     bool mIsVideo;
     bool mIsPCMAudio;
     sp<AMessage> mOutputFormat;
+    int32_t mVideoBitrate;
 
     sp<MediaCodec> mEncoder;
     sp<AMessage> mEncoderActivityNotify;
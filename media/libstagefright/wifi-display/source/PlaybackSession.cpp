@@ -322,7 +322,15 @@ WifiDisplaySource::PlaybackSession::PlaybackSession(
       mWeAreDead(false),
       mLastLifesignUs(),
       mVideoTrackIndex(-1),
+      mVideoBitrate(0),
+      mMaxVideoBitrate(0),
+      mLastVideoBitrateChangeUs(-1ll),
+      mLastCongestionUs(-1ll),
       mPrevTimeUs(-1ll),
+      mLatencyNumFrames(0),
+      mAvgLatencyUs(0ll),
+      mMaxLatencyUs(0ll),
+      mMaxQueueSize(0),
       mAllTracksHavePacketizerIndex(false) {
 }
 
@@ -367,6 +375,16 @@ int32_t WifiDisplaySource::PlaybackSession::getRTPPort() const {
     return mSender->getRTPPort();
 }
 
+void WifiDisplaySource::PlaybackSession::dump(AString *out) const {
+    Mutex::Autolock autoLock(mLatencyLock);
+
+    out->append(StringPrintf(
+                "PlaybackSession: frame-to-wire latency avg %.2f ms, "
+                "max %.2f ms (%d frames), max queue %zu bytes\n",
+                mAvgLatencyUs / 1E3, mMaxLatencyUs / 1E3, mLatencyNumFrames,
+                mMaxQueueSize));
+}
+
 int64_t WifiDisplaySource::PlaybackSession::getLastLifesignUs() const {
     return mLastLifesignUs;
 }
@@ -511,6 +529,44 @@ void WifiDisplaySource::PlaybackSession::onMessageReceived(
                 onFinishPlay2();
             } else if (what == Sender::kWhatSessionDead) {
                 notifySessionDead();
+            } else if (what == Sender::kWhatLatencyStats) {
+                int32_t numFrames;
+                int64_t avgLatencyUs, maxLatencyUs;
+                CHECK(msg->findInt32("numFrames", &numFrames));
+                CHECK(msg->findInt64("avgLatencyUs", &avgLatencyUs));
+                CHECK(msg->findInt64("maxLatencyUs", &maxLatencyUs));
+
+                int64_t avgSendDelayUs;
+                CHECK(msg->findInt64("avgSendDelayUs", &avgSendDelayUs));
+
+                size_t maxQueueSize;
+                CHECK(msg->findSize("maxQueueSize", &maxQueueSize));
+
+                ALOGV("frame-to-wire latency avg %.2f ms, max %.2f ms "
+                      "(%d frames), max queue %d bytes",
+                      avgLatencyUs / 1E3, maxLatencyUs / 1E3, numFrames,
+                      maxQueueSize);
+
+                {
+                    Mutex::Autolock autoLock(mLatencyLock);
+                    mLatencyNumFrames = numFrames;
+                    mAvgLatencyUs = avgLatencyUs;
+                    mMaxLatencyUs = maxLatencyUs;
+                    mMaxQueueSize = maxQueueSize;
+                }
+
+                onLatencyStats(avgSendDelayUs, maxQueueSize);
+            } else if (what == Sender::kWhatReceiverReport) {
+                int32_t fractionLost;
+                CHECK(msg->findInt32("fractionLost", &fractionLost));
+
+                int64_t jitterUs;
+                CHECK(msg->findInt64("jitterUs", &jitterUs));
+
+                ALOGV("receiver report: %.1f %% lost, jitter %.2f ms",
+                      fractionLost * 100.0 / 256, jitterUs / 1E3);
+
+                onReceiverReport(fractionLost, jitterUs);
             } else {
                 TRESPASS();
             }
@@ -750,6 +806,101 @@ void WifiDisplaySource::PlaybackSession::requestIDRFrame() {
     }
 }
 
+void WifiDisplaySource::PlaybackSession::onReceiverReport(
+        int32_t fractionLost, int64_t jitterUs) {
+    // Anything beyond ~2% loss or 40ms of jitter means the link can't
+    // sustain the current rate.
+    static const int32_t kMaxFractionLost = 5;  // in units of 1/256
+    static const int64_t kMaxJitterUs = 40000ll;
+
+    adaptVideoBitrate(
+            fractionLost > kMaxFractionLost || jitterUs > kMaxJitterUs);
+}
+
+void WifiDisplaySource::PlaybackSession::onLatencyStats(
+        int64_t avgSendDelayUs, size_t maxQueueSize) {
+    // Data queueing up in front of the socket is the earliest sign of a
+    // link that can't keep up, long before the sink reports any loss.
+    // Frames are paced by their timestamps, only the delay beyond the
+    // scheduled send time says anything about the link.
+    static const size_t kMaxQueueSize = 64 * 1024;
+    static const int64_t kMaxAvgSendDelayUs = 50000ll;
+
+    adaptVideoBitrate(
+            maxQueueSize > kMaxQueueSize
+                || avgSendDelayUs > kMaxAvgSendDelayUs);
+}
+
+void WifiDisplaySource::PlaybackSession::adaptVideoBitrate(bool congested) {
+    static const int32_t kMinVideoBitrate = 500000;
+
+    // Give the encoder and the link some time to settle before reacting
+    // again, and only probe for more bandwidth after a quiet period.
+    static const int64_t kMinDecreaseIntervalUs = 1000000ll;
+    static const int64_t kMinIncreaseIntervalUs = 4000000ll;
+
+    if (mVideoTrackIndex < 0) {
+        return;
+    }
+
+    const sp<Converter> &converter =
+        mTracks.valueFor(mVideoTrackIndex)->converter();
+
+    if (mMaxVideoBitrate == 0) {
+        mMaxVideoBitrate = mVideoBitrate = converter->getVideoBitrate();
+
+        if (mMaxVideoBitrate <= 0) {
+            return;
+        }
+    }
+
+    int64_t nowUs = ALooper::GetNowUs();
+
+    int32_t bitrate = mVideoBitrate;
+
+    if (congested) {
+        mLastCongestionUs = nowUs;
+
+        if (mLastVideoBitrateChangeUs >= 0ll
+                && nowUs - mLastVideoBitrateChangeUs < kMinDecreaseIntervalUs) {
+            return;
+        }
+
+        // Multiplicative decrease.
+        bitrate = (bitrate / 4) * 3;
+        if (bitrate < kMinVideoBitrate) {
+            bitrate = kMinVideoBitrate;
+        }
+    } else {
+        if ((mLastCongestionUs >= 0ll
+                    && nowUs - mLastCongestionUs < kMinIncreaseIntervalUs)
+                || (mLastVideoBitrateChangeUs >= 0ll
+                    && nowUs - mLastVideoBitrateChangeUs
+                        < kMinIncreaseIntervalUs)) {
+            return;
+        }
+
+        // Additive increase.
+        bitrate += mMaxVideoBitrate / 16;
+        if (bitrate > mMaxVideoBitrate) {
+            bitrate = mMaxVideoBitrate;
+        }
+    }
+
+    if (bitrate == mVideoBitrate) {
+        return;
+    }
+
+    ALOGI("%s video bitrate from %d to %d bps",
+          bitrate < mVideoBitrate ? "lowering" : "raising",
+          mVideoBitrate, bitrate);
+
+    mVideoBitrate = bitrate;
+    mLastVideoBitrateChangeUs = nowUs;
+
+    converter->setVideoBitrate(bitrate);
+}
+
 bool WifiDisplaySource::PlaybackSession::allTracksHavePacketizerIndex() {
     if (mAllTracksHavePacketizerIndex) {
         return true;
@@ -771,7 +922,8 @@ status_t WifiDisplaySource::PlaybackSession::packetizeAccessUnit(
         sp<ABuffer> *packets) {
     const sp<Track> &track = mTracks.valueFor(trackIndex);
 
-    uint32_t flags = 0;
+    // The sender transmits the packets in place.
+    uint32_t flags = TSPacketizer::RESERVE_RTP_HEADERS;
 
     bool isHDCPEncrypted = false;
     uint64_t inputCTR;
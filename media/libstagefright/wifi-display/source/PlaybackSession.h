@@ -62,6 +62,8 @@ struct WifiDisplaySource::PlaybackSession : public AHandler {
 
     void requestIDRFrame();
 
+    void dump(AString *out) const;
+
     enum {
         kWhatSessionDead,
         kWhatBinaryData,
@@ -102,8 +104,24 @@ private:
     KeyedVector<size_t, sp<Track> > mTracks;
     ssize_t mVideoTrackIndex;
 
+    // Video rate adaptation, the encoder starts out at mMaxVideoBitrate and
+    // backs off whenever the sink reports loss/jitter or packets pile up
+    // in front of the network.
+    int32_t mVideoBitrate;
+    int32_t mMaxVideoBitrate;
+    int64_t mLastVideoBitrateChangeUs;
+    int64_t mLastCongestionUs;
+
     int64_t mPrevTimeUs;
 
+    // The latest frame-to-wire latency report from the sender, read by
+    // dump() on the source's thread.
+    mutable Mutex mLatencyLock;
+    int32_t mLatencyNumFrames;
+    int64_t mAvgLatencyUs;
+    int64_t mMaxLatencyUs;
+    size_t mMaxQueueSize;
+
     bool mAllTracksHavePacketizerIndex;
 
     status_t setupPacketizer(bool usePCMAudio);
@@ -134,6 +152,10 @@ private:
 
     void notifySessionDead();
 
+    void onReceiverReport(int32_t fractionLost, int64_t jitterUs);
+    void onLatencyStats(int64_t avgSendDelayUs, size_t maxQueueSize);
+    void adaptVideoBitrate(bool congested);
+
     void drainAccessUnits();
 
     // Returns true iff an access unit was successfully drained.
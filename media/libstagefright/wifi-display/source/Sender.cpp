@@ -21,7 +21,9 @@
 #include "Sender.h"
 
 #include "ANetworkSession.h"
+#include "TSPacketizer.h"
 
+#include <cutils/properties.h>
 #include <media/stagefright/foundation/ABuffer.h>
 #include <media/stagefright/foundation/ADebug.h>
 #include <media/stagefright/foundation/AMessage.h>
@@ -102,15 +104,18 @@ double TimeSeries::sdev() const {
 
 ////////////////////////////////////////////////////////////////////////////////
 
-static size_t kMaxRTPPacketSize = 1500;
-static size_t kMaxNumTSPacketsPerRTPPacket = (kMaxRTPPacketSize - 12) / 188;
+static const size_t kMaxRTPPacketSize =
+    TSPacketizer::kRTPHeaderSize
+        + TSPacketizer::kNumTSPacketsPerRTPPacket * 188;
+
+// Frame-to-wire latency statistics are reported this often.
+static const int64_t kLatencyReportIntervalUs = 1000000ll;
 
 Sender::Sender(
         const sp<ANetworkSession> &netSession,
         const sp<AMessage> &notify)
     : mNetSession(netSession),
       mNotify(notify),
-      mTSQueue(new ABuffer(12 + kMaxNumTSPacketsPerRTPPacket * 188)),
       mTransportMode(TRANSPORT_UDP),
       mRTPChannel(0),
       mRTCPChannel(0),
@@ -136,7 +141,14 @@ Sender::Sender(
       mNumRTPSent(0),
       mNumRTPOctetsSent(0),
       mNumSRsSent(0),
-      mSendSRPending(false)
+      mSendSRPending(false),
+      mLatencyReportStartUs(-1ll),
+      mNumLatencyFrames(0),
+      mTotalLatencyUs(0ll),
+      mTotalSendDelayUs(0ll),
+      mMaxLatencyUs(0ll),
+      mMaxQueueSize(0),
+      mEmulatedPacketLossPercent(0)
 #if ENABLE_RETRANSMISSION
       ,mHistoryLength(0)
 #endif
@@ -148,11 +160,19 @@ Sender::Sender(
     ,mLogFile(NULL)
 #endif
 {
-    mTSQueue->setRange(0, 12);
-
 #if LOG_TRANSPORT_STREAM
     mLogFile = fopen("/system/etc/log.ts", "wb");
 #endif
+
+    char val[PROPERTY_VALUE_MAX];
+    if (property_get("media.wfd.emulate-packet-loss", val, NULL)) {
+        mEmulatedPacketLossPercent = atoi(val);
+
+        if (mEmulatedPacketLossPercent > 0) {
+            ALOGI("emulating %d%% RTP packet loss",
+                  mEmulatedPacketLossPercent);
+        }
+    }
 }
 
 Sender::~Sender() {
@@ -551,15 +571,53 @@ void Sender::onQueuePackets(const sp<ABuffer> &packets) {
 
     int64_t startTimeUs = ALooper::GetNowUs();
 
-    for (size_t offset = 0;
-            offset < packets->size(); offset += 188) {
-        bool lastTSPacket = (offset + 188 >= packets->size());
+    // The packetizer left room for an RTP header in front of every run of
+    // up to kNumTSPacketsPerRTPPacket transport stream packets, fill them
+    // in and send the packets straight out of the packetizer's buffer.
+    size_t offset = 0;
+    while (offset < packets->size()) {
+        size_t size = packets->size() - offset;
+        if (size > kMaxRTPPacketSize) {
+            size = kMaxRTPPacketSize;
+        }
+
+        CHECK_EQ((size - TSPacketizer::kRTPHeaderSize) % 188, 0u);
+
+        sendRTPPacket(
+                packets->data() + offset, size,
+                true /* timeDiscontinuity */);
+
+#if LOG_TRANSPORT_STREAM
+        if (mLogFile != NULL) {
+            fwrite(packets->data() + offset + TSPacketizer::kRTPHeaderSize,
+                   1,
+                   size - TSPacketizer::kRTPHeaderSize,
+                   mLogFile);
+        }
+#endif
+
+        offset += size;
+    }
 
-        appendTSData(
-                packets->data() + offset,
-                188,
-                true /* timeDiscontinuity */,
-                lastTSPacket /* flush */);
+    size_t queueSize;
+    if (mRTPSessionID != 0
+            && mNetSession->getOutgoingQueueSize(
+                mRTPSessionID, &queueSize) == OK
+            && queueSize > mMaxQueueSize) {
+        mMaxQueueSize = queueSize;
+    }
+
+    int32_t dummy;
+    if (packets->meta()->findInt32("isVideo", &dummy)) {
+        int64_t timeUs;
+        CHECK(packets->meta()->findInt64("timeUs", &timeUs));
+
+        int64_t whenUs;
+        CHECK(packets->meta()->findInt64("whenUs", &whenUs));
+
+        // Video frames are timestamped at capture time, on the same clock.
+        int64_t nowUs = ALooper::GetNowUs();
+        updateLatencyStats(nowUs - timeUs, nowUs - whenUs);
     }
 
 #if 0
@@ -584,102 +642,125 @@ void Sender::onQueuePackets(const sp<ABuffer> &packets) {
               isVideo ? "video" : "audio", delayUs, nowUs - netTimeUs - whenUs);
     }
 #endif
+}
 
-#if LOG_TRANSPORT_STREAM
-    if (mLogFile != NULL) {
-        fwrite(packets->data(), 1, packets->size(), mLogFile);
+void Sender::updateLatencyStats(int64_t latencyUs, int64_t sendDelayUs) {
+    int64_t nowUs = ALooper::GetNowUs();
+
+    if (mLatencyReportStartUs < 0ll) {
+        mLatencyReportStartUs = nowUs;
     }
-#endif
-}
 
-ssize_t Sender::appendTSData(
-        const void *data, size_t size, bool timeDiscontinuity, bool flush) {
-    CHECK_EQ(size, 188);
+    ++mNumLatencyFrames;
+    mTotalLatencyUs += latencyUs;
+    mTotalSendDelayUs += sendDelayUs > 0ll ? sendDelayUs : 0ll;
 
-    CHECK_LE(mTSQueue->size() + size, mTSQueue->capacity());
+    if (latencyUs > mMaxLatencyUs) {
+        mMaxLatencyUs = latencyUs;
+    }
 
-    memcpy(mTSQueue->data() + mTSQueue->size(), data, size);
-    mTSQueue->setRange(0, mTSQueue->size() + size);
+    if (nowUs - mLatencyReportStartUs < kLatencyReportIntervalUs) {
+        return;
+    }
 
-    if (flush || mTSQueue->size() == mTSQueue->capacity()) {
-        // flush
+    int64_t avgLatencyUs = mTotalLatencyUs / mNumLatencyFrames;
 
-        int64_t nowUs = ALooper::GetNowUs();
+    sp<AMessage> notify = mNotify->dup();
+    notify->setInt32("what", kWhatLatencyStats);
+    notify->setInt32("numFrames", mNumLatencyFrames);
+    notify->setInt64("avgLatencyUs", avgLatencyUs);
+    notify->setInt64("maxLatencyUs", mMaxLatencyUs);
+    notify->setInt64("avgSendDelayUs", mTotalSendDelayUs / mNumLatencyFrames);
+    notify->setSize("maxQueueSize", mMaxQueueSize);
+    notify->post();
+
+    mLatencyReportStartUs = nowUs;
+    mNumLatencyFrames = 0;
+    mTotalLatencyUs = 0ll;
+    mMaxLatencyUs = 0ll;
+    mTotalSendDelayUs = 0ll;
+    mMaxQueueSize = 0;
+}
+
+void Sender::sendRTPPacket(
+        uint8_t *rtp, size_t size, bool timeDiscontinuity) {
+    int64_t nowUs = ALooper::GetNowUs();
 
 #if TRACK_BANDWIDTH
-        if (mFirstPacketTimeUs < 0ll) {
-            mFirstPacketTimeUs = nowUs;
-        }
+    if (mFirstPacketTimeUs < 0ll) {
+        mFirstPacketTimeUs = nowUs;
+    }
 #endif
 
-        // 90kHz time scale
-        uint32_t rtpTime = (nowUs * 9ll) / 100ll;
-
-        uint8_t *rtp = mTSQueue->data();
-        rtp[0] = 0x80;
-        rtp[1] = 33 | (timeDiscontinuity ? (1 << 7) : 0);  // M-bit
-        rtp[2] = (mRTPSeqNo >> 8) & 0xff;
-        rtp[3] = mRTPSeqNo & 0xff;
-        rtp[4] = rtpTime >> 24;
-        rtp[5] = (rtpTime >> 16) & 0xff;
-        rtp[6] = (rtpTime >> 8) & 0xff;
-        rtp[7] = rtpTime & 0xff;
-        rtp[8] = kSourceID >> 24;
-        rtp[9] = (kSourceID >> 16) & 0xff;
-        rtp[10] = (kSourceID >> 8) & 0xff;
-        rtp[11] = kSourceID & 0xff;
-
-        ++mRTPSeqNo;
-        ++mNumRTPSent;
-        mNumRTPOctetsSent += mTSQueue->size() - 12;
-
-        mLastRTPTime = rtpTime;
-        mLastNTPTime = GetNowNTP();
-
-        if (mTransportMode == TRANSPORT_TCP_INTERLEAVED) {
-            sp<AMessage> notify = mNotify->dup();
-            notify->setInt32("what", kWhatBinaryData);
+    // 90kHz time scale
+    uint32_t rtpTime = (nowUs * 9ll) / 100ll;
+
+    rtp[0] = 0x80;
+    rtp[1] = 33 | (timeDiscontinuity ? (1 << 7) : 0);  // M-bit
+    rtp[2] = (mRTPSeqNo >> 8) & 0xff;
+    rtp[3] = mRTPSeqNo & 0xff;
+    rtp[4] = rtpTime >> 24;
+    rtp[5] = (rtpTime >> 16) & 0xff;
+    rtp[6] = (rtpTime >> 8) & 0xff;
+    rtp[7] = rtpTime & 0xff;
+    rtp[8] = kSourceID >> 24;
+    rtp[9] = (kSourceID >> 16) & 0xff;
+    rtp[10] = (kSourceID >> 8) & 0xff;
+    rtp[11] = kSourceID & 0xff;
+
+    ++mRTPSeqNo;
+    ++mNumRTPSent;
+    mNumRTPOctetsSent += size - 12;
+
+    mLastRTPTime = rtpTime;
+    mLastNTPTime = GetNowNTP();
+
+    if (mTransportMode == TRANSPORT_TCP_INTERLEAVED) {
+        sp<AMessage> notify = mNotify->dup();
+        notify->setInt32("what", kWhatBinaryData);
 
-            sp<ABuffer> data = new ABuffer(mTSQueue->size());
-            memcpy(data->data(), rtp, mTSQueue->size());
+        sp<ABuffer> data = new ABuffer(size);
+        memcpy(data->data(), rtp, size);
 
-            notify->setInt32("channel", mRTPChannel);
-            notify->setBuffer("data", data);
-            notify->post();
-        } else {
-            sendPacket(mRTPSessionID, rtp, mTSQueue->size());
+        notify->setInt32("channel", mRTPChannel);
+        notify->setBuffer("data", data);
+        notify->post();
+    } else if (mEmulatedPacketLossPercent > 0
+            && (rand() % 100) < mEmulatedPacketLossPercent) {
+        // Pretend the packet got lost on the way.
+    } else {
+        sendPacket(mRTPSessionID, rtp, size);
 
 #if TRACK_BANDWIDTH
-            mTotalBytesSent += mTSQueue->size();
-            int64_t delayUs = ALooper::GetNowUs() - mFirstPacketTimeUs;
+        mTotalBytesSent += size;
+        int64_t delayUs = ALooper::GetNowUs() - mFirstPacketTimeUs;
 
-            if (delayUs > 0ll) {
-                ALOGI("approx. net bandwidth used: %.2f Mbit/sec",
-                        mTotalBytesSent * 8.0 / delayUs);
-            }
-#endif
+        if (delayUs > 0ll) {
+            ALOGI("approx. net bandwidth used: %.2f Mbit/sec",
+                    mTotalBytesSent * 8.0 / delayUs);
         }
+#endif
+    }
 
 #if ENABLE_RETRANSMISSION
-        mTSQueue->setInt32Data(mRTPSeqNo - 1);
+    // The packetizer recycles its buffers, keep our own copy around.
+    sp<ABuffer> copy;
+    if (mHistoryLength >= kMaxHistoryLength) {
+        copy = *mHistory.begin();
+        mHistory.erase(mHistory.begin());
 
-        mHistory.push_back(mTSQueue);
-        ++mHistoryLength;
+        --mHistoryLength;
+    } else {
+        copy = new ABuffer(kMaxRTPPacketSize);
+    }
 
-        if (mHistoryLength > kMaxHistoryLength) {
-            mTSQueue = *mHistory.begin();
-            mHistory.erase(mHistory.begin());
+    memcpy(copy->data(), rtp, size);
+    copy->setRange(0, size);
+    copy->setInt32Data(mRTPSeqNo - 1);
 
-            --mHistoryLength;
-        } else {
-            mTSQueue = new ABuffer(12 + kMaxNumTSPacketsPerRTPPacket * 188);
-        }
+    mHistory.push_back(copy);
+    ++mHistoryLength;
 #endif
-
-        mTSQueue->setRange(0, 12);
-    }
-
-    return size;
 }
 
 void Sender::scheduleSendSR() {
@@ -926,8 +1007,17 @@ status_t Sender::parseRTCP(
         }
 
         switch (data[1]) {
-            case 200:
+            case 200:  // SR
+                if (headerLength >= 28) {
+                    parseReportBlocks(
+                            &data[28], headerLength - 28, data[0] & 0x1f);
+                }
+                break;
+
             case 201:  // RR
+                parseReportBlocks(&data[8], headerLength - 8, data[0] & 0x1f);
+                break;
+
             case 202:  // SDES
             case 203:
             case 204:  // APP
@@ -958,6 +1048,36 @@ status_t Sender::parseRTCP(
     return OK;
 }
 
+void Sender::parseReportBlocks(
+        const uint8_t *data, size_t size, size_t numBlocks) {
+    while (numBlocks-- > 0 && size >= 24) {
+        uint32_t ssrc = U32_AT(data);
+
+        if (ssrc == kSourceID) {
+            uint8_t fractionLost = data[4];
+
+            int32_t cumulativeLost = (data[5] << 16) | (data[6] << 8) | data[7];
+            if (cumulativeLost & 0x800000) {
+                // sign extend the 24 bit value.
+                cumulativeLost |= 0xff000000;
+            }
+
+            // interarrival jitter in units of the 90kHz RTP clock.
+            uint32_t jitter = U32_AT(&data[12]);
+
+            sp<AMessage> notify = mNotify->dup();
+            notify->setInt32("what", kWhatReceiverReport);
+            notify->setInt32("fractionLost", fractionLost);
+            notify->setInt32("cumulativeLost", cumulativeLost);
+            notify->setInt64("jitterUs", (jitter * 100ll) / 9ll);
+            notify->post();
+        }
+
+        data += 24;
+        size -= 24;
+    }
+}
+
 status_t Sender::sendPacket(
         int32_t sessionID, const void *data, size_t size) {
     return mNetSession->sendRequest(sessionID, data, size);
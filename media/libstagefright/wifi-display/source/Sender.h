@@ -36,6 +36,8 @@ struct Sender : public AHandler {
         kWhatInitDone,
         kWhatSessionDead,
         kWhatBinaryData,
+        kWhatLatencyStats,
+        kWhatReceiverReport,
     };
 
     enum TransportMode {
@@ -82,8 +84,6 @@ private:
     sp<ANetworkSession> mNetSession;
     sp<AMessage> mNotify;
 
-    sp<ABuffer> mTSQueue;
-
     TransportMode mTransportMode;
     AString mClientIP;
 
@@ -123,6 +123,25 @@ private:
 
     bool mSendSRPending;
 
+    // Frame-to-wire latency of video frames, from capture to the last
+    // RTP packet being handed to the network session.
+    int64_t mLatencyReportStartUs;
+    int32_t mNumLatencyFrames;
+    int64_t mTotalLatencyUs;
+    int64_t mMaxLatencyUs;
+
+    // How much later than scheduled the frames went out, without the
+    // intentional delay that paces them by their timestamps.
+    int64_t mTotalSendDelayUs;
+
+    // Largest backlog of RTP data waiting to go out on the network session
+    // since the last latency report.
+    size_t mMaxQueueSize;
+
+    // Percentage of RTP packets to drop on purpose, to exercise rate
+    // adaptation on a loopback link (media.wfd.emulate-packet-loss).
+    int32_t mEmulatedPacketLossPercent;
+
 #if ENABLE_RETRANSMISSION
     List<sp<ABuffer> > mHistory;
     size_t mHistoryLength;
@@ -142,16 +161,19 @@ private:
     FILE *mLogFile;
 #endif
 
-    ssize_t appendTSData(
-            const void *data, size_t size, bool timeDiscontinuity, bool flush);
+    // Fills in the RTP header at "rtp" and sends the packet.
+    void sendRTPPacket(uint8_t *rtp, size_t size, bool timeDiscontinuity);
 
     void onQueuePackets(const sp<ABuffer> &packets);
+    void updateLatencyStats(int64_t latencyUs, int64_t sendDelayUs);
 
 #if ENABLE_RETRANSMISSION
     status_t parseTSFB(const uint8_t *data, size_t size);
 #endif
 
     status_t parseRTCP(const sp<ABuffer> &buffer);
+    void parseReportBlocks(
+            const uint8_t *data, size_t size, size_t numBlocks);
 
     status_t sendPacket(int32_t sessionID, const void *data, size_t size);
 
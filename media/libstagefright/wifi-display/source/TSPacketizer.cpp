@@ -27,11 +27,32 @@
 #include <media/stagefright/foundation/hexdump.h>
 #include <media/stagefright/MediaDefs.h>
 #include <media/stagefright/MediaErrors.h>
+#include <utils/threads.h>
 
 #include <arpa/inet.h>
 
 namespace android {
 
+static const size_t kMaxBufferPoolSize = 16;
+
+static Mutex sCrcTableLock;
+static bool sCrcTableInitialized = false;
+
+// static
+uint32_t TSPacketizer::sCrcTable[256];
+
+// Returns the offset of the transport stream packet with the given index
+// within the output buffer.
+static size_t TSPacketOffset(size_t index, bool reserveRTPHeaders) {
+    if (!reserveRTPHeaders) {
+        return index * 188;
+    }
+
+    return index * 188
+        + (index / TSPacketizer::kNumTSPacketsPerRTPPacket + 1)
+            * TSPacketizer::kRTPHeaderSize;
+}
+
 struct TSPacketizer::Track : public RefBase {
     Track(const sp<AMessage> &format,
           unsigned PID, unsigned streamType, unsigned streamID);
@@ -322,7 +343,11 @@ void TSPacketizer::Track::finalize() {
 TSPacketizer::TSPacketizer()
     : mPATContinuityCounter(0),
       mPMTContinuityCounter(0) {
-    initCrcTable();
+    Mutex::Autolock autoLock(sCrcTableLock);
+    if (!sCrcTableInitialized) {
+        initCrcTable();
+        sCrcTableInitialized = true;
+    }
 }
 
 TSPacketizer::~TSPacketizer() {
@@ -472,8 +497,14 @@ status_t TSPacketizer::packetize(
         ++numTSPackets;
     }
 
-    sp<ABuffer> buffer = new ABuffer(numTSPackets * 188);
-    uint8_t *packetDataStart = buffer->data();
+    bool reserveRTPHeaders = (flags & RESERVE_RTP_HEADERS) != 0;
+
+    sp<ABuffer> buffer = acquireBuffer(
+            TSPacketOffset(numTSPackets - 1, reserveRTPHeaders) + 188);
+
+    size_t packetIndex = 0;
+    uint8_t *packetDataStart =
+        buffer->data() + TSPacketOffset(packetIndex, reserveRTPHeaders);
 
     if (flags & EMIT_PAT_AND_PMT) {
         // Program Association Table (PAT):
@@ -537,7 +568,8 @@ status_t TSPacketizer::packetize(
         size_t sizeLeft = packetDataStart + 188 - ptr;
         memset(ptr, 0xff, sizeLeft);
 
-        packetDataStart += 188;
+        packetDataStart =
+            buffer->data() + TSPacketOffset(++packetIndex, reserveRTPHeaders);
 
         // Program Map (PMT):
         // 0x47
@@ -638,7 +670,8 @@ status_t TSPacketizer::packetize(
         sizeLeft = packetDataStart + 188 - ptr;
         memset(ptr, 0xff, sizeLeft);
 
-        packetDataStart += 188;
+        packetDataStart =
+            buffer->data() + TSPacketOffset(++packetIndex, reserveRTPHeaders);
     }
 
     if (flags & EMIT_PCR) {
@@ -686,7 +719,8 @@ status_t TSPacketizer::packetize(
         size_t sizeLeft = packetDataStart + 188 - ptr;
         memset(ptr, 0xff, sizeLeft);
 
-        packetDataStart += 188;
+        packetDataStart =
+            buffer->data() + TSPacketOffset(++packetIndex, reserveRTPHeaders);
     }
 
     uint64_t PTS = (timeUs * 9ll) / 100ll;
@@ -762,7 +796,8 @@ status_t TSPacketizer::packetize(
     CHECK_EQ(sizeLeft, copy);
     memset(ptr, 0xff, sizeLeft - copy);
 
-    packetDataStart += 188;
+    packetDataStart =
+        buffer->data() + TSPacketOffset(++packetIndex, reserveRTPHeaders);
 
     size_t offset = copy;
     while (offset < accessUnit->size()) {
@@ -810,16 +845,39 @@ status_t TSPacketizer::packetize(
         memset(ptr, 0xff, sizeLeft - copy);
 
         offset += copy;
-        packetDataStart += 188;
+        packetDataStart =
+            buffer->data() + TSPacketOffset(++packetIndex, reserveRTPHeaders);
     }
 
-    CHECK(packetDataStart == buffer->data() + buffer->capacity());
+    CHECK_EQ(packetIndex, numTSPackets);
 
     *packets = buffer;
 
     return OK;
 }
 
+sp<ABuffer> TSPacketizer::acquireBuffer(size_t size) {
+    for (size_t i = 0; i < mBufferPool.size(); ++i) {
+        const sp<ABuffer> &buffer = mBufferPool.itemAt(i);
+
+        // Only the pool still references this buffer.
+        if (buffer->getStrongCount() == 1 && buffer->capacity() >= size) {
+            buffer->setRange(0, size);
+            buffer->meta()->clear();
+            return buffer;
+        }
+    }
+
+    sp<ABuffer> buffer = new ABuffer(size);
+
+    if (mBufferPool.size() < kMaxBufferPoolSize) {
+        mBufferPool.push(buffer);
+    }
+
+    return buffer;
+}
+
+// static
 void TSPacketizer::initCrcTable() {
     uint32_t poly = 0x04C11DB7;
 
@@ -828,16 +886,17 @@ void TSPacketizer::initCrcTable() {
         for (int j = 0; j < 8; j++) {
             crc = (crc << 1) ^ ((crc & 0x80000000) ? (poly) : 0);
         }
-        mCrcTable[i] = crc;
+        sCrcTable[i] = crc;
     }
 }
 
-uint32_t TSPacketizer::crc32(const uint8_t *start, size_t size) const {
+// static
+uint32_t TSPacketizer::crc32(const uint8_t *start, size_t size) {
     uint32_t crc = 0xFFFFFFFF;
     const uint8_t *p;
 
     for (p = start; p < start + size; ++p) {
-        crc = (crc << 8) ^ mCrcTable[((crc >> 24) ^ *p) & 0xFF];
+        crc = (crc << 8) ^ sCrcTable[((crc >> 24) ^ *p) & 0xFF];
     }
 
     return crc;
@@ -42,7 +42,18 @@ struct TSPacketizer : public RefBase {
         EMIT_PCR                        = 2,
         IS_ENCRYPTED                    = 4,
         PREPEND_SPS_PPS_TO_IDR_FRAMES   = 8,
+
+        // Leave room for an RTP header in front of every run of
+        // kNumTSPacketsPerRTPPacket transport stream packets, the sender
+        // fills in the headers and transmits the packets in place.
+        RESERVE_RTP_HEADERS             = 16,
+    };
+
+    enum {
+        kRTPHeaderSize              = 12,
+        kNumTSPacketsPerRTPPacket   = 7,  // (1500 - 12) / 188
     };
+
     status_t packetize(
             size_t trackIndex, const sp<ABuffer> &accessUnit,
             sp<ABuffer> *packets,
@@ -68,13 +79,18 @@ private:
 
     Vector<sp<Track> > mTracks;
 
+    // Output buffers are recycled once the sender is done with them.
+    Vector<sp<ABuffer> > mBufferPool;
+
     unsigned mPATContinuityCounter;
     unsigned mPMTContinuityCounter;
 
-    uint32_t mCrcTable[256];
+    static uint32_t sCrcTable[256];
+
+    static void initCrcTable();
+    static uint32_t crc32(const uint8_t *start, size_t size);
 
-    void initCrcTable();
-    uint32_t crc32(const uint8_t *start, size_t size) const;
+    sp<ABuffer> acquireBuffer(size_t size);
 
     DISALLOW_EVIL_CONSTRUCTORS(TSPacketizer);
 };
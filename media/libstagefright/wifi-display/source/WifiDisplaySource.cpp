@@ -102,6 +102,24 @@ status_t WifiDisplaySource::stop() {
     return err;
 }
 
+status_t WifiDisplaySource::dump(int fd, const Vector<String16> &args) {
+    sp<AMessage> msg = new AMessage(kWhatDump, id());
+
+    sp<AMessage> response;
+    status_t err = msg->postAndAwaitResponse(&response);
+
+    if (err != OK) {
+        return err;
+    }
+
+    AString out;
+    CHECK(response->findString("dump", &out));
+
+    write(fd, out.c_str(), out.size());
+
+    return OK;
+}
+
 void WifiDisplaySource::onMessageReceived(const sp<AMessage> &msg) {
     switch (msg->what()) {
         case kWhatStart:
@@ -434,6 +452,22 @@ void WifiDisplaySource::onMessageReceived(const sp<AMessage> &msg) {
             break;
         }
 
+        case kWhatDump:
+        {
+            uint32_t replyID;
+            CHECK(msg->senderAwaitsResponse(&replyID));
+
+            AString out = "WifiDisplaySource\n";
+            if (mClientInfo.mPlaybackSession != NULL) {
+                mClientInfo.mPlaybackSession->dump(&out);
+            }
+
+            sp<AMessage> response = new AMessage;
+            response->setString("dump", out.c_str());
+            response->postReply(replyID);
+            break;
+        }
+
         default:
             TRESPASS();
     }
@@ -21,6 +21,8 @@
 #include "ANetworkSession.h"
 
 #include <media/stagefright/foundation/AHandler.h>
+#include <utils/String16.h>
+#include <utils/Vector.h>
 
 #include <netinet/in.h>
 
@@ -42,6 +44,8 @@ struct WifiDisplaySource : public AHandler {
     status_t start(const char *iface);
     status_t stop();
 
+    status_t dump(int fd, const Vector<String16> &args);
+
 protected:
     virtual ~WifiDisplaySource();
     virtual void onMessageReceived(const sp<AMessage> &msg);
@@ -72,6 +76,7 @@ private:
         kWhatHDCPNotify,
         kWhatFinishStop2,
         kWhatTeardownTriggerTimedOut,
+        kWhatDump,
     };
 
     struct ResponseID {
@@ -31,7 +31,10 @@
 namespace android {
 
 struct TestHandler : public AHandler {
-    TestHandler(const sp<ANetworkSession> &netSession);
+    TestHandler(
+            const sp<ANetworkSession> &netSession,
+            size_t burstSize = 1,
+            size_t packetSize = 12);
 
     void startServer(unsigned localPort);
     void startClient(const char *remoteHost, unsigned remotePort);
@@ -58,19 +61,42 @@ private:
     double mTotalTimeUs;
     int32_t mCount;
 
+    // Throughput mode, "mBurstSize" packets of "mPacketSize" bytes
+    // are sent per tick and statistics are reported once per second.
+    size_t mBurstSize;
+    size_t mPacketSize;
+    int64_t mStatsStartUs;
+    int32_t mStatsCount;
+    int64_t mStatsMinUs;
+    int64_t mStatsMaxUs;
+    double mStatsTotalUs;
+
+    void sendPacket();
+    void updateStats(int64_t roundTripUs, int64_t nowUs);
     void postSendPacket(int64_t delayUs = 0ll);
 
     DISALLOW_EVIL_CONSTRUCTORS(TestHandler);
 };
 
-TestHandler::TestHandler(const sp<ANetworkSession> &netSession)
+TestHandler::TestHandler(
+        const sp<ANetworkSession> &netSession,
+        size_t burstSize,
+        size_t packetSize)
     : mNetSession(netSession),
       mIsServer(false),
       mConnected(false),
       mUDPSession(0),
       mSeqNo(0),
       mTotalTimeUs(0.0),
-      mCount(0) {
+      mCount(0),
+      mBurstSize(burstSize),
+      mPacketSize(packetSize),
+      mStatsStartUs(-1ll),
+      mStatsCount(0),
+      mStatsMinUs(0ll),
+      mStatsMaxUs(0ll),
+      mStatsTotalUs(0.0) {
+    CHECK_GE(mPacketSize, 12u);
 }
 
 TestHandler::~TestHandler() {
@@ -131,28 +157,9 @@ void TestHandler::onMessageReceived(const sp<AMessage> &msg) {
 
         case kWhatSendPacket:
         {
-            char buffer[12];
-            memset(buffer, 0, sizeof(buffer));
-
-            buffer[0] = mSeqNo >> 24;
-            buffer[1] = (mSeqNo >> 16) & 0xff;
-            buffer[2] = (mSeqNo >> 8) & 0xff;
-            buffer[3] = mSeqNo & 0xff;
-            ++mSeqNo;
-
-            int64_t nowUs = ALooper::GetNowUs();
-            buffer[4] = nowUs >> 56;
-            buffer[5] = (nowUs >> 48) & 0xff;
-            buffer[6] = (nowUs >> 40) & 0xff;
-            buffer[7] = (nowUs >> 32) & 0xff;
-            buffer[8] = (nowUs >> 24) & 0xff;
-            buffer[9] = (nowUs >> 16) & 0xff;
-            buffer[10] = (nowUs >> 8) & 0xff;
-            buffer[11] = nowUs & 0xff;
-
-            CHECK_EQ((status_t)OK,
-                     mNetSession->sendRequest(
-                         mUDPSession, buffer, sizeof(buffer)));
+            for (size_t i = 0; i < mBurstSize; ++i) {
+                sendPacket();
+            }
 
             postSendPacket(20000ll);
             break;
@@ -228,15 +235,20 @@ void TestHandler::onMessageReceived(const sp<AMessage> &msg) {
                                  mNetSession->sendRequest(
                                      mUDPSession, buffer->data(), buffer->size()));
                     } else {
-                        CHECK_EQ(data->size(), 20u);
+                        CHECK_EQ(data->size(), mPacketSize + 8);
 
                         uint32_t seqNo = U32_AT(data->data());
                         int64_t t1 = U64_AT(data->data() + 4);
-                        int64_t t2 = U64_AT(data->data() + 12);
+                        int64_t t2 = U64_AT(data->data() + mPacketSize);
 
                         int64_t t3;
                         CHECK(data->meta()->findInt64("arrivalTimeUs", &t3));
 
+                        if (mBurstSize > 1) {
+                            updateStats(t3 - t1, t3);
+                            break;
+                        }
+
 #if 0
                         printf("roundtrip seqNo %u, time = %lld us\n",
                                seqNo, t3 - t1);
@@ -261,6 +273,68 @@ void TestHandler::onMessageReceived(const sp<AMessage> &msg) {
     }
 }
 
+void TestHandler::sendPacket() {
+    sp<ABuffer> packet = new ABuffer(mPacketSize);
+    uint8_t *buffer = packet->data();
+    memset(buffer, 0, mPacketSize);
+
+    buffer[0] = mSeqNo >> 24;
+    buffer[1] = (mSeqNo >> 16) & 0xff;
+    buffer[2] = (mSeqNo >> 8) & 0xff;
+    buffer[3] = mSeqNo & 0xff;
+    ++mSeqNo;
+
+    int64_t nowUs = ALooper::GetNowUs();
+    buffer[4] = nowUs >> 56;
+    buffer[5] = (nowUs >> 48) & 0xff;
+    buffer[6] = (nowUs >> 40) & 0xff;
+    buffer[7] = (nowUs >> 32) & 0xff;
+    buffer[8] = (nowUs >> 24) & 0xff;
+    buffer[9] = (nowUs >> 16) & 0xff;
+    buffer[10] = (nowUs >> 8) & 0xff;
+    buffer[11] = nowUs & 0xff;
+
+    CHECK_EQ((status_t)OK,
+             mNetSession->sendRequest(
+                 mUDPSession, packet->data(), packet->size()));
+}
+
+void TestHandler::updateStats(int64_t roundTripUs, int64_t nowUs) {
+    if (mStatsStartUs < 0ll) {
+        mStatsStartUs = nowUs;
+    }
+
+    if (mStatsCount == 0 || roundTripUs < mStatsMinUs) {
+        mStatsMinUs = roundTripUs;
+    }
+
+    if (mStatsCount == 0 || roundTripUs > mStatsMaxUs) {
+        mStatsMaxUs = roundTripUs;
+    }
+
+    mStatsTotalUs += roundTripUs;
+    ++mStatsCount;
+
+    int64_t elapsedUs = nowUs - mStatsStartUs;
+    if (elapsedUs < 1000000ll) {
+        return;
+    }
+
+    double packetsPerSec = mStatsCount * 1E6 / elapsedUs;
+
+    printf("%.1f packets/sec (%.2f Mbit/sec), roundtrip "
+           "avg %.2f us, min %lld us, max %lld us\n",
+           packetsPerSec,
+           packetsPerSec * mPacketSize * 8 / 1E6,
+           mStatsTotalUs / mStatsCount,
+           mStatsMinUs,
+           mStatsMaxUs);
+
+    mStatsStartUs = nowUs;
+    mStatsCount = 0;
+    mStatsTotalUs = 0.0;
+}
+
 void TestHandler::postSendPacket(int64_t delayUs) {
     (new AMessage(kWhatSendPacket, id()))->post(delayUs);
 }
@@ -270,7 +344,10 @@ void TestHandler::postSendPacket(int64_t delayUs) {
 static void usage(const char *me) {
     fprintf(stderr,
             "usage: %s -c host[:port]\tconnect to test server\n"
-            "           -l            \tcreate a test server\n",
+            "           -l            \tcreate a test server\n"
+            "           -b count      \tsend bursts of count packets "
+            "(throughput mode)\n"
+            "           -s size       \tpacket size in bytes (default 12)\n",
             me);
 }
 
@@ -282,9 +359,11 @@ int main(int argc, char **argv) {
     int32_t localPort = -1;
     int32_t connectToPort = -1;
     AString connectToHost;
+    int32_t burstSize = 1;
+    int32_t packetSize = 12;
 
     int res;
-    while ((res = getopt(argc, argv, "hc:l:")) >= 0) {
+    while ((res = getopt(argc, argv, "hc:l:b:s:")) >= 0) {
         switch (res) {
             case 'c':
             {
@@ -321,6 +400,31 @@ int main(int argc, char **argv) {
                 break;
             }
 
+            case 'b':
+            {
+                char *end;
+                burstSize = strtol(optarg, &end, 10);
+
+                if (*end != '\0' || end == optarg || burstSize < 1) {
+                    fprintf(stderr, "Illegal burst size specified.\n");
+                    exit(1);
+                }
+                break;
+            }
+
+            case 's':
+            {
+                char *end;
+                packetSize = strtol(optarg, &end, 10);
+
+                if (*end != '\0' || end == optarg
+                        || packetSize < 12 || packetSize > 1464) {
+                    fprintf(stderr, "Illegal packet size specified.\n");
+                    exit(1);
+                }
+                break;
+            }
+
             case '?':
             case 'h':
                 usage(argv[0]);
@@ -339,7 +443,8 @@ int main(int argc, char **argv) {
 
     sp<ALooper> looper = new ALooper;
 
-    sp<TestHandler> handler = new TestHandler(netSession);
+    sp<TestHandler> handler =
+        new TestHandler(netSession, burstSize, packetSize);
     looper->registerHandler(handler);
 
     if (localPort >= 0) {
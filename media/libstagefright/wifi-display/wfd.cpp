@@ -27,15 +27,41 @@
 #include <media/stagefright/DataSource.h>
 #include <media/stagefright/foundation/ADebug.h>
 
+#include <pthread.h>
+
 namespace android {
 
+struct DumpThreadParams {
+    sp<WifiDisplaySink> mSink;
+    int32_t mIntervalSecs;
+};
+
+// Prints the sink's statistics every so often while it runs.
+static void *dumpThread(void *me) {
+    DumpThreadParams *params = static_cast<DumpThreadParams *>(me);
+
+    Vector<String16> args;
+    for (;;) {
+        sleep(params->mIntervalSecs);
+
+        if (params->mSink->dump(STDOUT_FILENO, args) != OK) {
+            break;
+        }
+    }
+
+    delete params;
+
+    return NULL;
+}
+
 }  // namespace android
 
 static void usage(const char *me) {
     fprintf(stderr,
             "usage:\n"
             "           %s -c host[:port]\tconnect to wifi source\n"
-            "           -u uri        \tconnect to an rtsp uri\n",
+            "           -u uri        \tconnect to an rtsp uri\n"
+            "           -d seconds    \tprint sink statistics periodically\n",
             me);
 }
 
@@ -49,9 +75,10 @@ int main(int argc, char **argv) {
     AString connectToHost;
     int32_t connectToPort = -1;
     AString uri;
+    int32_t dumpIntervalSecs = 0;
 
     int res;
-    while ((res = getopt(argc, argv, "hc:l:u:")) >= 0) {
+    while ((res = getopt(argc, argv, "hc:l:u:d:")) >= 0) {
         switch (res) {
             case 'c':
             {
@@ -81,6 +108,16 @@ int main(int argc, char **argv) {
                 break;
             }
 
+            case 'd':
+            {
+                dumpIntervalSecs = atoi(optarg);
+                if (dumpIntervalSecs < 1) {
+                    fprintf(stderr, "Illegal dump interval specified.\n");
+                    exit(1);
+                }
+                break;
+            }
+
             case '?':
             case 'h':
             default:
@@ -117,6 +154,16 @@ int main(int argc, char **argv) {
         sink->start(uri.c_str());
     }
 
+    if (dumpIntervalSecs > 0) {
+        DumpThreadParams *params = new DumpThreadParams;
+        params->mSink = sink;
+        params->mIntervalSecs = dumpIntervalSecs;
+
+        pthread_t thread;
+        CHECK_EQ(pthread_create(&thread, NULL, dumpThread, params), 0);
+        pthread_detach(thread);
+    }
+
     looper->start(true /* runOnCallingThread */);
 
     return 0;
@@ -57,6 +57,7 @@
 
 #include <media/EffectsFactoryApi.h>
 #include <audio_effects/effect_visualizer.h>
+#include <media/EffectVisualizerApi.h>
 #include <audio_effects/effect_ns.h>
 #include <audio_effects/effect_aec.h>
 
@@ -9165,9 +9166,17 @@ status_t AudioFlinger::EffectHandle::command(uint32_t cmdCode,
 //    ALOGV("command(), cmdCode: %d, mHasControl: %d, mEffect: %p",
 //              cmdCode, mHasControl, (mEffect == 0) ? 0 : mEffect.get());
 
-    // only get parameter command is permitted for applications not controlling the effect
+    // only get parameter command is permitted for applications not controlling the effect,
+    // and the visualizer's commands that only read the captured audio: that way any
+    // number of clients can visualize the same session
     if (!mHasControl && cmdCode != EFFECT_CMD_GET_PARAM) {
-        return INVALID_OPERATION;
+        if (mEffect == 0 ||
+                memcmp(&mEffect->desc().type, SL_IID_VISUALIZATION, sizeof(effect_uuid_t)) != 0 ||
+                (cmdCode != VISUALIZER_CMD_CAPTURE &&
+                 cmdCode != VISUALIZER_CMD_MEASURE &&
+                 cmdCode != VISUALIZER_CMD_READ)) {
+            return INVALID_OPERATION;
+        }
     }
     if (mEffect == 0) return DEAD_OBJECT;
     if (mClient == 0) return INVALID_OPERATION;